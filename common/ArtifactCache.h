@@ -0,0 +1,189 @@
+/**
+ * @file ArtifactCache.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Content-addressed store for data that modules derive from their inputs
+ * at startup (chart parameterizations, texture atlases etc.). An artifact
+ * is looked up by a key hashed from everything it is computed from: the
+ * input data itself or, for large inputs, the stamps of their files, plus
+ * the settings of the computation. Every key is a binary cache file of its
+ * own, so the artifacts of several configurations live side by side and
+ * switching between them stays a hit. Only the SF_ARTIFACT_VERSIONS most
+ * recently used files of each artifact are kept.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+}
+
+#include "Preprocess.h"
+#include "crc32.h"
+#include "BinaryCache.h"
+
+using namespace std;
+
+namespace SF {
+
+  static const unsigned int SF_ARTIFACT_VERSIONS = 4; // files kept for every artifact
+
+  class ArtifactKey {
+
+  protected:
+    uint32_t _remainder;
+
+  public:
+    ArtifactKey ()
+    : _remainder (SF_CRC32_INITIAL_REMAINDER)
+    { }
+
+    inline ArtifactKey &
+    add (const void *data, size_t size)
+    {
+      if (size){
+        _remainder = crc32Update (_remainder, static_cast <const char *> (data), size);
+      }
+      return *this;
+    }
+
+    template <class T>
+    inline ArtifactKey & add (const T &value) { return add (&value, sizeof (T)); }
+
+    template <class T>
+    inline ArtifactKey &
+    add (const vector <T> &v)
+    {
+      uint64_t size = v.size ();
+      add (size);
+      return add (v.empty () ? NULL : &(v [0]), v.size () * sizeof (T));
+    }
+
+    inline ArtifactKey & add (const string &s) { return add (s.c_str (), s.size () + 1); }
+
+    // method to add a file by its stamp (name, size and modification time); false if it is missing
+    inline bool
+    addFile (const string &file)
+    {
+      vector <string> files (1, file);
+      uint32_t stamp = 0;
+      if (!sourceStamp (files, stamp)){
+        return false;
+      }
+      add (stamp);
+      return true;
+    }
+
+    inline uint32_t value () const { return crc32Final (_remainder); }
+  };
+
+  class ArtifactCache {
+
+  protected:
+    string _folder; // empty while the store is closed
+
+  public:
+    ArtifactCache () { }
+
+    // method to keep the store in folder, creating it if needed (false leaves the store closed)
+    inline bool
+    open (const string &folder)
+    {
+      _folder.clear ();
+      if (folder.empty () || (mkdir (folder.c_str (), 0755) && errno != EEXIST)){
+        PRINT ("warning: could not create artifact cache %s\n", folder.c_str ());
+        return false;
+      }
+      _folder = folder;
+      if (_folder [_folder.size () - 1] != '/'){
+        _folder.append ("/");
+      }
+      return true;
+    }
+
+    inline bool isOpen () const { return !_folder.empty (); }
+
+    inline string
+    file (const string &name, uint32_t key) const
+    {
+      char keyStr [32];
+      sprintf (keyStr, ".%08x.cache", key);
+      return _folder + name + keyStr;
+    }
+
+    // method to map an artifact (false if the store is closed or has none for key)
+    inline bool
+    read (const string &name, uint32_t kind, uint32_t key, BinaryCacheReader &reader) const
+    {
+      if (!isOpen () || !reader.open (file (name, key), kind, key)){
+        return false;
+      }
+      utimes (file (name, key).c_str (), NULL); // mark as recently used
+      return true;
+    }
+
+    inline bool
+    write (const string &name, uint32_t kind, uint32_t key, const BinaryCacheWriter &writer) const
+    {
+      if (!isOpen () || !writer.write (file (name, key), kind, key)){
+        return false;
+      }
+      prune (name);
+      return true;
+    }
+
+  protected:
+    // method to remove all but the most recently used files of an artifact
+    inline void
+    prune (const string &name) const
+    {
+      DIR *dir = opendir (_folder.c_str ());
+      if (!dir){
+        return;
+      }
+      vector <pair <time_t, string> > files;
+      string prefix (name + ".");
+      for (struct dirent *entry = readdir (dir); entry; entry = readdir (dir)){
+        string entryName (entry->d_name);
+        if (entryName.size () == prefix.size () + 14 && !entryName.compare (0, prefix.size (), prefix)
+            && !entryName.compare (entryName.size () - 6, 6, ".cache")){
+          struct stat st;
+          if (!stat ((_folder + entryName).c_str (), &st)){
+            files.push_back (make_pair (st.st_mtime, entryName));
+          }
+        }
+      }
+      closedir (dir);
+
+      if (files.size () > SF_ARTIFACT_VERSIONS){
+        sort (files.rbegin (), files.rend ());
+        for (size_t i = SF_ARTIFACT_VERSIONS; i < files.size (); ++i){
+          remove ((_folder + files [i].second).c_str ());
+        }
+      }
+    }
+  };
+}
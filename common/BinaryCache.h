@@ -0,0 +1,341 @@
+/**
+ * @file BinaryCache.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Versioned binary container for data that is slow to produce from its
+ * source files (e.g. meshes parsed from text). A container is a header, a
+ * table of sections and the raw arrays of the sections, each aligned to
+ * SF_BINARY_CACHE_ALIGNMENT bytes. The header records a stamp of the
+ * source files (names, sizes and modification times), so a container is
+ * ignored as soon as any of its sources changes. Containers are read
+ * through a memory mapping: arrays are taken straight from the mapped
+ * pages, nothing is parsed. The header and section table are always checksummed; the
+ * arrays are checked in debug builds only, since a container is written
+ * to a temporary file and renamed into place, so it is never seen half
+ * written.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+#include "Preprocess.h"
+#include "crc32.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+namespace SF {
+
+  static const char SF_BINARY_CACHE_MAGIC [8] = {'S', 'F', 'C', 'A', 'C', 'H', 'E', '\0'};
+  static const uint32_t SF_BINARY_CACHE_VERSION = 1;
+  static const uint64_t SF_BINARY_CACHE_ALIGNMENT = 64;
+
+  struct BinaryCacheHeader {
+    char _magic [8];
+    uint32_t _version; // version of the container layout
+    uint32_t _kind; // what the container holds, including the version of its contents (set by the user)
+    uint32_t _stamp; // stamp of the source files
+    uint32_t _numSections;
+    uint32_t _dataChecksum; // crc32 of everything after the section table
+    uint32_t _headerChecksum; // crc32 of the header (with this field 0) and the section table
+  };
+
+  struct BinaryCacheSection {
+    uint32_t _id;
+    uint32_t _elementSize;
+    uint64_t _count;
+    uint64_t _offset; // from the start of the file
+  };
+
+  /**
+   * Method to compute the stamp of a set of source files from their names,
+   * sizes and modification times. Returns false if any of them is missing.
+   */
+  static inline bool
+  sourceStamp (const vector <string> &files, uint32_t &stamp)
+  {
+    uint32_t remainder = SF_CRC32_INITIAL_REMAINDER;
+    for (size_t i = 0; i < files.size (); ++i){
+      struct stat st;
+      if (stat (files [i].c_str (), &st)){
+        return false;
+      }
+      int64_t info [3] = {static_cast <int64_t> (st.st_size), static_cast <int64_t> (st.st_mtim.tv_sec), static_cast <int64_t> (st.st_mtim.tv_nsec)};
+      remainder = crc32Update (remainder, files [i].c_str (), files [i].size () + 1);
+      remainder = crc32Update (remainder, reinterpret_cast <const char *> (info), sizeof (info));
+    }
+    stamp = crc32Final (remainder);
+    return true;
+  }
+
+  class BinaryCacheReader {
+
+  protected:
+    MappedFile _file;
+    const BinaryCacheHeader *_header;
+    const BinaryCacheSection *_sections;
+
+  public:
+    BinaryCacheReader ()
+    : _header (NULL), _sections (NULL)
+    { }
+
+    /**
+     * Method to map a container. Fails quietly (returns false) if the file is
+     * missing, of another layout version or kind, made from other sources or
+     * damaged; the caller then reads the sources and writes a new container.
+     */
+    inline bool
+    open (const string &file, uint32_t kind, uint32_t stamp)
+    {
+      close ();
+      if (!_file.open (file) || _file.size () < sizeof (BinaryCacheHeader)){
+        close ();
+        return false;
+      }
+
+      BinaryCacheHeader header;
+      memcpy (&header, _file.data (), sizeof (BinaryCacheHeader));
+      uint64_t tableEnd = sizeof (BinaryCacheHeader) + static_cast <uint64_t> (header._numSections) * sizeof (BinaryCacheSection);
+      if (memcmp (header._magic, SF_BINARY_CACHE_MAGIC, sizeof (SF_BINARY_CACHE_MAGIC)) || header._version != SF_BINARY_CACHE_VERSION
+          || header._kind != kind || header._stamp != stamp || tableEnd > _file.size ()){
+        close ();
+        return false;
+      }
+
+      uint32_t checksum = header._headerChecksum;
+      header._headerChecksum = 0;
+      uint32_t remainder = crc32Update (SF_CRC32_INITIAL_REMAINDER, reinterpret_cast <const char *> (&header), sizeof (BinaryCacheHeader));
+      remainder = crc32Update (remainder, _file.data () + sizeof (BinaryCacheHeader), tableEnd - sizeof (BinaryCacheHeader));
+      if (crc32Final (remainder) != checksum){
+        PRINT ("warning: damaged cache file %s ignored\n", file.c_str ());
+        close ();
+        return false;
+      }
+
+      _header = reinterpret_cast <const BinaryCacheHeader *> (_file.data ());
+      _sections = reinterpret_cast <const BinaryCacheSection *> (_file.data () + sizeof (BinaryCacheHeader));
+      for (uint32_t i = 0; i < _header->_numSections; ++i){
+        if (_sections [i]._offset % SF_BINARY_CACHE_ALIGNMENT
+            || _sections [i]._offset + _sections [i]._count * _sections [i]._elementSize > _file.size ()
+            || (i && _sections [i]._id <= _sections [i - 1]._id)){
+          PRINT ("warning: damaged cache file %s ignored\n", file.c_str ());
+          close ();
+          return false;
+        }
+      }
+
+#ifndef NDEBUG
+      if (crc32 (_file.data () + tableEnd, _file.size () - tableEnd) != _header->_dataChecksum){
+        PRINT ("warning: damaged cache file %s ignored\n", file.c_str ());
+        close ();
+        return false;
+      }
+#endif
+      return true;
+    }
+
+    inline void
+    close ()
+    {
+      _file.close ();
+      _header = NULL;
+      _sections = NULL;
+    }
+
+    inline bool isOpen () const { return _header != NULL; }
+
+    // method to get the array of a section in place (false if there is none with elements of type T)
+    template <class T>
+    inline bool
+    get (uint32_t id, const T *&data, size_t &count) const
+    {
+      assert (_header);
+
+      // sections are stored sorted by id
+      uint32_t lo = 0, hi = _header->_numSections;
+      while (lo < hi){
+        uint32_t mid = (lo + hi)/ 2;
+        if (_sections [mid]._id < id){
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (lo == _header->_numSections || _sections [lo]._id != id || _sections [lo]._elementSize != sizeof (T)){
+        return false;
+      }
+      data = reinterpret_cast <const T *> (_file.data () + _sections [lo]._offset);
+      count = static_cast <size_t> (_sections [lo]._count);
+      return true;
+    }
+
+    // method to copy a section into a vector
+    template <class T>
+    inline bool
+    get (uint32_t id, vector <T> &v) const
+    {
+      const T *data = NULL;
+      size_t count = 0;
+      if (!get (id, data, count)){
+        return false;
+      }
+      v.assign (data, data + count);
+      return true;
+    }
+
+  private:
+    BinaryCacheReader (const BinaryCacheReader &);
+    BinaryCacheReader & operator = (const BinaryCacheReader &);
+  };
+
+  class BinaryCacheWriter {
+
+  protected:
+    struct Block {
+      uint32_t _id;
+      uint32_t _elementSize;
+      uint64_t _count;
+      const char *_data;
+    };
+    vector <Block> _blocks;
+    list <vector <char> > _copies; // data of sections built just for the container
+
+  public:
+    // method to add a section; the data is only read when the container is written
+    template <class T>
+    inline void
+    add (uint32_t id, const T *data, size_t count)
+    {
+      Block b;
+      b._id = id;
+      b._elementSize = sizeof (T);
+      b._count = count;
+      b._data = reinterpret_cast <const char *> (data);
+      _blocks.push_back (b);
+    }
+
+    template <class T>
+    inline void
+    add (uint32_t id, const vector <T> &v)
+    {
+      add (id, v.empty () ? static_cast <const T *> (NULL) : &(v [0]), v.size ());
+    }
+
+    // method to add a section from a temporary array; the data is copied
+    template <class T>
+    inline void
+    copy (uint32_t id, const vector <T> &v)
+    {
+      const char *data = v.empty () ? NULL : reinterpret_cast <const char *> (&(v [0]));
+      _copies.push_back (vector <char> (data, data + v.size () * sizeof (T)));
+      add (id, v.empty () ? static_cast <const T *> (NULL) : reinterpret_cast <const T *> (&(_copies.back () [0])), v.size ());
+    }
+
+    /**
+     * Method to write the container. It is written next to file and renamed
+     * over it when complete. Returns false (after a warning) if it could not
+     * be written, e.g. because the data folder is read-only.
+     */
+    inline bool
+    write (const string &file, uint32_t kind, uint32_t stamp) const
+    {
+      // the temporary name is unique per process, so two processes building the same container do not write into one file
+      char suffix [32];
+      sprintf (suffix, ".%ld.tmp", static_cast <long> (getpid ()));
+      string tmpFile (file);
+      tmpFile.append (suffix);
+      FILE *fp = fopen (tmpFile.c_str (), "wb");
+      if (!fp){
+        PRINT ("warning: could not write cache file %s\n", file.c_str ());
+        return false;
+      }
+
+      BinaryCacheHeader header;
+      memset (&header, 0, sizeof (BinaryCacheHeader));
+      memcpy (header._magic, SF_BINARY_CACHE_MAGIC, sizeof (SF_BINARY_CACHE_MAGIC));
+      header._version = SF_BINARY_CACHE_VERSION;
+      header._kind = kind;
+      header._stamp = stamp;
+      header._numSections = static_cast <uint32_t> (_blocks.size ());
+
+      // sections are stored sorted by id, so readers can search for them
+      vector <Block> blocks (_blocks);
+      stable_sort (blocks.begin (), blocks.end (), &BinaryCacheWriter::precedes);
+
+      vector <BinaryCacheSection> sections (blocks.size ());
+      uint64_t tableEnd = sizeof (BinaryCacheHeader) + sections.size () * sizeof (BinaryCacheSection);
+      uint64_t offset = tableEnd;
+      for (size_t i = 0; i < blocks.size (); ++i){
+        offset = (offset + SF_BINARY_CACHE_ALIGNMENT - 1)/ SF_BINARY_CACHE_ALIGNMENT * SF_BINARY_CACHE_ALIGNMENT;
+        assert (!i || blocks [i]._id != blocks [i - 1]._id);
+        sections [i]._id = blocks [i]._id;
+        sections [i]._elementSize = blocks [i]._elementSize;
+        sections [i]._count = blocks [i]._count;
+        sections [i]._offset = offset;
+        offset += blocks [i]._count * blocks [i]._elementSize;
+      }
+
+      // header and table are written last, once the data checksum is known
+      bool ok = !fseek (fp, static_cast <long> (tableEnd), SEEK_SET);
+      const char zeros [SF_BINARY_CACHE_ALIGNMENT] = {0};
+      uint32_t remainder = SF_CRC32_INITIAL_REMAINDER;
+      uint64_t position = tableEnd;
+      for (size_t i = 0; ok && i < blocks.size (); ++i){
+        size_t padding = static_cast <size_t> (sections [i]._offset - position);
+        size_t bytes = static_cast <size_t> (blocks [i]._count * blocks [i]._elementSize);
+        ok = fwrite (zeros, 1, padding, fp) == padding && (!bytes || fwrite (blocks [i]._data, 1, bytes, fp) == bytes);
+        remainder = crc32Update (remainder, zeros, padding);
+        remainder = crc32Update (remainder, blocks [i]._data, bytes);
+        position = sections [i]._offset + bytes;
+      }
+      header._dataChecksum = crc32Final (remainder);
+
+      remainder = crc32Update (SF_CRC32_INITIAL_REMAINDER, reinterpret_cast <const char *> (&header), sizeof (BinaryCacheHeader));
+      if (!sections.empty ()){
+        remainder = crc32Update (remainder, reinterpret_cast <const char *> (&(sections [0])), sections.size () * sizeof (BinaryCacheSection));
+      }
+      header._headerChecksum = crc32Final (remainder);
+
+      ok = ok && !fseek (fp, 0, SEEK_SET) && fwrite (&header, sizeof (BinaryCacheHeader), 1, fp) == 1
+           && (sections.empty () || fwrite (&(sections [0]), sizeof (BinaryCacheSection), sections.size (), fp) == sections.size ());
+      ok = !fclose (fp) && ok;
+
+      if (!ok || rename (tmpFile.c_str (), file.c_str ())){
+        PRINT ("warning: could not write cache file %s\n", file.c_str ());
+        remove (tmpFile.c_str ());
+        return false;
+      }
+      return true;
+    }
+
+  protected:
+    static inline bool precedes (const Block &a, const Block &b) { return a._id < b._id; }
+  };
+}
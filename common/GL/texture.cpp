@@ -31,20 +31,19 @@ extern "C" {
 }
 
 #include <vector>
-#include <list>
-
-#include <Eigen/Core>
-#include <Eigen/LU>
+#include <algorithm>
 
 #include "crc32.h"
+#include "Topology.h"
 #include "vec3.h"
 #include "mat3x3.h"
+#include "IO/TextReader.h"
 
 #include "common.h"
 #include "texture.h"
+#include "WorkerPool.h"
 
 using namespace std;
-using namespace Eigen;
 
 namespace SF {
 
@@ -52,6 +51,24 @@ namespace SF {
   static const real ALPHA_THRESHOLD = .9;
   static const real ALPHA_DISTANCE = .05;
   static const real SCALE_CONSTANT = 1./ 255.;
+  static const unsigned int RAY_TILE_ROWS = 8; // atlas rows marched by one task
+  static const double TUTTE_TOLERANCE = 1e-10; // residual of the Tutte system relative to its right hand side
+  static const uint32_t CHART_CACHE_KIND = 0x43485401; // "CHT" version 1
+  static const uint32_t ATLAS_CACHE_KIND = 0x41544c01; // "ATL" version 1
+
+  // chart artifact sections
+  enum {
+    CHART_CACHE_INFO = 0, // number of surface vertices, number of charts and size of real
+    CHART_CACHE_OFFSETS, // where the vertices of every chart start (and, one past the last, end)
+    CHART_CACHE_VERTICES,
+    CHART_CACHE_COORDS // two per vertex
+  };
+
+  // atlas artifact sections (the texels of chart i are in section ATLAS_CACHE_TEXELS + i)
+  enum {
+    ATLAS_CACHE_DIMS = 0, // atlas dimension of every chart
+    ATLAS_CACHE_TEXELS
+  };
 
   // write unsigned byte RGB data to png file
   void writeRGBToPng (const char *prefix, int index, int dim, const vector <GLubyte> &rgb)
@@ -164,105 +181,152 @@ namespace SF {
     writeRGBToPng (prefix, index, dim, rgbu);
   }
 
-  // function to get topology information for a triangular mesh
-  void initTopologyInfo (const vector <unsigned int> &faces, vector <FaceEdge> &edges, vector <FaceNeighbor> &neighbors)
+  // function to read a 3D texture (safe to run on a worker thread while the mesh is read)
+  void readTexture3D (const string &infoFile, const string &dataFile, Texture3D &texture, size_t cacheBytes)
   {
-    // initialize neighbors vector
-    neighbors.reserve (faces.size ()/3);
-    neighbors.resize (faces.size ()/3, FaceNeighbor ());
-
-    // make hash (vector) tables of size 2^16
-    vector <list <FaceEdge> > elists; // edges
-    elists.resize (USHRT_MAX + 1, list <FaceEdge> ());
-
-    vector <list <unsigned int> > olists; // edge owners
-    olists.resize (USHRT_MAX + 1, list <unsigned int> ());
-
-    vector <list <unsigned int> > ilists; // edge owner index
-    ilists.resize (USHRT_MAX + 1, list <unsigned int> ());
-
-    bool inflag = false;
-    uint32_t index = 0;
-    unsigned int inds [2];
-    char tmpStr [9], finalStr [32];
-
-    list <FaceEdge>::iterator eiter;
-    list <unsigned int>::iterator oiter;
-    list <unsigned int>::iterator iiter;
+    TextReader reader;
+    if (!reader.open (infoFile)){
+      PRINT ("fatal error: could not open texture info file %s\n", infoFile.c_str ());
+      exit (EXIT_FAILURE);
+    }
+    if (!reader.read (texture._dimension, 3) || !reader.read (texture._aspectRatio, 3)){
+      PRINT ("fatal error: texture info file %s is truncated or malformed\n", infoFile.c_str ());
+      exit (EXIT_FAILURE);
+    }
+    assert (texture._dimension [0] > 0 && texture._dimension [1] > 0 && texture._dimension [2] > 0);
+    assert (texture._aspectRatio [0] > 0. && texture._aspectRatio [1] > 0. && texture._aspectRatio [2] > 0.);
+    reader.close ();
+
+    vector <string> files;
+    files.push_back (infoFile);
+    files.push_back (dataFile);
+    sourceStamp (files, texture._stamp);
+
+    if (cacheBytes){
+      texture._bricks.reset (new BrickedVolume ());
+      if (!texture._bricks->open (infoFile, dataFile, texture._dimension, cacheBytes)){
+        PRINT ("fatal error: could not read texture file %s brick by brick\n", dataFile.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      return;
+    }
 
-    for (unsigned int i = 0; i < faces.size ()/ 3; ++i){
-      for (unsigned int j = 0; j < 3; ++j){
+    size_t size = 4*static_cast <size_t> (texture._dimension [0])*texture._dimension [1]*texture._dimension [2];
+    texture._rgba.resize (size);
 
-        // make a copy of two edges and sort them
-        if (j < 2){
-          inds [0] = faces [3*i + j];
-          inds [1] = faces [3*i + j + 1];
-        } else {
-          inds [0] = faces [3*i + 2];
-          inds [1] = faces [3*i];
-        }
+    FILE *fp = fopen (dataFile.c_str (), "rb");
+    if (!fp){
+      PRINT ("fatal error: could not open texture file %s\n", dataFile.c_str ());
+      exit (EXIT_FAILURE);
+    }
+    if (fread (&(texture._rgba [0]), sizeof (unsigned char), size, fp) != size){
+      PRINT ("warning: texture file %s is shorter than its info file says\n", dataFile.c_str ());
+    }
+    fclose (fp);
+  }
 
-        // sort indices - to get consistent edge ordering
-        if (inds [0] > inds [1]){
-          unsigned int tmpi = inds [0];
-          inds [0] = inds [1];
-          inds [1] = tmpi;
+  // function to count the texels where rows of a 3D texture enter or leave its opaque part
+  unsigned int countSurfaceTexels (const Texture3D &texture)
+  {
+    const unsigned int *dim = texture._dimension;
+    unsigned int numTexels = 0;
+
+    if (!texture._bricks){
+      size_t offset1 = 4*static_cast <size_t> (dim [0])*dim [1];
+      size_t offset2 = 4*static_cast <size_t> (dim [0]);
+      for (unsigned int i = 0; i < dim [2]; ++i){
+        for (unsigned int j = 0; j < dim [1]; ++j){
+          const unsigned char *row = &(texture._rgba [offset1*i + offset2*j]);
+          int first = -1, second = -1;
+          for (unsigned int k = 0; k < dim [0]; ++k){
+            if (row [4*k + 3]){
+              first = static_cast <int> (k);
+              break;
+            }
+          }
+          if (first >= 0){
+            for (int k = static_cast <int> (dim [0]) - 1; k >= 0; --k){
+              if (row [4*k + 3]){
+                second = k;
+                break;
+              }
+            }
+            numTexels += first < second ? 2 : 1;
+          }
         }
+      }
+      return numTexels;
+    }
 
-        // form a string by concatenating the two indices
-        sprintf (tmpStr, "%u", inds [0]);
-        assert (strlen (tmpStr) < 9);
-        sprintf (finalStr, "%u", inds [1]);
-        assert (strlen (finalStr) + strlen (tmpStr) < 32);
-        strcat (finalStr, tmpStr);
-
-        // get crc32 hash code and mask it to below 65536
-        index = crc32 (finalStr, strlen (finalStr));
-        index &= 0x0000ffff;
-
-        eiter = elists [index].begin ();
-        oiter = olists [index].begin ();
-        iiter = ilists [index].begin ();
-
-        // look for existence of edge in hash-table
-        inflag = false;
-        while (eiter != elists [index].end ()){
-          if (eiter->_v [0] != inds [0]){
-            ++eiter;
-            ++oiter;
-            ++iiter;
-          } else if (eiter->_v [1] != inds [1]){
-            ++eiter;
-            ++oiter;
-            ++iiter;
-          } else {
+    // one pass over the stored bricks (without going through the cache), keeping the ends of every row
+    vector <int> first (static_cast <size_t> (dim [1])*dim [2], -1), last (first.size (), -1);
+    const BrickedVolume &bricks = *(texture._bricks);
+    const unsigned int *numBricks = bricks.numBricks ();
+    vector <unsigned char> texels;
+    for (unsigned int bz = 0; bz < numBricks [2]; ++bz){
+      for (unsigned int by = 0; by < numBricks [1]; ++by){
+        for (unsigned int bx = 0; bx < numBricks [0]; ++bx){
+          unsigned int index = bricks.brickIndex (bx, by, bz);
+          if (bricks.isEmpty (index)){
+            continue;
+          }
+          bricks.load (index, texels);
 
-            neighbors [i]._v [j] = static_cast <int> (*oiter);
-            neighbors [*oiter]._v [*iiter] = static_cast <int> (i);
+          unsigned int origin [3] = {bx*SF_BRICK_SIZE, by*SF_BRICK_SIZE, bz*SF_BRICK_SIZE};
+          unsigned int size [3];
+          for (int j = 0; j < 3; ++j){
+            size [j] = min (SF_BRICK_SIZE, dim [j] - origin [j]);
+          }
+          for (unsigned int i = 0; i < size [2]; ++i){
+            for (unsigned int j = 0; j < size [1]; ++j){
+              size_t r = static_cast <size_t> (origin [2] + i)*dim [1] + origin [1] + j;
+              const unsigned char *row = &(texels [4*(i*SF_BRICK_SIDE + j)*SF_BRICK_SIDE]);
+              for (unsigned int k = 0; k < size [0]; ++k){
+                if (row [4*k + 3]){
+                  int x = static_cast <int> (origin [0] + k);
+                  if (first [r] < 0 || x < first [r]){
+                    first [r] = x;
+                  }
+                  last [r] = max (last [r], x);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    for (size_t r = 0; r < first.size (); ++r){
+      if (first [r] >= 0){
+        numTexels += first [r] < last [r] ? 2 : 1;
+      }
+    }
+    return numTexels;
+  }
 
-            edges.push_back (*eiter);
+  // function to get topology information for a triangular mesh
+  void initTopologyInfo (const vector <unsigned int> &faces, vector <FaceEdge> &edges, vector <FaceNeighbor> &neighbors)
+  {
+    unsigned int numFaces = faces.size ()/ 3;
+    vector <int> adjacent;
+    matchTriangleEdges (faces.empty () ? static_cast <const unsigned int *> (NULL) : &(faces [0]), numFaces, adjacent);
 
-            elists [index].erase (eiter);
-            olists [index].erase (oiter);
-            ilists [index].erase (iiter);
+    neighbors.assign (numFaces, FaceNeighbor ());
+    for (unsigned int i = 0; i < numFaces; ++i){
+      for (unsigned int j = 0; j < 3; ++j){
+        neighbors [i]._v [j] = adjacent [3*i + j];
+      }
+    }
 
-            inflag = true;
-            break;
+    // shared edges in the order their second face comes, then border edges
+    for (unsigned int pass = 0; pass < 2; ++pass){
+      for (unsigned int i = 0; i < numFaces; ++i){
+        for (unsigned int j = 0; j < 3; ++j){
+          int n = adjacent [3*i + j];
+          if (pass ? n < 0 : n >= 0 && static_cast <unsigned int> (n) < i){
+            unsigned int a = faces [3*i + j], b = faces [3*i + (j + 1) % 3];
+            edges.push_back (FaceEdge (min (a, b), max (a, b)));
           }
         }
-
-        if (!inflag) {
-          elists [index].push_back (FaceEdge (inds [0], inds [1]));
-          olists [index].push_back (i);
-          ilists [index].push_back (j);
-        }
-      } // end - for (int j = 0; j < 3; ++j)
-    } // end - for (unsigned int i = 0; i < faces.size ()/3; ++i)
-
-    for (unsigned int i = 0; i <= USHRT_MAX; ++i){
-      while (!elists [i].empty ()){
-        edges.push_back (elists [i].front ());
-        elists [i].pop_front ();
       }
     }
   }
@@ -394,18 +458,9 @@ namespace SF {
                                       vector <vec3> &outVerts, vector <unsigned int> &outFaces, vector <unsigned int> &uniqueVertIndices)
   {
     // get unique list of indices (also tells the size of outverts)
-    list <unsigned int> tmpi;
-    for (unsigned int i = 0; i < inFaces.size (); ++i){
-      tmpi.push_back (inFaces [i]);
-    }
-    tmpi.sort ();
-    tmpi.unique ();
-
-    uniqueVertIndices.reserve (tmpi.size ());
-    while (!tmpi.empty ()){
-      uniqueVertIndices.push_back (tmpi.front ());
-      tmpi.pop_front ();
-    }
+    uniqueVertIndices.assign (inFaces.begin (), inFaces.end ());
+    sort (uniqueVertIndices.begin (), uniqueVertIndices.end ());
+    uniqueVertIndices.erase (unique (uniqueVertIndices.begin (), uniqueVertIndices.end ()), uniqueVertIndices.end ());
 
     // gather the relevant vertices in new array
     outVerts.reserve (uniqueVertIndices.size ());
@@ -414,30 +469,195 @@ namespace SF {
     }
 
     // output the new indices
-#ifndef NDEBUG
-    bool checkFlag = false;
-#endif
-
+    outFaces.reserve (inFaces.size ());
     for (unsigned int i = 0; i < inFaces.size (); ++i){
-#ifndef NDEBUG
-      checkFlag = false;
-#endif
-      for (unsigned int j = 0; j < uniqueVertIndices.size (); ++j){
-        if (inFaces [i] == uniqueVertIndices [j]){
-          outFaces.push_back (j);
-#ifndef NDEBUG
-          checkFlag = true;
-#endif
+      vector <unsigned int>::const_iterator j = lower_bound (uniqueVertIndices.begin (), uniqueVertIndices.end (), inFaces [i]);
+      assert (j != uniqueVertIndices.end () && *j == inFaces [i]);
+      outFaces.push_back (static_cast <unsigned int> (j - uniqueVertIndices.begin ()));
+    }
+  }
+
+  // functor to sort 2D points by x, then y
+  struct LexicographicOrder {
+    const vector <vec2> *_points;
+
+    LexicographicOrder (const vector <vec2> &points) : _points (&points) { }
+
+    inline bool operator () (unsigned int a, unsigned int b) const
+    {
+      const real *pa = (*_points) [a]._v, *pb = (*_points) [b]._v;
+      return pa [0] < pb [0] || (pa [0] == pb [0] && pa [1] < pb [1]);
+    }
+  };
+
+  // function to keep only those flagged points that lie on the convex hull of the flagged points (points along hull edges included)
+  static void flagConvexHull (const vector <vec2> &points, vector <bool> &flags)
+  {
+    vector <unsigned int> order;
+    for (unsigned int i = 0; i < flags.size (); ++i){
+      if (flags [i]){
+        order.push_back (i);
+      }
+    }
+    sort (order.begin (), order.end (), LexicographicOrder (points));
+
+    // Andrew's monotone chain: lower hull left to right, then upper hull right to left
+    vector <unsigned int> hull;
+    hull.reserve (2*order.size ());
+    for (int pass = 0; pass < 2; ++pass){
+      size_t start = hull.size ();
+      for (size_t k = 0; k < order.size (); ++k){
+        unsigned int i = pass ? order [order.size () - 1 - k] : order [k];
+        while (hull.size () >= start + 2){
+          vec2 e1 = points [hull [hull.size () - 1]] - points [hull [hull.size () - 2]];
+          vec2 e2 = points [i] - points [hull [hull.size () - 1]];
+          if (e1._v [0]*e2._v [1] - e1._v [1]*e2._v [0] >= 0.){
+            break;
+          }
+          hull.pop_back ();
+        }
+        hull.push_back (i);
+      }
+    }
+
+    flags.assign (flags.size (), false);
+    for (unsigned int i = 0; i < hull.size (); ++i){
+      flags [hull [i]] = true;
+    }
+  }
+
+  /**
+   * Function to solve the Tutte system of a chart: every inside vertex sits
+   * at the average of its neighbors while the border vertices stay where
+   * they are. Scaling each row by the vertex degree turns the system into the
+   * graph Laplacian of the inside vertices, which is symmetric positive
+   * definite, so it is stored in compressed rows and solved with Jacobi
+   * preconditioned conjugate gradients. coords holds the starting guess for
+   * the inside vertices on entry and the solution on exit.
+   */
+  static void solveTutteSystem (const vector <FaceEdge> &edges, const vector <bool> &borderFlag, vector <vec2> &coords)
+  {
+    unsigned int numVerts = coords.size ();
+
+    // number inside vertices consecutively
+    vector <unsigned int> row (numVerts, UINT_MAX);
+    unsigned int numRows = 0;
+    for (unsigned int i = 0; i < numVerts; ++i){
+      if (!borderFlag [i]){
+        row [i] = numRows++;
+      }
+    }
+    if (!numRows){
+      return;
+    }
+
+    // degree of every vertex (the diagonal) and right hand side from border neighbors
+    vector <double> degree (numRows, 0.), rhs (2*numRows, 0.);
+    vector <unsigned int> rowStart (numRows + 1, 0);
+    for (unsigned int i = 0; i < edges.size (); ++i){
+      unsigned int v [2] = {edges [i]._v [0], edges [i]._v [1]};
+      assert (v [0] < numVerts && v [1] < numVerts);
+      for (int j = 0; j < 2; ++j){
+        unsigned int r = row [v [j]];
+        if (r == UINT_MAX){
+          continue;
+        }
+        degree [r] += 1.;
+        if (borderFlag [v [1 - j]]){
+          rhs [2*r] += coords [v [1 - j]]._v [0];
+          rhs [2*r + 1] += coords [v [1 - j]]._v [1];
+        } else {
+          ++rowStart [r + 1];
+        }
+      }
+    }
+    for (unsigned int r = 0; r < numRows; ++r){
+      assert (degree [r] > 0.);
+      rowStart [r + 1] += rowStart [r];
+    }
+
+    // off-diagonal columns (all entries are -1)
+    vector <unsigned int> columns (rowStart [numRows]);
+    {
+      vector <unsigned int> fill (rowStart.begin (), rowStart.end () - 1);
+      for (unsigned int i = 0; i < edges.size (); ++i){
+        unsigned int r0 = row [edges [i]._v [0]], r1 = row [edges [i]._v [1]];
+        if (r0 != UINT_MAX && r1 != UINT_MAX){
+          columns [fill [r0]++] = r1;
+          columns [fill [r1]++] = r0;
+        }
+      }
+    }
+
+    // the two coordinates are independent systems with the same matrix
+    vector <double> x (numRows), r (numRows), z (numRows), p (numRows), q (numRows);
+    for (int d = 0; d < 2; ++d){
+      double bnorm = 0.;
+      for (unsigned int i = 0, k = 0; i < numVerts; ++i){
+        if (!borderFlag [i]){
+          x [k] = coords [i]._v [d];
+          bnorm += rhs [2*k + d]*rhs [2*k + d];
+          ++k;
+        }
+      }
+      double threshold = TUTTE_TOLERANCE*TUTTE_TOLERANCE*bnorm;
+
+      // r = b - Ax, z = r/ diagonal, p = z
+      double rz = 0., rr = 0.;
+      for (unsigned int i = 0; i < numRows; ++i){
+        double ax = degree [i]*x [i];
+        for (unsigned int j = rowStart [i]; j < rowStart [i + 1]; ++j){
+          ax -= x [columns [j]];
+        }
+        r [i] = rhs [2*i + d] - ax;
+        z [i] = r [i]/ degree [i];
+        p [i] = z [i];
+        rz += r [i]*z [i];
+        rr += r [i]*r [i];
+      }
+
+      for (unsigned int iteration = 0; rr > threshold && iteration < 2*numRows + 100; ++iteration){
+        double pq = 0.;
+        for (unsigned int i = 0; i < numRows; ++i){
+          q [i] = degree [i]*p [i];
+          for (unsigned int j = rowStart [i]; j < rowStart [i + 1]; ++j){
+            q [i] -= p [columns [j]];
+          }
+          pq += p [i]*q [i];
+        }
+        if (pq <= 0.){
           break;
         }
+
+        double alpha = rz/ pq, rzNext = 0.;
+        rr = 0.;
+        for (unsigned int i = 0; i < numRows; ++i){
+          x [i] += alpha*p [i];
+          r [i] -= alpha*q [i];
+          z [i] = r [i]/ degree [i];
+          rzNext += r [i]*z [i];
+          rr += r [i]*r [i];
+        }
+        double beta = rzNext/ rz;
+        rz = rzNext;
+        for (unsigned int i = 0; i < numRows; ++i){
+          p [i] = z [i] + beta*p [i];
+        }
+      }
+
+      for (unsigned int i = 0, k = 0; i < numVerts; ++i){
+        if (!borderFlag [i]){
+          coords [i]._v [d] = static_cast <real> (x [k++]);
+        }
       }
-#ifndef NDEBUG
-      assert (checkFlag);
-#endif
     }
   }
+
   void calculateParametricCoordinates (unsigned int numSurfaceVerts, const vector <vec> &vertices, const vector <unsigned int> &indices, vector <vec2> &texCoords)
   {
+    if (texCoords.size () < numSurfaceVerts){
+      texCoords.resize (numSurfaceVerts);
+    }
     if (indices.empty ()){
       return;
     }
@@ -456,7 +676,6 @@ namespace SF {
     // transform 3D vertices to 2D form and identify border vertices
     vector <vec2> tmpTexCoords;
     vector <bool> borderFlag;
-    unsigned int numBorderVerts = 0;
     {
       // calculate area-weighted average normal
       vec3 normal (vec3::ZERO), tmpv, e1, e2;
@@ -566,13 +785,8 @@ namespace SF {
           }
         }
       }
-      for (unsigned int i = 0; i < borderFlag.size (); ++i){
-        if (borderFlag [i]){
-          ++numBorderVerts;
-        }
-      }
 
-      // scale border 2D texture coordinates to 0-1 range
+      // scale 2D texture coordinates to 0-1 range (projected inside vertices are the starting guess of the solver)
       real min [2] = {tmpTexCoords [0]._v [0], tmpTexCoords [0]._v [1]};
       real max [2] = {min [0], min [1]};
       for (unsigned int i = 1; i < tmpTexCoords.size (); ++i){
@@ -591,171 +805,18 @@ namespace SF {
         max [j] = 1./ max [j];
       }
       for (unsigned int i = 0; i < tmpTexCoords.size (); ++i){
-        if (borderFlag [i]){
-          for (int j = 0; j < 2; ++j){
-            tmpTexCoords [i]._v [j] -= min [j];
-            tmpTexCoords [i]._v [j] *= max [j];
-          }
-        }
-      }
-    }
-
-    // run convex hull on border vertices and read in the output
-    vector <vec2> convexCoords;
-    {
-      // write border vertices to temp file
-      FILE *fp = fopen ("./.tmpQHullInput", "w");
-      assert (fp);
-      fprintf (fp, "2\n%u\n", numBorderVerts);
-      for (unsigned int i = 0; i < tmpTexCoords.size (); ++i){
-        if (borderFlag [i]){
-          fprintf (fp, "%g %g\n", tmpTexCoords [i]._v [0], tmpTexCoords [i]._v [1]);
-        }
-      }
-      fclose (fp);
-
-      // run qhull on the file and print output to temp file
-      int status = system ("qconvex Qc p < ./.tmpQHullInput > ./.tmpQHullOutput");
-      assert (!status);
-
-      // read temp file outputted by qhull
-      unsigned int numVerts = 0;
-      fp = fopen ("./.tmpQHullOutput", "r");
-      assert (fp);
-      status = fscanf (fp, "%u\n", &numVerts); // this is the cardinality of each point (2 in our case)
-      assert (status != 0);
-      status = fscanf (fp, "%u\n", &numVerts);
-      assert (status != 0);
-      assert (numVerts);
-
-      convexCoords.reserve (numVerts);
-
-      real tmpr [2];
-      for (unsigned int i = 0; i < numVerts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-        status = fscanf (fp, "%lf %lf\n", &(tmpr [0]), &(tmpr [1]));
-#else
-        status = fscanf (fp, "%f %f\n", &(tmpr [0]), &(tmpr [1]));
-#endif
-        assert (status != 0);
-        convexCoords.push_back (vec2 (tmpr));
-      }
-      fclose (fp);
-
-      // remove temp files
-      status = system ("rm -f ./.tmpQHull*");
-      assert (!status);
-    }
-
-    // update boundary flags after convex hull operation
-    {
-      bool present = true;
-      for (unsigned int i = 0; i < tmpTexCoords.size (); ++i){
-        if (borderFlag [i]){
-          present = false;
-          for (unsigned int j = 0; j < convexCoords.size (); ++j){
-            if (tmpTexCoords [i] == convexCoords [j]){
-              present = true;
-              break;
-            }
-          }
-          borderFlag [i] = present;
+        for (int j = 0; j < 2; ++j){
+          tmpTexCoords [i]._v [j] -= min [j];
+          tmpTexCoords [i]._v [j] *= max [j];
         }
       }
     }
 
-    // calculate degree of incidence for all vertices
-    vector <real> lambda;
-    lambda.resize (verts.size (), 0.);
-    for (unsigned int i = 0; i < edges.size (); ++i){
-      lambda  [edges [i]._v [0]] += 1.;
-      lambda  [edges [i]._v [1]] += 1.;
-    }
-    for (unsigned int i = 0; i < lambda.size (); ++i){
-      assert (lambda [i] > 0.);
-      lambda [i] = 1./ lambda [i];
-    }
-
-    // calculate new indices separating border and internal vertices
-    vector <unsigned int> newIndices (verts.size ());
-    {
-      unsigned int counter1 = 0, counter2 = 0;
-      for (unsigned int i = 0; i < borderFlag.size (); ++i){
-        if (borderFlag [i]){
-          newIndices [i] = counter1;
-          ++counter1;
-        } else {
-          newIndices [i] = counter2;
-          ++counter2;
-        }
-      }
-    }
-
-    // initialize eigen matrix and vector
-    unsigned int numInsideVerts = tmpTexCoords.size () - convexCoords.size ();
-#ifdef SF_DOUBLE_PRECISION
-    MatrixXd A (MatrixXd::Identity (numInsideVerts, numInsideVerts));
-    VectorXd B (VectorXd::Zero (numInsideVerts));
-    VectorXd C (VectorXd::Zero (numInsideVerts));
-#else
-    MatrixXf A (MatrixXf::Identity (numInsideVerts, numInsideVerts));
-    VectorXf B (VectorXf::Zero (numInsideVerts));
-    VectorXf C (VectorXf::Zero (numInsideVerts));
-#endif
-
-    unsigned int index1, index2;
-    for (unsigned int i = 0; i < edges.size (); ++i){
-      index1 = edges [i]._v [0];
-      index2 = edges [i]._v [1];
-      assert (index1 < verts.size ());
-      assert (index2 < verts.size ());
-
-      if (!borderFlag [index1] && !borderFlag [index2]){
-        assert (newIndices [index1] < numInsideVerts);
-        assert (newIndices [index2] < numInsideVerts);
-        A (newIndices [index1], newIndices [index2]) = -lambda [index1];
-        A (newIndices [index2], newIndices [index1]) = -lambda [index2];
-      }
-      else if (!borderFlag [index1]){
-        assert (newIndices [index1] < numInsideVerts);
-        assert (newIndices [index2] < convexCoords.size ());
-        B [newIndices [index1]] += convexCoords [newIndices [index2]]._v [0] * lambda [index1];
-        C [newIndices [index1]] += convexCoords [newIndices [index2]]._v [1] * lambda [index1];
-      }
-      else if (!borderFlag [index2]){
-        assert (newIndices [index2] < numInsideVerts);
-        assert (newIndices [index1] < convexCoords.size ());
-        B [newIndices [index2]] += convexCoords [newIndices [index1]]._v [0] * lambda [index2];
-        C [newIndices [index2]] += convexCoords [newIndices [index1]]._v [1] * lambda [index2];
-      }
-    }
+    // border vertices off the convex hull of the border are left free, so the border stays convex
+    flagConvexHull (tmpTexCoords, borderFlag);
 
-    // do LU decomposition to obtain jittered internal vertices
-#ifdef SF_DOUBLE_PRECISION
-    FullPivLU <MatrixXd> luOfA (A);
-    VectorXd x1;
-#else
-    FullPivLU <MatrixXf> luOfA (A);
-    VectorXf x1;
-#endif
-    x1 = luOfA.solve (B);
-
-#ifdef SF_DOUBLE_PRECISION
-    VectorXd x2;
-#else
-    VectorXf x2;
-#endif
-    x2 = luOfA.solve (C);
-
-    // copy to temporary 2D texture coordinate buffer
-    index1 = 0;
-    for (unsigned int i = 0; i < tmpTexCoords.size (); ++i){
-      if (!borderFlag [i]){
-        tmpTexCoords [i]._v [0] = x1 [index1];
-        tmpTexCoords [i]._v [1] = x2 [index1];
-        ++index1;
-      }
-    }
+    // place inside vertices
+    solveTutteSystem (edges, borderFlag, tmpTexCoords);
 
     // scale it again to between 0 and 1
     real min [2] = {tmpTexCoords [0]._v [0], tmpTexCoords [0]._v [1]};
@@ -794,6 +855,157 @@ namespace SF {
     }
   }
 
+  // static function to parameterize charts [first, last) (run on the pool)
+  static void parameterizeRange (unsigned int numSurfaceVerts, const vector <vec> *vertices, const vector <vector <unsigned int> > *faceIndices,
+                                 vector <vector <vec2> > *texCoords, unsigned int first, unsigned int last)
+  {
+    for (unsigned int i = first; i < last; ++i){
+      calculateParametricCoordinates (numSurfaceVerts, *vertices, (*faceIndices) [i], (*texCoords) [i]);
+    }
+  }
+
+  // static function to hash the surface vertices and charts that texture coordinates are computed from
+  static uint32_t hashCharts (unsigned int numSurfaceVerts, const vector <vec> &vertices, const vector <vector <unsigned int> > &faceIndices)
+  {
+    uint32_t remainder = crc32Update (SF_CRC32_INITIAL_REMAINDER, reinterpret_cast <const char *> (&numSurfaceVerts), sizeof (unsigned int));
+    for (unsigned int i = 0; i < numSurfaceVerts && i < vertices.size (); ++i){
+      remainder = crc32Update (remainder, reinterpret_cast <const char *> (vertices [i]._v), 3*sizeof (real));
+    }
+    for (unsigned int i = 0; i < faceIndices.size (); ++i){
+      uint32_t size = static_cast <uint32_t> (faceIndices [i].size ());
+      remainder = crc32Update (remainder, reinterpret_cast <const char *> (&size), sizeof (uint32_t));
+      if (size){
+        remainder = crc32Update (remainder, reinterpret_cast <const char *> (&(faceIndices [i][0])), size*sizeof (unsigned int));
+      }
+    }
+    return crc32Final (remainder);
+  }
+
+  uint32_t calculateParametricCoordinates (const ArtifactCache &artifacts, unsigned int numSurfaceVerts, const vector <vec> &vertices,
+                                           const vector <vector <unsigned int> > &faceIndices, vector <vector <vec2> > &texCoords, WorkerPool &pool)
+  {
+    texCoords.assign (faceIndices.size (), vector <vec2> ());
+    uint32_t key = artifacts.isOpen () ? hashCharts (numSurfaceVerts, vertices, faceIndices) : 0;
+
+    // reuse the coordinates computed before for the same charts
+    {
+      BinaryCacheReader cache;
+      const uint32_t *info = NULL;
+      const uint64_t *offsets = NULL;
+      const uint32_t *verts = NULL;
+      const real *coords = NULL;
+      size_t count [4] = {0, 0, 0, 0};
+      if (artifacts.read ("charts", CHART_CACHE_KIND, key, cache) && cache.get (CHART_CACHE_INFO, info, count [0]) && count [0] == 3
+          && info [0] == numSurfaceVerts && info [1] == faceIndices.size () && info [2] == sizeof (real)
+          && cache.get (CHART_CACHE_OFFSETS, offsets, count [1]) && count [1] == faceIndices.size () + 1
+          && cache.get (CHART_CACHE_VERTICES, verts, count [2]) && count [2] == offsets [faceIndices.size ()]
+          && cache.get (CHART_CACHE_COORDS, coords, count [3]) && count [3] == 2*count [2]){
+        for (unsigned int i = 0; i < texCoords.size (); ++i){
+          texCoords [i].resize (numSurfaceVerts);
+          for (uint64_t j = offsets [i]; j < offsets [i + 1]; ++j){
+            assert (verts [j] < numSurfaceVerts);
+            texCoords [i][verts [j]] = vec2 (coords + 2*j);
+          }
+        }
+        return key;
+      }
+    }
+
+    // charts are independent of each other
+    pool.parallelFor (0, faceIndices.size (), boost::bind (&parameterizeRange, numSurfaceVerts, &vertices, &faceIndices, &texCoords, _1, _2), 1);
+
+    // store only the vertices of each chart
+    if (artifacts.isOpen ()){
+      uint32_t info [3] = {numSurfaceVerts, static_cast <uint32_t> (faceIndices.size ()), static_cast <uint32_t> (sizeof (real))};
+      vector <uint64_t> offsets (1, 0);
+      vector <uint32_t> verts;
+      vector <real> coords;
+      for (unsigned int i = 0; i < faceIndices.size (); ++i){
+        vector <unsigned int> chart (faceIndices [i]);
+        sort (chart.begin (), chart.end ());
+        chart.erase (unique (chart.begin (), chart.end ()), chart.end ());
+        for (unsigned int j = 0; j < chart.size (); ++j){
+          verts.push_back (chart [j]);
+          coords.push_back (texCoords [i][chart [j]]._v [0]);
+          coords.push_back (texCoords [i][chart [j]]._v [1]);
+        }
+        offsets.push_back (verts.size ());
+      }
+
+      BinaryCacheWriter cache;
+      cache.add (CHART_CACHE_INFO, info, 3);
+      cache.add (CHART_CACHE_OFFSETS, offsets);
+      cache.add (CHART_CACHE_VERTICES, verts);
+      cache.add (CHART_CACHE_COORDS, coords);
+      artifacts.write ("charts", CHART_CACHE_KIND, key, cache);
+    }
+    return key;
+  }
+
+  uint32_t textureAtlasKey (uint32_t chartKey, const Texture3D &texture, const aabb &bv, const vector <real> &scales, unsigned int atlasScale,
+                            const string &shaderHeader, const string &shader)
+  {
+    ArtifactKey key;
+    key.add (chartKey).add (CHART_CACHE_KIND).add (texture._stamp).add (texture._aspectRatio).add (scales).add (atlasScale).add (shaderHeader);
+    for (int i = 0; i < 2; ++i){
+      key.add (bv._v [i]._v, 3*sizeof (real));
+    }
+    key.addFile (shader + ".vs");
+    key.addFile (shader + ".fs");
+    return key.value ();
+  }
+
+  // static function to read the atlases of all charts (texels of type T)
+  template <class T>
+  static bool readAtlases (const ArtifactCache &artifacts, uint32_t key, vector <int> &dims, vector <vector <T> > &atlases)
+  {
+    BinaryCacheReader cache;
+    if (!artifacts.read ("atlases", ATLAS_CACHE_KIND, key, cache) || !cache.get (ATLAS_CACHE_DIMS, dims)){
+      return false;
+    }
+    atlases.resize (dims.size ());
+    for (unsigned int i = 0; i < dims.size (); ++i){
+      if (!cache.get (ATLAS_CACHE_TEXELS + i, atlases [i]) || atlases [i].size () != 4*static_cast <size_t> (dims [i])*dims [i]){
+        PRINT ("warning: texture atlases in %s do not match their charts\n", artifacts.file ("atlases", key).c_str ());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // static function to write the atlases of all charts (texels of type T)
+  template <class T>
+  static bool writeAtlases (const ArtifactCache &artifacts, uint32_t key, const vector <int> &dims, const vector <vector <T> > &atlases)
+  {
+    assert (dims.size () == atlases.size ());
+    BinaryCacheWriter cache;
+    cache.add (ATLAS_CACHE_DIMS, dims);
+    for (unsigned int i = 0; i < atlases.size (); ++i){
+      cache.add (ATLAS_CACHE_TEXELS + i, atlases [i]);
+    }
+    return artifacts.write ("atlases", ATLAS_CACHE_KIND, key, cache);
+  }
+
+  bool readTextureAtlases (const ArtifactCache &artifacts, uint32_t key, vector <int> &dims, vector <vector <GLubyte> > &atlases)
+  {
+    return readAtlases (artifacts, key, dims, atlases);
+  }
+
+  bool readTextureAtlases (const ArtifactCache &artifacts, uint32_t key, vector <int> &dims, vector <vector <GLfloat> > &atlases)
+  {
+    return readAtlases (artifacts, key, dims, atlases);
+  }
+
+  bool writeTextureAtlases (const ArtifactCache &artifacts, uint32_t key, const vector <int> &dims, const vector <vector <GLubyte> > &atlases)
+  {
+    return writeAtlases (artifacts, key, dims, atlases);
+  }
+
+  bool writeTextureAtlases (const ArtifactCache &artifacts, uint32_t key, const vector <int> &dims, const vector <vector <GLfloat> > &atlases)
+  {
+    return writeAtlases (artifacts, key, dims, atlases);
+  }
+
   // function to scale vertices with proper aspect ratio to between 0 and 1
   void scaleVertices (const real *aspect, const vector <vec> &src, const aabb &bv, vector <vec> &dest)
   {
@@ -972,21 +1184,86 @@ namespace SF {
     glUseProgram (0);
   }
 
+  /**
+   * Class to reach the texels around sample positions of a 3D texture. For a
+   * bricked texture it holds on to the brick of the last position, so the
+   * brick cache is only asked when a ray crosses into another brick.
+   */
+  class VolumeSampler {
+
+  protected:
+    const Texture3D &_texture;
+    BrickedVolume::Brick _brick;
+    unsigned int _brickIndex;
+    const unsigned char *_base; // texel at _origin
+    int _origin [3];
+    ptrdiff_t _offset1, _offset2; // bytes between neighbouring texels along z and y
+
+  public:
+    VolumeSampler (const Texture3D &texture)
+    : _texture (texture), _brickIndex (UINT_MAX), _base (NULL)
+    {
+      for (int j = 0; j < 3; ++j){
+        _origin [j] = 0;
+      }
+      if (texture._bricks){
+        _offset1 = 4*SF_BRICK_SIDE*SF_BRICK_SIDE;
+        _offset2 = 4*SF_BRICK_SIDE;
+      } else {
+        _base = &(texture._rgba [0]);
+        _offset1 = 4*static_cast <ptrdiff_t> (texture._dimension [1])*texture._dimension [0];
+        _offset2 = 4*static_cast <ptrdiff_t> (texture._dimension [0]);
+      }
+    }
+
+    inline ptrdiff_t offset1 () const { return _offset1; }
+    inline ptrdiff_t offset2 () const { return _offset2; }
+
+    // method to get the texel at pos (its neighbours along x, y and z are 4, offset2 () and offset1 () bytes further)
+    inline const unsigned char *
+    texel (const int *pos)
+    {
+      if (!_texture._bricks){
+        return _base + _offset1*pos [2] + _offset2*pos [1] + 4*pos [0];
+      }
+
+      int p [3];
+      unsigned int b [3];
+      for (int j = 0; j < 3; ++j){
+        p [j] = min (max (pos [j], 0), static_cast <int> (_texture._dimension [j]) - 1);
+        b [j] = static_cast <unsigned int> (p [j])/ SF_BRICK_SIZE;
+      }
+      unsigned int index = _texture._bricks->brickIndex (b [0], b [1], b [2]);
+      if (index != _brickIndex){
+        _brick = _texture._bricks->fetch (index);
+        _brickIndex = index;
+        _base = &((*_brick) [0]);
+        for (int j = 0; j < 3; ++j){
+          _origin [j] = static_cast <int> (b [j]*SF_BRICK_SIZE);
+        }
+      }
+      return _base + _offset1*(p [2] - _origin [2]) + _offset2*(p [1] - _origin [1]) + 4*(p [0] - _origin [0]);
+    }
+  };
+
   // ray-trace function to reach texture boundary (returns end-position of rays)
-	static inline real getAlpha (int offset1, int offset2, const Texture3D &texture, const int* intPos, const real* delta)
+	static inline real getAlpha (VolumeSampler &sampler, const int* intPos, const real* delta)
 	{
-	  int index = offset1*intPos [2] + offset2*intPos [1] + 4*intPos [0];
-		real comp1 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + 3]) + delta [2] * static_cast <real> (texture._rgba [index + offset1 + 3]);
-		real comp2 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + offset2 + 3]) +
-      delta [2] * static_cast <real> (texture._rgba [index + offset1 + offset2 + 3]);
+	  const unsigned char *texel = sampler.texel (intPos);
+	  ptrdiff_t offset1 = sampler.offset1 (), offset2 = sampler.offset2 ();
+		real comp1 =  (1. - delta [2]) * static_cast <real> (texel [3]) + delta [2] * static_cast <real> (texel [offset1 + 3]);
+		real comp2 =  (1. - delta [2]) * static_cast <real> (texel [offset2 + 3]) +
+      delta [2] * static_cast <real> (texel [offset1 + offset2 + 3]);
 
-		real comp3 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + 7]) + delta [2] * static_cast <real> (texture._rgba [index + offset1 + 7]);
-		real comp4 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + offset2 + 7]) +
-      delta [2] * static_cast <real> (texture._rgba [index + offset1 + offset2 + 7]);
+		real comp3 =  (1. - delta [2]) * static_cast <real> (texel [7]) + delta [2] * static_cast <real> (texel [offset1 + 7]);
+		real comp4 =  (1. - delta [2]) * static_cast <real> (texel [offset2 + 7]) +
+      delta [2] * static_cast <real> (texel [offset1 + offset2 + 7]);
 
 		return SCALE_CONSTANT * ((1. - delta [0])*( (1. - delta [1])*comp1 + delta [1]*comp2) + delta [0]*( (1. - delta [1])*comp3 + delta [1]*comp4));
 	}
-  void raytraceThroughVolumef (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLfloat> &rgbaData)
+  // static function to march the rays of atlas rows [firstRow, lastRow) (run on the pool)
+  static void marchRaysf (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLfloat> &rgbaData,
+                          unsigned int firstRow, unsigned int lastRow)
   {
     real realDims [3] = {static_cast <real> (texture._dimension [0]), static_cast <real> (texture._dimension [1]), static_cast <real> (texture._dimension [2])};
 
@@ -994,10 +1271,9 @@ namespace SF {
     bool outside, reverse;
     real alpha, prevAlpha, realPos [3], ray [3], delta [3];
 
-    int offset1 = static_cast <int> (4*texture._dimension [1]*texture._dimension [0]);
-    int offset2 = static_cast <int> (4*texture._dimension [0]);
+    VolumeSampler sampler (texture);
 
-    for (int i = 0; i < 4*dim*dim; i += 4){
+    for (int i = 4*dim*static_cast <int> (firstRow); i < 4*dim*static_cast <int> (lastRow); i += 4){
       if (coData [i + 3] > .5){
 
         // see if current position is outside texture borders
@@ -1032,7 +1308,7 @@ namespace SF {
         for (int j = 0; j < 3; ++j){
           delta [j] = realPos [j] - static_cast <real> (intPos [j]);
         }
-        alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+        alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
         // ray-tracing starts here
         if (! (outside && alpha > ALPHA_THRESHOLD)){
@@ -1059,7 +1335,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
               for (int j = 0; j < 3; ++j){
                 realPos [j] += ray [j];
               }
@@ -1076,7 +1352,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
               for (int j = 0; j < 3; ++j){
                 realPos [j] += ray [j];
               }
@@ -1096,7 +1372,7 @@ namespace SF {
             for (int j = 0; j < 3; ++j){
               delta [j] = realPos [j] - static_cast <real> (intPos [j]);
             }
-            alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+            alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
           }
           else { // inside texture border, so we can converge on isosurface boundary
 
@@ -1112,7 +1388,7 @@ namespace SF {
             for (int j = 0; j < 3; ++j){
               delta [j] = realPos [j] - static_cast <real> (intPos [j]);
             }
-            alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+            alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
             while (ABS (alpha - ALPHA_THRESHOLD) > ALPHA_DISTANCE){
               if (sqrt (ray [0]*ray [0] + ray [1]*ray [1] + ray [2]*ray [2]) < EPSILON){
@@ -1129,7 +1405,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
               if ((alpha - ALPHA_THRESHOLD)*(prevAlpha - ALPHA_THRESHOLD) < 0.){
                 for (int j = 0; j < 3; ++j){
@@ -1147,9 +1423,26 @@ namespace SF {
         }
 
       } // end - if (coData [i + 3] > .5)
-    } // end - for (int i = 0; i < 4*dim*dim; i += 4)
+    } // end - for (int i = 4*dim*firstRow; i < 4*dim*lastRow; i += 4)
+  }
+
+  /**
+   * Ray-trace function to reach texture boundary (returns end-position of rays). Tiles of atlas rows are
+   * marched on the pool, if one is given. Every ray is marched by the same code whichever thread takes
+   * it, so the result is bit-identical to that of a serial run.
+   */
+  void raytraceThroughVolumef (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLfloat> &rgbaData,
+                               WorkerPool *pool)
+  {
+    if (pool){
+      pool->parallelFor (0, static_cast <unsigned int> (dim), boost::bind (&marchRaysf, dim, boost::cref (coData), boost::cref (noData), boost::cref (texture),
+                                                                          boost::ref (rgbaData), _1, _2), RAY_TILE_ROWS);
+    } else {
+      marchRaysf (dim, coData, noData, texture, rgbaData, 0, static_cast <unsigned int> (dim));
+    }
 
     // scale vertices to between 0 and 1, because these are 3D texture coordinates
+    real realDims [3] = {static_cast <real> (texture._dimension [0]), static_cast <real> (texture._dimension [1]), static_cast <real> (texture._dimension [2])};
     for (int j = 0; j < 3; ++j){
       realDims [j] = 1./ realDims [j];
     }
@@ -1165,26 +1458,28 @@ namespace SF {
   }
 
   // ray-trace function to reach texture boundary (returns trilinearly interpolated texel color at end of ray)
-  static inline void getColor (int offset1, int offset2, const Texture3D &texture, const int *intPos, const real *delta, GLubyte *rgb)
+  static inline void getColor (VolumeSampler &sampler, const int *intPos, const real *delta, GLubyte *rgb)
   {
-    int index;
     real sum, comp1, comp2, comp3, comp4;
+    const unsigned char *texel = sampler.texel (intPos);
+    ptrdiff_t offset1 = sampler.offset1 (), offset2 = sampler.offset2 ();
     for (int i = 0; i < 3; ++i){
-      index = offset1*intPos [2] + offset2*intPos [1] + 4*intPos [0];
-      comp1 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + i]) + delta [2] * static_cast <real> (texture._rgba [index + offset1 + i]);
-      comp2 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + offset2 + i]) +
-        delta [2] * static_cast <real> (texture._rgba [index + offset1 + offset2 + i]);
+      comp1 =  (1. - delta [2]) * static_cast <real> (texel [i]) + delta [2] * static_cast <real> (texel [offset1 + i]);
+      comp2 =  (1. - delta [2]) * static_cast <real> (texel [offset2 + i]) +
+        delta [2] * static_cast <real> (texel [offset1 + offset2 + i]);
 
-      comp3 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + 4 + i]) + delta [2] * static_cast <real> (texture._rgba [index + offset1 + 4 + i]);
-      comp4 =  (1. - delta [2]) * static_cast <real> (texture._rgba [index + offset2 + 4 + i]) +
-        delta [2] * static_cast <real> (texture._rgba [index + offset1 + offset2 + 4 + i]);
+      comp3 =  (1. - delta [2]) * static_cast <real> (texel [4 + i]) + delta [2] * static_cast <real> (texel [offset1 + 4 + i]);
+      comp4 =  (1. - delta [2]) * static_cast <real> (texel [offset2 + 4 + i]) +
+        delta [2] * static_cast <real> (texel [offset1 + offset2 + 4 + i]);
 
       sum = SCALE_CONSTANT * ((1. - delta [0])*( (1. - delta [1])*comp1 + delta [1]*comp2) + delta [0]*( (1. - delta [1])*comp3 + delta [1]*comp4));
       sum = sum > 1. ? 1. : sum;
       rgb [i] = static_cast <GLubyte> (floor (255. * sum));
     }
   }
-  void raytraceThroughVolumeb (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLubyte> &rgbaData)
+  // static function to march the rays of atlas rows [firstRow, lastRow) (run on the pool)
+  static void marchRaysb (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLubyte> &rgbaData,
+                          unsigned int firstRow, unsigned int lastRow)
   {
     real realDims [3] = {static_cast <real> (texture._dimension [0]), static_cast <real> (texture._dimension [1]), static_cast <real> (texture._dimension [2])};
 
@@ -1192,10 +1487,9 @@ namespace SF {
     bool outside, reverse;
     real alpha, prevAlpha, realPos [3], ray [3], delta [3];
 
-    int offset1 = static_cast <int> (4*texture._dimension [1]*texture._dimension [0]);
-    int offset2 = static_cast <int> (4*texture._dimension [0]);
+    VolumeSampler sampler (texture);
 
-    for (int i = 0; i < 4*dim*dim; i += 4){
+    for (int i = 4*dim*static_cast <int> (firstRow); i < 4*dim*static_cast <int> (lastRow); i += 4){
       if (coData [i + 3] > .5){
 
         // see if current position is outside texture borders
@@ -1230,7 +1524,7 @@ namespace SF {
         for (int j = 0; j < 3; ++j){
           delta [j] = realPos [j] - static_cast <real> (intPos [j]);
         }
-        alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+        alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
         // ray-tracing starts here
         if (! (outside && alpha > ALPHA_THRESHOLD)){
@@ -1257,7 +1551,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
               for (int j = 0; j < 3; ++j){
                 realPos [j] += ray [j];
               }
@@ -1274,7 +1568,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
               for (int j = 0; j < 3; ++j){
                 realPos [j] += ray [j];
               }
@@ -1294,7 +1588,7 @@ namespace SF {
             for (int j = 0; j < 3; ++j){
               delta [j] = realPos [j] - static_cast <real> (intPos [j]);
             }
-            alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+            alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
           }
           else { // inside texture border, so we can converge on isosurface boundary
 
@@ -1310,7 +1604,7 @@ namespace SF {
             for (int j = 0; j < 3; ++j){
               delta [j] = realPos [j] - static_cast <real> (intPos [j]);
             }
-            alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+            alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
             while (ABS (alpha - ALPHA_THRESHOLD) > ALPHA_DISTANCE){
               if (sqrt (ray [0]*ray [0] + ray [1]*ray [1] + ray [2]*ray [2]) < EPSILON){
@@ -1327,7 +1621,7 @@ namespace SF {
               for (int j = 0; j < 3; ++j){
                 delta [j] = realPos [j] - static_cast <real> (intPos [j]);
               }
-              alpha = getAlpha (offset1, offset2, texture, &(intPos [0]), &(delta [0]));
+              alpha = getAlpha (sampler, &(intPos [0]), &(delta [0]));
 
               if ((alpha - ALPHA_THRESHOLD)*(prevAlpha - ALPHA_THRESHOLD) < 0.){
                 for (int j = 0; j < 3; ++j){
@@ -1340,9 +1634,21 @@ namespace SF {
         } // end - if (!outside && alpha > ALPHA_THRESHOLD)
 
         rgbaData [i + 3] = static_cast <GLubyte> (floor (255.*alpha));
-        getColor (offset1, offset2, texture, &(intPos [0]), &(delta [0]), &(rgbaData [i]));
+        getColor (sampler, &(intPos [0]), &(delta [0]), &(rgbaData [i]));
 
       } // end - if (coData [i + 3] > .5)
-    } // end - for (int i = 0; i < 4*dim*dim; i += 4)
+    } // end - for (int i = 4*dim*firstRow; i < 4*dim*lastRow; i += 4)
+  }
+
+  // ray-trace function to reach texture boundary (returns trilinearly interpolated texel color at end of ray; marched like raytraceThroughVolumef)
+  void raytraceThroughVolumeb (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLubyte> &rgbaData,
+                               WorkerPool *pool)
+  {
+    if (pool){
+      pool->parallelFor (0, static_cast <unsigned int> (dim), boost::bind (&marchRaysb, dim, boost::cref (coData), boost::cref (noData), boost::cref (texture),
+                                                                          boost::ref (rgbaData), _1, _2), RAY_TILE_ROWS);
+    } else {
+      marchRaysb (dim, coData, noData, texture, rgbaData, 0, static_cast <unsigned int> (dim));
+    }
   }
 }
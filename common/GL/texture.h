@@ -21,6 +21,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 
 #include "Preprocess.h"
 #include "vec2.h"
@@ -30,18 +31,25 @@
 #include "vec4.h"
 #endif
 #include "aabb.h"
+#include "volume.h"
+#include "ArtifactCache.h"
 
 using namespace std;
 
 namespace SF {
 
+  class WorkerPool;
+
   typedef struct texture3D_t {
 
     unsigned int _dimension [3];
     real _aspectRatio [3];
-    vector <unsigned char> _rgba;
+    vector <unsigned char> _rgba; // whole volume, unless it is read brick by brick
+    boost::shared_ptr <BrickedVolume> _bricks;
+    uint32_t _stamp; // stamp of the info and data files (keys artifacts derived from the texture)
 
     inline texture3D_t ()
+    : _stamp (0)
     {
       for (int i = 0; i < 3; ++i){
         _dimension [i] = 0;
@@ -80,6 +88,13 @@ namespace SF {
     }
   } FaceEdge;
 
+  // function to read a 3D texture (dimensions and aspect ratio from infoFile, RGBA texels from dataFile);
+  // with a non-zero cacheBytes the texels are read brick by brick when rays need them instead
+  void readTexture3D (const string &infoFile, const string &dataFile, Texture3D &texture, size_t cacheBytes = 0);
+
+  // function to count the texels where rows of a 3D texture enter or leave its opaque part
+  unsigned int countSurfaceTexels (const Texture3D &texture);
+
   // function to write different format data's to PNG file
   void writeRGBToPng (const char *prefix, int index, int dim, const vector <GLubyte> &rgb);
   void writeRGBAToPng (const char *prefix, int index, int dim, const vector <GLubyte> &rgba);
@@ -94,6 +109,11 @@ namespace SF {
   // function to calculate parametric coordinates using Tutte's method (used to calculate texture coordinates)
   void calculateParametricCoordinates (unsigned int numSurfaceVerts, const vector <vec> &vertices, const vector <unsigned int> &indices, vector <vec2> &texCoords);
 
+  // function to calculate the parametric coordinates of all charts on the pool, reusing those in the artifact cache if made from the same charts;
+  // returns the key of the charts (for artifacts derived from them)
+  uint32_t calculateParametricCoordinates (const ArtifactCache &artifacts, unsigned int numSurfaceVerts, const vector <vec> &vertices,
+                                           const vector <vector <unsigned int> > &faceIndices, vector <vector <vec2> > &texCoords, WorkerPool &pool);
+
   // function to scale vertices with aspect ratio
   void scaleVertices (const real *aspect, const vector <vec> &src, const aabb &bv, vector <vec> &dest);
 
@@ -104,9 +124,23 @@ namespace SF {
   void initTextureAtlas (GLuint program, int dim, const vector <vec> &verts, const vector <vec2> &texCoords,
                          const vector <unsigned int> &faces, vector <GLfloat> &rgbaData);
 
-  // ray-trace function to reach texture boundary (returns end-position of rays)
-  void raytraceThroughVolumef (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLfloat> &rgbaData);
+  // function to compute the key of the texture atlases rasterized from charts (chartKey) with the given texture, scales and atlas program
+  uint32_t textureAtlasKey (uint32_t chartKey, const Texture3D &texture, const aabb &bv, const vector <real> &scales, unsigned int atlasScale,
+                            const string &shaderHeader, const string &shader);
+
+  // functions to read the texture atlases of all charts from the artifact cache (false if it has none for key)
+  bool readTextureAtlases (const ArtifactCache &artifacts, uint32_t key, vector <int> &dims, vector <vector <GLubyte> > &atlases);
+  bool readTextureAtlases (const ArtifactCache &artifacts, uint32_t key, vector <int> &dims, vector <vector <GLfloat> > &atlases);
+
+  // functions to write the texture atlases of all charts to the artifact cache
+  bool writeTextureAtlases (const ArtifactCache &artifacts, uint32_t key, const vector <int> &dims, const vector <vector <GLubyte> > &atlases);
+  bool writeTextureAtlases (const ArtifactCache &artifacts, uint32_t key, const vector <int> &dims, const vector <vector <GLfloat> > &atlases);
+
+  // ray-trace function to reach texture boundary (returns end-position of rays); rays are marched on the pool if one is given
+  void raytraceThroughVolumef (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLfloat> &rgbaData,
+                               WorkerPool *pool = NULL);
 
   // ray-trace function to reach texture boundary (returns trilinearly interpolated texel color at end of ray)
-  void raytraceThroughVolumeb (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLubyte> &rgbaData);
+  void raytraceThroughVolumeb (int dim, const vector <GLfloat> &coData, const vector <GLfloat> &noData, const Texture3D &texture, vector <GLubyte> &rgbaData,
+                               WorkerPool *pool = NULL);
 }
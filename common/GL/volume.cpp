@@ -0,0 +1,275 @@
+/**
+ * @file volume.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Out-of-core RGBA volume for 3D textures too big to be held in memory
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include <sys/types.h>
+}
+
+#include "BinaryCache.h"
+#include "volume.h"
+
+#ifdef SF_LZ4_ENABLED
+extern "C" {
+#include <lz4.h>
+}
+#endif
+
+using namespace std;
+
+namespace SF {
+
+  // brick file: content version (with or without compression) and section ids
+#ifdef SF_LZ4_ENABLED
+  static const uint32_t SF_BRICK_KIND = 0x42524c01; // "BRL" version 1
+#else
+  static const uint32_t SF_BRICK_KIND = 0x42524b01; // "BRK" version 1
+#endif
+  enum {
+    SF_BRICK_INFO = 0, // volume dimensions and brick size
+    SF_BRICK_OFFSETS,
+    SF_BRICK_DATA
+  };
+
+  BrickedVolume::BrickedVolume ()
+  : _file (new BinaryCacheReader), _offsets (NULL), _data (NULL), _capacity (1), _numCached (0), _hits (0), _misses (0)
+  {
+    for (int i = 0; i < 3; ++i){
+      _dimension [i] = 0;
+      _numBricks [i] = 0;
+    }
+  }
+
+  BrickedVolume::~BrickedVolume ()
+  {
+    delete _file;
+  }
+
+  bool BrickedVolume::open (const string &infoFile, const string &dataFile, const unsigned int *dimension, size_t cacheBytes)
+  {
+    vector <string> sources;
+    sources.push_back (infoFile);
+    sources.push_back (dataFile);
+    uint32_t stamp = 0;
+    if (!sourceStamp (sources, stamp)){
+      return false;
+    }
+    for (int i = 0; i < 3; ++i){
+      _dimension [i] = dimension [i];
+      _numBricks [i] = (dimension [i] + SF_BRICK_SIZE - 1)/ SF_BRICK_SIZE;
+    }
+
+    string brickFile (dataFile);
+    brickFile.append (".bricks");
+    if (!_file->open (brickFile, SF_BRICK_KIND, stamp)){
+      PRINT ("cutting %s into bricks\n", dataFile.c_str ());
+      if (!cut (dataFile, brickFile, stamp) || !_file->open (brickFile, SF_BRICK_KIND, stamp)){
+        return false;
+      }
+    }
+
+    size_t numBricks = static_cast <size_t> (_numBricks [0])*_numBricks [1]*_numBricks [2];
+    const uint32_t *info = NULL;
+    size_t count = 0, dataSize = 0;
+    if (!_file->get (SF_BRICK_INFO, info, count) || count != 4 || info [0] != dimension [0] || info [1] != dimension [1]
+        || info [2] != dimension [2] || info [3] != SF_BRICK_SIZE || !_file->get (SF_BRICK_OFFSETS, _offsets, count)
+        || count != numBricks + 1 || !_file->get (SF_BRICK_DATA, _data, dataSize) || _offsets [numBricks] != dataSize){
+      PRINT ("warning: %s does not match %s\n", brickFile.c_str (), infoFile.c_str ());
+      _file->close ();
+      return false;
+    }
+
+    _capacity = max (cacheBytes/ SF_BRICK_BYTES, static_cast <size_t> (1));
+    _slots.assign (numBricks, Slot ());
+    _empty.reset (new vector <unsigned char> (SF_BRICK_BYTES, 0));
+    return true;
+  }
+
+  BrickedVolume::Brick BrickedVolume::fetch (unsigned int index)
+  {
+    assert (index < _slots.size ());
+    if (isEmpty (index)){
+      return _empty;
+    }
+
+    {
+      boost::mutex::scoped_lock lock (_mutex);
+      Slot &slot = _slots [index];
+      if (slot._cached){
+        ++_hits;
+        _lru.splice (_lru.begin (), _lru, slot._position);
+        return slot._brick;
+      }
+      ++_misses;
+    }
+
+    // decode outside the lock, so threads missing different bricks do not wait for each other
+    boost::shared_ptr <vector <unsigned char> > texels (new vector <unsigned char> ());
+    load (index, *texels);
+
+    boost::mutex::scoped_lock lock (_mutex);
+    Slot &slot = _slots [index];
+    if (!slot._cached){ // another thread may have decoded it meanwhile
+      slot._brick = texels;
+      slot._cached = true;
+      _lru.push_front (index);
+      slot._position = _lru.begin ();
+      ++_numCached;
+
+      // bricks still held by a sampler stay alive until it lets go of them
+      while (_numCached > _capacity){
+        Slot &oldest = _slots [_lru.back ()];
+        oldest._brick.reset ();
+        oldest._cached = false;
+        _lru.pop_back ();
+        --_numCached;
+      }
+    }
+    return slot._brick;
+  }
+
+  void BrickedVolume::load (unsigned int index, vector <unsigned char> &texels) const
+  {
+    assert (index < _slots.size ());
+    texels.resize (SF_BRICK_BYTES);
+    size_t size = static_cast <size_t> (_offsets [index + 1] - _offsets [index]);
+    if (!size){
+      fill (texels.begin (), texels.end (), 0);
+      return;
+    }
+
+#ifdef SF_LZ4_ENABLED
+    int decoded = LZ4_decompress_safe (_data + _offsets [index], reinterpret_cast <char *> (&(texels [0])),
+                                       static_cast <int> (size), static_cast <int> (SF_BRICK_BYTES));
+    if (decoded != static_cast <int> (SF_BRICK_BYTES)){
+      PRINT ("fatal error: brick %u of a 3D texture is damaged\n", index);
+      exit (EXIT_FAILURE);
+    }
+#else
+    assert (size == SF_BRICK_BYTES);
+    memcpy (&(texels [0]), _data + _offsets [index], SF_BRICK_BYTES);
+#endif
+  }
+
+  /**
+   * Method to cut the raw volume into bricks, one layer of bricks at a time.
+   * The bricks are streamed to a temporary file that is then mapped into the
+   * brick file, so the whole volume is never held in memory.
+   */
+  bool BrickedVolume::cut (const string &dataFile, const string &brickFile, uint32_t stamp) const
+  {
+    FILE *raw = fopen (dataFile.c_str (), "rb");
+    if (!raw){
+      return false;
+    }
+    string tmpFile (brickFile);
+    tmpFile.append (".data");
+    FILE *out = fopen (tmpFile.c_str (), "wb");
+    if (!out){
+      PRINT ("warning: could not write %s\n", tmpFile.c_str ());
+      fclose (raw);
+      return false;
+    }
+
+    const unsigned int *dim = _dimension;
+    size_t rowBytes = 4*static_cast <size_t> (dim [0]);
+    size_t sliceBytes = rowBytes*dim [1];
+    vector <unsigned char> slab (sliceBytes*SF_BRICK_SIDE);
+    vector <unsigned char> brick (SF_BRICK_BYTES);
+#ifdef SF_LZ4_ENABLED
+    vector <char> packed (static_cast <size_t> (LZ4_compressBound (static_cast <int> (SF_BRICK_BYTES))));
+#endif
+
+    vector <uint64_t> offsets (1, 0);
+    offsets.reserve (static_cast <size_t> (_numBricks [0])*_numBricks [1]*_numBricks [2] + 1);
+
+    bool ok = true;
+    for (unsigned int bz = 0; ok && bz < _numBricks [2]; ++bz){
+
+      // slices of this layer of bricks and its apron (the last slice of the volume repeats beyond its end)
+      for (unsigned int k = 0; ok && k < SF_BRICK_SIDE; ++k){
+        unsigned int z = min (bz*SF_BRICK_SIZE + k, dim [2] - 1);
+        ok = !fseeko (raw, static_cast <off_t> (z)*static_cast <off_t> (sliceBytes), SEEK_SET)
+             && fread (&(slab [k*sliceBytes]), 1, sliceBytes, raw) == sliceBytes;
+      }
+      if (!ok){
+        PRINT ("warning: texture file %s is shorter than its info file says\n", dataFile.c_str ());
+      }
+
+      for (unsigned int by = 0; ok && by < _numBricks [1]; ++by){
+        for (unsigned int bx = 0; ok && bx < _numBricks [0]; ++bx){
+          unsigned int x0 = bx*SF_BRICK_SIZE;
+          unsigned int inside = min (SF_BRICK_SIDE, dim [0] - x0);
+          for (unsigned int k = 0; k < SF_BRICK_SIDE; ++k){
+            for (unsigned int j = 0; j < SF_BRICK_SIDE; ++j){
+              unsigned int y = min (by*SF_BRICK_SIZE + j, dim [1] - 1);
+              const unsigned char *row = &(slab [k*sliceBytes + y*rowBytes]);
+              unsigned char *dest = &(brick [4*(k*SF_BRICK_SIDE + j)*SF_BRICK_SIDE]);
+              memcpy (dest, row + 4*x0, 4*inside);
+              for (unsigned int i = inside; i < SF_BRICK_SIDE; ++i){
+                memcpy (dest + 4*i, row + rowBytes - 4, 4);
+              }
+            }
+          }
+
+          // bricks without a single non-zero texel are not stored
+          size_t size = 0;
+          for (size_t i = 0; i < SF_BRICK_BYTES && !size; ++i){
+            size = brick [i] ? SF_BRICK_BYTES : 0;
+          }
+          if (size){
+#ifdef SF_LZ4_ENABLED
+            int packedSize = LZ4_compress_default (reinterpret_cast <const char *> (&(brick [0])), &(packed [0]),
+                                                   static_cast <int> (SF_BRICK_BYTES), static_cast <int> (packed.size ()));
+            size = packedSize > 0 ? static_cast <size_t> (packedSize) : 0;
+            ok = size && fwrite (&(packed [0]), 1, size, out) == size;
+#else
+            ok = fwrite (&(brick [0]), 1, size, out) == size;
+#endif
+          }
+          offsets.push_back (offsets.back () + size);
+        }
+      }
+    }
+    fclose (raw);
+    ok = !fclose (out) && ok;
+
+    MappedFile data;
+    if (ok && offsets.back ()){
+      ok = data.open (tmpFile);
+    }
+    if (ok){
+      uint32_t info [4] = {dim [0], dim [1], dim [2], SF_BRICK_SIZE};
+      BinaryCacheWriter writer;
+      writer.add (SF_BRICK_INFO, info, 4);
+      writer.add (SF_BRICK_OFFSETS, offsets);
+      writer.add (SF_BRICK_DATA, data.data (), static_cast <size_t> (offsets.back ()));
+      ok = writer.write (brickFile, SF_BRICK_KIND, stamp);
+    }
+    data.close ();
+    remove (tmpFile.c_str ());
+    return ok;
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file volume.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Out-of-core RGBA volume for 3D textures too big to be held in memory.
+ * The raw volume is cut once into bricks of SF_BRICK_SIZE^3 texels, each
+ * stored with one extra layer of texels on its upper x, y and z sides, so
+ * a trilinear sample never needs more than one brick. Bricks that are
+ * completely zero are not stored at all. The bricks live in a binary cache
+ * file next to the raw volume (LZ4-compressed when built with WITH_LZ4) and
+ * are decoded on demand into a fixed-size LRU cache, so memory scales with
+ * the part of the volume that rays actually touch.
+ */
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include "Preprocess.h"
+
+using namespace std;
+
+namespace SF {
+
+  class BinaryCacheReader;
+
+  static const unsigned int SF_BRICK_SIZE = 32; // texels along each side of a brick (not counting its apron)
+  static const unsigned int SF_BRICK_SIDE = SF_BRICK_SIZE + 1; // texels stored along each side of a brick
+  static const size_t SF_BRICK_BYTES = 4*SF_BRICK_SIDE*SF_BRICK_SIDE*SF_BRICK_SIDE;
+
+  class BrickedVolume {
+
+  public:
+    typedef boost::shared_ptr <const vector <unsigned char> > Brick; // SF_BRICK_SIDE^3 RGBA texels, x fastest
+
+  protected:
+    struct Slot {
+      Brick _brick;
+      list <unsigned int>::iterator _position; // in _lru
+      bool _cached;
+
+      Slot () : _cached (false) { }
+    };
+
+    BinaryCacheReader *_file; // mapped brick file
+    unsigned int _dimension [3];
+    unsigned int _numBricks [3];
+    const uint64_t *_offsets; // where the data of every brick starts (and, one past the last, ends)
+    const char *_data;
+
+    boost::mutex _mutex; // guards everything below
+    size_t _capacity; // number of bricks kept decoded
+    vector <Slot> _slots;
+    list <unsigned int> _lru; // cached bricks, most recently used first
+    size_t _numCached;
+    Brick _empty;
+    unsigned long _hits, _misses;
+
+  public:
+    BrickedVolume ();
+    ~BrickedVolume ();
+
+    /**
+     * Method to open the bricks of the raw volume dataFile (described by
+     * infoFile), cutting them first if they are missing or out of date.
+     * cacheBytes bounds the memory taken by decoded bricks.
+     */
+    bool open (const string &infoFile, const string &dataFile, const unsigned int *dimension, size_t cacheBytes);
+
+    inline const unsigned int * numBricks () const { return _numBricks; }
+    inline unsigned int brickIndex (unsigned int x, unsigned int y, unsigned int z) const { return (z*_numBricks [1] + y)*_numBricks [0] + x; }
+    inline bool isEmpty (unsigned int index) const { return _offsets [index] == _offsets [index + 1]; }
+
+    // method to get a brick through the cache (safe to call from several threads)
+    Brick fetch (unsigned int index);
+
+    // method to decode a brick without caching it (for passes over the whole volume)
+    void load (unsigned int index, vector <unsigned char> &texels) const;
+
+    inline unsigned long hits () const { return _hits; }
+    inline unsigned long misses () const { return _misses; }
+
+  protected:
+    bool cut (const string &dataFile, const string &brickFile, uint32_t stamp) const;
+
+  private:
+    BrickedVolume (const BrickedVolume &);
+    BrickedVolume & operator = (const BrickedVolume &);
+  };
+}
@@ -0,0 +1,322 @@
+/**
+ * @file TextReader.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Reader for the white space separated text formats of SF (.node, .ele,
+ * .tet, .off etc.). The file is mapped into memory and numbers are parsed
+ * in place, independent of the C locale. Runs of digits are consumed
+ * eight at a time within a 64-bit word. Floating point values of up to 15
+ * significant digits with exponents within 10^±22 are converted with a
+ * single rounding; longer ones go to strtod in the "C" locale, so every
+ * value is read exactly as printf wrote it.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <stdint.h>
+#include <locale.h>
+}
+
+#include "MappedFile.h"
+
+using namespace std;
+
+namespace SF {
+
+  static const unsigned int SF_TEXT_MAX_DIGITS = 19; // digits that always fit into 64 bits
+
+  class TextReader {
+
+  protected:
+    MappedFile _file;
+    const char *_pos;
+    const char *_end;
+
+  public:
+    TextReader ()
+    : _pos (NULL), _end (NULL)
+    { }
+
+    // method to open a file (false if it cannot be opened or is empty)
+    inline bool
+    open (const string &file)
+    {
+      _pos = _end = NULL;
+      if (!_file.open (file)){
+        return false;
+      }
+      _file.sequential ();
+      _pos = _file.data ();
+      _end = _pos + _file.size ();
+      return true;
+    }
+
+    inline void
+    close ()
+    {
+      _file.close ();
+      _pos = _end = NULL;
+    }
+
+    inline bool isOpen () const { return _file.isOpen (); }
+
+    // method to check if nothing but white space is left
+    inline bool
+    atEnd ()
+    {
+      skipSpace ();
+      return _pos == _end;
+    }
+
+    // method to get the next non-white space character without consuming it (0 at the end)
+    inline char
+    peek ()
+    {
+      skipSpace ();
+      return _pos < _end ? *_pos : 0;
+    }
+
+    // method to skip the rest of the current line (e.g. a comment)
+    inline void
+    skipLine ()
+    {
+      const char *p = static_cast <const char *> (memchr (_pos, '\n', _end - _pos));
+      _pos = p ? p + 1 : _end;
+    }
+
+    // method to read a word (any run of non-white space characters)
+    inline bool
+    read (string &word)
+    {
+      skipSpace ();
+      const char *start = _pos;
+      while (_pos < _end && static_cast <unsigned char> (*_pos) > ' '){
+        ++_pos;
+      }
+      word.assign (start, _pos);
+      return _pos > start;
+    }
+
+    inline bool
+    read (int &v)
+    {
+      skipSpace ();
+      const char *start = _pos;
+      bool negative = sign ();
+      uint64_t m = 0;
+      unsigned int kept = 0, dropped = 0;
+      if (!scanDigits (m, kept, dropped) || dropped || m > (negative ? 2147483648ull : 2147483647ull)){
+        _pos = start;
+        return false;
+      }
+      v = negative ? static_cast <int> (-static_cast <int64_t> (m)) : static_cast <int> (m);
+      return true;
+    }
+
+    inline bool
+    read (unsigned int &v)
+    {
+      skipSpace ();
+      const char *start = _pos;
+      uint64_t m = 0;
+      unsigned int kept = 0, dropped = 0;
+      if (sign () || !scanDigits (m, kept, dropped) || dropped || m > 4294967295ull){
+        _pos = start;
+        return false;
+      }
+      v = static_cast <unsigned int> (m);
+      return true;
+    }
+
+    inline bool
+    read (double &v)
+    {
+      skipSpace ();
+      const char *start = _pos;
+      bool negative = sign ();
+
+      uint64_t m = 0;
+      unsigned int kept = 0, dropped = 0, fractionDropped = 0;
+      size_t digits = scanDigits (m, kept, dropped);
+      int exponent = static_cast <int> (dropped); // integer digits beyond the first 19 still count
+      if (_pos < _end && *_pos == '.'){
+        ++_pos;
+        size_t fraction = scanDigits (m, kept, fractionDropped);
+        exponent -= static_cast <int> (fraction - fractionDropped);
+        digits += fraction;
+      }
+      if (!digits){
+        _pos = start;
+        return false;
+      }
+
+      if (_pos < _end && (*_pos == 'e' || *_pos == 'E')){
+        const char *e = _pos++;
+        bool negativeExponent = sign ();
+        uint64_t ev = 0;
+        unsigned int evKept = 0, evDropped = 0;
+        if (!scanDigits (ev, evKept, evDropped)){
+          _pos = e; // not an exponent after all
+        } else {
+          int magnitude = evDropped || ev > 100000 ? 100000 : static_cast <int> (ev);
+          exponent += negativeExponent ? -magnitude : magnitude;
+        }
+      }
+
+      if (!dropped && !fractionDropped && m < (1ull << 53) && exponent >= -22 && exponent <= 22){
+        v = scale (m, exponent);
+      } else {
+        v = slowConvert (start, _pos);
+        negative = false;
+      }
+      if (negative){
+        v = -v;
+      }
+      return true;
+    }
+
+    inline bool
+    read (float &v)
+    {
+      double d;
+      if (!read (d)){
+        return false;
+      }
+      v = static_cast <float> (d);
+      return true;
+    }
+
+    // method to read count values into consecutive elements
+    template <class T>
+    inline bool
+    read (T *values, size_t count)
+    {
+      for (size_t i = 0; i < count; ++i){
+        if (!read (values [i])){
+          return false;
+        }
+      }
+      return true;
+    }
+
+  protected:
+    inline void
+    skipSpace ()
+    {
+      while (_pos < _end && static_cast <unsigned char> (*_pos) <= ' '){
+        ++_pos;
+      }
+    }
+
+    // method to consume an optional sign (true if negative)
+    inline bool
+    sign ()
+    {
+      if (_pos < _end && (*_pos == '-' || *_pos == '+')){
+        return *(_pos++) == '-';
+      }
+      return false;
+    }
+
+    static inline bool isDigit (char c) { return static_cast <unsigned char> (c - '0') < 10; }
+
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // method to check if the 8 bytes at p are all decimal digits
+    static inline bool
+    eightDigits (const char *p)
+    {
+      uint64_t w;
+      memcpy (&w, p, 8);
+      return ((w & 0xF0F0F0F0F0F0F0F0ull) | (((w + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+    }
+
+    // method to convert 8 decimal digits at p at once (pairs, then quadruples, then the whole word)
+    static inline uint32_t
+    parseEightDigits (const char *p)
+    {
+      uint64_t w;
+      memcpy (&w, p, 8);
+      w = ((w & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+      w = ((w & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+      return static_cast <uint32_t> (((w & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+    }
+#endif
+
+    /**
+     * Method to consume a run of digits, accumulating them into v. Leading
+     * zeros are not counted in kept; digits beyond SF_TEXT_MAX_DIGITS are
+     * counted in dropped instead. Returns the number of digits consumed.
+     */
+    inline size_t
+    scanDigits (uint64_t &v, unsigned int &kept, unsigned int &dropped)
+    {
+      const char *start = _pos;
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      while (kept + 8 <= SF_TEXT_MAX_DIGITS && _end - _pos >= 8 && eightDigits (_pos)){
+        bool leading = !v;
+        v = v * 100000000ull + parseEightDigits (_pos);
+        if (leading){
+          kept = 0;
+          for (uint64_t t = v; t; t /= 10){
+            ++kept;
+          }
+        } else {
+          kept += 8;
+        }
+        _pos += 8;
+      }
+#endif
+      for (; _pos < _end && isDigit (*_pos); ++_pos){
+        if (kept < SF_TEXT_MAX_DIGITS){
+          v = 10 * v + static_cast <unsigned int> (*_pos - '0');
+          kept = v ? kept + 1 : 0;
+        } else {
+          ++dropped;
+        }
+      }
+      return static_cast <size_t> (_pos - start);
+    }
+
+    // method to compute m * 10^exponent for m < 2^53 and |exponent| <= 22 (both exact, so one rounding)
+    static inline double
+    scale (uint64_t m, int exponent)
+    {
+      static const double POWERS [] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+      double d = static_cast <double> (m);
+      return exponent >= 0 ? d * POWERS [exponent] : d / POWERS [-exponent];
+    }
+
+    // method to convert a number the fast path cannot round exactly
+    static inline double
+    slowConvert (const char *first, const char *last)
+    {
+      static locale_t cLocale = newlocale (LC_ALL_MASK, "C", static_cast <locale_t> (0));
+      string token (first, last);
+      return strtod_l (token.c_str (), NULL, cLocale);
+    }
+
+  private:
+    TextReader (const TextReader &);
+    TextReader & operator = (const TextReader &);
+  };
+}
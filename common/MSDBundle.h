@@ -0,0 +1,63 @@
+/**
+ * @file MSDBundle.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Layout of the binary mesh container of the mass-spring plugin. The
+ * plugin writes it as a cache of the text files it reads, and Edit Mesh
+ * writes it directly as a bundle (prefix.msd.bin) that stands in for the
+ * text files. Both are binary cache containers of the same kind; a bundle
+ * has no source files, so it carries SF_MSD_BUNDLE_STAMP instead of their
+ * stamp.
+ *
+ * The coarser surfaces of partition i (optional) are one section, holding
+ * the number of levels followed by the number of triangles and the
+ * triangles of every level, i.e. the contents of the text file
+ * prefix.i.lod.
+ *
+ * A two-level mesh (optional, all sections or none) adds a coarse lattice
+ * and the embedding of every vertex in one of its tetrahedra, i.e. the
+ * contents of prefix.lattice.node, prefix.lattice.lm, prefix.lattice.edge
+ * and prefix.embed.
+ */
+
+#pragma once
+
+extern "C" {
+#include <stdint.h>
+}
+
+namespace SF {
+
+  static const uint32_t SF_MSD_MESH_KIND = 0x4d534401; // "MSD" version 1
+  static const uint32_t SF_MSD_BUNDLE_STAMP = 0;
+
+  // section ids (triangles of partition i are in SF_MSD_FACES + i, its coarser surfaces in SF_MSD_LEVELS + i)
+  enum {
+    SF_MSD_NODES = 0, // vertices, as vec of the build (surface vertices first)
+    SF_MSD_MASSES, // reciprocal vertex masses
+    SF_MSD_SPRINGS, // vertex pairs of springs
+    SF_MSD_BOUNDS, // bounding box of the vertices (padded), as two vec
+    SF_MSD_SURFACE, // number of surface vertices
+    SF_MSD_FACES,
+    SF_MSD_LATTICE_NODES = 0x20000000, // lattice nodes, as vec of the build
+    SF_MSD_LATTICE_MASSES, // reciprocal node masses
+    SF_MSD_LATTICE_SPRINGS, // node pairs of lattice springs
+    SF_MSD_EMBED_REGIONS, // lattice cell (region) of every vertex
+    SF_MSD_EMBED_NODES, // four lattice nodes per vertex
+    SF_MSD_EMBED_WEIGHTS, // their barycentric weights, as real
+    SF_MSD_LEVELS = 0x40000000
+  };
+}
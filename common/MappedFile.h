@@ -0,0 +1,106 @@
+/**
+ * @file MappedFile.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * A whole file mapped read-only into memory. Pages are only read from disk
+ * when touched, and the mapping goes away with the object.
+ */
+
+#pragma once
+
+#include <string>
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+using namespace std;
+
+namespace SF {
+
+  class MappedFile {
+
+  protected:
+    char *_data;
+    size_t _size;
+
+  public:
+    MappedFile ()
+    : _data (NULL), _size (0)
+    { }
+
+    ~MappedFile ()
+    {
+      close ();
+    }
+
+    // method to map a file (false if it cannot be opened or is empty)
+    inline bool
+    open (const string &file)
+    {
+      close ();
+
+      int fd = ::open (file.c_str (), O_RDONLY);
+      if (fd < 0){
+        return false;
+      }
+      struct stat st;
+      if (fstat (fd, &st) || st.st_size <= 0){
+        ::close (fd);
+        return false;
+      }
+      void *p = mmap (NULL, static_cast <size_t> (st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close (fd); // the mapping keeps the file alive
+      if (p == MAP_FAILED){
+        return false;
+      }
+      _data = static_cast <char *> (p);
+      _size = static_cast <size_t> (st.st_size);
+      return true;
+    }
+
+    inline void
+    close ()
+    {
+      if (_data){
+        munmap (_data, _size);
+      }
+      _data = NULL;
+      _size = 0;
+    }
+
+    // method to tell the kernel the whole file will be read front to back
+    inline void
+    sequential () const
+    {
+      if (_data){
+        madvise (_data, _size, MADV_SEQUENTIAL);
+        madvise (_data, _size, MADV_WILLNEED);
+      }
+    }
+
+    inline bool isOpen () const { return _data != NULL; }
+    inline const char * data () const { return _data; }
+    inline size_t size () const { return _size; }
+
+  private:
+    MappedFile (const MappedFile &);
+    MappedFile & operator = (const MappedFile &);
+  };
+}
@@ -0,0 +1,311 @@
+/**
+ * @file Topology.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Integer-keyed mesh topology, shared by the runtime and EditMesh. Edges,
+ * triangles and tetrahedra are keyed by their sorted vertex indices packed
+ * into integers (64 bits for an edge, 96 for a triangle, 128 for a
+ * tetrahedron), so no key is ever formatted or hashed as a string.
+ * Triangles are matched across their edges through EdgeTable, a hash table
+ * keeping edge keys in a single open-addressing array with linear probing
+ * (one or two cache lines per lookup, no memory allocated per edge).
+ * Tetrahedra are matched across their faces by sorting face keys, which
+ * takes the same time for any mesh and can be handed a parallel sort.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <stdint.h>
+}
+
+using namespace std;
+
+namespace SF {
+
+  // key of the undirected edge between vertices a and b
+  inline uint64_t
+  edgeKey (unsigned int a, unsigned int b)
+  {
+    return a < b ? (static_cast <uint64_t> (a) << 32) | b : (static_cast <uint64_t> (b) << 32) | a;
+  }
+
+  // key of the triangle on vertices a, b and c in any order (its lower two vertices as an edge key, then the upper one)
+  typedef pair <uint64_t, unsigned int> FaceKey;
+
+  inline FaceKey
+  faceKey (unsigned int a, unsigned int b, unsigned int c)
+  {
+    unsigned int lo = a < b ? a : b, hi = a < b ? b : a;
+    if (c < lo){
+      return make_pair (edgeKey (c, lo), hi);
+    }
+    return c < hi ? make_pair (edgeKey (lo, c), hi) : make_pair (edgeKey (lo, hi), c);
+  }
+
+  // key of the tetrahedron on vertices a, b, c and d in any order (its lower two vertices as an edge key, then the upper two)
+  typedef pair <uint64_t, uint64_t> CellKey;
+
+  inline CellKey
+  cellKey (unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+  {
+    unsigned int v [4] = {a, b, c, d};
+    sort (v, v + 4);
+    return make_pair (edgeKey (v [0], v [1]), edgeKey (v [2], v [3]));
+  }
+
+  template <class T>
+  class EdgeTable {
+
+  protected:
+    static const uint64_t EMPTY = ~0ull; // no edge has both vertices at UINT_MAX
+
+    vector <uint64_t> _keys;
+    vector <T> _values;
+    size_t _size;
+    unsigned int _shift; // 64 - log2 (capacity)
+
+  public:
+    explicit EdgeTable (size_t expected = 0)
+    : _size (0), _shift (64)
+    {
+      reserve (expected);
+    }
+
+    inline size_t size () const { return _size; }
+    inline bool empty () const { return !_size; }
+
+    // method to make room for expected edges without growing on the way
+    inline void
+    reserve (size_t expected)
+    {
+      size_t capacity = 16;
+      while (capacity < 2*expected){
+        capacity *= 2;
+      }
+      if (capacity > _keys.size ()){
+        rehash (capacity);
+      }
+    }
+
+    // method to get the value stored for an edge (NULL if there is none)
+    inline T *
+    find (uint64_t key)
+    {
+      assert (key != EMPTY);
+      for (size_t i = home (key);; i = next (i)){
+        if (_keys [i] == key){
+          return &(_values [i]);
+        }
+        if (_keys [i] == EMPTY){
+          return NULL;
+        }
+      }
+    }
+
+    /**
+     * Method to store value for an edge unless it already has one. Returns
+     * the value stored for the edge; inserted tells which was the case.
+     */
+    inline T &
+    insert (uint64_t key, const T &value, bool &inserted)
+    {
+      assert (key != EMPTY);
+      if (2*(_size + 1) > _keys.size ()){
+        rehash (2*_keys.size ());
+      }
+      size_t i = home (key);
+      for (; _keys [i] != EMPTY; i = next (i)){
+        if (_keys [i] == key){
+          inserted = false;
+          return _values [i];
+        }
+      }
+      _keys [i] = key;
+      _values [i] = value;
+      ++_size;
+      inserted = true;
+      return _values [i];
+    }
+
+    // method to remove an edge (false if it is not in the table)
+    inline bool
+    erase (uint64_t key)
+    {
+      assert (key != EMPTY);
+      size_t i = home (key);
+      for (; _keys [i] != key; i = next (i)){
+        if (_keys [i] == EMPTY){
+          return false;
+        }
+      }
+
+      // shift later entries of the probe run back, so no tombstones are needed
+      for (size_t j = next (i); _keys [j] != EMPTY; j = next (j)){
+        size_t k = home (_keys [j]);
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)){
+          _keys [i] = _keys [j];
+          _values [i] = _values [j];
+          i = j;
+        }
+      }
+      _keys [i] = EMPTY;
+      --_size;
+      return true;
+    }
+
+    // methods to visit all edges: slots [0, capacity ()) holding one have occupied (slot) true
+    inline size_t capacity () const { return _keys.size (); }
+    inline bool occupied (size_t slot) const { return _keys [slot] != EMPTY; }
+    inline uint64_t key (size_t slot) const { return _keys [slot]; }
+    inline T & value (size_t slot) { return _values [slot]; }
+    inline const T & value (size_t slot) const { return _values [slot]; }
+
+  protected:
+    // Fibonacci hashing: the upper bits of the product depend on all bits of the key
+    inline size_t home (uint64_t key) const { return static_cast <size_t> ((key * 0x9E3779B97F4A7C15ull) >> _shift); }
+    inline size_t next (size_t i) const { return (i + 1) & (_keys.size () - 1); }
+
+    inline void
+    rehash (size_t capacity)
+    {
+      vector <uint64_t> keys (capacity, EMPTY);
+      vector <T> values (capacity);
+      keys.swap (_keys);
+      values.swap (_values);
+      _shift = 64;
+      for (size_t c = capacity; c > 1; c /= 2){
+        --_shift;
+      }
+      for (size_t i = 0; i < keys.size (); ++i){
+        if (keys [i] != EMPTY){
+          size_t j = home (keys [i]);
+          while (_keys [j] != EMPTY){
+            j = next (j);
+          }
+          _keys [j] = keys [i];
+          _values [j] = values [i];
+        }
+      }
+    }
+  };
+
+  template <class T>
+  const uint64_t EdgeTable <T>::EMPTY;
+
+  /**
+   * Function to find the neighbors of triangles across their edges. Edge j
+   * of face f runs from corner j to corner (j + 1) % 3 of the face, and
+   * neighbors [3*f + j] is set to the face on the other side of it (-1 if
+   * there is none). An edge shared by more than two faces pairs them up in
+   * the order they come.
+   */
+  template <class Index>
+  inline void
+  matchTriangleEdges (const Index *faces, size_t numFaces, vector <int> &neighbors)
+  {
+    neighbors.assign (3*numFaces, -1);
+
+    // edges still waiting for their second face (3*face + edge)
+    EdgeTable <unsigned int> open (3*numFaces/ 2);
+    bool inserted = false;
+    for (size_t f = 0; f < numFaces; ++f){
+      for (unsigned int j = 0; j < 3; ++j){
+        uint64_t key = edgeKey (static_cast <unsigned int> (faces [3*f + j]), static_cast <unsigned int> (faces [3*f + (j + 1) % 3]));
+        unsigned int other = open.insert (key, static_cast <unsigned int> (3*f + j), inserted);
+        if (!inserted){
+          neighbors [3*f + j] = static_cast <int> (other/ 3);
+          neighbors [other] = static_cast <int> (f);
+          open.erase (key);
+        }
+      }
+    }
+  }
+
+  // corners of face j of a tetrahedron, wound the same way for every face
+  static const unsigned int SF_TET_FACE_CORNERS [4][3] = {{0, 1, 2}, {0, 2, 3}, {0, 3, 1}, {1, 3, 2}};
+
+  // face j of cell c (as 4*c + j) with its key, for matching faces by sorting
+  struct FaceSlot {
+    uint64_t _lower; // lower two vertices as an edge key
+    unsigned int _upper;
+    unsigned int _slot;
+
+    inline bool
+    operator < (const FaceSlot &f) const
+    {
+      return _lower < f._lower || (_lower == f._lower && (_upper < f._upper || (_upper == f._upper && _slot < f._slot)));
+    }
+    inline bool sameFace (const FaceSlot &f) const { return _lower == f._lower && _upper == f._upper; }
+  };
+
+  // sorter used by matchTetrahedronFaces unless it is handed another one (a parallel sort, say)
+  struct SerialSort {
+    template <class T>
+    inline void operator () (vector <T> &v) const { sort (v.begin (), v.end ()); }
+  };
+
+  /**
+   * Function to find the neighbors of tetrahedra across their faces. Face j
+   * of cell c has the corners SF_TET_FACE_CORNERS [j], and neighbors
+   * [4*c + j] is set to the cell on the other side of it (-1 if there is
+   * none). Faces without a neighbor are appended to boundary as 4*c + j, in
+   * the order of their keys. A face shared by more than two cells pairs them
+   * up in the order of the cells.
+   */
+  template <class Index, class Sorter>
+  inline void
+  matchTetrahedronFaces (const Index *cells, size_t numCells, vector <int> &neighbors, vector <unsigned int> &boundary, const Sorter &sorter)
+  {
+    vector <FaceSlot> faces (4*numCells);
+    for (size_t c = 0; c < numCells; ++c){
+      for (unsigned int j = 0; j < 4; ++j){
+        FaceKey key = faceKey (static_cast <unsigned int> (cells [4*c + SF_TET_FACE_CORNERS [j][0]]),
+                               static_cast <unsigned int> (cells [4*c + SF_TET_FACE_CORNERS [j][1]]),
+                               static_cast <unsigned int> (cells [4*c + SF_TET_FACE_CORNERS [j][2]]));
+        FaceSlot &f = faces [4*c + j];
+        f._lower = key.first;
+        f._upper = key.second;
+        f._slot = static_cast <unsigned int> (4*c + j);
+      }
+    }
+    sorter (faces);
+
+    neighbors.assign (4*numCells, -1);
+    for (size_t i = 0; i < faces.size ();){
+      if (i + 1 < faces.size () && faces [i].sameFace (faces [i + 1])){
+        neighbors [faces [i]._slot] = static_cast <int> (faces [i + 1]._slot/ 4);
+        neighbors [faces [i + 1]._slot] = static_cast <int> (faces [i]._slot/ 4);
+        i += 2;
+      } else {
+        boundary.push_back (faces [i]._slot);
+        ++i;
+      }
+    }
+  }
+
+  template <class Index>
+  inline void
+  matchTetrahedronFaces (const Index *cells, size_t numCells, vector <int> &neighbors, vector <unsigned int> &boundary)
+  {
+    matchTetrahedronFaces (cells, numCells, neighbors, boundary, SerialSort ());
+  }
+}
@@ -141,6 +141,7 @@ namespace SF {
 				case 6:
 					return vec (_v[0]._v[0], _v[1]._v[1], _v[1]._v[2]);
 				case 7:
+				default:
 					return vec (_v[1]);
 			}
 		}
@@ -5,3 +5,4 @@
 /* #undef SF_VECTOR3_ENABLED */
 #define SF_VECTOR4_ENABLED
 /* #undef SF_NO_PRINT */
+/* #undef SF_LZ4_ENABLED */
@@ -112,16 +112,25 @@ namespace SF {
 		return reflection;
 	}
 
-	inline uint32_t crc32 (char const input[], size_t size)
+	// add a block of data to a running crc32 remainder (start from SF_CRC32_INITIAL_REMAINDER)
+	inline uint32_t crc32Update (uint32_t remainder, char const input[], size_t size)
 	{
-		uint32_t remainder = SF_CRC32_INITIAL_REMAINDER;
-
 		uint8_t data;
 		for (size_t i = 0; i < size; ++i){
 			data = reflect <uint8_t> (input [i]) ^ (remainder >>  24);
 			remainder = SF_CRC32_Table [data] ^ (remainder << 8);
 		}
+		return remainder;
+	}
 
+	// turn a running crc32 remainder into the hash code
+	inline uint32_t crc32Final (uint32_t remainder)
+	{
 		return reflect <uint32_t> (remainder ^ SF_CRC32_XOR_CONSTANT);
 	}
+
+	inline uint32_t crc32 (char const input[], size_t size)
+	{
+		return crc32Final (crc32Update (SF_CRC32_INITIAL_REMAINDER, input, size));
+	}
 }
@@ -29,6 +29,9 @@
 #include <boost/shared_ptr.hpp>
 
 #include "Plugin.h"
+#include "StageControl.h"
+#include "Placement.h"
+#include "WorkerPool.h"
 
 #include "Preprocess.h"
 
@@ -50,6 +53,20 @@ namespace SF {
 		// resources
 		vector< boost::shared_ptr< Resource > > _resources;
 
+		// ordering of stages within a frame, used by resources without hand-numbered semaphores
+		StageGraph _stageGraph;
+
+		// placement of threads and memory; used by the pool
+		Placement _placement;
+
+		// worker threads shared by all plugins (declared after _placement, which it uses)
+		WorkerPool _pool;
+
+		// headless execution: no window or GL context; stop after _maxFrames frames or _maxSeconds (0 for no limit)
+		bool _headless;
+		unsigned long _maxFrames;
+		double _maxSeconds;
+
 		// plugin-library-specific variables
 	protected:
 		vector< Plugin* > _plugins;
@@ -62,5 +79,8 @@ namespace SF {
 	public:
 		void run ();
 		void cleanup ();
+
+	protected:
+		void runHeadless ();
 	};
 }
@@ -0,0 +1,263 @@
+/**
+ * @file Placement.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Thread and memory placement policy of the Driver. Each role (a stage
+ * loop or the pool's workers) may be given a list of CPUs; threads of that
+ * role are pinned to these CPUs round-robin. With first touch enabled,
+ * resources re-allocate their large arrays from their own, pinned threads
+ * so that Linux places the pages on the NUMA node of the CPU that uses
+ * them, instead of on the node of the thread that loaded the data.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+}
+
+#include "Preprocess.h"
+#include "StageControl.h"
+
+using namespace std;
+
+namespace SF {
+
+	// roles threads are pinned by: the stages plus the worker pool
+	const int WORKER_ROLE = NUM_STAGES;
+	const int NUM_ROLES = NUM_STAGES + 1;
+
+	// method to get a role index from its configuration name (-1 if unknown)
+	static inline int
+	roleIndex (const char *name)
+	{
+		if (!strcmp (name, "workers")){
+			return WORKER_ROLE;
+		}
+		return StageGraph::stageIndex (name);
+	}
+
+	// method to move the contents of an array into memory first touched by the calling thread
+	template <class T>
+	inline void
+	firstTouch (vector <T> &v)
+	{
+		vector <T> (v).swap (v);
+	}
+
+	class Placement {
+
+	protected:
+		vector <int> _cpus [NUM_ROLES];
+		unsigned int _next [NUM_ROLES];
+		vector <int> _cpuNode; // NUMA node of each CPU (indexed by CPU)
+		int _numNodes;
+		bool _firstTouch;
+
+		boost::mutex _mutex;
+
+	public:
+		Placement ()
+		: _numNodes (1), _firstTouch (false)
+		{
+			for (int i = 0; i < NUM_ROLES; ++i){
+				_next [i] = 0;
+			}
+			readTopology ();
+		}
+
+		// method to set the CPUs of a role from a list such as "0-7,16-23" (false if unreadable)
+		inline bool
+		setCpus (int role, const char *list)
+		{
+			assert (role >= 0 && role < NUM_ROLES);
+			vector <int> cpus;
+			if (!parseCpuList (list, cpus)){
+				return false;
+			}
+			_cpus [role] = cpus;
+			return true;
+		}
+
+		// method to read a CPU list in the kernel's format
+		static inline bool
+		parseCpuList (const char *list, vector <int> &cpus)
+		{
+			cpus.clear ();
+			const char *c = list;
+			while (*c && *c != '\n'){
+				if (!isdigit (*c)){
+					return false;
+				}
+				char *e;
+				int first = static_cast <int> (strtol (c, &e, 10));
+				int last = first;
+				c = e;
+				if (*c == '-'){
+					++c;
+					if (!isdigit (*c)){
+						return false;
+					}
+					last = static_cast <int> (strtol (c, &e, 10));
+					c = e;
+				}
+				if (last < first || last >= CPU_SETSIZE){
+					return false;
+				}
+				for (int i = first; i <= last; ++i){
+					cpus.push_back (i);
+				}
+				if (*c == ','){
+					++c;
+				} else if (*c && *c != '\n'){
+					return false;
+				}
+			}
+			return !cpus.empty ();
+		}
+
+		inline void setFirstTouch (bool flag) { _firstTouch = flag; }
+		inline bool firstTouch () const { return _firstTouch; }
+
+		inline int numNodes () const { return _numNodes; }
+
+		// method to get the NUMA node of a CPU (0 if unknown)
+		inline int
+		node (int cpu) const
+		{
+			return cpu >= 0 && cpu < static_cast <int> (_cpuNode.size ()) ? _cpuNode [cpu] : 0;
+		}
+
+		/**
+		 * Method to pin the calling thread to the next CPU of a role.
+		 * Returns the CPU, or -1 if the role is not pinned (the thread is
+		 * then left alone).
+		 */
+		inline int
+		pin (int role)
+		{
+			assert (role >= 0 && role < NUM_ROLES);
+			if (_cpus [role].empty ()){
+				return -1;
+			}
+			int cpu;
+			{
+				boost::lock_guard <boost::mutex> lock (_mutex);
+				cpu = _cpus [role][_next [role]++ % _cpus [role].size ()];
+			}
+
+			cpu_set_t set;
+			CPU_ZERO (&set);
+			CPU_SET (cpu, &set);
+			if (pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &set)){
+				PRINT ("warning: could not pin thread to cpu %d\n", cpu);
+				return -1;
+			}
+			return cpu;
+		}
+
+		// method to get the NUMA nodes a role's threads run on (empty if the role is not pinned)
+		inline vector <int>
+		nodes (int role) const
+		{
+			assert (role >= 0 && role < NUM_ROLES);
+			vector <int> result;
+			for (unsigned int i = 0; i < _cpus [role].size (); ++i){
+				int n = node (_cpus [role][i]);
+				if (find (result.begin (), result.end (), n) == result.end ()){
+					result.push_back (n);
+				}
+			}
+			return result;
+		}
+
+		// method to run f with the calling thread moved to the CPUs of a NUMA node for the duration
+		inline void
+		onNode (int n, const boost::function <void ()> &f) const
+		{
+			cpu_set_t saved, set;
+			CPU_ZERO (&set);
+			for (unsigned int i = 0; i < _cpuNode.size (); ++i){
+				if (_cpuNode [i] == n){
+					CPU_SET (i, &set);
+				}
+			}
+			if (!CPU_COUNT (&set) || pthread_getaffinity_np (pthread_self (), sizeof (cpu_set_t), &saved)
+			    || pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &set)){
+				f ();
+				return;
+			}
+			f ();
+			pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &saved);
+		}
+
+	protected:
+		// method to read a list in the kernel's format from a sysfs file
+		static inline bool
+		readList (const char *path, vector <int> &items)
+		{
+			FILE *f = fopen (path, "r");
+			if (!f){
+				return false;
+			}
+			char list [1024];
+			bool result = fgets (list, sizeof (list), f) && parseCpuList (list, items);
+			fclose (f);
+			return result;
+		}
+
+		// method to read which CPUs belong to which NUMA node from sysfs (node numbers may have gaps)
+		inline void
+		readTopology ()
+		{
+			vector <int> nodes;
+			if (!readList ("/sys/devices/system/node/possible", nodes)){
+				return;
+			}
+			char path [64];
+			for (unsigned int j = 0; j < nodes.size (); ++j){
+				int n = nodes [j];
+				sprintf (path, "/sys/devices/system/node/node%d/cpulist", n);
+				vector <int> cpus;
+				if (!readList (path, cpus)){
+					continue; // possible, but not online
+				}
+				for (unsigned int i = 0; i < cpus.size (); ++i){
+					if (cpus [i] >= static_cast <int> (_cpuNode.size ())){
+						_cpuNode.resize (cpus [i] + 1, 0);
+					}
+					_cpuNode [cpus [i]] = n;
+				}
+				_numNodes = max (_numNodes, n + 1);
+			}
+		}
+
+	private:
+		Placement (const Placement &);
+		Placement & operator = (const Placement &);
+	};
+}
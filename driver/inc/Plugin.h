@@ -21,7 +21,9 @@
  * resources. The resources may be in the form of the library's choosing.
  * The synchronicity/ data-safety of the threads with respect to the
  * resources is assured by having the plugin threads access these resources
- * using pre-defined boost semaphores.
+ * using pre-defined boost semaphores. Plugins do not create threads of
+ * their own; they use the Driver's worker pool for their resource loops
+ * and for any parallel work.
  */
 #pragma once
 
@@ -37,27 +39,28 @@ namespace SF {
 
 	class Driver;
 	class Resource;
+	class WorkerPool;
 
 	class Plugin {
 
-	private:
-		boost::thread *_threads;
+	protected:
+		WorkerPool *_pool; // shared with all plugins; set from the Driver in the constructor
 
 	public:
 		std::vector <boost::shared_ptr <Resource> > _resources;
 
 	private:
 		Plugin ()
-		: _threads (NULL)
+		: _pool (NULL)
 		{ }
 
 		Plugin (const Plugin &p)
-		: _threads (p._threads), _resources (p._resources)
+		: _pool (p._pool), _resources (p._resources)
 		{ }
 
 		Plugin& operator = (const Plugin& p)
 		{
-			_threads = p._threads;
+			_pool = p._pool;
 			_resources = p._resources;
 
 			return *this;
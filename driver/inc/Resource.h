@@ -29,12 +29,21 @@ using namespace boost;
 
 namespace SF {
 
+	class TripleBuffer;
+	class StageControl;
+
 	class Resource {
 
 	public:
 		boost::shared_ptr < string > _name;
 		boost::shared_ptr < string > _owner;
 
+		// lock-free handoff of the latest complete state (NULL if resource synchronizes via semaphores)
+		boost::shared_ptr < TripleBuffer > _state;
+
+		// stages the resource takes part in (NULL if it has none); owned by the derived class
+		StageControl *_stages;
+
 	public:
 		Resource ();
 		virtual ~Resource () { }
@@ -47,5 +56,6 @@ namespace SF {
 		void (* touch) (Resource&);
 		void (* transform) (Resource&);
 		void (* reprogram) (Resource&);
+		void (* relocate) (Resource&); // re-allocate large arrays from the calling thread (NUMA first touch); may be NULL
 	};
 }
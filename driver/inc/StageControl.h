@@ -0,0 +1,410 @@
+/**
+ * @file StageControl.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Declarative stage ordering for resources controlled by the Driver.
+ * StageGraph describes which stages (physics, collision, intersection,
+ * graphics) depend on which within one frame, plus optional target rates.
+ * StageControl turns such a graph into semaphores for one resource: every
+ * dependency gets its own semaphore and the last stages of a frame release
+ * the first stages of the next. Independent stages therefore run in
+ * parallel, and adding a stage never requires renumbering semaphores.
+ * The graph orders the stages of one resource only: every resource keeps
+ * running its stages in a loop on its own thread, with its own semaphores,
+ * so a dependency never spans two resources and the Driver does not
+ * schedule stage bodies on its worker pool.
+ * Resources may still describe their semaphores by hand (num_mutexes,
+ * mutex_startvalN, <stage>_wait_index, <stage>_post_index).
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <utility>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Preprocess.h"
+#include "ThreadControl.h"
+
+using namespace std;
+
+namespace SF {
+
+	enum Stage {
+		PHYSICS_STAGE = 0,
+		COLLISION_STAGE,
+		INTERSECTION_STAGE,
+		GRAPHICS_STAGE,
+		NUM_STAGES
+	};
+
+	static const char * const STAGE_NAMES [NUM_STAGES] = {"physics", "collision", "intersection", "graphics"};
+
+	class StageGraph {
+
+	public:
+		bool _present [NUM_STAGES];
+		double _rate [NUM_STAGES]; // target starts per second (0 for unthrottled)
+		vector <pair <int, int> > _edges; // (before, after) within one frame
+
+	public:
+		StageGraph ()
+		{
+			for (int i = 0; i < NUM_STAGES; ++i){
+				_present [i] = false;
+				_rate [i] = 0.;
+			}
+		}
+
+		// method to look up a stage by its configuration name (-1 if unknown)
+		static inline int
+		stageIndex (const char *name)
+		{
+			for (int i = 0; i < NUM_STAGES; ++i){
+				if (!strcmp (name, STAGE_NAMES [i])){
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		inline bool empty () const
+		{
+			for (int i = 0; i < NUM_STAGES; ++i){
+				if (_present [i]){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline void
+		addStage (int stage, double rate = 0.)
+		{
+			assert (stage >= 0 && stage < NUM_STAGES);
+			_present [stage] = true;
+			_rate [stage] = rate;
+		}
+
+		inline void
+		addDependency (int before, int after)
+		{
+			assert (before >= 0 && before < NUM_STAGES);
+			assert (after >= 0 && after < NUM_STAGES);
+			_present [before] = _present [after] = true;
+			for (size_t i = 0; i < _edges.size (); ++i){
+				if (_edges [i].first == before && _edges [i].second == after){
+					return;
+				}
+			}
+			_edges.push_back (pair <int, int> (before, after));
+		}
+
+		// method to drop a stage that a resource does not run; its predecessors are joined to its successors
+		inline void
+		removeStage (int stage)
+		{
+			assert (stage >= 0 && stage < NUM_STAGES);
+			if (!_present [stage]){
+				return;
+			}
+			vector <int> before, after;
+			vector <pair <int, int> > edges;
+			for (size_t i = 0; i < _edges.size (); ++i){
+				if (_edges [i].second == stage){
+					before.push_back (_edges [i].first);
+				} else if (_edges [i].first == stage){
+					after.push_back (_edges [i].second);
+				} else {
+					edges.push_back (_edges [i]);
+				}
+			}
+			_edges = edges;
+			_present [stage] = false;
+			for (size_t i = 0; i < before.size (); ++i){
+				for (size_t j = 0; j < after.size (); ++j){
+					addDependency (before [i], after [j]);
+				}
+			}
+		}
+
+		// method to check that dependencies within a frame do not form a cycle
+		inline bool
+		isAcyclic () const
+		{
+			int inDegree [NUM_STAGES];
+			bool done [NUM_STAGES];
+			for (int i = 0; i < NUM_STAGES; ++i){
+				inDegree [i] = 0;
+				done [i] = !_present [i];
+			}
+			for (size_t i = 0; i < _edges.size (); ++i){
+				++inDegree [_edges [i].second];
+			}
+			bool progress = true;
+			while (progress){
+				progress = false;
+				for (int i = 0; i < NUM_STAGES; ++i){
+					if (!done [i] && !inDegree [i]){
+						done [i] = true;
+						progress = true;
+						for (size_t j = 0; j < _edges.size (); ++j){
+							if (_edges [j].first == i){
+								--inDegree [_edges [j].second];
+							}
+						}
+					}
+				}
+			}
+			for (int i = 0; i < NUM_STAGES; ++i){
+				if (!done [i]){
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	class StageControl {
+
+	protected:
+		ThreadControl _sync;
+		vector <unsigned int> _waits [NUM_STAGES];
+		vector <unsigned int> _posts [NUM_STAGES];
+
+		boost::posix_time::time_duration _period [NUM_STAGES];
+		boost::posix_time::ptime _lastStart [NUM_STAGES];
+
+		boost::atomic <unsigned long> _completed [NUM_STAGES]; // number of times each stage was released
+
+	public:
+		StageControl ()
+		{
+			for (int i = 0; i < NUM_STAGES; ++i){
+				_period [i] = boost::posix_time::microseconds (0);
+				_completed [i] = 0;
+			}
+		}
+
+		// method to check if a stage takes part in the synchronization of the resource
+		inline bool has (int stage) const { return !_waits [stage].empty () || !_posts [stage].empty (); }
+
+		// method to get control for a stage
+		inline void
+		wait (int stage)
+		{
+			assert (stage >= 0 && stage < NUM_STAGES);
+			for (size_t i = 0; i < _waits [stage].size (); ++i){
+				_sync [_waits [stage][i]].wait ();
+			}
+			pace (stage);
+		}
+
+		// method to get control for a stage unless the deadline (universal time) passes first; returns false (holding nothing) then
+		inline bool
+		timedWait (int stage, const boost::posix_time::ptime &deadline)
+		{
+			assert (stage >= 0 && stage < NUM_STAGES);
+			for (size_t i = 0; i < _waits [stage].size (); ++i){
+				if (!_sync [_waits [stage][i]].timed_wait (deadline)){
+					while (i--){
+						_sync [_waits [stage][i]].post ();
+					}
+					return false;
+				}
+			}
+			pace (stage);
+			return true;
+		}
+
+		// method to release control of a stage
+		inline void
+		post (int stage)
+		{
+			assert (stage >= 0 && stage < NUM_STAGES);
+			for (size_t i = 0; i < _posts [stage].size (); ++i){
+				_sync [_posts [stage][i]].post ();
+			}
+			_completed [stage].fetch_add (1, boost::memory_order_relaxed);
+		}
+
+		// method to get how many times a stage has run to completion
+		inline unsigned long completed (int stage) const { return _completed [stage].load (boost::memory_order_relaxed); }
+
+		// method to build semaphores from a stage graph
+		inline bool
+		build (const StageGraph &graph)
+		{
+			assert (_sync.empty ());
+			if (graph.empty () || !graph.isAcyclic ()){
+				return false;
+			}
+
+			// one semaphore per dependency within a frame
+			for (size_t i = 0; i < graph._edges.size (); ++i){
+				_waits [graph._edges [i].second].push_back (static_cast <unsigned int> (_sync.size ()));
+				_posts [graph._edges [i].first].push_back (static_cast <unsigned int> (_sync.size ()));
+				_sync.push_back (0);
+			}
+
+			// the last stages of a frame release the first stages of the next one
+			bool source [NUM_STAGES], sink [NUM_STAGES];
+			for (int i = 0; i < NUM_STAGES; ++i){
+				source [i] = sink [i] = graph._present [i];
+			}
+			for (size_t i = 0; i < graph._edges.size (); ++i){
+				sink [graph._edges [i].first] = false;
+				source [graph._edges [i].second] = false;
+			}
+			for (int i = 0; i < NUM_STAGES; ++i){
+				for (int j = 0; sink [i] && j < NUM_STAGES; ++j){
+					if (source [j]){
+						_waits [j].push_back (static_cast <unsigned int> (_sync.size ()));
+						_posts [i].push_back (static_cast <unsigned int> (_sync.size ()));
+						_sync.push_back (1);
+					}
+				}
+			}
+
+			for (int i = 0; i < NUM_STAGES; ++i){
+				if (graph._present [i] && graph._rate [i] > 0.){
+					_period [i] = boost::posix_time::microseconds (static_cast <long> (1.e6/ graph._rate [i]));
+				}
+			}
+			return true;
+		}
+
+		// method to check that a configuration value is a non-negative decimal number
+		static inline bool
+		isNumber (const string &value)
+		{
+			if (value.empty () || value.size () > 9){
+				return false;
+			}
+			for (size_t i = 0; i < value.size (); ++i){
+				if (!isdigit (value [i])){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * Method to set up synchronization of a resource from its configuration file.
+		 * Hand-numbered semaphores (num_mutexes etc.) take precedence. Otherwise the
+		 * Driver's stage graph is used, minus the stages the resource does not run
+		 * (bit i of stageMask set for every stage i that it runs).
+		 */
+		inline bool
+		configure (const string &config, bool (*getParameter) (const string &, const char *, string &),
+		           const StageGraph &driverGraph, unsigned int stageMask)
+		{
+			string mStr;
+			getParameter (config, "num_mutexes", mStr);
+
+			if (mStr.empty ()){
+				StageGraph graph (driverGraph);
+				for (int i = 0; i < NUM_STAGES; ++i){
+					if (!(stageMask & (1u << i))){
+						graph.removeStage (i);
+					}
+				}
+				if (!build (graph)){
+					PRINT ("error: invalid stage graph for %s\n", config.c_str ());
+					return false;
+				}
+				return true;
+			}
+
+			if (!isNumber (mStr)){
+				PRINT ("error: num_mutexes %s in %s is not a number\n", mStr.c_str (), config.c_str ());
+				return false;
+			}
+			int numMutex = atoi (mStr.c_str ());
+
+			string msv;
+			for (int i = 0; i < numMutex; ++i){
+				char param [32];
+				sprintf (param, "mutex_startval%d", i + 1);
+				getParameter (config, param, msv);
+				if (msv.empty ()){
+					PRINT ("error: %s not specified in %s\n", param, config.c_str ());
+					return false;
+				}
+				if (!isNumber (msv)){
+					PRINT ("error: %s %s in %s is not a number\n", param, msv.c_str (), config.c_str ());
+					return false;
+				}
+				_sync.push_back (static_cast <unsigned int> (atoi (msv.c_str ())));
+			}
+
+			for (int i = 0; i < NUM_STAGES; ++i){
+				if (!(stageMask & (1u << i))){
+					continue;
+				}
+				string waitStr, postStr, param (STAGE_NAMES [i]);
+				getParameter (config, (param + "_wait_index").c_str (), waitStr);
+				getParameter (config, (param + "_post_index").c_str (), postStr);
+				if (waitStr.empty () && postStr.empty ()){
+					continue;
+				}
+				if (waitStr.empty () || postStr.empty ()){
+					PRINT ("error: %s stage in %s needs both wait and post indices\n", STAGE_NAMES [i], config.c_str ());
+					return false;
+				}
+				if (!isNumber (waitStr) || !isNumber (postStr)){
+					PRINT ("error: %s stage indices %s and %s in %s are not numbers\n", STAGE_NAMES [i], waitStr.c_str (), postStr.c_str (), config.c_str ());
+					return false;
+				}
+				int waitIndex = atoi (waitStr.c_str ());
+				int postIndex = atoi (postStr.c_str ());
+				if (waitIndex < 0 || waitIndex >= numMutex || postIndex < 0 || postIndex >= numMutex){
+					PRINT ("error: %s stage indices in %s out of range [0, %d)\n", STAGE_NAMES [i], config.c_str (), numMutex);
+					return false;
+				}
+				_waits [i].push_back (static_cast <unsigned int> (waitIndex));
+				_posts [i].push_back (static_cast <unsigned int> (postIndex));
+			}
+			return true;
+		}
+
+	protected:
+		// method to hold back a stage that is running ahead of its target rate
+		inline void
+		pace (int stage)
+		{
+			if (_period [stage].total_microseconds () > 0){
+				boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time ();
+				if (!_lastStart [stage].is_not_a_date_time ()){
+					boost::posix_time::time_duration left = _period [stage] - (now - _lastStart [stage]);
+					if (left.total_microseconds () > 0){
+						boost::this_thread::sleep (left);
+						now += left;
+					}
+				}
+				_lastStart [stage] = now;
+			}
+		}
+	};
+}
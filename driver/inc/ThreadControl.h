@@ -25,14 +25,13 @@
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
 
 using namespace std;
-using namespace boost::interprocess;
 
 namespace SF {
 
 	class ThreadControl {
 
 	protected:
-		vector< interprocess_semaphore* > _mutex;
+		vector< boost::interprocess::interprocess_semaphore* > _mutex;
 
 	public:
 		ThreadControl(){}
@@ -50,7 +49,7 @@ namespace SF {
 		inline size_t size(){ return _mutex.size(); }
 
 		// method to access individual members
-		inline interprocess_semaphore&
+		inline boost::interprocess::interprocess_semaphore&
 		operator [] (unsigned int index)
 		{
 			assert (index < static_cast <unsigned int>(_mutex.size()));
@@ -61,7 +60,7 @@ namespace SF {
 		inline void
 		push_back(unsigned int number)
 		{
-			interprocess_semaphore* ism = new interprocess_semaphore (number);
+			boost::interprocess::interprocess_semaphore* ism = new boost::interprocess::interprocess_semaphore (number);
 			_mutex.push_back (ism);
 		}
 	};
@@ -0,0 +1,74 @@
+/**
+ * @file TripleBuffer.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Lock-free triple-buffered state handoff between one producer thread
+ * (e.g. physics) and one consumer thread (e.g. graphics). The class only
+ * hands out slot indices (0, 1 or 2); the owner keeps three copies of its
+ * state and indexes them with these. The producer never waits and the
+ * consumer always sees the latest completely written slot.
+ */
+
+#pragma once
+
+#include <boost/atomic.hpp>
+
+namespace SF {
+
+	class TripleBuffer {
+
+	protected:
+		static const unsigned int INDEX_MASK = 3;
+		static const unsigned int FRESH_BIT = 4;
+
+		boost::atomic <unsigned int> _middle; // shared slot (with FRESH_BIT if not yet consumed)
+		unsigned int _back; // slot owned by producer
+		unsigned int _front; // slot owned by consumer
+
+	public:
+		TripleBuffer ()
+		: _middle (1), _back (0), _front (2)
+		{ }
+
+		// producer: slot to write the next state into
+		inline unsigned int writeIndex () const { return _back; }
+
+		// producer: hand over the written slot and take the stale shared one
+		inline void
+		publish ()
+		{
+			_back = _middle.exchange (_back | FRESH_BIT, boost::memory_order_acq_rel) & INDEX_MASK;
+		}
+
+		// consumer: take the latest published slot if there is one; returns false if nothing new
+		inline bool
+		acquire ()
+		{
+			if (!(_middle.load (boost::memory_order_relaxed) & FRESH_BIT)){
+				return false;
+			}
+			_front = _middle.exchange (_front, boost::memory_order_acq_rel) & INDEX_MASK;
+			return true;
+		}
+
+		// consumer: slot holding the state to read
+		inline unsigned int readIndex () const { return _front; }
+
+	private:
+		TripleBuffer (const TripleBuffer &);
+		TripleBuffer & operator = (const TripleBuffer &);
+	};
+}
@@ -0,0 +1,333 @@
+/**
+ * @file WorkerPool.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * The worker pool owned by the Driver and shared by all plugins. Short
+ * tasks are queued by priority and run on a fixed set of worker threads,
+ * so several loaded plugins do not oversubscribe the machine. A thread
+ * waiting for a task group runs queued tasks itself instead of blocking,
+ * which makes nested parallel work safe. The endless per-resource loops
+ * (Mesh::run etc.) are not tasks; they are started with spawn on threads
+ * of their own, which the pool keeps track of. Threads are placed as the
+ * Driver's Placement policy says, and tasks may be queued for the workers
+ * of one NUMA node; other workers only take them when idle.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include "Resource.h"
+#include "Placement.h"
+
+using namespace std;
+
+namespace SF {
+
+	enum TaskPriority {
+		HIGH_PRIORITY = 0,
+		NORMAL_PRIORITY,
+		LOW_PRIORITY,
+		NUM_PRIORITIES
+	};
+
+	// set of tasks that can be waited upon together
+	class TaskGroup {
+
+		friend class WorkerPool;
+
+	protected:
+		unsigned int _pending; // guarded by the owning pool's mutex
+
+	public:
+		TaskGroup ()
+		: _pending (0)
+		{ }
+
+	private:
+		TaskGroup (const TaskGroup &);
+		TaskGroup & operator = (const TaskGroup &);
+	};
+
+	class WorkerPool {
+
+	protected:
+		struct Task {
+			boost::function <void ()> _function;
+			TaskGroup *_group;
+		};
+
+		boost::mutex _mutex;
+		boost::condition_variable _ready; // signalled when a task is queued
+		boost::condition_variable _finished; // signalled when a task group empties
+		vector <deque <Task> > _queue [NUM_PRIORITIES]; // one queue per NUMA node, the last for any node
+		bool _stop;
+
+		boost::thread_group _workers;
+		unsigned int _numWorkers;
+		vector <boost::thread *> _loops;
+
+		Placement *_placement;
+
+	public:
+		WorkerPool ()
+		: _stop (false), _numWorkers (0), _placement (NULL)
+		{
+			for (int i = 0; i < NUM_PRIORITIES; ++i){
+				_queue [i].resize (1);
+			}
+		}
+
+		~WorkerPool ()
+		{
+			{
+				boost::lock_guard <boost::mutex> lock (_mutex);
+				_stop = true;
+			}
+			_ready.notify_all ();
+			_workers.join_all ();
+
+			// resource loops never return; let them go with the process
+			for (unsigned int i = 0; i < _loops.size (); ++i){
+				_loops [i]->detach ();
+				delete _loops [i];
+			}
+		}
+
+		// method to start the worker threads (0 to use one per hardware thread) placed by a policy (may be NULL)
+		inline void
+		start (unsigned int n = 0, Placement *placement = NULL)
+		{
+			assert (!_numWorkers);
+			_placement = placement;
+			if (_placement){
+				for (int i = 0; i < NUM_PRIORITIES; ++i){
+					_queue [i].resize (_placement->numNodes () + 1);
+				}
+			}
+			if (!n){
+				n = boost::thread::hardware_concurrency ();
+			}
+			if (!n){
+				n = 1;
+			}
+			for (unsigned int i = 0; i < n; ++i){
+				_workers.create_thread (boost::bind (&WorkerPool::work, this));
+			}
+			_numWorkers = n;
+		}
+
+		inline unsigned int size () const { return _numWorkers; }
+		inline Placement * placement () const { return _placement; }
+
+		/**
+		 * Method to start a long-running loop (e.g. a resource's run method) on
+		 * its own thread. The thread is pinned as the placement policy says for
+		 * role, and resource (if given) is relocated from it before the loop
+		 * starts if first touch is enabled.
+		 */
+		inline void
+		spawn (const boost::function <void ()> &loop, int role = -1, Resource *resource = NULL)
+		{
+			boost::lock_guard <boost::mutex> lock (_mutex);
+			_loops.push_back (new boost::thread (boost::bind (&WorkerPool::runLoop, this, loop, role, resource)));
+		}
+
+		// method to queue a short task; group may be NULL if nobody waits on it, node -1 for any NUMA node
+		inline void
+		submit (const boost::function <void ()> &f, TaskGroup *group = NULL, TaskPriority priority = NORMAL_PRIORITY, int node = -1)
+		{
+			assert (priority >= 0 && priority < NUM_PRIORITIES);
+			if (!_numWorkers){
+				f ();
+				return;
+			}
+			Task t;
+			t._function = f;
+			t._group = group;
+			{
+				boost::lock_guard <boost::mutex> lock (_mutex);
+				if (group){
+					++(group->_pending);
+				}
+				if (node < 0 || node >= static_cast <int> (_queue [priority].size ()) - 1){
+					node = static_cast <int> (_queue [priority].size ()) - 1;
+				}
+				_queue [priority][node].push_back (t);
+			}
+			_ready.notify_one ();
+		}
+
+		// method to wait for all tasks of a group; the caller runs queued tasks of that group meanwhile (never unrelated, possibly slower ones)
+		inline void
+		wait (TaskGroup &group)
+		{
+			boost::unique_lock <boost::mutex> lock (_mutex);
+			Task t;
+			while (group._pending){
+				if (popGroup (t, &group)){
+					execute (t, lock);
+				} else {
+					_finished.wait (lock);
+				}
+			}
+		}
+
+		/**
+		 * Method to run f (lo, hi) over [begin, end) split into chunks of at
+		 * most grain indices, and wait for all of them. A grain of 0 gives
+		 * every worker a few chunks.
+		 */
+		inline void
+		parallelFor (unsigned int begin, unsigned int end, const boost::function <void (unsigned int, unsigned int)> &f,
+		             unsigned int grain = 0, TaskPriority priority = NORMAL_PRIORITY)
+		{
+			if (begin >= end){
+				return;
+			}
+			if (!grain){
+				unsigned int chunks = 4 * (_numWorkers ? _numWorkers : 1);
+				grain = (end - begin + chunks - 1)/ chunks;
+			}
+			if (_numWorkers < 2 || end - begin <= grain){
+				f (begin, end);
+				return;
+			}
+
+			TaskGroup group;
+			for (unsigned int lo = begin; lo < end; lo += grain){
+				unsigned int hi = end - lo > grain ? lo + grain : end;
+				submit (boost::bind (f, lo, hi), &group, priority);
+			}
+			wait (group);
+		}
+
+	protected:
+		// method to take the most urgent queued task, preferring those of own node (mutex must be held)
+		inline bool
+		pop (Task &t, int node)
+		{
+			for (int i = 0; i < NUM_PRIORITIES; ++i){
+				int any = static_cast <int> (_queue [i].size ()) - 1;
+				if (node >= 0 && node < any && take (_queue [i][node], t)){
+					return true;
+				}
+				if (take (_queue [i][any], t)){
+					return true;
+				}
+			}
+			// nothing for this node; help the others
+			for (int i = 0; i < NUM_PRIORITIES; ++i){
+				for (size_t j = 0; j + 1 < _queue [i].size (); ++j){
+					if (take (_queue [i][j], t)){
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		// method to take the most urgent queued task of a group (mutex must be held)
+		inline bool
+		popGroup (Task &t, const TaskGroup *group)
+		{
+			for (int i = 0; i < NUM_PRIORITIES; ++i){
+				for (size_t j = 0; j < _queue [i].size (); ++j){
+					deque <Task> &q = _queue [i][j];
+					for (deque <Task>::iterator it = q.begin (); it != q.end (); ++it){
+						if (it->_group == group){
+							t = *it;
+							q.erase (it);
+							return true;
+						}
+					}
+				}
+			}
+			return false;
+		}
+
+		static inline bool
+		take (deque <Task> &q, Task &t)
+		{
+			if (q.empty ()){
+				return false;
+			}
+			t = q.front ();
+			q.pop_front ();
+			return true;
+		}
+
+		// method to run a task outside the lock and account for it in its group
+		inline void
+		execute (Task &t, boost::unique_lock <boost::mutex> &lock)
+		{
+			lock.unlock ();
+			t._function ();
+			t._function.clear ();
+			lock.lock ();
+			if (t._group && !--(t._group->_pending)){
+				_finished.notify_all ();
+			}
+		}
+
+		// worker thread body
+		void
+		work ()
+		{
+			int node = -1;
+			if (_placement){
+				int cpu = _placement->pin (WORKER_ROLE);
+				if (cpu >= 0){
+					node = _placement->node (cpu);
+				}
+			}
+
+			boost::unique_lock <boost::mutex> lock (_mutex);
+			Task t;
+			while (true){
+				while (!_stop && !pop (t, node)){
+					_ready.wait (lock);
+				}
+				if (_stop){
+					return;
+				}
+				execute (t, lock);
+			}
+		}
+
+		// thread body of a long-running loop
+		void
+		runLoop (boost::function <void ()> loop, int role, Resource *resource)
+		{
+			if (_placement && role >= 0){
+				_placement->pin (role);
+				if (_placement->firstTouch () && resource && resource->relocate){
+					resource->relocate (*resource);
+				}
+			}
+			loop ();
+		}
+
+	private:
+		WorkerPool (const WorkerPool &);
+		WorkerPool & operator = (const WorkerPool &);
+	};
+}
@@ -23,6 +23,8 @@
  * controlling rendering related behavior.
  */
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 
 #include <vector>
@@ -40,6 +42,7 @@ extern "C" {
 #include "aabb.h"
 
 #include "Plugin.h"
+#include "Resource.h"
 #include "Display.h"
 #include "Driver.h"
 
@@ -50,7 +53,8 @@ namespace SF {
 
 	// static function to parse and retrieve contents from a configuration file
 	static bool
-	parse (char* const cfgFile, vector <string>& types, vector <string>& properties, vector <string>& configs)
+	parse (char* const cfgFile, vector <string>& types, vector <string>& properties, vector <string>& configs, StageGraph &stages,
+	       unsigned int &poolSize, Placement &placement, bool &headless, unsigned long &maxFrames, double &maxSeconds)
 	{
 		assert (cfgFile);
 
@@ -105,6 +109,118 @@ namespace SF {
 				free (typeName); typeName = NULL;
 				free (configFile); configFile = NULL;
 			}
+			// read in stage-related properties
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "stage")){
+
+				char *stageName = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("name")));
+				assert (stageName);
+				int stage = StageGraph::stageIndex (stageName);
+				if (stage < 0){
+					PRINT ("error: unknown stage %s in %s\n", stageName, cfgFile);
+					free (stageName);
+					xmlFreeDoc (doc);
+					return false;
+				}
+
+				double rate = 0.;
+				char *rateStr = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("rate")));
+				if (rateStr){
+					rate = atof (rateStr);
+					free (rateStr); rateStr = NULL;
+				}
+				stages.addStage (stage, rate);
+
+				free (stageName); stageName = NULL;
+			}
+			// read in ordering between stages
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "dependency")){
+
+				char *before = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("before")));
+				assert (before);
+				char *after = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("after")));
+				assert (after);
+
+				int b = StageGraph::stageIndex (before), a = StageGraph::stageIndex (after);
+				if (b < 0 || a < 0){
+					PRINT ("error: unknown stage in dependency %s -> %s in %s\n", before, after, cfgFile);
+					free (before); free (after);
+					xmlFreeDoc (doc);
+					return false;
+				}
+				stages.addDependency (b, a);
+
+				free (before); before = NULL;
+				free (after); after = NULL;
+			}
+			// read in size of the shared worker pool
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "workerpool")){
+
+				char *sizeStr = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("size")));
+				assert (sizeStr);
+				for (unsigned int i = 0; i < strlen (sizeStr); ++i){
+					if (!isdigit (sizeStr [i])){
+						PRINT ("error: workerpool size \'%s\' in %s is not a number\n", sizeStr, cfgFile);
+						free (sizeStr);
+						xmlFreeDoc (doc);
+						return false;
+					}
+				}
+				poolSize = static_cast <unsigned int> (atoi (sizeStr));
+
+				free (sizeStr); sizeStr = NULL;
+			}
+			// read in cores that threads of a stage (or the worker pool) are pinned to
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "affinity")){
+
+				char *roleName = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("role")));
+				assert (roleName);
+				char *cpus = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("cpus")));
+				assert (cpus);
+
+				int role = roleIndex (roleName);
+				if (role < 0 || !placement.setCpus (role, cpus)){
+					PRINT ("error: invalid affinity %s -> %s in %s\n", roleName, cpus, cfgFile);
+					free (roleName); free (cpus);
+					xmlFreeDoc (doc);
+					return false;
+				}
+
+				free (roleName); roleName = NULL;
+				free (cpus); cpus = NULL;
+			}
+			// read in headless (render-less) execution
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "headless")){
+
+				headless = true;
+
+				char *framesStr = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("frames")));
+				if (framesStr){
+					for (unsigned int i = 0; i < strlen (framesStr); ++i){
+						if (!isdigit (framesStr [i])){
+							PRINT ("error: headless frames \'%s\' in %s is not a number\n", framesStr, cfgFile);
+							free (framesStr);
+							xmlFreeDoc (doc);
+							return false;
+						}
+					}
+					maxFrames = strtoul (framesStr, NULL, 10);
+					free (framesStr); framesStr = NULL;
+				}
+				char *secondsStr = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("seconds")));
+				if (secondsStr){
+					maxSeconds = atof (secondsStr);
+					free (secondsStr); secondsStr = NULL;
+				}
+			}
+			// read in memory placement
+			else if (!strcmp (reinterpret_cast <const char*> (node->name), "numa")){
+
+				char *firstTouch = reinterpret_cast <char*> (xmlGetProp (node, reinterpret_cast <const xmlChar*> ("firsttouch")));
+				if (firstTouch){
+					placement.setFirstTouch (!strcmp (firstTouch, "true"));
+					free (firstTouch); firstTouch = NULL;
+				}
+			}
 
 			node = node->next; node = node->next;
 		}
@@ -130,6 +246,7 @@ namespace SF {
 	 * @param configFile Input XML styled configuration file
 	 */
 	Driver::Driver (int &argc, char **argv)
+	: _headless (false), _maxFrames (0), _maxSeconds (0.)
 	{
 		// sanity test
 		char *cfgFile = argv [1];
@@ -141,11 +258,28 @@ namespace SF {
 		{
 			vector  <string> moduleTypes;
 			vector  <string> propertyNames;
+			unsigned int poolSize = 0;
 
-			if (!parse (cfgFile, moduleTypes, propertyNames, configFiles)){
+			if (!parse (cfgFile, moduleTypes, propertyNames, configFiles, _stageGraph, poolSize, _placement,
+			            _headless, _maxFrames, _maxSeconds)){
 				PRINT ("error in parsing %s....Aborting\n", cfgFile);
 				exit (EXIT_FAILURE);
 			}
+
+			// default frame: physics, then intersection, then graphics
+			if (_stageGraph.empty ()){
+				_stageGraph.addDependency (PHYSICS_STAGE, INTERSECTION_STAGE);
+				_stageGraph.addDependency (INTERSECTION_STAGE, GRAPHICS_STAGE);
+			}
+			if (!_stageGraph.isAcyclic ()){
+				PRINT ("error: stage dependencies in %s form a cycle....Aborting\n", cfgFile);
+				exit (EXIT_FAILURE);
+			}
+
+			// plugins may hand work to the pool as soon as they are constructed
+			_pool.start (poolSize, &_placement);
+			PRINT ("worker pool started with %u threads on %d NUMA node(s)\n", _pool.size (), _placement.numNodes ());
+
 			assert (!moduleTypes.empty ());
 			assert (!propertyNames.empty ());
 			assert (!configFiles.empty ());
@@ -160,7 +294,7 @@ namespace SF {
 
 			while (miter != moduleTypes.end ()){
 				if (!miter->compare ("interface") && !piter->compare ("display")){
-					_display = boost::shared_ptr <GL_Window> (new GL_Window (argc, argv, *citer));
+					_display = boost::shared_ptr <GL_Window> (new GL_Window (argc, argv, *citer, _headless));
 
 					moduleTypes.erase (miter);
 					propertyNames.erase (piter);
@@ -174,6 +308,14 @@ namespace SF {
 					++citer;
 				}
 			}
+			// plugins still take view state (lights, matrices, bounds) from a display without a window
+			if (!_display){
+				if (!_headless){
+					PRINT ("error: no display interface in %s....Aborting\n", cfgFile);
+					exit (EXIT_FAILURE);
+				}
+				_display = boost::shared_ptr <GL_Window> (new GL_Window (argc, argv, string (), true));
+			}
 			assert (!moduleTypes.empty ());
 
 			// copy plugin names and configuration files and erase the rest
@@ -233,10 +375,89 @@ namespace SF {
 	  // register self to the display
 	  _display.get ()->_parent = const_cast <Driver *> (this);
 
+	  // this thread renders from here on
+	  _placement.pin (GRAPHICS_STAGE);
+
 		for (unsigned int i = 0; i  < _plugins.size(); ++i){
 			_plugins.at (i)->run ();
 		}
-		_display.get ()->run ();
+
+		if (_headless){
+			runHeadless ();
+		} else {
+			_display.get ()->run ();
+		}
+	}
+
+	/**
+	 * The loop of a headless run. It stands in for the display: every frame it
+	 * takes and releases the graphics stage of each resource, so pipelines run
+	 * exactly as they would with rendering. It stops after the configured number
+	 * of frames or seconds (whichever comes first; never if neither is set),
+	 * also while a stalled pipeline holds back the graphics stage.
+	 */
+	void
+	Driver::runHeadless ()
+	{
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time ();
+		boost::posix_time::ptime deadline = start + boost::posix_time::microseconds (static_cast <long> (_maxSeconds * 1.e6));
+		boost::posix_time::time_duration elapsed = boost::posix_time::microseconds (0);
+		unsigned long frames = 0;
+
+		// frames are counted by graphics or physics stages; without any the run could never end
+		bool countable = false;
+		for (unsigned int i = 0; i < _resources.size (); ++i){
+			StageControl *stages = _resources [i].get ()->_stages;
+			countable = countable || (stages && (stages->has (GRAPHICS_STAGE) || stages->has (PHYSICS_STAGE)));
+		}
+		if (!countable){
+			PRINT ("fatal error: headless run without a resource that has a graphics or physics stage to count frames\n");
+			cleanup ();
+			exit (EXIT_FAILURE);
+		}
+
+		bool timedOut = false;
+		while (!timedOut && (!_maxFrames || frames < _maxFrames) && (_maxSeconds <= 0. || elapsed.total_microseconds () < _maxSeconds * 1.e6)){
+
+			bool paced = false;
+			for (unsigned int i = 0; i < _resources.size () && !timedOut; ++i){
+				StageControl *stages = _resources [i].get ()->_stages;
+				if (stages && stages->has (GRAPHICS_STAGE)){
+					if (_maxSeconds > 0.){
+						timedOut = !stages->timedWait (GRAPHICS_STAGE, deadline);
+					} else {
+						stages->wait (GRAPHICS_STAGE);
+					}
+					if (!timedOut){
+						stages->post (GRAPHICS_STAGE);
+						paced = true;
+					}
+				}
+			}
+
+			if (timedOut){
+				// the deadline passed within the frame, which does not count
+			} else if (paced){
+				++frames;
+			} else {
+				// nothing waits on graphics: count frames of the slowest physics loop instead
+				boost::this_thread::sleep (boost::posix_time::milliseconds (1));
+				bool first = true;
+				for (unsigned int i = 0; i < _resources.size (); ++i){
+					StageControl *stages = _resources [i].get ()->_stages;
+					if (stages && stages->has (PHYSICS_STAGE)){
+						unsigned long n = stages->completed (PHYSICS_STAGE);
+						frames = first || n < frames ? n : frames;
+						first = false;
+					}
+				}
+			}
+			elapsed = boost::posix_time::microsec_clock::universal_time () - start;
+		}
+
+		double seconds = static_cast <double> (elapsed.total_microseconds ()) * 1.e-6;
+		PRINT ("headless run: %lu frames in %g s (%g frames/s)\n", frames, seconds, seconds > 0. ? frames/ seconds : 0.);
+		cleanup ();
 	}
 
   // the cleanup method
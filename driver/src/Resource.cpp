@@ -19,19 +19,20 @@
  * Function pointers in Resource need to be implemented by derived classes.
  */
 
+#include "TripleBuffer.h"
 #include "Resource.h"
 
 namespace SF {
 
 	// default constructor
 	Resource::Resource ()
-	: draw (NULL), touch (NULL), transform (NULL), reprogram (NULL)
+	: _stages (NULL), draw (NULL), touch (NULL), transform (NULL), reprogram (NULL), relocate (NULL)
 	{ }
 
 	// copy constructor
 	Resource::Resource (const Resource& r)
-	: _name (r._name), _owner (r._owner),
-	  draw (r.draw), touch (r.touch), transform (r.transform), reprogram (r.reprogram)
+	: _name (r._name), _owner (r._owner), _state (r._state), _stages (r._stages),
+	  draw (r.draw), touch (r.touch), transform (r.transform), reprogram (r.reprogram), relocate (r.relocate)
 	{ }
 
 	// assignment operator
@@ -40,11 +41,14 @@ namespace SF {
 	{
 		_name = r._name;
 		_owner = r._owner;
+		_state = r._state;
+		_stages = r._stages;
 
 		draw = r.draw;
 		touch = r.touch;
 		transform = r.transform;
 		reprogram = r.reprogram;
+		relocate = r.relocate;
 
 		return *this;
 	}
@@ -0,0 +1,24 @@
+uniform mat4 modelview;
+uniform mat4 projection;
+uniform mat4 pose;
+
+in vec4 vertex;
+
+in vec2 normalTexCoord;
+uniform sampler2D normalTexture;
+
+out vec4 position;
+out vec4 eye;
+out vec4 normal;
+
+void main ()
+{
+  position = modelview * pose * vertex;
+
+  vec4 nrm = normalize (texture (normalTexture, normalTexCoord));
+  normal = modelview * pose * vec4 (nrm.xyz, 0.);
+
+  eye = inverse (projection) * vec4 (0., 0., -1., 0.);
+
+  gl_Position = projection * position;
+}
@@ -54,6 +54,9 @@ namespace SF {
     // pointer to the parent driver
     Driver *_parent;
 
+    // no window or GL context: only the view state below is kept (Driver runs without rendering)
+    bool _headless;
+
 		// resources participating in display
 		vector <boost::shared_ptr <Resource> > _drawables;
 
@@ -105,7 +108,7 @@ namespace SF {
 		GLuint _glEnvTextureId;
 
 	public:
-		GL_Window (int &argc, char **argv, const string &config);
+		GL_Window (int &argc, char **argv, const string &config, bool headless = false);
 		~GL_Window ();
 
 	private:
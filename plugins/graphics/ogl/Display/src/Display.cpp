@@ -492,11 +492,12 @@ namespace SF {
 	}
 
 	// overloaded constructor
-	GL_Window::GL_Window (int &argc, char **argv, const string &config)
-	: _parent (NULL), _moveToggleCounter (0),
+	GL_Window::GL_Window (int &argc, char **argv, const string &config, bool headless)
+	: _parent (NULL), _headless (headless), _moveToggleCounter (0),
 	  _windowX (0), _windowY (0), _windowWidth (0), _windowHeight (0),
 	  _mouseX (0), _mouseY (0), _mouseButton (0),
-	  _numLights (0), _lightSpec1 (0.), _lightExp1 (0.), _lightSpec2 (0.), _lightExp2 (0.)
+	  _numLights (0), _lightSpec1 (0.), _lightExp1 (0.), _lightSpec2 (0.), _lightExp2 (0.),
+	  _glEnvTextureId (0)
 	{
 		for (int i = 0; i < 3; ++i){
 			_background [i] = 1.;
@@ -520,6 +521,12 @@ namespace SF {
 		_projection [0] = _projection [5] = _projection [10] = _projection [15] = 1.;
 		_modelview [0] = _modelview [5] = _modelview [10] = _modelview [15] = 1.;
 
+		// a headless run may come without any display configuration
+		if (_headless && config.empty ()){
+			_windowWidth = _windowHeight = 1;
+			return;
+		}
+
 		// get parameters from input configuration file
 		string inStr;
 		if (getProperty (config, "dimensions", "width", inStr)){
@@ -766,6 +773,11 @@ namespace SF {
       }
     }
 
+		// nothing below is done without a GL context
+		if (_headless){
+			return;
+		}
+
 		// initialize rendering context
     GLenum error;
 
@@ -23,6 +23,10 @@
 #include <vector>
 #include <string>
 
+extern "C" {
+#include <stdint.h>
+}
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 extern "C" {
@@ -42,8 +46,15 @@ using namespace boost::posix_time;
 namespace SF {
 
   class aabb;
+  class mat4x4;
   class Driver;
-  class ThreadControl;
+  class StageControl;
+  class TripleBuffer;
+  class WorkerPool;
+
+  namespace RM {
+    class Mesh;
+  }
 
   namespace MSD {
 
@@ -53,19 +64,14 @@ namespace SF {
       aabb _bbox;
 
       /************************ THREADCONTROL RELATED PARAMETERS *************************/
-      ThreadControl _syncControl;
-      int _semPhysicsWaitIndex;
-      int _semPhysicsPostIndex;
-      int _semCollisionWaitIndex;
-      int _semCollisionPostIndex;
-      int _semGraphicsWaitIndex;
-      int _semGraphicsPostIndex;
+      StageControl _syncControl;
 
       /************************ DATA RELATED PARAMETERS *************************/
       unsigned int _numSurfaceVertices;
       vector <vec> _vertices [2]; // on-host memory surface vertex buffers
       vector <vec> *_curr;
       vector <vec> *_prev;
+      vector <vec> _snapshot [3]; // surface vertices handed to graphics when synchronizing lock-free (see _state)
 
 			unsigned int _numSprings;
 			vector <unsigned int> _springIndices;
@@ -75,6 +81,66 @@ namespace SF {
 
 			vector <unsigned int> _numFaces;
 			vector <vector <unsigned int> > _faceIndices;
+			vector <vector <vector <unsigned int> > > _levelIndices; // coarser surfaces of each octant, if the mesh has them ([octant][level - 1])
+
+			/**
+			 * Coarse lattice of a two-level mesh (empty otherwise). The lattice is
+			 * simulated everywhere; the vertices above only run their springs in
+			 * regions (lattice cells) whose nodes overlap the tool's bounding box,
+			 * pass their forces on to the lattice there, and follow the lattice
+			 * by their embedding elsewhere.
+			 */
+			vector <vec> _latticeVertices [2]; // current and previous lattice nodes
+			vector <vec> _latticeRestVertices;
+			vector <vec> _latticeForce;
+			vector <real> _latticeMass;
+			vector <unsigned int> _latticeSpringIndices;
+			vector <unsigned int> _embedRegions; // region of every vertex
+			vector <unsigned int> _embedNodes; // four lattice nodes per vertex
+			vector <real> _embedWeights; // their barycentric weights
+			vector <unsigned int> _regionVertices [2]; // vertices of every region (offsets, then vertices in ascending order)
+			vector <unsigned int> _regionNodes [2]; // lattice nodes the vertices of every region hang on (offsets, then nodes)
+			vector <unsigned int> _regionSprings [2]; // springs with a vertex in every region (offsets, then springs)
+			vector <char> _regionActive; // regions that ran their springs in the last step
+			vector <unsigned char> _regionSettle; // steps left to blend the surface of a region that went idle onto the lattice
+			SF::RM::Mesh *_tool; // rigid body that activates regions (NULL: all regions follow the lattice)
+			boost::shared_ptr <TripleBuffer> _toolState; // handoff of the tool's pose and box from its thread (taken once a step)
+			mat4x4 _toolPose [3]; // slots indexed by _toolState
+			aabb _toolBox [3];
+
+			/**
+			 * Sleeping partitions of a single-level mesh (empty unless
+			 * sleep_threshold is set). Every vertex belongs to one partition
+			 * (octant); a partition whose vertices all moved less than the
+			 * threshold for SF_MSD_SLEEP_STEPS steps stops running its springs and
+			 * holds still until a moving neighbor, the tool or wake () wakes it.
+			 */
+			real _sleepThreshold; // largest displacement per step of a partition that counts as quiet (0 never sleeps)
+			vector <unsigned int> _vertexPartition; // partition of every vertex
+			vector <unsigned int> _partitionVertices [2]; // vertices of every partition (offsets, then vertices)
+			vector <unsigned int> _partitionSprings [2]; // springs with a vertex in every partition (offsets, then springs)
+			vector <unsigned int> _partitionNeighbors [2]; // partitions joined to every partition by a spring (offsets, then partitions)
+			vector <real> _partitionBounds; // box around the vertices of every partition in the last step (min, max)
+			vector <unsigned int> _partitionQuiet; // consecutive quiet steps of every partition
+			vector <char> _partitionAwake;
+
+			/**
+			 * Contact with the tool. Every step starts with a collision pass over
+			 * the octants: an octant whose surface vertices overlap the tool's
+			 * bounding box tests them against the tool's triangles, and vertices
+			 * found inside the tool are pushed out towards the nearest point of
+			 * its surface, in proportion to their depth.
+			 */
+			real _contactStiffness; // pull of the contact per unit of depth, relative to a spring (0 turns contact off)
+			vector <unsigned int> _octantSurface [2]; // surface vertices of every octant, each in one octant only (offsets, then vertices)
+			vector <real> _octantBounds; // box around the surface vertices of every octant, for the current step (min, max)
+			vector <vec> _toolTriangles; // corners of the tool's triangles in world space, for the current step
+			vector <real> _toolTriangleBounds; // box around every one of these triangles (min, max)
+			vector <vec> _toolModelNormals; // normals of the corners, edges and face of every tool triangle in model space
+			vector <vec> _toolNormals; // and in world space, for the current step
+			vector <vector <unsigned int> > _contactVertices; // vertices of every octant inside the tool in this step
+			vector <vector <vec> > _contactForces; // and the forces pushing them out
+			WorkerPool *_pool; // pool that runs the collision pass
 
 			// time-related parameters
 			ptime _past;
@@ -105,6 +171,9 @@ namespace SF {
       vector <GLuint> _glTexCoordBufferId; // texture coordinates into texture atlas
       vector <GLuint> _glTextureId; // texture atlas ID containing color
       vector <GLuint> _glRenderVertexArrayId; // vertex buffer used by rendering programs (2*number-of-submeshes)
+      vector <vector <GLuint> > _glLevelIndexBufferId; // indexed triangles of the coarser surfaces of each octant
+      vector <real> _glOctantBounds; // sphere bounding each octant at rest (center, radius), to pick its surface by size on screen
+      real _glLevelPixels; // pixels a triangle covers on average before a coarser surface is drawn (0 always draws the full surface)
 
       // program variable locations (Rendering program 1)
       GLint _glModelviewMatrixLocation;
@@ -161,6 +230,8 @@ namespace SF {
       ~Mesh ();
 
       void run (); // run method
+      void addTool (Resource *r); // registers the rigid body that activates regions of a two-level mesh
+      void wake (unsigned int partition); // wakes a sleeping partition (e.g. on contact)
       bool initGPUPrograms (); // initializes all GPU programs
 
     private:
@@ -170,9 +241,22 @@ namespace SF {
 
       void checkMySanity (); // method to check the consistency of all data
 
+      void readMeshFiles (const string &prefix, unsigned int numPartitions, WorkerPool &pool);
+      bool readMeshCache (const string &file, uint32_t stamp, unsigned int numPartitions);
+      bool writeMeshCache (const string &file, uint32_t stamp) const;
+      void initRegions (); // groups vertices, lattice nodes and springs of a two-level mesh by region
+      void stepLattice (real factor0, real factor1, unsigned int numIters); // advances a two-level mesh by one step
+      void initPartitions (); // assigns vertices and springs of a single-level mesh to partitions for sleeping
+      void stepPartitions (real factor0, real factor1, unsigned int numIters); // advances the awake partitions of a single-level mesh by one step
+      void initContacts (); // assigns surface vertices to octants for the collision pass
+      void initToolNormals (); // computes the pseudo-normals of the tool's triangles for the collision pass
+      void collide (); // collision pass: finds the vertices inside the tool and their contact forces
+      void addContactForces (); // adds the contact forces to the vertices that move in this step
+
       bool initGLBufferObjects (); // initializes non-texture related GL Buffer objects
-      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const Texture3D &texture);
-      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords);
+      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool);
+      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool);
 
     };
   }
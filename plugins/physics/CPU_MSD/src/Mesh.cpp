@@ -25,6 +25,9 @@
 #include <fstream>
 
 #include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
 #include <string>
 
 #include "Preprocess.h"
@@ -52,12 +55,20 @@ extern "C" {
 #endif
 
 #include "aabb.h"
+#include "BinaryCache.h"
+#include "MSDBundle.h"
 #include "GL/common.h"
 #include "GL/texture.h"
+#include "IO/TextReader.h"
 
-#include "ThreadControl.h"
+#include "StageControl.h"
+#include "TripleBuffer.h"
+#include "Placement.h"
 #include "Driver.h"
 #include "Display.h"
+#include "mat4x4.h"
+
+#include "Rigid/inc/Mesh.h"
 
 #include "Common.h"
 #include "Mesh.h"
@@ -66,27 +77,488 @@ namespace SF {
 
   namespace MSD {
 
+    // consecutive quiet steps after which a partition goes to sleep
+    static const unsigned int SF_MSD_SLEEP_STEPS = 30;
+
+    // steps over which the surface of a region that goes idle is blended onto the lattice
+    static const unsigned int SF_MSD_SETTLE_STEPS = 20;
+
+    // static method to read the vertices of a node file
+    static void
+    readNodeFile (const string &file, vector <vec> *vertices)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = 0;
+      if (!reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      real tmpr  [SF_VECTOR_SIZE] = {0.};
+#ifdef SF_VECTOR4_ENABLED
+      tmpr [3] = 1.;
+#endif
+      vertices->resize (static_cast <unsigned int> (tmpd), vec (tmpr));
+      for (unsigned int i = 0; i < vertices->size (); ++i){
+        if (!reader.read ((*vertices) [i]._v, 3)){
+          PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+      }
+    }
+
+    // static method to read the reciprocal vertex masses (run on the pool)
+    static void
+    readMassFile (const string &file, vector <real> *mass)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = 0;
+      if (!reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of vertex masses \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      mass->resize (static_cast <unsigned int> (tmpd));
+      if (!reader.read (&((*mass) [0]), mass->size ())){
+        PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+    }
+
+    // static method to read the vertex pairs of springs (run on the pool)
+    static void
+    readSpringFile (const string &file, vector <unsigned int> *springIndices)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = 0;
+      if (!reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of springs \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      springIndices->resize (2*static_cast <unsigned int> (tmpd));
+      if (!reader.read (&((*springIndices) [0]), springIndices->size ())){
+        PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+    }
+
+    // static method to read a file of triangles (run on the pool); maxIndex gets the largest vertex index
+    static void
+    readTriangleFile (const string &file, vector <unsigned int> *indices, unsigned int *maxIndex)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = -1;
+      if (!reader.read (tmpd) || tmpd < 0){
+        PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      indices->resize (3*static_cast <unsigned int> (tmpd));
+      *maxIndex = 0;
+      if (indices->empty ()){
+        return;
+      }
+      if (!reader.read (&((*indices) [0]), indices->size ())){
+        PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      *maxIndex = *max_element (indices->begin (), indices->end ());
+    }
+
+    // static method to check for the lattice files of a two-level mesh
+    static inline bool
+    hasLatticeFiles (const string &prefix)
+    {
+      struct stat info;
+      return !stat ((prefix + ".embed").c_str (), &info);
+    }
+
+    // static method to read the embedding of vertices in the lattice (run on the pool): per vertex its region, four nodes and their weights
+    static void
+    readEmbedFile (const string &file, vector <unsigned int> *regions, vector <unsigned int> *nodes, vector <real> *weights)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = 0;
+      if (!reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      regions->resize (static_cast <unsigned int> (tmpd));
+      nodes->resize (4*regions->size ());
+      weights->resize (4*regions->size ());
+      for (unsigned int i = 0; i < regions->size (); ++i){
+        if (!reader.read ((*regions) [i]) || !reader.read (&((*nodes) [4*i]), 4) || !reader.read (&((*weights) [4*i]), 4)){
+          PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+      }
+    }
+
+    // static method to check for files of coarser surfaces (meshes exported before edit-mesh made them have none)
+    static inline bool
+    hasLevelFiles (const string &prefix)
+    {
+      struct stat info;
+      return !stat ((prefix + ".0.lod").c_str (), &info);
+    }
+
+    // static method to read the coarser surfaces of an octant as they are stored (run on the pool)
+    static void
+    readLevelFile (const string &file, vector <unsigned int> *data)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = -1;
+      if (!reader.read (tmpd) || tmpd < 0){
+        PRINT ("fatal error: invalid number of levels \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      data->assign (1, static_cast <unsigned int> (tmpd));
+      for (unsigned int l = (*data) [0]; l > 0; --l){
+        if (!reader.read (tmpd) || tmpd < 0){
+          PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+        size_t offset = data->size () + 1;
+        data->resize (offset + 3*static_cast <size_t> (tmpd));
+        (*data) [offset - 1] = static_cast <unsigned int> (tmpd);
+        if (tmpd && !reader.read (&((*data) [offset]), 3*static_cast <size_t> (tmpd))){
+          PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+      }
+    }
+
+    /**
+     * Static method to split the stored coarser surfaces of an octant (number
+     * of levels, then the number of triangles and the triangles of every
+     * level) into levels. Returns false if they are malformed or use vertices
+     * that are not on the surface.
+     */
+    static bool
+    splitLevels (const unsigned int *data, size_t count, unsigned int numSurfaceVertices, vector <vector <unsigned int> > &levels)
+    {
+      levels.clear ();
+      if (!count){
+        return false;
+      }
+      size_t o = 1;
+      for (unsigned int l = 0; l < data [0]; ++l){
+        if (o >= count || count - o - 1 < 3*static_cast <size_t> (data [o])){
+          return false;
+        }
+        levels.push_back (vector <unsigned int> (data + o + 1, data + o + 1 + 3*static_cast <size_t> (data [o])));
+        o += 1 + 3*static_cast <size_t> (data [o]);
+        for (unsigned int j = 0; j < levels.back ().size (); ++j){
+          if (levels.back () [j] >= numSurfaceVertices){
+            return false;
+          }
+        }
+      }
+      return o == count;
+    }
+
+    // static function to check that every index of an array is below limit (a damaged cache must not reach past the vertices)
+    static inline bool
+    indicesBelow (const vector <unsigned int> &indices, size_t limit)
+    {
+      for (size_t i = 0; i < indices.size (); ++i){
+        if (indices [i] >= limit){
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /**
+     * Static function to pick the surface to draw for octant i: the finest one
+     * whose triangles cover at least _glLevelPixels pixels each on average,
+     * judged by the projected size of the sphere bounding the octant at rest.
+     * The full surface is kept while the camera is inside the sphere.
+     */
+    static void
+    pickLevel (const Mesh *mptr, unsigned int i, GLint viewHeight, GLuint &buffer, GLsizei &count)
+    {
+      const vector <vector <unsigned int> > &levels = mptr->_levelIndices [i];
+      if (mptr->_glLevelIndexBufferId [i].empty () || mptr->_glLevelPixels <= 0.){
+        return;
+      }
+
+      const real *s = &(mptr->_glOctantBounds [4*i]);
+      const real *m = mptr->_glModelview;
+      const real *p = mptr->_glProjection;
+      real z = m [2]*s [0] + m [6]*s [1] + m [10]*s [2] + m [14]; // eye-space depth of the center
+      real w = p [11]*z + p [15]; // clip-space w (distance in front of the camera, or 1 for orthographic views)
+      if (w <= s [3]*fabs (p [11])){
+        return;
+      }
+      real radius = s [3]*p [5]/ w * .5*viewHeight;
+      real pixels = M_PI*radius*radius;
+      for (unsigned int l = 0; l < levels.size () && pixels < mptr->_glLevelPixels*(count/ 3); ++l){
+        buffer = mptr->_glLevelIndexBufferId [i][l];
+        count = static_cast <GLsizei> (levels [l].size ());
+      }
+    }
+
+    // static method to get the outer face rings of partitions [first, last) (run on the pool)
+    static void
+    getFaceRingRange (const vector <vector <unsigned int> > *faceIndices, vector <vector <unsigned int> > *rings, unsigned int first, unsigned int last)
+    {
+      for (unsigned int i = first; i < last; ++i){
+        getFaceRings (i, *faceIndices, (*rings) [i]);
+      }
+    }
+
+    // static function to calculate the displacement of vertex i in the first two time-steps
+    static inline void displaceVertex_01 (const vector <vec> &src, vector <vec> &dest, const vector <vec> &force, const real factor0, const real factor1, unsigned int i)
+    {
+      vec velocity = force [i] * factor0;
+      for (unsigned int j = 0; j < 3; ++j){
+        dest [i]._v [j] = src [i]._v [j] + factor0*velocity._v [j] + 0.5*factor1*force [i]._v [j];
+      }
+    }
+
+    // static function to calculate the time-corrected Verlet integration based displacement of vertex i
+    static inline void displaceVertex_n (const vector <vec> &src, vector <vec> &dest, const vector <vec> &force, const real factor0, const real factor1, unsigned int i)
+    {
+      vec future;
+      for (unsigned int j = 0; j < 3; ++j){
+        future._v [j] = src [i]._v [j] + factor0 * (src [i]._v [j] - dest [i]._v [j]) + factor1 * force [i]._v [j];
+      }
+      dest [i] = future;
+    }
+
     // static CPU program to calculate displacement in the first two time-steps
     static void displace_01 (const vector <vec> &src, vector <vec> &dest, const vector <vec> &force, const real factor0, const real factor1)
     {
-      vec velocity;
       for (unsigned int i = 0; i < src.size (); ++i){
-        velocity = force [i] * factor0;
-        for (unsigned int j = 0; j < 3; ++j){
-          dest [i]._v [j] = src [i]._v [j] + factor0*velocity._v [j] + 0.5*factor1*force [i]._v [j];
-        }
+        displaceVertex_01 (src, dest, force, factor0, factor1, i);
       }
     }
 
     // static CPU program to calculate time-corrected Verlet integration based displacement
     static void displace_n (const vector <vec> &src, vector <vec> &dest, const vector <vec> &force, const real factor0, const real factor1)
     {
-      vec future;
       for (unsigned int i = 0; i < src.size (); ++i){
-        for (unsigned int j = 0; j < 3; ++j){
-          future._v [j] = src [i]._v [j] + factor0 * (src [i]._v [j] - dest [i]._v [j]) + factor1 * force [i]._v [j];
+        displaceVertex_n (src, dest, force, factor0, factor1, i);
+      }
+    }
+
+    // static function to get the pull of a spring from its current and rest ends (added to end 0, taken from end 1)
+    static inline vec springForce (const vec &curr0, const vec &curr1, const vec &rest0, const vec &rest1)
+    {
+      vec displacement = curr1 - curr0;
+      displacement -= rest1 - rest0;
+      return displacement;
+    }
+
+    // static function to get the dot product of the first three coordinates of two vectors
+    static inline real dot3 (const vec &a, const vec &b)
+    {
+      return a._v [0]*b._v [0] + a._v [1]*b._v [1] + a._v [2]*b._v [2];
+    }
+
+    // static function to get a direction (fourth coordinate 0) from its three coordinates
+    static inline vec direction (real x, real y, real z)
+    {
+      return vec (x, y, z
+#ifdef SF_VECTOR4_ENABLED
+                  , 0.
+#endif
+                  );
+    }
+
+    // static function to get the cross product of the first three coordinates of two vectors
+    static inline vec cross3 (const vec &a, const vec &b)
+    {
+      return direction (a._v [1]*b._v [2] - a._v [2]*b._v [1], a._v [2]*b._v [0] - a._v [0]*b._v [2], a._v [0]*b._v [1] - a._v [1]*b._v [0]);
+    }
+
+    // features of a triangle a closest point can lie on (also the order of the triangle's normals in _toolNormals)
+    enum TriangleFeature {
+      CORNER_A = 0,
+      CORNER_B,
+      CORNER_C,
+      EDGE_AB,
+      EDGE_BC,
+      EDGE_CA,
+      FACE,
+      NUM_TRIANGLE_FEATURES
+    };
+
+    /**
+     * Static function to get the point of triangle (a, b, c) closest to p, by
+     * the Voronoi region of the triangle that p is in (Ericson, Real-Time
+     * Collision Detection, 5.1.5). feature tells which corner, edge or the
+     * face interior the point lies on.
+     */
+    static vec closestOnTriangle (const vec &p, const vec &a, const vec &b, const vec &c, int &feature)
+    {
+      vec ab = b - a, ac = c - a, ap = p - a;
+      real d1 = dot3 (ab, ap), d2 = dot3 (ac, ap);
+      if (d1 <= 0. && d2 <= 0.){
+        feature = CORNER_A;
+        return a;
+      }
+      vec bp = p - b;
+      real d3 = dot3 (ab, bp), d4 = dot3 (ac, bp);
+      if (d3 >= 0. && d4 <= d3){
+        feature = CORNER_B;
+        return b;
+      }
+      real vc = d1*d4 - d3*d2;
+      if (vc <= 0. && d1 >= 0. && d3 <= 0.){
+        feature = EDGE_AB;
+        return a + ab*(d1/ (d1 - d3));
+      }
+      vec cp = p - c;
+      real d5 = dot3 (ab, cp), d6 = dot3 (ac, cp);
+      if (d6 >= 0. && d5 <= d6){
+        feature = CORNER_C;
+        return c;
+      }
+      real vb = d5*d2 - d1*d6;
+      if (vb <= 0. && d2 >= 0. && d6 <= 0.){
+        feature = EDGE_CA;
+        return a + ac*(d2/ (d2 - d6));
+      }
+      real va = d3*d6 - d5*d4;
+      if (va <= 0. && d4 >= d3 && d5 >= d6){
+        feature = EDGE_BC;
+        return b + (c - b)*((d4 - d3)/ ((d4 - d3) + (d5 - d6)));
+      }
+      feature = FACE;
+      real denom = 1./ (va + vb + vc);
+      return a + ab*(vb*denom) + ac*(vc*denom);
+    }
+
+    /**
+     * Static function to run the collision pass of octants [first, last) (run
+     * on the pool). An octant skips its vertices unless their box (see
+     * collide) overlaps the tool's box; a vertex inside the tool's box is inside the tool if it
+     * is behind the nearest point of the tool's surface, judged by the normal
+     * of the feature that point lies on: the face normal inside a triangle,
+     * the pseudo-normal of an edge or a corner otherwise (see
+     * initToolNormals). A vertex inside gets a contact force towards that
+     * point. A triangle is only tested if its box is nearer to the vertex
+     * than the nearest triangle found so far.
+     */
+    static void collideOctants (Mesh *mptr, const aabb *tool, unsigned int first, unsigned int last)
+    {
+      const vector <vec> &curr = *(mptr->_curr);
+      const vector <vec> &corners = mptr->_toolTriangles;
+      const vector <vec> &normals = mptr->_toolNormals;
+      const real *bounds = corners.empty () ? NULL : &(mptr->_toolTriangleBounds [0]);
+      for (unsigned int p = first; p < last; ++p){
+        vector <unsigned int> &contacts = mptr->_contactVertices [p];
+        vector <vec> &forces = mptr->_contactForces [p];
+        contacts.clear ();
+        forces.clear ();
+
+        unsigned int begin = mptr->_octantSurface [0][p], end = mptr->_octantSurface [0][p + 1];
+        if (begin == end){
+          continue;
+        }
+        const real *octant = &(mptr->_octantBounds [6*p]);
+        if (!tool->collide (aabb (vec3 (octant [0], octant [1], octant [2]), vec3 (octant [3], octant [4], octant [5])))){
+          continue;
         }
-        dest [i] = future;
+
+        for (unsigned int k = begin; k < end; ++k){
+          unsigned int v = mptr->_octantSurface [1][k];
+          if (!tool->collide (curr [v])){
+            continue;
+          }
+          real nearest = -1.;
+          unsigned int triangle = 0;
+          int feature = FACE, f;
+          vec closest;
+          for (unsigned int t = 0; t < corners.size (); t += 3){
+            const real *box = bounds + 2*t;
+            real boxDistance = 0.;
+            for (int j = 0; j < 3; ++j){
+              real gap = box [j] - curr [v]._v [j];
+              gap = gap > 0. ? gap : curr [v]._v [j] - box [3 + j];
+              boxDistance += gap > 0. ? gap*gap : 0.;
+            }
+            if (nearest >= 0. && boxDistance >= nearest){
+              continue;
+            }
+            vec q = closestOnTriangle (curr [v], corners [t], corners [t + 1], corners [t + 2], f);
+            real distance = (q - curr [v]).square_length ();
+            if (nearest < 0. || distance < nearest){
+              nearest = distance;
+              triangle = t/ 3;
+              feature = f;
+              closest = q;
+            }
+          }
+          if (nearest < 0.){
+            continue;
+          }
+
+          vec push = closest - curr [v];
+          if (dot3 (push, normals [NUM_TRIANGLE_FEATURES*triangle + feature]) > 0.){
+            contacts.push_back (v);
+            forces.push_back (push*mptr->_contactStiffness);
+          }
+        }
+      }
+    }
+
+    // static function to place a vertex on the lattice by its four nodes and weights (any fourth coordinate is kept)
+    static inline vec placeVertex (const vector <vec> &lattice, const unsigned int *nodes, const real *weights, const vec &vertex)
+    {
+      vec placed (vertex);
+      for (unsigned int j = 0; j < 3; ++j){
+        placed._v [j] = weights [0]*lattice [nodes [0]]._v [j] + weights [1]*lattice [nodes [1]]._v [j]
+                        + weights [2]*lattice [nodes [2]]._v [j] + weights [3]*lattice [nodes [3]]._v [j];
+      }
+      return placed;
+    }
+
+    // static function to group (region, item) pairs by region: groups [0] gets the offsets of every region in groups [1]
+    static void groupByRegion (vector <pair <unsigned int, unsigned int> > &pairs, unsigned int numRegions, vector <unsigned int> *groups)
+    {
+      sort (pairs.begin (), pairs.end ());
+      pairs.erase (unique (pairs.begin (), pairs.end ()), pairs.end ());
+
+      groups [0].assign (numRegions + 1, 0);
+      groups [1].resize (pairs.size ());
+      for (size_t i = 0; i < pairs.size (); ++i){
+        ++groups [0][pairs [i].first + 1];
+        groups [1][i] = pairs [i].second;
+      }
+      for (unsigned int r = 0; r < numRegions; ++r){
+        groups [0][r + 1] += groups [0][r];
       }
     }
 
@@ -97,6 +569,31 @@ namespace SF {
 	    mptr->_glReprogramFlag = true;
 	  }
 
+	  // static function to move the arrays of the physics loop to memory local to the calling thread
+	  static void relocateArrays (Resource & r)
+	  {
+	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
+	    for (int i = 0; i < 2; ++i){
+	      firstTouch (mptr->_vertices [i]);
+	    }
+	    firstTouch (mptr->_springIndices);
+	    firstTouch (mptr->_restVertices);
+	    firstTouch (mptr->_force);
+	    firstTouch (mptr->_mass);
+	    for (int i = 0; i < 2; ++i){
+	      firstTouch (mptr->_latticeVertices [i]);
+	    }
+	    firstTouch (mptr->_latticeRestVertices);
+	    firstTouch (mptr->_latticeForce);
+	    firstTouch (mptr->_latticeMass);
+	    firstTouch (mptr->_latticeSpringIndices);
+	    firstTouch (mptr->_embedNodes);
+	    firstTouch (mptr->_embedWeights);
+	    firstTouch (mptr->_vertexPartition);
+	    firstTouch (mptr->_partitionVertices [1]);
+	    firstTouch (mptr->_partitionSprings [1]);
+	  }
+
     // inline function to draw normals
     static void drawNormals (Mesh *mptr)
     {
@@ -105,7 +602,20 @@ namespace SF {
 #endif
 
       // update data
-      if (!mptr->_glBufferFlag){
+      if (mptr->_state){
+        // lock-free mode: graphics stays on buffer 0 and only refreshes it (and the normals) on a newer state
+        if (!mptr->_state->acquire ()){
+          return;
+        }
+        glBindBuffer (GL_ARRAY_BUFFER, mptr->_glVertexBufferId [0]);
+#ifndef NDEBUG
+        checkGLError (error);
+#endif
+        glBufferSubData (GL_ARRAY_BUFFER, 0, sizeof (real)*SF_VECTOR_SIZE*mptr->_numSurfaceVertices, &(mptr->_snapshot [mptr->_state->readIndex ()][0]));
+#ifndef NDEBUG
+        checkGLError (error);
+#endif
+      } else if (!mptr->_glBufferFlag){
         glBindBuffer (GL_ARRAY_BUFFER, mptr->_glVertexBufferId [0]);
 #ifndef NDEBUG
         checkGLError (error);
@@ -201,7 +711,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 
 	    // reload program if needed
 	    if (mptr->_glReprogramFlag) {
@@ -307,16 +817,21 @@ namespace SF {
       if (mptr->_glBufferFlag){
         offset = mptr->_glIndexBufferId.size ();
       }
+      GLint viewport [4];
+      glGetIntegerv (GL_VIEWPORT, viewport);
       for (unsigned int i = 0; i < mptr->_glIndexBufferId.size (); ++i){
         glBindVertexArray (mptr->_glRenderVertexArrayId [i + offset]);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
-        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mptr->_glIndexBufferId [i]);
+        GLuint indexBuffer = mptr->_glIndexBufferId [i];
+        GLsizei numIndices = mptr->_numFaces [i];
+        pickLevel (mptr, i, viewport [3], indexBuffer, numIndices);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
-        glDrawElements (GL_TRIANGLES, mptr->_numFaces [i], GL_UNSIGNED_INT, 0);
+        glDrawElements (GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
@@ -329,7 +844,7 @@ namespace SF {
       glBindTexture (GL_TEXTURE_CUBE_MAP, 0);
       glUseProgram (0);
 
-      mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+      mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
     // drawing function textured datasets
@@ -337,7 +852,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 
 	    // reload program if needed
 	    if (mptr->_glReprogramFlag) {
@@ -437,6 +952,8 @@ namespace SF {
       if (mptr->_glBufferFlag){
         offset = mptr->_glIndexBufferId.size ();
       }
+      GLint viewport [4];
+      glGetIntegerv (GL_VIEWPORT, viewport);
 
       for (unsigned int i = 0; i < mptr->_glIndexBufferId.size (); ++i){
         glActiveTexture (GL_TEXTURE2);
@@ -453,11 +970,14 @@ namespace SF {
 #ifndef NDEBUG
       checkGLError (error);
 #endif
-        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mptr->_glIndexBufferId [i]);
+        GLuint indexBuffer = mptr->_glIndexBufferId [i];
+        GLsizei numIndices = mptr->_numFaces [i];
+        pickLevel (mptr, i, viewport [3], indexBuffer, numIndices);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
-        glDrawElements (GL_TRIANGLES, mptr->_numFaces [i], GL_UNSIGNED_INT, 0);
+        glDrawElements (GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
@@ -473,7 +993,7 @@ namespace SF {
 
       glUseProgram (0);
 
-	    mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+	    mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
 		// protected constructor and assignment functions
@@ -483,10 +1003,8 @@ namespace SF {
 
 		// only legitimate constructor
 		Mesh::Mesh (const string &config, Driver &driver)
-		: _semPhysicsWaitIndex (-1), _semPhysicsPostIndex (-1),
-		  _semGraphicsWaitIndex (-1), _semGraphicsPostIndex (-1),
-		  _numSurfaceVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])),
-		  _numSprings (0), _past (boost::posix_time::microsec_clock::universal_time ()), _present (boost::posix_time::microsec_clock::universal_time ()),
+		: _numSurfaceVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])),
+		  _numSprings (0), _tool (NULL), _sleepThreshold (0.), _contactStiffness (10.), _pool (&(driver._pool)), _past (boost::posix_time::microsec_clock::universal_time ()), _present (boost::posix_time::microsec_clock::universal_time ()),
 		  _glBufferFlag (false), _glTextureFlag (false), _glReprogramFlag (false),
 		  _glNormalFramebufferId (0), _glNormalTexCoordBufferId (0), _glNormalTextureId (0), _glNumFaces (0), _glNormalIndexBufferId (0),
 			_glEnvTextureId (driver._display.get ()->_glEnvTextureId),
@@ -504,6 +1022,33 @@ namespace SF {
 
 			_owner = boost::shared_ptr <string> (new string ("CudaMsd"));
 
+			// the 3D texture (if any) is read on the pool while the mesh is loaded
+			Texture3D tex3d;
+			TaskGroup textureLoad;
+			string texStr;
+			getConfigParameter (config, "texture", texStr);
+			if (!texStr.empty () && !driver._display.get ()->_headless){
+				string texInfoFile;
+				getConfigParameter (config, "textureinfo", texInfoFile);
+				assert (!texInfoFile.empty ());
+				// with texture_cache (megabytes of decoded bricks) the texture is read brick by brick as rays need it
+				size_t cacheBytes = 0;
+				string cacheStr;
+				if (getConfigParameter (config, "texture_cache", cacheStr)){
+				  for (unsigned int i = 0; i < cacheStr.length (); ++i){
+				    if (!isdigit (cacheStr [i])){
+				      PRINT ("fatal error: texture cache %s in %s not a number\n", cacheStr.c_str (), config.c_str ());
+				      exit (EXIT_FAILURE);
+				    }
+				  }
+				  cacheBytes = static_cast <size_t> (atoi (cacheStr.c_str ())) << 20;
+				}
+				driver._pool.submit (boost::bind (&readTexture3D, texInfoFile, texStr, boost::ref (tex3d), cacheBytes), &textureLoad);
+			}
+
+			// store of data derived from the mesh at startup (closed if mesh_cache is "off")
+			ArtifactCache artifacts;
+
 			{
 				string name;
 				if (!getConfigParameter (config, "name", name)){
@@ -549,263 +1094,134 @@ namespace SF {
 				string prefix (folder);
 				prefix.append (name);
 
-				/*************************** READ NODE (VERTEX) FILE ***************************/
-				int tmpd  [3]; // size 3 because this is used to read triangular elements later
-
-				string file (prefix);
-				file.append (".node");
-
-				FILE* fp = fopen (file.c_str (), "r");
-				assert (fp);
-
-				int status = fscanf (fp, "%d\n", &(tmpd [0]));
-				assert (status != 0);
-				if (tmpd [0] <= 0){
-          PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
-          exit (EXIT_FAILURE);
-				}
-
-				unsigned int nverts = static_cast <unsigned int> (tmpd [0]);
-
-				_vertices [0].reserve (nverts);
-				_vertices [1].reserve (nverts);
+				/*************************** READ MESH DATA ***************************/
 				{
-					real tmpr  [SF_VECTOR_SIZE];
-#ifdef SF_VECTOR4_ENABLED
-					tmpr [3] = 1.;
-#endif
-#ifdef SF_DOUBLE_PRECISION
-					status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-					status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-					assert (status != 0);
-					_vertices [0].push_back (vec (tmpr));
+				  // binary cache (and artifact store) are on unless mesh_cache is "off"
+				  string cacheStr;
+				  getConfigParameter (config, "mesh_cache", cacheStr);
+				  if (cacheStr.compare ("off")){
+				    artifacts.open (folder + "artifacts");
+				  }
 
-					vec3 min (vec3 (tmpr [0], tmpr [1], tmpr [2]));
-					vec3 max (min);
+				  // a bundle written by edit-mesh holds the mesh in the layout of the binary cache and stands in for the text files
+				  string bundleFile (prefix);
+				  bundleFile.append (".msd.bin");
+				  struct stat bundleInfo;
+				  bool bundled = !stat (bundleFile.c_str (), &bundleInfo);
+				  if (bundled && !readMeshCache (bundleFile, SF_MSD_BUNDLE_STAMP, numPartitions)){
+				    PRINT ("warning: %s does not match depth %u or the precision of this build, reading text files\n", bundleFile.c_str (), depth);
+				    bundled = false;
+				  }
 
-					for (unsigned int i = 1; i < nverts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-						status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-						status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-						assert (status != 0);
-						_vertices [0].push_back (vec (tmpr));
-						for (int j = 0; j < 3; ++j){
-							if (min._v [j] > tmpr [j]){
-								min._v [j] = tmpr [j];
-							}
-							else if (max._v [j] < tmpr [j]){
-								max._v [j] = tmpr [j];
-							}
-						}
-					}
-					for (int j = 0; j < 3; ++j){
-            min._v [j] -= .05;
-					}
-					for (int j = 0; j < 3; ++j){
-            max._v [j] += .05;
-					}
-					_bbox = aabb (min, max);
+				  if (!bundled){
+				    // text sources, stamped in this order for the binary cache
+				    vector <string> files;
+				    files.push_back (prefix + ".node");
+				    files.push_back (prefix + ".lm");
+				    files.push_back (prefix + ".edge");
+				    for (unsigned int i = 0; i < numPartitions; ++i){
+				      char indexStr [16];
+				      sprintf (indexStr, ".%u.tri", i);
+				      files.push_back (prefix + indexStr);
+				    }
+				    if (hasLevelFiles (prefix)){
+				      for (unsigned int i = 0; i < numPartitions; ++i){
+				        char indexStr [16];
+				        sprintf (indexStr, ".%u.lod", i);
+				        files.push_back (prefix + indexStr);
+				      }
+				    }
+				    if (hasLatticeFiles (prefix)){
+				      files.push_back (prefix + ".lattice.node");
+				      files.push_back (prefix + ".lattice.lm");
+				      files.push_back (prefix + ".lattice.edge");
+				      files.push_back (prefix + ".embed");
+				    }
+				    uint32_t stamp = 0;
+				    bool useCache = cacheStr.compare ("off") && sourceStamp (files, stamp);
+
+				    string cacheFile (prefix);
+				    cacheFile.append (".msd.cache");
+				    if (!useCache || !readMeshCache (cacheFile, stamp, numPartitions)){
+				      readMeshFiles (prefix, numPartitions, driver._pool);
+				      if (useCache && writeMeshCache (cacheFile, stamp)){
+				        PRINT ("wrote mesh cache %s\n", cacheFile.c_str ());
+				      }
+				    }
+				  }
 				}
-				fclose (fp);
 
 				_vertices [1] = _vertices [0];
 				_restVertices = _vertices [0];
 
         _force.resize (_vertices [0].size ());
 
-				/*************************** READ VERTEX MASS RECIPROCAL FILE ***************************/
-				file = prefix;
-				file.append (".lm");
-
-				fp = fopen (file.c_str (), "r");
-				assert (fp);
-
-				status = fscanf (fp, "%d\n", &(tmpd [0]));
-				assert (status != 0);
-				if (tmpd [0] <= 0){
-          PRINT ("fatal error: invalid number of vertex masses \'%d\' in %s\n", tmpd [0], file.c_str ());
-          exit (EXIT_FAILURE);
-				}
-				{
-				  unsigned int nmass = static_cast <unsigned int> (tmpd [0]);
-				  _mass.resize (nmass);
-
-				  for (unsigned int i = 0; i < nmass; ++i){
-#ifdef SF_DOUBLE_PRECISION
-            status = fscanf (fp, "%lf\n", &(_mass [i]));
-#else
-            status = fscanf (fp, "%f\n", &(_mass [i]));
-#endif
-            assert (status != 0);
-				  }
-				}
-
-
-				fclose (fp);
-
-				/*************************** READ EDGE ELEMENT FILES ***************************/
-				{
-					file = prefix;
-					file.append (".edge");
-
-					fp = fopen (file.c_str (), "r");
-					assert (fp);
-
-					int status = fscanf (fp, "%d\n", &(tmpd [0]));
-					assert (status != 0);
-					if (tmpd [0] <= 0){
-		        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
-		        exit (EXIT_FAILURE);
-					}
-
-#ifndef NDEBUG
-            int vertSize = static_cast <int> (_vertices [0].size ());
-#endif
-
-					_numSprings = static_cast <unsigned int> (tmpd [0]);
-					_springIndices.resize (_numSprings * 2);
-
-					for (unsigned int i = 0; i < _numSprings; ++i){
-						status = fscanf (fp, "%d %d\n", &(tmpd [0]), &(tmpd [1]));
-						assert (status != 0);
-						assert (tmpd [0] >= 0 && tmpd [0] < vertSize);
-						assert (tmpd [1] >= 0 && tmpd [1] < vertSize);
-						_springIndices [2*i] = tmpd [0];
-						_springIndices [2*i + 1] = tmpd [1];
-					}
-
-					fclose (fp);
-				}
-
-				/*************************** READ TRIANGULAR ELEMENT FILES ***************************/
-				_numFaces.resize (numPartitions, 0);
-				_faceIndices.resize (numPartitions, vector <unsigned int> ());
-
-				for (unsigned int i = 0; i < numPartitions; ++i){
-
-					// generate file name
-					file = prefix;
-					file.append (".");
-
-					char indexStr [4];
-					sprintf (indexStr, "%u", i);
-					file.append (indexStr);
-					file.append (".tri");
-
-					fp = fopen (file.c_str (), "r");
-					assert (fp);
-
-					status = fscanf (fp, "%d\n", &(tmpd [0]));
-					assert (status != 0);
-          if (tmpd [0] < 0){
-            PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd [0], file.c_str ());
-            exit (EXIT_FAILURE);
-          }
-
-					_numFaces [i] = static_cast <unsigned int> (tmpd [0]);
-
-					if (_numFaces [i]){
-						_faceIndices [i].reserve (3*_numFaces [i]);
-#ifndef NDEBUG
-            int vertSize = static_cast <int> (_vertices [0].size ());
-#endif
-
-						for (unsigned int j = 0; j < _numFaces [i]; ++j){
-							status = fscanf (fp, "%d %d %d\n", &(tmpd [0]), &(tmpd [1]), &(tmpd [2]));
-							assert (status != 0);
-							assert (tmpd [0] >= 0 && tmpd [0] < vertSize);
-							assert (tmpd [1] >= 0 && tmpd [1] < vertSize);
-							assert (tmpd [2] >= 0 && tmpd [2] < vertSize);
-							for (int k = 0; k < 3; ++k){
-								_faceIndices [i].push_back (static_cast <unsigned int> (tmpd [k]));
-								if (_numSurfaceVertices < static_cast <unsigned int> (tmpd [k])){
-									_numSurfaceVertices = static_cast <unsigned int> (tmpd [k]);
-								}
-							}
-						}
-						_numFaces [i] *= 3;
-					}
-					fclose (fp);
-				} // end - for (unsigned int i = 0; i < numSubmeshes; ++i)
-
-				++_numSurfaceVertices; // this is done because before this _numSurfaceVertices contains biggest index of triangles
-			}
-
-      /*************************** INITIALIZE THREAD CONTROL PARAMETERS ***************************/
-      {
-        string mStr;
-        getConfigParameter (config, "num_mutexes", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (!_latticeVertices [0].empty ()){
+          initRegions ();
+          _latticeVertices [1] = _latticeVertices [0];
+          _latticeRestVertices = _latticeVertices [0];
+          _latticeForce.resize (_latticeVertices [0].size ());
+          PRINT ("%s: two-level mesh of %lu lattice nodes in %lu regions\n", name.c_str (), _latticeVertices [0].size (), _regionActive.size ());
         }
 
-        int numMutex = atoi (mStr.c_str ());
-        string msp ("mutex_startval"), msv;
-        for (int i = 0; i < numMutex; ++i){
-          mStr = msp;
-          char indexStr [4];
-          sprintf (indexStr, "%d", i + 1);
-          mStr.append (indexStr);
-
-          getConfigParameter (config, mStr.c_str (), msv);
-          assert (!msv.empty ());
-          for (unsigned int j = 0; j < msv.size (); ++j){
-            assert (isdigit (msv [j]));
+        // partitions of a single-level mesh whose vertices move less than sleep_threshold per step go to sleep (0 turns this off)
+        {
+          string sleepStr;
+          if (getConfigParameter (config, "sleep_threshold", sleepStr)){
+            _sleepThreshold = static_cast <real> (atof (sleepStr.c_str ()));
           }
-          _syncControl.push_back (static_cast <unsigned int> (atoi (msv.c_str ())));
-        }
-
-        getConfigParameter (config, "physics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "physics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
         }
-        _semPhysicsPostIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (_sleepThreshold > 0.){
+          if (_latticeVertices [0].empty ()){
+            initPartitions ();
+            PRINT ("%s: %lu partitions sleep below %g per step\n", name.c_str (), _partitionAwake.size (), _sleepThreshold);
+          } else {
+            PRINT ("warning: %s is a two-level mesh; its idle regions follow the lattice instead of sleeping\n", name.c_str ());
+          }
         }
-        _semCollisionWaitIndex = atoi (mStr.c_str ());
 
-        getConfigParameter (config, "collision_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        // surface vertices inside the tool are pushed out by contact_stiffness times their depth (0 turns contact off)
+        {
+          string stiffnessStr;
+          if (getConfigParameter (config, "contact_stiffness", stiffnessStr)){
+            _contactStiffness = static_cast <real> (atof (stiffnessStr.c_str ()));
+          }
         }
-        _semCollisionPostIndex = atoi (mStr.c_str ());
-
+        initContacts ();
+			}
 
-        getConfigParameter (config, "graphics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+      /*************************** INITIALIZE THREAD CONTROL PARAMETERS ***************************/
+      {
+        unsigned int stages = 1u << PHYSICS_STAGE;
+
+        /**
+         * With graphics_sync="lockfree" the renderer never blocks on physics: it draws
+         * the latest published snapshot instead, so graphics is left out of the stages.
+         */
+        string syncStr;
+        getConfigParameter (config, "graphics_sync", syncStr);
+        if (!syncStr.compare ("lockfree")){
+          _state = boost::shared_ptr <TripleBuffer> (new TripleBuffer ());
+          for (int i = 0; i < 3; ++i){
+            _snapshot [i].assign (_vertices [0].begin (), _vertices [0].begin () + _numSurfaceVertices);
+          }
+          _state->publish ();
+        } else {
+          stages |= 1u << GRAPHICS_STAGE;
         }
-        _semGraphicsWaitIndex = atoi (mStr.c_str ());
 
-        getConfigParameter (config, "graphics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (!_syncControl.configure (config, &getConfigParameter, driver._stageGraph, stages)){
+          PRINT ("fatal error: could not set up stages for %s\n", config.c_str ());
+          exit (EXIT_FAILURE);
         }
-        _semGraphicsPostIndex = atoi (mStr.c_str ());
+        assert (_syncControl.has (PHYSICS_STAGE));
       }
 
       /*************************** INITIALIZE OPENGL PARAMETERS ***************************/
 
+      // without a GL context (headless run) only the physics state is set up
+      bool headless = driver._display.get ()->_headless;
+
       // initialize octant specific GL buffer ID's
       GLuint tmpu = 0;
       _glIndexBufferId.resize (_faceIndices.size (), tmpu);
@@ -820,52 +1236,26 @@ namespace SF {
       getConfigParameter (config, "color_shader", _glProgramName [1]);
       assert (!_glProgramName [1].empty ());
 
+      // octants with coarser surfaces draw them once their triangles would cover fewer than lod_pixels pixels (0 turns this off)
+      _glLevelPixels = 4.;
+      {
+        string pixelStr;
+        if (getConfigParameter (config, "lod_pixels", pixelStr)){
+          _glLevelPixels = static_cast <real> (atof (pixelStr.c_str ()));
+        }
+      }
+
       for (int i = 0; i < 2; ++i){
         _glProgram [i] = 0;
       }
 
-      string texStr;
-      getConfigParameter (config, "texture", texStr);
+      driver._pool.wait (textureLoad);
 
-      if (!texStr.empty ()) {
+      if (!texStr.empty () && !headless) {
 
         // initialize texture-related variables
         _glTextureFlag = true;
 
-        Texture3D tex3d;
-        int status = 0;
-
-        // load and read 3D texture file
-        {
-          string texInfoFile;
-          getConfigParameter (config, "textureinfo", texInfoFile);
-          assert (!texInfoFile.empty ());
-
-          FILE *txfp = fopen (texInfoFile.c_str (), "r");
-          assert (txfp);
-          status = fscanf (txfp, "%u %u %u", &(tex3d._dimension [0]), &(tex3d._dimension [1]), &(tex3d._dimension [2]));
-          assert (status != 0);
-          assert (tex3d._dimension [0] > 0 && tex3d._dimension [1] > 0 && tex3d._dimension [2] > 0);
-
-#ifdef SF_DOUBLE_PRECISION
-          status = fscanf (txfp, "%lf %lf %lf\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#else
-          status = fscanf (txfp, "%f %f %f\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#endif
-          assert (status != 0);
-          assert (tex3d._aspectRatio [0] > 0. && tex3d._aspectRatio [1] > 0. && tex3d._aspectRatio [2] > 0.);
-          fclose (txfp);
-
-          unsigned int size = 4*tex3d._dimension [0]*tex3d._dimension [1]*tex3d._dimension [2];
-          tex3d._rgba.resize (size);
-
-          txfp = fopen (texStr.c_str (), "rb");
-          assert (txfp);
-          status = fread (&(tex3d._rgba [0]), sizeof (unsigned char), size, txfp);
-          assert (status != 0);
-          texStr.clear ();
-        }
-
         // initialize non-texture related buffers
         initGLBufferObjects ();
 
@@ -886,7 +1276,7 @@ namespace SF {
           }
           scale = static_cast <unsigned int> (atoi (scaleStr.c_str ()));
         }
-        initGLTextureObjects (scale, atlasShader, tex3d);
+        initGLTextureObjects (scale, atlasShader, artifacts, tex3d, driver._pool);
       }
       else {
         string cStr;
@@ -923,13 +1313,15 @@ namespace SF {
           }
         }
 
-        initGLBufferObjects ();
+        if (!headless){
+          initGLBufferObjects ();
+        }
       }
 
       // initialize GPU programs and update view volume
-      initGPUPrograms ();
-
-      _numSprings *= 2;
+      if (!headless){
+        initGPUPrograms ();
+      }
 
       GL_Window *disp = driver._display.get ();
       if (_glNumLights){
@@ -964,11 +1356,233 @@ namespace SF {
         draw = &plainDraw;
       }
       reprogram = &reloadPrograms;
+      relocate = &relocateArrays;
+      _stages = &_syncControl;
 
       // last line of this function (checks consistency of all data)
       checkMySanity ();
     }
 
+		// private method to read the mesh from its text files (all but the node file are read on the pool)
+		void
+		Mesh::readMeshFiles (const string &prefix, unsigned int numPartitions, WorkerPool &pool)
+		{
+			/*************************** READ MASS, EDGE AND TRIANGULAR ELEMENT FILES (ON THE POOL) ***************************/
+			// these files are independent, so workers read them while this thread reads the vertices
+			_numFaces.resize (numPartitions, 0);
+			_faceIndices.resize (numPartitions, vector <unsigned int> ());
+			vector <unsigned int> maxIndices (numPartitions, 0);
+
+			TaskGroup fileLoad;
+			pool.submit (boost::bind (&readMassFile, prefix + ".lm", &_mass), &fileLoad);
+			pool.submit (boost::bind (&readSpringFile, prefix + ".edge", &_springIndices), &fileLoad);
+			for (unsigned int i = 0; i < numPartitions; ++i){
+				char fileStr [32];
+				sprintf (fileStr, ".%u.tri", i);
+				pool.submit (boost::bind (&readTriangleFile, prefix + fileStr, &(_faceIndices [i]), &(maxIndices [i])), &fileLoad);
+			}
+			if (hasLatticeFiles (prefix)){
+				pool.submit (boost::bind (&readNodeFile, prefix + ".lattice.node", &(_latticeVertices [0])), &fileLoad);
+				pool.submit (boost::bind (&readMassFile, prefix + ".lattice.lm", &_latticeMass), &fileLoad);
+				pool.submit (boost::bind (&readSpringFile, prefix + ".lattice.edge", &_latticeSpringIndices), &fileLoad);
+				pool.submit (boost::bind (&readEmbedFile, prefix + ".embed", &_embedRegions, &_embedNodes, &_embedWeights), &fileLoad);
+			}
+			vector <vector <unsigned int> > levelData (hasLevelFiles (prefix) ? numPartitions : 0);
+			for (unsigned int i = 0; i < levelData.size (); ++i){
+				char fileStr [32];
+				sprintf (fileStr, ".%u.lod", i);
+				pool.submit (boost::bind (&readLevelFile, prefix + fileStr, &(levelData [i])), &fileLoad);
+			}
+
+			/*************************** READ NODE (VERTEX) FILE ***************************/
+			readNodeFile (prefix + ".node", &(_vertices [0]));
+			unsigned int nverts = static_cast <unsigned int> (_vertices [0].size ());
+
+			_vertices [1].reserve (nverts);
+			{
+				vec3 min (_vertices [0][0]._v [0], _vertices [0][0]._v [1], _vertices [0][0]._v [2]);
+				vec3 max (min);
+
+				for (unsigned int i = 1; i < nverts; ++i){
+					const real *v = _vertices [0][i]._v;
+					for (int j = 0; j < 3; ++j){
+						if (min._v [j] > v [j]){
+							min._v [j] = v [j];
+						}
+						else if (max._v [j] < v [j]){
+							max._v [j] = v [j];
+						}
+					}
+				}
+				for (int j = 0; j < 3; ++j){
+          min._v [j] -= .05;
+				}
+				for (int j = 0; j < 3; ++j){
+          max._v [j] += .05;
+				}
+				_bbox = aabb (min, max);
+			}
+
+			/*************************** COLLECT MASS, EDGE AND TRIANGULAR ELEMENT FILES ***************************/
+			pool.wait (fileLoad);
+
+			_numSprings = static_cast <unsigned int> (_springIndices.size ()/ 2);
+			for (unsigned int i = 0; i < _springIndices.size (); ++i){
+				if (_springIndices [i] >= nverts){
+          PRINT ("fatal error: spring %u of %s has an invalid vertex %u\n", i/ 2, prefix.c_str (), _springIndices [i]);
+          exit (EXIT_FAILURE);
+				}
+			}
+
+			for (unsigned int i = 0; i < numPartitions; ++i){
+				if (!_faceIndices [i].empty () && maxIndices [i] >= nverts){
+          PRINT ("fatal error: vertex index %u of partition %u out of range\n", maxIndices [i], i);
+          exit (EXIT_FAILURE);
+				}
+				_numFaces [i] = static_cast <unsigned int> (_faceIndices [i].size ());
+				if (_numSurfaceVertices < maxIndices [i]){
+					_numSurfaceVertices = maxIndices [i];
+				}
+			}
+			++_numSurfaceVertices; // this is done because before this _numSurfaceVertices contains biggest index of triangles
+
+			_levelIndices.resize (levelData.size ());
+			for (unsigned int i = 0; i < levelData.size (); ++i){
+				if (!splitLevels (&(levelData [i][0]), levelData [i].size (), _numSurfaceVertices, _levelIndices [i])){
+          PRINT ("fatal error: coarser surfaces of partition %u of %s are malformed\n", i, prefix.c_str ());
+          exit (EXIT_FAILURE);
+				}
+			}
+		}
+
+		/**
+		 * Private method to read the mesh from its binary cache (or bundle). The
+		 * arrays are copied straight out of the mapped file. Returns false,
+		 * leaving the mesh untouched, if the cache is missing, stale, of another
+		 * precision or of another number of partitions.
+		 */
+		bool
+		Mesh::readMeshCache (const string &file, uint32_t stamp, unsigned int numPartitions)
+		{
+		  BinaryCacheReader cache;
+		  if (!cache.open (file, SF_MSD_MESH_KIND, stamp)){
+		    return false;
+		  }
+
+		  vector <vec> vertices;
+		  vector <real> mass;
+		  vector <unsigned int> springIndices, surface;
+		  vector <vec> bounds;
+		  if (!cache.get (SF_MSD_NODES, vertices) || !cache.get (SF_MSD_MASSES, mass) || !cache.get (SF_MSD_SPRINGS, springIndices)
+		      || !cache.get (SF_MSD_BOUNDS, bounds) || !cache.get (SF_MSD_SURFACE, surface) || bounds.size () != 2 || surface.size () != 1){
+		    return false;
+		  }
+
+		  // the arrays are only checksummed in debug builds, so indices are checked here; a damaged cache is read from text again
+		  if (mass.size () != vertices.size () || surface [0] > vertices.size () || springIndices.size () % 2
+		      || !indicesBelow (springIndices, vertices.size ())){
+		    PRINT ("warning: damaged cache file %s ignored\n", file.c_str ());
+		    return false;
+		  }
+
+		  vector <vector <unsigned int> > faceIndices (numPartitions, vector <unsigned int> ());
+		  for (unsigned int i = 0; i < numPartitions; ++i){
+		    if (!cache.get (SF_MSD_FACES + i, faceIndices [i])){
+		      return false;
+		    }
+		    if (faceIndices [i].size () % 3 || !indicesBelow (faceIndices [i], surface [0])){
+		      PRINT ("warning: damaged cache file %s ignored\n", file.c_str ());
+		      return false;
+		    }
+		  }
+		  const unsigned int *extra = NULL;
+		  size_t numExtra = 0;
+		  if (cache.get (SF_MSD_FACES + numPartitions, extra, numExtra)){
+		    return false;
+		  }
+
+		  // coarser surfaces are optional, but then every partition has them
+		  vector <vector <vector <unsigned int> > > levelIndices;
+		  const unsigned int *levelData = NULL;
+		  size_t levelCount = 0;
+		  if (cache.get (SF_MSD_LEVELS, levelData, levelCount)){
+		    levelIndices.resize (numPartitions);
+		    for (unsigned int i = 0; i < numPartitions; ++i){
+		      if (!cache.get (SF_MSD_LEVELS + i, levelData, levelCount) || !splitLevels (levelData, levelCount, surface [0], levelIndices [i])){
+		        return false;
+		      }
+		    }
+		  }
+		  if (cache.get (SF_MSD_LEVELS + numPartitions, extra, numExtra)){
+		    return false;
+		  }
+
+		  // the lattice of a two-level mesh is optional too (its indices are checked by initRegions)
+		  vector <vec> latticeVertices;
+		  vector <real> latticeMass, embedWeights;
+		  vector <unsigned int> latticeSpringIndices, embedRegions, embedNodes;
+		  if (cache.get (SF_MSD_LATTICE_NODES, latticeVertices)){
+		    if (!cache.get (SF_MSD_LATTICE_MASSES, latticeMass) || !cache.get (SF_MSD_LATTICE_SPRINGS, latticeSpringIndices)
+		        || !cache.get (SF_MSD_EMBED_REGIONS, embedRegions) || !cache.get (SF_MSD_EMBED_NODES, embedNodes)
+		        || !cache.get (SF_MSD_EMBED_WEIGHTS, embedWeights)){
+		      return false;
+		    }
+		  }
+
+		  _vertices [0].swap (vertices);
+		  _mass.swap (mass);
+		  _springIndices.swap (springIndices);
+		  _numSprings = static_cast <unsigned int> (_springIndices.size ()/ 2);
+		  _bbox = aabb (bounds [0], bounds [1]);
+		  _numSurfaceVertices = surface [0];
+
+		  _faceIndices.swap (faceIndices);
+		  _levelIndices.swap (levelIndices);
+		  _latticeVertices [0].swap (latticeVertices);
+		  _latticeMass.swap (latticeMass);
+		  _latticeSpringIndices.swap (latticeSpringIndices);
+		  _embedRegions.swap (embedRegions);
+		  _embedNodes.swap (embedNodes);
+		  _embedWeights.swap (embedWeights);
+		  _numFaces.resize (numPartitions, 0);
+		  for (unsigned int i = 0; i < numPartitions; ++i){
+		    _numFaces [i] = static_cast <unsigned int> (_faceIndices [i].size ());
+		  }
+		  return true;
+		}
+
+		// private method to write the mesh just read from text to its binary cache
+		bool
+		Mesh::writeMeshCache (const string &file, uint32_t stamp) const
+		{
+		  BinaryCacheWriter cache;
+		  cache.add (SF_MSD_NODES, _vertices [0]);
+		  cache.add (SF_MSD_MASSES, _mass);
+		  cache.add (SF_MSD_SPRINGS, _springIndices);
+		  cache.add (SF_MSD_BOUNDS, _bbox._v, 2);
+		  cache.add (SF_MSD_SURFACE, &_numSurfaceVertices, 1);
+		  for (unsigned int i = 0; i < _faceIndices.size (); ++i){
+		    cache.add (SF_MSD_FACES + i, _faceIndices [i]);
+		  }
+		  for (unsigned int i = 0; i < _levelIndices.size (); ++i){
+		    vector <unsigned int> data (1, static_cast <unsigned int> (_levelIndices [i].size ()));
+		    for (unsigned int l = 0; l < _levelIndices [i].size (); ++l){
+		      data.push_back (static_cast <unsigned int> (_levelIndices [i][l].size ()/ 3));
+		      data.insert (data.end (), _levelIndices [i][l].begin (), _levelIndices [i][l].end ());
+		    }
+		    cache.copy (SF_MSD_LEVELS + i, data);
+		  }
+		  if (!_latticeVertices [0].empty ()){
+		    cache.add (SF_MSD_LATTICE_NODES, _latticeVertices [0]);
+		    cache.add (SF_MSD_LATTICE_MASSES, _latticeMass);
+		    cache.add (SF_MSD_LATTICE_SPRINGS, _latticeSpringIndices);
+		    cache.add (SF_MSD_EMBED_REGIONS, _embedRegions);
+		    cache.add (SF_MSD_EMBED_NODES, _embedNodes);
+		    cache.add (SF_MSD_EMBED_WEIGHTS, _embedWeights);
+		  }
+		  return cache.write (file, SF_MSD_MESH_KIND, stamp);
+		}
+
 		// class destructor
 		Mesh::~Mesh ()
 		{
@@ -984,7 +1598,7 @@ namespace SF {
 		  while (true){
 
         // wait for physics end to get control
-        _syncControl [_semPhysicsWaitIndex].wait ();
+        _syncControl.wait (PHYSICS_STAGE);
 
         // calculate time-differences
         _past = _present;
@@ -992,43 +1606,54 @@ namespace SF {
         _deltaT0 = _deltaT1;
         _deltaT1 = _present - _past;
 
-        // gather all the incident forces on vertices
-        for (unsigned int i = 0; i < _force.size (); ++i){
-          _force [i] = vec::ZERO;
+        // time factors of the Verlet transform
+        double deltaT0 = static_cast <double> (_deltaT0.total_nanoseconds ())*1.e-9;
+        double deltaT1 = static_cast <double> (_deltaT1.total_nanoseconds ())*1.e-9;
+        real factor0 = deltaT1/ deltaT0;
+        real factor1 = deltaT1 * deltaT1;
+
+        // take the latest pose of the tool and find the contacts with it before any vertex moves
+        if (_tool){
+          _toolState->acquire ();
         }
+        collide ();
 
-        unsigned int index0, index1;
-        vec currDisplacement, restDisplacement;
-        for (unsigned int i = 0; i < _numSprings; i+=2){
-          index0 = _springIndices [i];
-          index1 = _springIndices [i + 1];
+        if (!_latticeVertices [0].empty ()){
+          stepLattice (factor0, factor1, numIters);
+        } else if (!_partitionAwake.empty ()){
+          stepPartitions (factor0, factor1, numIters);
+        } else {
+          // gather all the incident forces on vertices
+          for (unsigned int i = 0; i < _force.size (); ++i){
+            _force [i] = vec::ZERO;
+          }
 
-          restDisplacement = _restVertices [index1] -  _restVertices [index0];
-          currDisplacement = (* _curr) [index1] - (* _curr) [index0];
+          unsigned int index0, index1;
+          vec pull;
+          for (unsigned int i = 0; i < _numSprings; ++i){
+            index0 = _springIndices [2*i];
+            index1 = _springIndices [2*i + 1];
 
-          restDisplacement -= currDisplacement;
+            pull = springForce ((* _curr) [index0], (* _curr) [index1], _restVertices [index0], _restVertices [index1]);
 
-          _force [index0] += restDisplacement;
-          _force [index1] += restDisplacement;
-        }
-
-        // convert force to acceleration
-        for (unsigned int i = 0; i < _force.size (); ++i){
-          _force [i] *= _mass [i];
-        }
+            _force [index0] += pull;
+            _force [index1] -= pull;
+          }
+          addContactForces ();
 
-        // use Verlet transform to calculate updated displacement
-        double deltaT0 = static_cast <double> (_deltaT0.total_nanoseconds ())*1.e-9;
-        double deltaT1 = static_cast <double> (_deltaT1.total_nanoseconds ())*1.e-9;
-        real factor0 = deltaT1/ deltaT0;
-        real factor1 = deltaT1 * deltaT1;
+          // convert force to acceleration
+          for (unsigned int i = 0; i < _force.size (); ++i){
+            _force [i] *= _mass [i];
+          }
 
-        if (numIters > 2){
-          displace_n (*_curr, *_prev, _force, factor0, factor1);
-        } else if (numIters){
-          displace_01 (*_curr, *_prev, _force, factor0, factor1);
-          ++numIters;
-        } else {
+          // use Verlet transform to calculate updated displacement
+          if (numIters > 2){
+            displace_n (*_curr, *_prev, _force, factor0, factor1);
+          } else if (numIters){
+            displace_01 (*_curr, *_prev, _force, factor0, factor1);
+          }
+        }
+        if (numIters < 3){
           ++numIters;
         }
 
@@ -1037,14 +1662,632 @@ namespace SF {
         _curr = _prev;
         _prev = tmp;
 
-        // toggle swap buffer flag
-        _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
+        if (_state){
+          // hand a copy of the new surface to graphics without waiting for it
+          vector <vec> &snapshot = _snapshot [_state->writeIndex ()];
+          copy (_curr->begin (), _curr->begin () + _numSurfaceVertices, snapshot.begin ());
+          _state->publish ();
+        } else {
+          // toggle swap buffer flag
+          _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
+        }
 
         // release data
-        _syncControl [_semPhysicsPostIndex].post ();
+        _syncControl.post (PHYSICS_STAGE);
 		  }
 		}
 
+		// method to register the rigid body (a resource of the Rigid plugin) whose bounding box activates regions of a two-level mesh
+		void
+		Mesh::addTool (Resource *r)
+		{
+		  _tool = static_cast <SF::RM::Mesh *> (r);
+
+		  // the tool moves on its own thread and hands over its pose and box once a step; until then they are the current ones
+		  _toolState = boost::shared_ptr <TripleBuffer> (new TripleBuffer ());
+		  for (int i = 0; i < 3; ++i){
+		    _toolPose [i] = *(_tool->_currPose);
+		    _toolBox [i] = _tool->_bbox;
+		  }
+		  _tool->watch (_toolState.get (), _toolPose, _toolBox);
+		  initToolNormals ();
+		  if (_latticeVertices [0].empty () && _partitionAwake.empty ()){
+		    PRINT ("warning: %s has a tool but neither a lattice nor sleep_threshold; all of its springs run every step\n", _name.get ()->c_str ());
+		  }
+		}
+
+		/**
+		 * Private method to compute the normals of the tool's triangles in model
+		 * space (the tool is rigid), NUM_TRIANGLE_FEATURES per triangle: the
+		 * angle-weighted pseudo-normals of its corners, the pseudo-normals of
+		 * its edges (the sum of the normals of the two triangles sharing them)
+		 * and its face normal. Whether a point is behind the nearest point of a
+		 * closed surface is decided correctly by the normal of the feature that
+		 * point lies on (Baerentzen and Aanaes, Signed distance computation
+		 * using the angle weighted pseudonormal, 2005), also at sharp edges.
+		 * Corners at the same position count as one, so triangles that do not
+		 * share their vertices still join up.
+		 */
+		void
+		Mesh::initToolNormals ()
+		{
+		  const vector <vec> &vertices = _tool->_vertices;
+		  const vector <unsigned int> &indices = _tool->_faceIndices [0];
+		  unsigned int numTriangles = static_cast <unsigned int> (indices.size ()/ 3);
+
+		  // one id per distinct position
+		  map <pair <real, pair <real, real> >, unsigned int> positions;
+		  vector <unsigned int> ids (vertices.size ());
+		  for (unsigned int i = 0; i < vertices.size (); ++i){
+		    pair <real, pair <real, real> > key (vertices [i]._v [0], make_pair (vertices [i]._v [1], vertices [i]._v [2]));
+		    ids [i] = positions.insert (make_pair (key, static_cast <unsigned int> (positions.size ()))).first->second;
+		  }
+
+		  vector <vec> faceNormals (numTriangles);
+		  vector <vec> cornerNormals (positions.size (), direction (0., 0., 0.));
+		  map <pair <unsigned int, unsigned int>, vec> edgeNormals;
+		  for (unsigned int t = 0; t < numTriangles; ++t){
+		    const vec *corner [3] = {&(vertices [indices [3*t]]), &(vertices [indices [3*t + 1]]), &(vertices [indices [3*t + 2]])};
+		    vec normal = cross3 (*(corner [1]) - *(corner [0]), *(corner [2]) - *(corner [0]));
+		    real length = sqrt (dot3 (normal, normal));
+		    faceNormals [t] = length > 0. ? normal*(1./ length) : normal;
+		    for (int j = 0; j < 3; ++j){
+		      vec e1 = *(corner [(j + 1)% 3]) - *(corner [j]), e2 = *(corner [(j + 2)% 3]) - *(corner [j]);
+		      real lengths = sqrt (dot3 (e1, e1)*dot3 (e2, e2));
+		      real cosine = lengths > 0. ? dot3 (e1, e2)/ lengths : 1.;
+		      cornerNormals [ids [indices [3*t + j]]] += faceNormals [t]*acos (cosine < -1. ? -1. : (cosine > 1. ? 1. : cosine));
+
+		      unsigned int id0 = ids [indices [3*t + j]], id1 = ids [indices [3*t + (j + 1)% 3]];
+		      pair <unsigned int, unsigned int> edge (id0 < id1 ? id0 : id1, id0 < id1 ? id1 : id0);
+		      map <pair <unsigned int, unsigned int>, vec>::iterator it = edgeNormals.insert (make_pair (edge, direction (0., 0., 0.))).first;
+		      it->second += faceNormals [t];
+		    }
+		  }
+
+		  _toolModelNormals.resize (NUM_TRIANGLE_FEATURES*numTriangles);
+		  for (unsigned int t = 0; t < numTriangles; ++t){
+		    vec *normals = &(_toolModelNormals [NUM_TRIANGLE_FEATURES*t]);
+		    for (int j = 0; j < 3; ++j){
+		      unsigned int id0 = ids [indices [3*t + j]], id1 = ids [indices [3*t + (j + 1)% 3]];
+		      normals [CORNER_A + j] = cornerNormals [id0];
+		      normals [EDGE_AB + j] = edgeNormals [make_pair (id0 < id1 ? id0 : id1, id0 < id1 ? id1 : id0)];
+		    }
+		    normals [FACE] = faceNormals [t];
+		  }
+		}
+
+		// method to wake a sleeping partition of a single-level mesh (no-op if it is awake or the mesh does not sleep)
+		void
+		Mesh::wake (unsigned int partition)
+		{
+		  if (partition < _partitionAwake.size () && !_partitionAwake [partition]){
+		    _partitionAwake [partition] = 1;
+		    _partitionQuiet [partition] = 0;
+		  }
+		}
+
+		// private method to check the lattice of a two-level mesh and group its vertices, nodes and springs by region
+		void
+		Mesh::initRegions ()
+		{
+		  size_t numVerts = _vertices [0].size ();
+		  size_t numNodes = _latticeVertices [0].size ();
+		  if (_latticeMass.size () != numNodes || _embedRegions.size () != numVerts || _embedNodes.size () != 4*numVerts || _embedWeights.size () != 4*numVerts){
+		    PRINT ("fatal error: the lattice of %s does not match its %lu vertices\n", _name.get ()->c_str (), numVerts);
+		    exit (EXIT_FAILURE);
+		  }
+		  if ((!_latticeSpringIndices.empty () && *max_element (_latticeSpringIndices.begin (), _latticeSpringIndices.end ()) >= numNodes)
+		      || *max_element (_embedNodes.begin (), _embedNodes.end ()) >= numNodes){
+		    PRINT ("fatal error: the lattice of %s refers to a node beyond its %lu nodes\n", _name.get ()->c_str (), numNodes);
+		    exit (EXIT_FAILURE);
+		  }
+		  unsigned int numRegions = *max_element (_embedRegions.begin (), _embedRegions.end ()) + 1;
+
+		  vector <pair <unsigned int, unsigned int> > pairs;
+		  pairs.reserve (4*numVerts);
+		  for (unsigned int i = 0; i < numVerts; ++i){
+		    pairs.push_back (make_pair (_embedRegions [i], i));
+		  }
+		  groupByRegion (pairs, numRegions, _regionVertices);
+
+		  pairs.clear ();
+		  for (unsigned int i = 0; i < numVerts; ++i){
+		    for (int j = 0; j < 4; ++j){
+		      pairs.push_back (make_pair (_embedRegions [i], _embedNodes [4*i + j]));
+		    }
+		  }
+		  groupByRegion (pairs, numRegions, _regionNodes);
+
+		  // a spring joining two regions is listed in both and run by the region of its first vertex while that one is active
+		  pairs.clear ();
+		  for (unsigned int i = 0; i < _numSprings; ++i){
+		    unsigned int r0 = _embedRegions [_springIndices [2*i]], r1 = _embedRegions [_springIndices [2*i + 1]];
+		    pairs.push_back (make_pair (r0, i));
+		    if (r1 != r0){
+		      pairs.push_back (make_pair (r1, i));
+		    }
+		  }
+		  groupByRegion (pairs, numRegions, _regionSprings);
+
+		  _regionActive.assign (numRegions, 0);
+		  _regionSettle.assign (numRegions, 0);
+		}
+
+		// private method to give every surface vertex to the first octant whose triangles use it, for the collision pass
+		void
+		Mesh::initContacts ()
+		{
+		  vector <char> owned (_numSurfaceVertices, 0);
+		  vector <pair <unsigned int, unsigned int> > pairs;
+		  pairs.reserve (_numSurfaceVertices);
+		  for (unsigned int p = 0; p < _faceIndices.size (); ++p){
+		    for (unsigned int j = 0; j < _faceIndices [p].size (); ++j){
+		      unsigned int v = _faceIndices [p][j];
+		      if (!owned [v]){
+		        owned [v] = 1;
+		        pairs.push_back (make_pair (p, v));
+		      }
+		    }
+		  }
+		  groupByRegion (pairs, static_cast <unsigned int> (_faceIndices.size ()), _octantSurface);
+		  _contactVertices.resize (_faceIndices.size ());
+		  _contactForces.resize (_faceIndices.size ());
+		}
+
+		/**
+		 * Private method to run the collision pass of a step. The box around the
+		 * current surface vertices of every octant is found first, and nothing
+		 * is tested unless the tool's box overlaps the union of these boxes
+		 * (the mesh moves, so its rest box will not do); otherwise the tool's
+		 * triangles and their boxes are placed in world space once and the
+		 * octants are tested on the pool, each filling its own contact list.
+		 */
+		void
+		Mesh::collide ()
+		{
+		  bool touching = _tool && _contactStiffness > 0.;
+
+		  aabb tool;
+		  if (touching){
+		    const vector <vec> &curr = *_curr;
+		    unsigned int numOctants = static_cast <unsigned int> (_contactVertices.size ());
+		    _octantBounds.resize (6*numOctants);
+		    real mesh [6];
+		    bool empty = true;
+		    for (unsigned int p = 0; p < numOctants; ++p){
+		      unsigned int begin = _octantSurface [0][p], end = _octantSurface [0][p + 1];
+		      if (begin == end){
+		        continue;
+		      }
+		      real *box = &(_octantBounds [6*p]);
+		      for (int j = 0; j < 3; ++j){
+		        box [j] = box [3 + j] = curr [_octantSurface [1][begin]]._v [j];
+		      }
+		      for (unsigned int k = begin + 1; k < end; ++k){
+		        const real *v = curr [_octantSurface [1][k]]._v;
+		        for (int j = 0; j < 3; ++j){
+		          box [j] = min (box [j], v [j]);
+		          box [3 + j] = max (box [3 + j], v [j]);
+		        }
+		      }
+		      for (int j = 0; j < 3; ++j){
+		        mesh [j] = empty ? box [j] : min (mesh [j], box [j]);
+		        mesh [3 + j] = empty ? box [3 + j] : max (mesh [3 + j], box [3 + j]);
+		      }
+		      empty = false;
+		    }
+
+		    tool = _toolBox [_toolState->readIndex ()];
+		    touching = !empty && tool.collide (aabb (vec3 (mesh [0], mesh [1], mesh [2]), vec3 (mesh [3], mesh [4], mesh [5])));
+		  }
+		  if (!touching){
+		    for (unsigned int p = 0; p < _contactVertices.size (); ++p){
+		      _contactVertices [p].clear ();
+		      _contactForces [p].clear ();
+		    }
+		    return;
+		  }
+
+		  mat4x4 pose (_toolPose [_toolState->readIndex ()]);
+		  const vector <unsigned int> &indices = _tool->_faceIndices [0];
+		  _toolTriangles.resize (indices.size ());
+		  for (unsigned int i = 0; i < indices.size (); ++i){
+		    const vec &corner = _tool->_vertices [indices [i]];
+		    vec4 tmpv (corner._v [0], corner._v [1], corner._v [2], 1.);
+		    tmpv = pose * tmpv;
+		    _toolTriangles [i] = vec (tmpv._v [0], tmpv._v [1], tmpv._v [2]);
+		  }
+		  // normals only turn with the tool (mat4x4 * vec4 divides by w, so the rotation is applied by hand)
+		  const real *m = pose._m;
+		  _toolNormals.resize (_toolModelNormals.size ());
+		  for (unsigned int i = 0; i < _toolModelNormals.size (); ++i){
+		    const real *n = _toolModelNormals [i]._v;
+		    _toolNormals [i] = direction (m [0]*n [0] + m [1]*n [1] + m [2]*n [2], m [4]*n [0] + m [5]*n [1] + m [6]*n [2], m [8]*n [0] + m [9]*n [1] + m [10]*n [2]);
+		  }
+		  _toolTriangleBounds.resize (2*indices.size ());
+		  for (unsigned int t = 0; t < indices.size (); t += 3){
+		    real *box = &(_toolTriangleBounds [2*t]);
+		    for (int j = 0; j < 3; ++j){
+		      box [j] = min (_toolTriangles [t]._v [j], min (_toolTriangles [t + 1]._v [j], _toolTriangles [t + 2]._v [j]));
+		      box [3 + j] = max (_toolTriangles [t]._v [j], max (_toolTriangles [t + 1]._v [j], _toolTriangles [t + 2]._v [j]));
+		    }
+		  }
+
+		  _pool->parallelFor (0, static_cast <unsigned int> (_contactVertices.size ()), boost::bind (&collideOctants, this, &tool, _1, _2), 1, HIGH_PRIORITY);
+		}
+
+		// private method to add the contact forces of the collision pass to the vertices that move in this step
+		void
+		Mesh::addContactForces ()
+		{
+		  for (unsigned int p = 0; p < _contactVertices.size (); ++p){
+		    for (unsigned int k = 0; k < _contactVertices [p].size (); ++k){
+		      unsigned int v = _contactVertices [p][k];
+		      if (!_regionActive.empty () && !_regionActive [_embedRegions [v]]){
+		        continue;
+		      }
+		      if (!_partitionAwake.empty () && !_partitionAwake [_vertexPartition [v]]){
+		        continue;
+		      }
+		      _force [v] += _contactForces [p][k];
+		    }
+		  }
+		}
+
+		/**
+		 * Private method to assign every vertex of a single-level mesh to a
+		 * partition and group vertices, springs and neighboring partitions by
+		 * partition. Surface vertices go to the first octant whose triangles use
+		 * them, interior vertices to the octant of the nearest surface vertex
+		 * (counted in springs), and vertices no spring reaches to octant 0.
+		 */
+		void
+		Mesh::initPartitions ()
+		{
+		  unsigned int numVerts = static_cast <unsigned int> (_vertices [0].size ());
+		  unsigned int numPartitions = _faceIndices.empty () ? 1 : static_cast <unsigned int> (_faceIndices.size ());
+
+		  vector <unsigned int> queue;
+		  queue.reserve (numVerts);
+		  _vertexPartition.assign (numVerts, numPartitions);
+		  for (unsigned int p = 0; p < _faceIndices.size (); ++p){
+		    for (unsigned int j = 0; j < _faceIndices [p].size (); ++j){
+		      unsigned int v = _faceIndices [p][j];
+		      if (_vertexPartition [v] == numPartitions){
+		        _vertexPartition [v] = p;
+		        queue.push_back (v);
+		      }
+		    }
+		  }
+
+		  vector <pair <unsigned int, unsigned int> > pairs;
+		  pairs.reserve (2*_numSprings);
+		  for (unsigned int i = 0; i < _numSprings; ++i){
+		    pairs.push_back (make_pair (_springIndices [2*i], _springIndices [2*i + 1]));
+		    pairs.push_back (make_pair (_springIndices [2*i + 1], _springIndices [2*i]));
+		  }
+		  vector <unsigned int> adjacency [2];
+		  groupByRegion (pairs, numVerts, adjacency);
+		  for (size_t k = 0; k < queue.size (); ++k){
+		    unsigned int v = queue [k];
+		    for (unsigned int j = adjacency [0][v]; j < adjacency [0][v + 1]; ++j){
+		      if (_vertexPartition [adjacency [1][j]] == numPartitions){
+		        _vertexPartition [adjacency [1][j]] = _vertexPartition [v];
+		        queue.push_back (adjacency [1][j]);
+		      }
+		    }
+		  }
+		  for (unsigned int i = 0; i < numVerts; ++i){
+		    if (_vertexPartition [i] == numPartitions){
+		      _vertexPartition [i] = 0;
+		    }
+		  }
+
+		  pairs.clear ();
+		  for (unsigned int i = 0; i < numVerts; ++i){
+		    pairs.push_back (make_pair (_vertexPartition [i], i));
+		  }
+		  groupByRegion (pairs, numPartitions, _partitionVertices);
+
+		  // like the springs of regions, a spring joining two partitions is listed in both and run by the partition of its first vertex while that one is awake
+		  pairs.clear ();
+		  vector <pair <unsigned int, unsigned int> > neighbors;
+		  for (unsigned int i = 0; i < _numSprings; ++i){
+		    unsigned int p0 = _vertexPartition [_springIndices [2*i]], p1 = _vertexPartition [_springIndices [2*i + 1]];
+		    pairs.push_back (make_pair (p0, i));
+		    if (p1 != p0){
+		      pairs.push_back (make_pair (p1, i));
+		      neighbors.push_back (make_pair (p0, p1));
+		      neighbors.push_back (make_pair (p1, p0));
+		    }
+		  }
+		  groupByRegion (pairs, numPartitions, _partitionSprings);
+		  groupByRegion (neighbors, numPartitions, _partitionNeighbors);
+
+		  _partitionBounds.assign (6*numPartitions, 0.);
+		  for (unsigned int p = 0; p < numPartitions; ++p){
+		    real *bounds = &(_partitionBounds [6*p]);
+		    for (unsigned int k = _partitionVertices [0][p]; k < _partitionVertices [0][p + 1]; ++k){
+		      const real *v = _vertices [0][_partitionVertices [1][k]]._v;
+		      for (int j = 0; j < 3; ++j){
+		        bounds [j] = k == _partitionVertices [0][p] || bounds [j] > v [j] ? v [j] : bounds [j];
+		        bounds [3 + j] = k == _partitionVertices [0][p] || bounds [3 + j] < v [j] ? v [j] : bounds [3 + j];
+		      }
+		    }
+		  }
+		  _partitionQuiet.assign (numPartitions, 0);
+		  _partitionAwake.assign (numPartitions, 1);
+		}
+
+		/**
+		 * Private method to advance a single-level mesh with sleeping partitions
+		 * by one step. Only awake partitions run their springs and move; the
+		 * vertices of sleeping neighbors hold the ends of boundary springs in
+		 * place. Partitions are woken by the tool's bounding box before the step
+		 * and by neighbors that moved more than the threshold after it. A
+		 * partition that falls asleep gets the same positions in both buffers,
+		 * so it wakes up at rest.
+		 */
+		void
+		Mesh::stepPartitions (real factor0, real factor1, unsigned int numIters)
+		{
+		  unsigned int numPartitions = static_cast <unsigned int> (_partitionAwake.size ());
+
+		  /*************************** WAKE PARTITIONS UNDER THE TOOL ***************************/
+		  if (_tool){
+		    const aabb &tool = _toolBox [_toolState->readIndex ()];
+		    for (unsigned int p = 0; p < numPartitions; ++p){
+		      const real *bounds = &(_partitionBounds [6*p]);
+		      bool overlap = !_partitionAwake [p];
+		      for (int j = 0; j < 3; ++j){
+		        overlap = overlap && bounds [j] <= tool._v [1]._v [j] && bounds [3 + j] >= tool._v [0]._v [j];
+		      }
+		      if (overlap){
+		        wake (p);
+		      }
+		    }
+		  }
+
+		  /*************************** RUN THE SPRINGS OF AWAKE PARTITIONS ***************************/
+		  for (unsigned int p = 0; p < numPartitions; ++p){
+		    if (_partitionAwake [p]){
+		      for (unsigned int k = _partitionVertices [0][p]; k < _partitionVertices [0][p + 1]; ++k){
+		        _force [_partitionVertices [1][k]] = vec::ZERO;
+		      }
+		    }
+		  }
+		  vec pull;
+		  for (unsigned int p = 0; p < numPartitions; ++p){
+		    if (!_partitionAwake [p]){
+		      continue;
+		    }
+		    for (unsigned int k = _partitionSprings [0][p]; k < _partitionSprings [0][p + 1]; ++k){
+		      unsigned int s = _partitionSprings [1][k];
+		      unsigned int index0 = _springIndices [2*s], index1 = _springIndices [2*s + 1];
+		      bool awake0 = _partitionAwake [_vertexPartition [index0]], awake1 = _partitionAwake [_vertexPartition [index1]];
+		      if (_vertexPartition [index0] != p && awake0){
+		        continue;
+		      }
+		      pull = springForce ((*_curr) [index0], (*_curr) [index1], _restVertices [index0], _restVertices [index1]);
+		      if (awake0){
+		        _force [index0] += pull;
+		      }
+		      if (awake1){
+		        _force [index1] -= pull;
+		      }
+		    }
+		  }
+		  addContactForces ();
+
+		  /*************************** DISPLACE AND TRACK ACTIVITY ***************************/
+		  // an awake partition is marked 2 if it moved more than the threshold, to wake its neighbors below
+		  real threshold = _sleepThreshold*_sleepThreshold;
+		  for (unsigned int p = 0; p < numPartitions; ++p){
+		    if (!_partitionAwake [p]){
+		      continue;
+		    }
+		    real maxDisplacement = 0.;
+		    real *bounds = &(_partitionBounds [6*p]);
+		    for (unsigned int k = _partitionVertices [0][p]; k < _partitionVertices [0][p + 1]; ++k){
+		      unsigned int v = _partitionVertices [1][k];
+		      _force [v] *= _mass [v];
+		      if (numIters > 2){
+		        displaceVertex_n (*_curr, *_prev, _force, factor0, factor1, v);
+		      } else if (numIters){
+		        displaceVertex_01 (*_curr, *_prev, _force, factor0, factor1, v);
+		      }
+
+		      const real *curr = (*_curr) [v]._v, *next = (*_prev) [v]._v;
+		      real displacement = 0.;
+		      for (int j = 0; j < 3; ++j){
+		        displacement += (next [j] - curr [j])*(next [j] - curr [j]);
+		        bounds [j] = k == _partitionVertices [0][p] || bounds [j] > next [j] ? next [j] : bounds [j];
+		        bounds [3 + j] = k == _partitionVertices [0][p] || bounds [3 + j] < next [j] ? next [j] : bounds [3 + j];
+		      }
+		      maxDisplacement = maxDisplacement < displacement ? displacement : maxDisplacement;
+		    }
+
+		    // the first steps are not judged (their displacement is not a velocity yet)
+		    if (numIters < 3){
+		      continue;
+		    }
+		    if (maxDisplacement >= threshold){
+		      _partitionQuiet [p] = 0;
+		      _partitionAwake [p] = 2;
+		    } else if (++_partitionQuiet [p] >= SF_MSD_SLEEP_STEPS){
+		      for (unsigned int k = _partitionVertices [0][p]; k < _partitionVertices [0][p + 1]; ++k){
+		        unsigned int v = _partitionVertices [1][k];
+		        (*_curr) [v] = (*_prev) [v];
+		      }
+		      _partitionAwake [p] = 0;
+		    }
+		  }
+
+		  for (unsigned int p = 0; p < numPartitions; ++p){
+		    if (_partitionAwake [p] == 2){
+		      _partitionAwake [p] = 1;
+		      for (unsigned int k = _partitionNeighbors [0][p]; k < _partitionNeighbors [0][p + 1]; ++k){
+		        wake (_partitionNeighbors [1][k]);
+		      }
+		    }
+		  }
+		}
+
+		/**
+		 * Private method to advance a two-level mesh by one step. Regions whose
+		 * lattice nodes overlap the tool's bounding box are active: their
+		 * vertices run their springs, against positions on the lattice for
+		 * neighbors in idle regions. The lattice runs its own springs everywhere,
+		 * and the forces on active vertices (springs and contact) are spread onto
+		 * the lattice nodes they hang on by their weights, so the lattice follows
+		 * what happens under the tool. The surface vertices of idle regions are
+		 * placed on the lattice; those of a region that just went idle are
+		 * blended onto it over SF_MSD_SETTLE_STEPS steps. Interior vertices of
+		 * idle regions are not updated; a region that wakes up places them (both
+		 * time levels) on the lattice first, and its surface vertices too unless
+		 * they are still settling.
+		 */
+		void
+		Mesh::stepLattice (real factor0, real factor1, unsigned int numIters)
+		{
+		  vector <vec> &lcurr = _latticeVertices [0];
+		  vector <vec> &lprev = _latticeVertices [1];
+		  const unsigned int *nodes = &(_embedNodes [0]);
+		  const real *weights = &(_embedWeights [0]);
+		  unsigned int numRegions = static_cast <unsigned int> (_regionActive.size ());
+
+		  /*************************** FIND ACTIVE REGIONS ***************************/
+		  aabb tool;
+		  if (_tool){
+		    tool = _toolBox [_toolState->readIndex ()];
+		  }
+		  for (unsigned int r = 0; r < numRegions; ++r){
+		    bool active = _tool;
+		    if (active){
+		      vec3 min (lcurr [_regionNodes [1][_regionNodes [0][r]]]._v);
+		      vec3 max (min);
+		      for (unsigned int k = _regionNodes [0][r] + 1; k < _regionNodes [0][r + 1]; ++k){
+		        const real *v = lcurr [_regionNodes [1][k]]._v;
+		        for (int j = 0; j < 3; ++j){
+		          min._v [j] = min._v [j] > v [j] ? v [j] : min._v [j];
+		          max._v [j] = max._v [j] < v [j] ? v [j] : max._v [j];
+		        }
+		      }
+		      for (int j = 0; j < 3; ++j){
+		        active = active && min._v [j] <= tool._v [1]._v [j] && max._v [j] >= tool._v [0]._v [j];
+		      }
+		    }
+		    if (active && !_regionActive [r]){
+		      for (unsigned int k = _regionVertices [0][r]; k < _regionVertices [0][r + 1]; ++k){
+		        unsigned int v = _regionVertices [1][k];
+		        if (_regionSettle [r] && v < _numSurfaceVertices){
+		          continue;
+		        }
+		        (*_curr) [v] = placeVertex (lcurr, nodes + 4*v, weights + 4*v, (*_curr) [v]);
+		        (*_prev) [v] = placeVertex (lprev, nodes + 4*v, weights + 4*v, (*_prev) [v]);
+		      }
+		      _regionSettle [r] = 0;
+		    } else if (!active && _regionActive [r]){
+		      _regionSettle [r] = SF_MSD_SETTLE_STEPS;
+		    }
+		    _regionActive [r] = active;
+		  }
+
+		  /*************************** ADVANCE THE LATTICE ***************************/
+		  for (unsigned int i = 0; i < _latticeForce.size (); ++i){
+		    _latticeForce [i] = vec::ZERO;
+		  }
+		  vec pull;
+		  for (unsigned int i = 0; i < _latticeSpringIndices.size (); i += 2){
+		    unsigned int index0 = _latticeSpringIndices [i], index1 = _latticeSpringIndices [i + 1];
+		    pull = springForce (lcurr [index0], lcurr [index1], _latticeRestVertices [index0], _latticeRestVertices [index1]);
+		    _latticeForce [index0] += pull;
+		    _latticeForce [index1] -= pull;
+		  }
+
+		  /*************************** RUN THE SPRINGS OF ACTIVE REGIONS ***************************/
+		  for (unsigned int r = 0; r < numRegions; ++r){
+		    if (_regionActive [r]){
+		      for (unsigned int k = _regionVertices [0][r]; k < _regionVertices [0][r + 1]; ++k){
+		        _force [_regionVertices [1][k]] = vec::ZERO;
+		      }
+		    }
+		  }
+		  for (unsigned int r = 0; r < numRegions; ++r){
+		    if (!_regionActive [r]){
+		      continue;
+		    }
+		    for (unsigned int k = _regionSprings [0][r]; k < _regionSprings [0][r + 1]; ++k){
+		      unsigned int s = _regionSprings [1][k];
+		      unsigned int index0 = _springIndices [2*s], index1 = _springIndices [2*s + 1];
+		      bool active0 = _regionActive [_embedRegions [index0]], active1 = _regionActive [_embedRegions [index1]];
+		      if (_embedRegions [index0] != r && active0){
+		        continue;
+		      }
+		      pull = springForce (active0 ? (*_curr) [index0] : placeVertex (lcurr, nodes + 4*index0, weights + 4*index0, (*_curr) [index0]),
+		                          active1 ? (*_curr) [index1] : placeVertex (lcurr, nodes + 4*index1, weights + 4*index1, (*_curr) [index1]),
+		                          _restVertices [index0], _restVertices [index1]);
+		      if (active0){
+		        _force [index0] += pull;
+		      }
+		      if (active1){
+		        _force [index1] -= pull;
+		      }
+		    }
+		  }
+		  addContactForces ();
+
+		  // the lattice feels the active vertices through the transpose of the embedding
+		  for (unsigned int r = 0; r < numRegions; ++r){
+		    if (_regionActive [r]){
+		      for (unsigned int k = _regionVertices [0][r]; k < _regionVertices [0][r + 1]; ++k){
+		        unsigned int v = _regionVertices [1][k];
+		        for (int j = 0; j < 4; ++j){
+		          _latticeForce [nodes [4*v + j]] += _force [v]*weights [4*v + j];
+		        }
+		      }
+		    }
+		  }
+		  for (unsigned int i = 0; i < _latticeForce.size (); ++i){
+		    _latticeForce [i] *= _latticeMass [i];
+		  }
+
+		  /*************************** DISPLACE ***************************/
+		  if (numIters > 2){
+		    displace_n (lcurr, lprev, _latticeForce, factor0, factor1);
+		  } else if (numIters){
+		    displace_01 (lcurr, lprev, _latticeForce, factor0, factor1);
+		  }
+
+		  for (unsigned int r = 0; r < numRegions; ++r){
+		    if (_regionActive [r]){
+		      for (unsigned int k = _regionVertices [0][r]; k < _regionVertices [0][r + 1]; ++k){
+		        unsigned int v = _regionVertices [1][k];
+		        _force [v] *= _mass [v];
+		        if (numIters > 2){
+		          displaceVertex_n (*_curr, *_prev, _force, factor0, factor1, v);
+		        } else if (numIters){
+		          displaceVertex_01 (*_curr, *_prev, _force, factor0, factor1, v);
+		        }
+		      }
+		    } else {
+		      // vertices of a region are in ascending order, so its surface vertices come first
+		      real blend = _regionSettle [r] ? 1./ _regionSettle [r] : 1.;
+		      for (unsigned int k = _regionVertices [0][r]; k < _regionVertices [0][r + 1] && _regionVertices [1][k] < _numSurfaceVertices; ++k){
+		        unsigned int v = _regionVertices [1][k];
+		        vec placed = placeVertex (lprev, nodes + 4*v, weights + 4*v, (*_curr) [v]);
+		        (*_prev) [v] = (*_curr) [v] + (placed - (*_curr) [v])*blend;
+		      }
+		      if (_regionSettle [r]){
+		        --_regionSettle [r];
+		      }
+		    }
+		  }
+
+		  // the new lattice becomes current (the vertex buffers are swapped by the caller)
+		  lcurr.swap (lprev);
+		}
+
 		// method to initialize all the GPU programs
 		bool
 		Mesh::initGPUPrograms ()
@@ -1250,23 +2493,11 @@ namespace SF {
     Mesh::checkMySanity ()
     {
       // check thread variables
-      if (_semPhysicsWaitIndex < 0 || _semPhysicsWaitIndex > 2){
-        fprintf (stderr, "_semPhysicsWaitIndex incorrect - %d\n", _semPhysicsWaitIndex);
-      }
-      if (_semPhysicsPostIndex < 0 || _semPhysicsPostIndex > 2){
-        fprintf (stderr, "_semPhysicsPostIndex incorrect - %d\n", _semPhysicsPostIndex);
-      }
-      if (_semCollisionWaitIndex < 0 || _semCollisionWaitIndex > 2){
-        fprintf (stderr, "_semCollisionWaitIndex incorrect - %d\n", _semCollisionWaitIndex);
-      }
-      if (_semCollisionPostIndex < 0 || _semCollisionPostIndex > 2){
-        fprintf (stderr, "_semCollisionPostIndex incorrect - %d\n", _semCollisionPostIndex);
+      if (!_syncControl.has (PHYSICS_STAGE)){
+        fprintf (stderr, "physics stage is not synchronized\n");
       }
-      if (_semGraphicsWaitIndex < 0 || _semGraphicsWaitIndex > 2){
-        fprintf (stderr, "_semGraphicsWaitIndex incorrect - %d\n", _semGraphicsWaitIndex);
-      }
-      if (_semGraphicsPostIndex < 0 || _semGraphicsPostIndex > 2){
-        fprintf (stderr, "_semGraphicsPostIndex incorrect - %d\n", _semGraphicsPostIndex);
+      if (!_state && !_syncControl.has (GRAPHICS_STAGE)){
+        fprintf (stderr, "graphics stage is not synchronized\n");
       }
 
       // check vertex arrays
@@ -1301,13 +2532,13 @@ namespace SF {
       }
 
       // check spring variables
-      if (!_numSprings || _numSprings != _springIndices.size ()){
+      if (!_numSprings || 2*_numSprings != _springIndices.size ()){
         fprintf (stderr, "Inconsistent spring sizes: _numSprings - %u _springIndices.size () - %lu\n", _numSprings, _springIndices.size ());
       }
       unsigned int maxVertexIndex = _vertices [0].size () - 1;
-      for (unsigned int i = 0; i < _numSprings; i += 2){
-        if (_springIndices [i] > maxVertexIndex || _springIndices [i + 1] > maxVertexIndex){
-          fprintf (stderr, "Inconsistent spring index for spring [%u] - %u %u (maxIndex should be %u)\n", i/2, _springIndices [i], _springIndices [i + 1], maxVertexIndex);
+      for (unsigned int i = 0; i < _numSprings; ++i){
+        if (_springIndices [2*i] > maxVertexIndex || _springIndices [2*i + 1] > maxVertexIndex){
+          fprintf (stderr, "Inconsistent spring index for spring [%u] - %u %u (maxIndex should be %u)\n", i, _springIndices [2*i], _springIndices [2*i + 1], maxVertexIndex);
         }
       }
       if (_force.size () != _vertices [0].size ()){
@@ -1443,6 +2674,41 @@ namespace SF {
 		    glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (unsigned int)*_numFaces [i], &(_faceIndices [i][0]), GL_DYNAMIC_DRAW);
 		    checkGLError (error);
 		  }
+
+		  // coarser surfaces of each octant, and the sphere bounding the octant at rest to pick one by its size on screen
+		  _glLevelIndexBufferId.resize (_levelIndices.size ());
+		  _glOctantBounds.assign (4*_levelIndices.size (), 0.);
+		  for (unsigned int i = 0; i < _levelIndices.size (); ++i){
+		    if (_levelIndices [i].empty () || !_numFaces [i]){
+		      continue;
+		    }
+		    _glLevelIndexBufferId [i].resize (_levelIndices [i].size (), 0);
+		    glGenBuffers (_glLevelIndexBufferId [i].size (), &(_glLevelIndexBufferId [i][0]));
+		    checkGLError (error);
+		    for (unsigned int l = 0; l < _levelIndices [i].size (); ++l){
+		      glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, _glLevelIndexBufferId [i][l]);
+		      checkGLError (error);
+		      glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (unsigned int)*_levelIndices [i][l].size (),
+		                    _levelIndices [i][l].empty () ? NULL : &(_levelIndices [i][l][0]), GL_STATIC_DRAW);
+		      checkGLError (error);
+		    }
+
+		    vec3 min (_vertices [0][_faceIndices [i][0]]._v);
+		    vec3 max (min);
+		    for (unsigned int j = 1; j < _numFaces [i]; ++j){
+		      const real *v = _vertices [0][_faceIndices [i][j]]._v;
+		      for (int k = 0; k < 3; ++k){
+		        min._v [k] = std::min (min._v [k], v [k]);
+		        max._v [k] = std::max (max._v [k], v [k]);
+		      }
+		    }
+		    real *s = &(_glOctantBounds [4*i]);
+		    for (int k = 0; k < 3; ++k){
+		      s [k] = .5*(min._v [k] + max._v [k]);
+		      s [3] += .25*(max._v [k] - min._v [k])*(max._v [k] - min._v [k]);
+		    }
+		    s [3] = sqrt (s [3]);
+		  }
 		  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
 
 		  /*************************** INITIALIZE NORMAL CALCULATION BUFFERS ***************************/
@@ -1551,7 +2817,7 @@ namespace SF {
 
     // private method to initialize texture-related objects
     bool
-    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const Texture3D &texture)
+    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool)
     {
       // store original number of faces and get three outer rings for each submesh triangles
       {
@@ -1559,9 +2825,7 @@ namespace SF {
         extraFaces.reserve (_faceIndices.size ());
         extraFaces.resize (_faceIndices.size ());
 
-        for (unsigned int i = 0; i < extraFaces.size (); ++i){
-          getFaceRings (i, _faceIndices, extraFaces [i]);
-        }
+        pool.parallelFor (0, extraFaces.size (), boost::bind (&getFaceRingRange, &_faceIndices, &extraFaces, _1, _2), 1);
         for (unsigned int i = 0; i < extraFaces.size (); ++i){
           for (unsigned int j = 0; j < extraFaces [i].size (); ++j){
             _faceIndices [i].push_back (extraFaces [i][j]);
@@ -1569,9 +2833,7 @@ namespace SF {
           extraFaces [i].clear ();
         }
 
-        for (unsigned int i = 0; i < extraFaces.size (); ++i){
-          getFaceRings (i, _faceIndices, extraFaces [i]);
-        }
+        pool.parallelFor (0, extraFaces.size (), boost::bind (&getFaceRingRange, &_faceIndices, &extraFaces, _1, _2), 1);
         for (unsigned int i = 0; i < extraFaces.size (); ++i){
           for (unsigned int j = 0; j < extraFaces [i].size (); ++j){
             _faceIndices [i].push_back (extraFaces [i][j]);
@@ -1580,41 +2842,15 @@ namespace SF {
         }
       }
 
-      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method
-      vector <vector <vec2> > texCoords (_faceIndices.size ());
-      for (unsigned int i = 0; i < _faceIndices.size (); ++i){
-        calculateParametricCoordinates (_numSurfaceVertices, _vertices [0], _faceIndices [i], texCoords [i]);
-      }
+      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method (partitions are independent)
+      vector <vector <vec2> > texCoords;
+      uint32_t chartKey = calculateParametricCoordinates (artifacts, _numSurfaceVertices, _vertices [0], _faceIndices, texCoords, pool);
 
       // determine scale factors to be used for rasterizing charts
       vector <real> area2d (_faceIndices.size ());
       {
         // calculate the resolution of surface pixels
-        int first, second;
-        unsigned int numPixels = 0;
-        unsigned int offset1 = 4*texture._dimension[0]*texture._dimension[1];
-        unsigned int offset2 = 4*texture._dimension[0];
-        for (unsigned int i = 0; i < texture._dimension [2]; ++i){
-          for (unsigned int j = 0; j < texture._dimension [1]; ++j){
-            first = -1;
-            second = -1;
-            for (unsigned int k = 0; k < texture._dimension [0]; ++k){
-              if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                first = static_cast <int> (k);
-                break;
-              }
-            }
-            if (first >= 0){
-              for (int k = static_cast <int> (texture._dimension [0]) - 1; k >=0; --k){
-                if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                  second = k;
-                  break;
-                }
-              }
-              numPixels += first < second ? 2 : 1;
-            }
-          }
-        }
+        unsigned int numPixels = countSurfaceTexels (texture);
 
         // calculate scaling factors
         vec te, e1, e2;
@@ -1660,7 +2896,7 @@ namespace SF {
       }
 
       // rasterize each flattened 2D submesh and generate rectangular charts
-      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d, texCoords);
+      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d, texCoords, artifacts, chartKey, pool);
 
       // resize the indices (done to undo the additions made to the indices at the very start of this method)
       for (unsigned int i = 0; i < _faceIndices.size (); ++i){
@@ -1672,29 +2908,39 @@ namespace SF {
 
     // private method to rasterize flattened submeshes
     void
-    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords)
+    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool)
     {
-      // scale vertices to account for aspect ratios of the texture dataset
-      vector <vec> normalizedVerts (_numSurfaceVertices);
-      scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
-
-      // locally calculate normals
-      vector <vec> normals;
-      normals.reserve (_numSurfaceVertices);
-      normals.resize (_numSurfaceVertices, vec::ZERO);
-      calculateVertexNormals (normalizedVerts, _faceIndices, normals);
+      // atlases rasterized before from the same charts, texture and settings are taken from the artifact cache
+      uint32_t atlasKey = artifacts.isOpen () ? textureAtlasKey (chartKey, texture, _bbox, scales, atlasScale, *_glslPrefixString, atlasShader) : 0;
+      vector <int> dims;
+      vector <vector <GLubyte> > atlases;
+      bool cached = artifacts.isOpen () && readTextureAtlases (artifacts, atlasKey, dims, atlases) && dims.size () == _faceIndices.size ();
+      dims.resize (_faceIndices.size ());
+      atlases.resize (_faceIndices.size ());
+
+      vector <vec> normalizedVerts, normals;
+      GLuint program = 0;
+      if (!cached){
+        // scale vertices to account for aspect ratios of the texture dataset
+        normalizedVerts.resize (_numSurfaceVertices);
+        scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
+
+        // locally calculate normals
+        normals.resize (_numSurfaceVertices, vec::ZERO);
+        calculateVertexNormals (normalizedVerts, _faceIndices, normals);
+
+        // scale normals so that they go from [-1:1] to [0, 1]
+        for (unsigned int i = 0; i < normals.size (); ++i){
+          normals [i] *= .5;
+          normals [i] += .5;
+        }
 
-      // scale normals so that they go from [-1:1] to [0, 1]
-      for (unsigned int i = 0; i < normals.size (); ++i){
-        normals [i] *= .5;
-        normals [i] += .5;
+        // load GL shader file
+        initGPUProgram (false, *_glslPrefixString, atlasShader, program);
+        assert (program);
       }
 
-      // load GL shader file
-      GLuint program = 0;
-      initGPUProgram (false, *_glslPrefixString, atlasShader, program);
-      assert (program);
-
       // initialize GL texture atlas and texture coordinate objects
       GLenum error;
 
@@ -1739,39 +2985,40 @@ namespace SF {
           }
         }
 
-        // generate texture atlases for coordinate and normal data
-        vector <GLubyte> rgbaData;
-        vector <GLfloat> coData, noData;
-        coData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normalizedVerts, texCoords [i], _faceIndices [i], coData);
-
-        noData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normals, texCoords [i], _faceIndices [i], noData);
-
-        // normalize incoming normals
-        for (int j = 0; j < 4*dim*dim; j += 4){
-          if (noData [j + 3] > .5) {
-            mag = 0.;
-            for (int k = 0; k < 3; ++k){
-              mag += noData [j + k] * noData [j + k];
-            }
-            mag = 1./ static_cast <real> (sqrt (mag));
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= mag;
-            }
-            // rescale normals from [0:1] range to [-1:1]
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= 2.;
-              noData [j + k] -= 1.;
+        // generate texture atlases for coordinate and normal data, unless they were cached
+        vector <GLubyte> &rgbaData = atlases [i];
+        assert (!cached || dims [i] == dim);
+        if (!cached){
+          dims [i] = dim;
+          vector <GLfloat> coData, noData;
+          coData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normalizedVerts, texCoords [i], _faceIndices [i], coData);
+
+          noData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normals, texCoords [i], _faceIndices [i], noData);
+
+          // normalize incoming normals
+          for (int j = 0; j < 4*dim*dim; j += 4){
+            if (noData [j + 3] > .5) {
+              mag = 0.;
+              for (int k = 0; k < 3; ++k){
+                mag += noData [j + k] * noData [j + k];
+              }
+              mag = 1./ static_cast <real> (sqrt (mag));
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= mag;
+              }
+              // rescale normals from [0:1] range to [-1:1]
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= 2.;
+                noData [j + k] -= 1.;
+              }
             }
           }
-        }
 
-        rgbaData.resize (4*dim*dim, 0.);
-        raytraceThroughVolumeb (dim, coData, noData, texture, rgbaData);
-
-        coData.clear ();
-        noData.clear ();
+          rgbaData.resize (4*dim*dim, 0.);
+          raytraceThroughVolumeb (dim, coData, noData, texture, rgbaData, &pool);
+        }
 
         // generate 2D texture atlas containing texture coordinates
         glBindTexture (GL_TEXTURE_2D, _glTextureId [i]);
@@ -1783,16 +3030,23 @@ namespace SF {
         glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, dim, dim, 0, GL_RGBA, GL_UNSIGNED_BYTE, &(rgbaData [0]));
         checkGLError (error);
 
-        rgbaData.clear ();
+        // atlases are kept until they are written to the artifact cache
+        if (!artifacts.isOpen ()){
+          rgbaData.clear ();
+        }
 
         // generate 2D texture coordinate objects
         glBindBuffer (GL_ARRAY_BUFFER, _glTexCoordBufferId [i]);
         checkGLError (error);
-        glBufferData (GL_ARRAY_BUFFER, 2*sizeof (real)*_numSurfaceVertices, &(texCoords [0]), GL_STATIC_DRAW);
+        glBufferData (GL_ARRAY_BUFFER, 2*sizeof (real)*_numSurfaceVertices, &(texCoords [i][0]), GL_STATIC_DRAW);
         checkGLError (error);
 
       } // end - for (unsigned int i = 0; i < _faceIndices.size (); ++i)
 
+      if (!cached && artifacts.isOpen ()){
+        writeTextureAtlases (artifacts, atlasKey, dims, atlases);
+      }
+
       // cleanup
       glBindTexture (GL_TEXTURE_2D, 0);
       glBindBuffer (GL_ARRAY_BUFFER, 0);
@@ -40,7 +40,9 @@ extern "C" {
 
 #include "Preprocess.h"
 #include "aabb.h"
-#include "ThreadControl.h"
+#include "mat4x4.h"
+#include "StageControl.h"
+#include "WorkerPool.h"
 #include "Plugin.h"
 #include "Driver.h"
 #include "Display.h"
@@ -100,6 +102,7 @@ namespace SF {
 	// plugin constructor
 	EXPORT
 	Plugin::Plugin (const string &config, Driver &driver)
+	: _pool (&(driver._pool))
 	{
 		// parse input configuration files
 		vector <string> configFiles;
@@ -141,18 +144,34 @@ namespace SF {
 	void
 	Plugin::synchronize (const string &config, const vector <boost::shared_ptr <Resource > > &resources)
 	{
+	  vector <string> configFiles;
+	  parse (config, configFiles);
 
+	  // register the tool (a rigid body) that activates the fine springs of two-level meshes
+	  Resource *r;
+	  string toolOwner, toolName;
+	  for (unsigned int i = 0; i < configFiles.size () && i < _resources.size (); ++i){
+	    MSD::getConfigParameter (configFiles [i], "tool_name", toolName);
+	    MSD::getConfigParameter (configFiles [i], "tool_owner", toolOwner);
+
+	    if (!toolName.empty () && !toolOwner.empty ()){
+	      for (unsigned int j = 0; j < resources.size (); ++j){
+	        r = resources [j].get ();
+	        if (!r->_name.get ()->compare (toolName) && !r->_owner.get ()->compare (toolOwner)){
+	          dynamic_cast <SF::MSD::Mesh *> (_resources [i].get ())->addTool (r);
+	          break;
+	        }
+	      }
+	    }
+	  }
 	}
 
 	// run method
 	void
 	Plugin::run ()
 	{
-    _threads = new boost::thread [_resources.size ()];
-
     for (unsigned int i = 0; i < _resources.size (); ++i){
-      boost::thread xm (&SF::MSD::Mesh::run, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ()));
-      _threads [i] = boost::move (xm);
+      _pool->spawn (boost::bind (&SF::MSD::Mesh::run, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ())), PHYSICS_STAGE, _resources.at (i).get ());
     }
     PRINT ("libCpuMsd threads started\n");
 	}
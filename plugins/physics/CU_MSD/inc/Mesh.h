@@ -46,7 +46,8 @@ namespace SF {
 
   class aabb;
   class Driver;
-  class ThreadControl;
+  class StageControl;
+  class WorkerPool;
 
 	namespace MSD {
 
@@ -56,13 +57,7 @@ namespace SF {
       aabb _bbox;
 
       /************************ THREADCONTROL RELATED PARAMETERS *************************/
-      ThreadControl _syncControl;
-      int _semPhysicsWaitIndex;
-      int _semPhysicsPostIndex;
-      int _semCollisionWaitIndex;
-      int _semCollisionPostIndex;
-      int _semGraphicsWaitIndex;
-      int _semGraphicsPostIndex;
+      StageControl _syncControl;
 
       /************************ DATA RELATED PARAMETERS *************************/
       unsigned int _numSurfaceVertices;
@@ -207,8 +202,9 @@ namespace SF {
 
       bool initGLForceBufferObjects (const vector <unsigned int> &springs);
       bool initGLBufferObjects (); // initializes non-texture related GL Buffer objects
-      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const Texture3D &texture);
-      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords);
+      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool);
+      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool);
 		};
 	}
 }
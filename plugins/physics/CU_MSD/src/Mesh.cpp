@@ -57,10 +57,11 @@ extern "C" {
 #include "aabb.h"
 #include "GL/common.h"
 #include "GL/texture.h"
+#include "IO/TextReader.h"
 
 #include "CUDA/common.h"
 
-#include "ThreadControl.h"
+#include "StageControl.h"
 #include "Driver.h"
 #include "Display.h"
 
@@ -265,7 +266,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 
 	    // reload program if needed
 	    if (mptr->_glReprogramFlag) {
@@ -396,7 +397,7 @@ namespace SF {
       /*************************** CALCULATION OF FORCES HAPPENS HERE *****************************/
 			calcForces (mptr);
 
-      mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+      mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
     // drawing function textured datasets
@@ -404,7 +405,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 
 	    // reload program if needed
 	    if (mptr->_glReprogramFlag) {
@@ -543,7 +544,7 @@ namespace SF {
       /*************************** CALCULATION OF FORCES HAPPENS HERE *****************************/
 			calcForces (mptr);
 
-	    mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+	    mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
 		// protected constructor and assignment functions
@@ -553,9 +554,7 @@ namespace SF {
 
 		// only legitimate constructor
 		Mesh::Mesh (const string &config, Driver &driver)
-		: _semPhysicsWaitIndex (-1), _semPhysicsPostIndex (-1),
-		  _semGraphicsWaitIndex (-1), _semGraphicsPostIndex (-1),
-		  _numSurfaceVertices (0), _numTotalVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])), _mass (NULL), _numSprings (0),
+		: _numSurfaceVertices (0), _numTotalVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])), _mass (NULL), _numSprings (0),
 		  _past (boost::posix_time::microsec_clock::universal_time ()), _present (boost::posix_time::microsec_clock::universal_time ()),
 		  _glBufferFlag (false), _glTextureFlag (false), _glReprogramFlag (false),
 		  _glNormalFramebufferId (0), _glNormalTexCoordBufferId (0), _glNormalTextureId (0), _glNumFaces (0), _glNormalIndexBufferId (0),
@@ -575,6 +574,9 @@ namespace SF {
 
 			_owner = boost::shared_ptr <string> (new string ("CudaMsd"));
 
+			// store of data derived from the mesh at startup (closed if mesh_cache is "off")
+			ArtifactCache artifacts;
+
 			{
 				string name;
 				if (!getConfigParameter (config, "name", name)){
@@ -619,57 +621,53 @@ namespace SF {
 				// generate file prefix
 				string prefix (folder);
 				prefix.append (name);
+				{
+				  string cacheStr;
+				  getConfigParameter (config, "mesh_cache", cacheStr);
+				  if (cacheStr.compare ("off")){
+				    artifacts.open (folder + "artifacts");
+				  }
+				}
 
 				/*************************** READ NODE (VERTEX) FILE ***************************/
-				int tmpd  [3]; // size 3 because this is used to read triangular elements later
+				int tmpd = 0;
 
 				string file (prefix);
 				file.append (".node");
 
-				FILE* fp = fopen (file.c_str (), "r");
-				assert (fp);
-
-				int status = fscanf (fp, "%d\n", &(tmpd [0]));
-				assert (status != 0);
-				if (tmpd [0] <= 0){
-          PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
+				TextReader reader;
+				if (!reader.open (file) || !reader.read (tmpd) || tmpd <= 0){
+          PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
           exit (EXIT_FAILURE);
 				}
 
-				unsigned int nverts = static_cast <unsigned int> (tmpd [0]);
+				unsigned int nverts = static_cast <unsigned int> (tmpd);
 
-				_vertices [0].reserve (nverts);
 				_vertices [1].reserve (nverts);
 				{
-					real tmpr  [SF_VECTOR_SIZE];
+					real tmpr  [SF_VECTOR_SIZE] = {0.};
 #ifdef SF_VECTOR4_ENABLED
 					tmpr [3] = 1.;
 #endif
-#ifdef SF_DOUBLE_PRECISION
-					status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-					status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-					assert (status != 0);
-					_vertices [0].push_back (vec (tmpr));
+					_vertices [0].resize (nverts, vec (tmpr));
+					for (unsigned int i = 0; i < nverts; ++i){
+						if (!reader.read (_vertices [0][i]._v, 3)){
+              PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+              exit (EXIT_FAILURE);
+						}
+					}
 
-					vec3 min (vec3 (tmpr [0], tmpr [1], tmpr [2]));
+					vec3 min (_vertices [0][0]._v [0], _vertices [0][0]._v [1], _vertices [0][0]._v [2]);
 					vec3 max (min);
 
 					for (unsigned int i = 1; i < nverts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-						status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-						status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-						assert (status != 0);
-						_vertices [0].push_back (vec (tmpr));
+						const real *v = _vertices [0][i]._v;
 						for (int j = 0; j < 3; ++j){
-							if (min._v [j] > tmpr [j]){
-								min._v [j] = tmpr [j];
+							if (min._v [j] > v [j]){
+								min._v [j] = v [j];
 							}
-							else if (max._v [j] < tmpr [j]){
-								max._v [j] = tmpr [j];
+							else if (max._v [j] < v [j]){
+								max._v [j] = v [j];
 							}
 						}
 					}
@@ -681,7 +679,6 @@ namespace SF {
 					}
 					_bbox = aabb (min, max);
 				}
-				fclose (fp);
 
 				_vertices [1] = _vertices [0];
 				_numTotalVertices = _vertices [0].size ();
@@ -690,64 +687,39 @@ namespace SF {
 				file = prefix;
 				file.append (".lm");
 
-				fp = fopen (file.c_str (), "r");
-				assert (fp);
-
-				status = fscanf (fp, "%d\n", &(tmpd [0]));
-				assert (status != 0);
-				if (tmpd [0] <= 0){
-          PRINT ("fatal error: invalid number of vertex masses \'%d\' in %s\n", tmpd [0], file.c_str ());
+				if (!reader.open (file) || !reader.read (tmpd) || tmpd <= 0){
+          PRINT ("fatal error: invalid number of vertex masses \'%d\' in %s\n", tmpd, file.c_str ());
           exit (EXIT_FAILURE);
 				}
 				{
-				  unsigned int nmass = static_cast <unsigned int> (tmpd [0]);
+				  unsigned int nmass = static_cast <unsigned int> (tmpd);
 				  _mass = new real [nmass];
-
-				  for (unsigned int i = 0; i < nmass; ++i){
-#ifdef SF_DOUBLE_PRECISION
-            status = fscanf (fp, "%lf\n", &(_mass [i]));
-#else
-            status = fscanf (fp, "%f\n", &(_mass [i]));
-#endif
-            assert (status != 0);
+				  if (!reader.read (_mass, nmass)){
+            PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+            exit (EXIT_FAILURE);
 				  }
 				}
 
-
-				fclose (fp);
-
 				/*************************** READ EDGE ELEMENT FILES ***************************/
 				{
 					file = prefix;
 					file.append (".edge");
 
-					fp = fopen (file.c_str (), "r");
-					assert (fp);
-
-					int status = fscanf (fp, "%d\n", &(tmpd [0]));
-					assert (status != 0);
-					if (tmpd [0] <= 0){
-		        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
+					if (!reader.open (file) || !reader.read (tmpd) || tmpd <= 0){
+		        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
 		        exit (EXIT_FAILURE);
 					}
 
-#ifndef NDEBUG
-            int vertSize = static_cast <int> (_vertices [0].size ());
-#endif
-
-					_numSprings = static_cast <unsigned int> (tmpd [0]);
+					_numSprings = static_cast <unsigned int> (tmpd);
 
 					vector <unsigned int> springIndices (_numSprings * 2);
-					for (unsigned int i = 0; i < _numSprings; ++i){
-						status = fscanf (fp, "%d %d\n", &(tmpd [0]), &(tmpd [1]));
-						assert (status != 0);
-						assert (tmpd [0] >= 0 && tmpd [0] < vertSize);
-						assert (tmpd [1] >= 0 && tmpd [1] < vertSize);
-						springIndices [2*i] = tmpd [0];
-						springIndices [2*i + 1] = tmpd [1];
+					if (!reader.read (&(springIndices [0]), springIndices.size ())){
+            PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+            exit (EXIT_FAILURE);
+					}
+					for (unsigned int i = 0; i < springIndices.size (); ++i){
+						assert (springIndices [i] < nverts);
 					}
-
-					fclose (fp);
 				}
 
 				/*************************** READ TRIANGULAR ELEMENT FILES ***************************/
@@ -765,40 +737,28 @@ namespace SF {
 					file.append (indexStr);
 					file.append (".tri");
 
-					fp = fopen (file.c_str (), "r");
-					assert (fp);
-
-					status = fscanf (fp, "%d\n", &(tmpd [0]));
-					assert (status != 0);
-          if (tmpd [0] < 0){
-            PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd [0], file.c_str ());
+					tmpd = -1;
+          if (!reader.open (file) || !reader.read (tmpd) || tmpd < 0){
+            PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd, file.c_str ());
             exit (EXIT_FAILURE);
           }
 
-					_numFaces [i] = static_cast <unsigned int> (tmpd [0]);
+					_numFaces [i] = static_cast <unsigned int> (tmpd);
 
 					if (_numFaces [i]){
-						_faceIndices [i].reserve (3*_numFaces [i]);
-#ifndef NDEBUG
-            int vertSize = static_cast <int> (_vertices [0].size ());
-#endif
-
-						for (unsigned int j = 0; j < _numFaces [i]; ++j){
-							status = fscanf (fp, "%d %d %d\n", &(tmpd [0]), &(tmpd [1]), &(tmpd [2]));
-							assert (status != 0);
-							assert (tmpd [0] >= 0 && tmpd [0] < vertSize);
-							assert (tmpd [1] >= 0 && tmpd [1] < vertSize);
-							assert (tmpd [2] >= 0 && tmpd [2] < vertSize);
-							for (int k = 0; k < 3; ++k){
-								_faceIndices [i].push_back (static_cast <unsigned int> (tmpd [k]));
-								if (_numSurfaceVertices < static_cast <unsigned int> (tmpd [k])){
-									_numSurfaceVertices = static_cast <unsigned int> (tmpd [k]);
-								}
+						_faceIndices [i].resize (3*_numFaces [i]);
+						if (!reader.read (&(_faceIndices [i][0]), _faceIndices [i].size ())){
+              PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+              exit (EXIT_FAILURE);
+						}
+						for (unsigned int j = 0; j < _faceIndices [i].size (); ++j){
+							assert (_faceIndices [i][j] < nverts);
+							if (_numSurfaceVertices < _faceIndices [i][j]){
+								_numSurfaceVertices = _faceIndices [i][j];
 							}
 						}
 						_numFaces [i] *= 3;
 					}
-					fclose (fp);
 				} // end - for (unsigned int i = 0; i < numSubmeshes; ++i)
 
 				++_numSurfaceVertices; // this is done because before this _numSurfaceVertices contains biggest index of triangles
@@ -806,75 +766,23 @@ namespace SF {
 
       /*************************** INITIALIZE THREAD CONTROL PARAMETERS ***************************/
       {
-        string mStr;
-        getConfigParameter (config, "num_mutexes", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
+        unsigned int stages = (1u << PHYSICS_STAGE) | (1u << GRAPHICS_STAGE);
 
-        int numMutex = atoi (mStr.c_str ());
-        string msp ("mutex_startval"), msv;
-        for (int i = 0; i < numMutex; ++i){
-          mStr = msp;
-          char indexStr [4];
-          sprintf (indexStr, "%d", i + 1);
-          mStr.append (indexStr);
-
-          getConfigParameter (config, mStr.c_str (), msv);
-          assert (!msv.empty ());
-          for (unsigned int j = 0; j < msv.size (); ++j){
-            assert (isdigit (msv [j]));
-          }
-          _syncControl.push_back (static_cast <unsigned int> (atoi (msv.c_str ())));
-        }
-
-        getConfigParameter (config, "physics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "physics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsPostIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionPostIndex = atoi (mStr.c_str ());
-
-
-        getConfigParameter (config, "graphics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semGraphicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "graphics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (!_syncControl.configure (config, &getConfigParameter, driver._stageGraph, stages)){
+          PRINT ("fatal error: could not set up stages for %s\n", config.c_str ());
+          exit (EXIT_FAILURE);
         }
-        _semGraphicsPostIndex = atoi (mStr.c_str ());
+        assert (_syncControl.has (PHYSICS_STAGE));
       }
 
       /*************************** INITIALIZE OPENGL PARAMETERS ***************************/
 
+      // the CUDA solver works on GL buffers mapped through CUDA-GL interop, so it needs a GL context
+      if (driver._display.get ()->_headless){
+        PRINT ("fatal error: %s cannot run headless (CUDA-GL interop needs a GL context)\n", config.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
       // initialize octant specific GL buffer ID's
       GLuint tmpu = 0;
       _glIndexBufferId.resize (_faceIndices.size (), tmpu);
@@ -913,28 +821,19 @@ namespace SF {
           getConfigParameter (config, "textureinfo", texInfoFile);
           assert (!texInfoFile.empty ());
 
-          FILE *txfp = fopen (texInfoFile.c_str (), "r");
-          assert (txfp);
-          status = fscanf (txfp, "%u %u %u", &(tex3d._dimension [0]), &(tex3d._dimension [1]), &(tex3d._dimension [2]));
-          assert (status != 0);
-          assert (tex3d._dimension [0] > 0 && tex3d._dimension [1] > 0 && tex3d._dimension [2] > 0);
-
-#ifdef SF_DOUBLE_PRECISION
-          status = fscanf (txfp, "%lf %lf %lf\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#else
-          status = fscanf (txfp, "%f %f %f\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#endif
-          assert (status != 0);
-          assert (tex3d._aspectRatio [0] > 0. && tex3d._aspectRatio [1] > 0. && tex3d._aspectRatio [2] > 0.);
-          fclose (txfp);
-
-          unsigned int size = 4*tex3d._dimension [0]*tex3d._dimension [1]*tex3d._dimension [2];
-          tex3d._rgba.resize (size);
-
-          txfp = fopen (texStr.c_str (), "rb");
-          assert (txfp);
-          status = fread (&(tex3d._rgba [0]), sizeof (unsigned char), size, txfp);
-          assert (status != 0);
+          // with texture_cache (megabytes of decoded bricks) the texture is read brick by brick as rays need it
+          size_t cacheBytes = 0;
+          string cacheStr;
+          if (getConfigParameter (config, "texture_cache", cacheStr)){
+            for (unsigned int i = 0; i < cacheStr.length (); ++i){
+              if (!isdigit (cacheStr [i])){
+                PRINT ("fatal error: texture cache %s in %s not a number\n", cacheStr.c_str (), config.c_str ());
+                exit (EXIT_FAILURE);
+              }
+            }
+            cacheBytes = static_cast <size_t> (atoi (cacheStr.c_str ())) << 20;
+          }
+          readTexture3D (texInfoFile, texStr, tex3d, cacheBytes);
           texStr.clear ();
         }
 
@@ -958,7 +857,7 @@ namespace SF {
           }
           scale = static_cast <unsigned int> (atoi (scaleStr.c_str ()));
         }
-        initGLTextureObjects (scale, atlasShader, tex3d);
+        initGLTextureObjects (scale, atlasShader, artifacts, tex3d, driver._pool);
       }
       else {
         string cStr;
@@ -1034,6 +933,7 @@ namespace SF {
         draw = &plainDraw;
       }
       reprogram = &reloadPrograms;
+      _stages = &_syncControl;
 
       /**************************** INITIALIZE GLX RELATED PARAMETERS *****************************/
       _glContext = glXGetCurrentContext ();
@@ -1193,7 +1093,7 @@ namespace SF {
       while (true){
 
         // wait for physics end to get control
-        _syncControl [_semPhysicsWaitIndex].wait ();
+        _syncControl.wait (PHYSICS_STAGE);
 
         // calculate time-differences
         _past = _present;
@@ -1312,7 +1212,7 @@ namespace SF {
         _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
 
         // release data
-        _syncControl [_semPhysicsPostIndex].post ();
+        _syncControl.post (PHYSICS_STAGE);
       }
 		}
 
@@ -1819,7 +1719,7 @@ namespace SF {
 
     // private method to initialize texture-related objects
     bool
-    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const Texture3D &texture)
+    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool)
     {
       // store original number of faces and get three outer rings for each submesh triangles
       {
@@ -1847,41 +1747,15 @@ namespace SF {
         }
       }
 
-      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method
-      vector <vector <vec2> > texCoords (_faceIndices.size (), vector <vec2> (_numSurfaceVertices));
-      for (unsigned int i = 0; i < _faceIndices.size (); ++i){
-        calculateParametricCoordinates (_numSurfaceVertices, _vertices [0], _faceIndices [i], texCoords [i]);
-      }
+      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method (partitions are independent)
+      vector <vector <vec2> > texCoords;
+      uint32_t chartKey = calculateParametricCoordinates (artifacts, _numSurfaceVertices, _vertices [0], _faceIndices, texCoords, pool);
 
       // determine scale factors to be used for rasterizing charts
       vector <real> area2d (_faceIndices.size ());
       {
         // calculate the resolution of surface pixels
-        int first, second;
-        unsigned int numPixels = 0;
-        unsigned int offset1 = 4*texture._dimension[0]*texture._dimension[1];
-        unsigned int offset2 = 4*texture._dimension[0];
-        for (unsigned int i = 0; i < texture._dimension [2]; ++i){
-          for (unsigned int j = 0; j < texture._dimension [1]; ++j){
-            first = -1;
-            second = -1;
-            for (unsigned int k = 0; k < texture._dimension [0]; ++k){
-              if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                first = static_cast <int> (k);
-                break;
-              }
-            }
-            if (first >= 0){
-              for (int k = static_cast <int> (texture._dimension [0]) - 1; k >=0; --k){
-                if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                  second = k;
-                  break;
-                }
-              }
-              numPixels += first < second ? 2 : 1;
-            }
-          }
-        }
+        unsigned int numPixels = countSurfaceTexels (texture);
 
         // calculate scaling factors
         vec te, e1, e2;
@@ -1927,7 +1801,7 @@ namespace SF {
       }
 
       // rasterize each flattened 2D submesh and generate rectangular charts
-      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d, texCoords);
+      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d, texCoords, artifacts, chartKey, pool);
 
       // resize the indices (done to undo the additions made to the indices at the very start of this method)
       for (unsigned int i = 0; i < _faceIndices.size (); ++i){
@@ -1939,29 +1813,40 @@ namespace SF {
 
     // private method to rasterize flattened submeshes
     void
-    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords)
+    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales, vector <vector <vec2> > &texCoords,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool)
     {
-      // scale vertices to account for aspect ratios of the texture dataset
-      //vector <vec> normalizedVerts (_numSurfaceVertices, vec::ZERO);
-      //scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
+      // atlases rasterized before from the same charts, texture and settings are taken from the artifact cache
+      uint32_t atlasKey = artifacts.isOpen () ? textureAtlasKey (chartKey, texture, _bbox, scales, atlasScale, *_glslPrefixString, atlasShader) : 0;
+      vector <int> dims;
+      vector <vector <GLubyte> > atlases;
+      bool cached = artifacts.isOpen () && readTextureAtlases (artifacts, atlasKey, dims, atlases) && dims.size () == _faceIndices.size ();
+      dims.resize (_faceIndices.size ());
+      atlases.resize (_faceIndices.size ());
+
+      vector <vec> normalizedVerts, normals;
+      GLuint program = 0;
+      if (!cached){
+        // scale vertices to account for aspect ratios of the texture dataset
+        //normalizedVerts.resize (_numSurfaceVertices, vec::ZERO);
+        //scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
 
-      vector <vec> normalizedVerts (_vertices [0]);
-      normalizedVerts.resize (_numSurfaceVertices);
+        normalizedVerts.assign (_vertices [0].begin (), _vertices [0].begin () + _numSurfaceVertices);
 
-      // locally calculate normals
-      vector <vec> normals (_numSurfaceVertices, vec::ZERO);
-      calculateVertexNormals (normalizedVerts, _faceIndices, normals);
+        // locally calculate normals
+        normals.resize (_numSurfaceVertices, vec::ZERO);
+        calculateVertexNormals (normalizedVerts, _faceIndices, normals);
 
-      // scale normals so that they go from [-1:1] to [0, 1]
-      for (unsigned int i = 0; i < normals.size (); ++i){
-        normals [i] *= .5;
-        normals [i] += .5;
-      }
+        // scale normals so that they go from [-1:1] to [0, 1]
+        for (unsigned int i = 0; i < normals.size (); ++i){
+          normals [i] *= .5;
+          normals [i] += .5;
+        }
 
-      // load GL shader file
-      GLuint program = 0;
-      initGPUProgram (false, *_glslPrefixString, atlasShader, program);
-      assert (program);
+        // load GL shader file
+        initGPUProgram (false, *_glslPrefixString, atlasShader, program);
+        assert (program);
+      }
 
       // initialize GL texture atlas and texture coordinate objects
       GLenum error;
@@ -2007,39 +1892,40 @@ namespace SF {
           }
         }
 
-        // generate texture atlases for coordinate and normal data
-        vector <GLubyte> rgbaData;
-        vector <GLfloat> coData, noData;
-        coData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normalizedVerts, texCoords [i], _faceIndices [i], coData);
-
-        noData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normals, texCoords [i], _faceIndices [i], noData);
-
-        // normalize incoming normals
-        for (int j = 0; j < 4*dim*dim; j += 4){
-          if (noData [j + 3] > .5) {
-            mag = 0.;
-            for (int k = 0; k < 3; ++k){
-              mag += noData [j + k] * noData [j + k];
-            }
-            mag = 1./ static_cast <real> (sqrt (mag));
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= mag;
-            }
-            // rescale normals from [0:1] range to [-1:1]
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= 2.;
-              noData [j + k] -= 1.;
+        // generate texture atlases for coordinate and normal data, unless they were cached
+        vector <GLubyte> &rgbaData = atlases [i];
+        assert (!cached || dims [i] == dim);
+        if (!cached){
+          dims [i] = dim;
+          vector <GLfloat> coData, noData;
+          coData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normalizedVerts, texCoords [i], _faceIndices [i], coData);
+
+          noData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normals, texCoords [i], _faceIndices [i], noData);
+
+          // normalize incoming normals
+          for (int j = 0; j < 4*dim*dim; j += 4){
+            if (noData [j + 3] > .5) {
+              mag = 0.;
+              for (int k = 0; k < 3; ++k){
+                mag += noData [j + k] * noData [j + k];
+              }
+              mag = 1./ static_cast <real> (sqrt (mag));
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= mag;
+              }
+              // rescale normals from [0:1] range to [-1:1]
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= 2.;
+                noData [j + k] -= 1.;
+              }
             }
           }
-        }
-
-        rgbaData.resize (4*dim*dim, 0);
-        raytraceThroughVolumeb (dim, coData, noData, texture, rgbaData);
 
-        coData.clear ();
-        noData.clear ();
+          rgbaData.resize (4*dim*dim, 0);
+          raytraceThroughVolumeb (dim, coData, noData, texture, rgbaData, &pool);
+        }
 
         // generate 2D texture atlas containing texture coordinates
         glBindTexture (GL_TEXTURE_2D, _glTextureId [i]);
@@ -2051,16 +1937,23 @@ namespace SF {
         glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, dim, dim, 0, GL_RGBA, GL_UNSIGNED_BYTE, &(rgbaData [0]));
         checkGLError (error);
 
-        rgbaData.clear ();
+        // atlases are kept until they are written to the artifact cache
+        if (!artifacts.isOpen ()){
+          rgbaData.clear ();
+        }
 
         // generate 2D texture coordinate objects
         glBindBuffer (GL_ARRAY_BUFFER, _glTexCoordBufferId [i]);
         checkGLError (error);
-        glBufferData (GL_ARRAY_BUFFER, 2*sizeof (real)*_numSurfaceVertices, &(texCoords [0]), GL_STATIC_DRAW);
+        glBufferData (GL_ARRAY_BUFFER, 2*sizeof (real)*_numSurfaceVertices, &(texCoords [i][0]), GL_STATIC_DRAW);
         checkGLError (error);
 
       } // end - for (unsigned int i = 0; i < _faceIndices.size (); ++i)
 
+      if (!cached && artifacts.isOpen ()){
+        writeTextureAtlases (artifacts, atlasKey, dims, atlases);
+      }
+
       // cleanup
       glBindTexture (GL_TEXTURE_2D, 0);
       glBindBuffer (GL_ARRAY_BUFFER, 0);
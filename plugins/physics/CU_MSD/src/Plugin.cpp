@@ -40,7 +40,8 @@ extern "C" {
 
 #include "Preprocess.h"
 #include "aabb.h"
-#include "ThreadControl.h"
+#include "StageControl.h"
+#include "WorkerPool.h"
 #include "Plugin.h"
 #include "Driver.h"
 #include "Display.h"
@@ -100,6 +101,7 @@ namespace SF {
 	// plugin constructor
 	EXPORT
 	Plugin::Plugin (const string &config, Driver &driver)
+	: _pool (&(driver._pool))
 	{
 		// parse input configuration files
 		vector <string> configFiles;
@@ -148,11 +150,8 @@ namespace SF {
 	void
 	Plugin::run ()
 	{
-    _threads = new boost::thread [_resources.size ()];
-
     for (unsigned int i = 0; i < _resources.size (); ++i){
-      boost::thread xm (&SF::MSD::Mesh::run, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ()));
-      _threads [i] = boost::move (xm);
+      _pool->spawn (boost::bind (&SF::MSD::Mesh::run, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ())), PHYSICS_STAGE, _resources.at (i).get ());
     }
     PRINT ("libCudaMsd threads started\n");
 	}
@@ -161,10 +160,11 @@ namespace SF {
 	void
 	Plugin::cleanup ()
 	{
+	  TaskGroup group;
 	  for (unsigned int i = 0; i < _resources.size (); ++i){
-      boost::thread xm (&SF::MSD::Mesh::cleanup, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ()));
-      _threads [i] = boost::move (xm);
+      _pool->submit (boost::bind (&SF::MSD::Mesh::cleanup, dynamic_cast <SF::MSD::Mesh *> (_resources.at (i).get ())), &group, HIGH_PRIORITY);
 	  }
+	  _pool->wait (group);
 	}
 
 }
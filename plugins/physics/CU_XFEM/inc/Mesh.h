@@ -26,6 +26,7 @@
 #include <boost/shared_ptr.hpp>
 
 extern "C" {
+#include <stdint.h>
 #include <GL/glx.h>
 #include <GL/glxext.h>
 #include <cuda.h>
@@ -46,7 +47,9 @@ namespace SF {
 
   class aabb;
   class Driver;
-  class ThreadControl;
+  class StageControl;
+  class BinaryCacheReader;
+  class WorkerPool;
 
   namespace XFE {
 
@@ -59,15 +62,7 @@ namespace SF {
       aabb _bbox;
 
       /************************ THREADCONTROL RELATED PARAMETERS *************************/
-      ThreadControl _syncControl;
-      int _semPhysicsWaitIndex;
-      int _semPhysicsPostIndex;
-      int _semCollisionWaitIndex;
-      int _semCollisionPostIndex;
-      int _semIntersectionWaitIndex;
-      int _semIntersectionPostIndex;
-      int _semGraphicsWaitIndex;
-      int _semGraphicsPostIndex;
+      StageControl _syncControl;
 
       /************************ DATA RELATED PARAMETERS *************************/
       unsigned int _numSurfaceVertices;
@@ -206,9 +201,15 @@ namespace SF {
       Mesh (const Mesh &mesh);
       Mesh & operator = (const Mesh &mesh);
 
+      void readMeshFiles (const string &prefix, unsigned int numSubmeshes, WorkerPool &pool);
+      bool readMeshCache (const BinaryCacheReader &cache, unsigned int numSubmeshes);
+      bool writeMeshCache (const string &file, uint32_t stamp) const;
+      void buildSubmeshes (const string &config, const string &prefix, const BinaryCacheReader *cache, unsigned int first, unsigned int last);
+
       bool initGLBufferObjects (); // initializes non-texture related GL Buffer objects
-      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const Texture3D &texture);
-      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales);
+      bool initGLTextureObjects (unsigned int scale, const string & atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool);
+      void rasterizeCharts (unsigned int atlasScale, const string &shader, const Texture3D &texture, const vector <real> &scales,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool);
     };
 
   }
@@ -23,9 +23,9 @@
 
 #include <vector>
 #include <boost/shared_ptr.hpp>
-#include <boost/threadpool.hpp>
 
 #include "Preprocess.h"
+#include "WorkerPool.h"
 
 #ifdef SF_VECTOR3_ENABLED
 #include "vec3.h"
@@ -40,13 +40,16 @@
 
 using namespace std;
 using namespace boost;
-using namespace boost::threadpool;
 
 namespace SF {
 
-    class ThreadControl;
+    class StageControl;
     class aabb;
 
+  namespace RM {
+    class Mesh;
+  }
+
   namespace XFE {
 
     class PoolJob {
@@ -71,16 +74,16 @@ namespace SF {
     class Scene {
 
       private:
-        // threads
-        pool _pool;
+        // threads (the Driver's shared pool)
+        WorkerPool *_pool;
+        TaskGroup _jobs;
 
         // meshes
         vector <boost::shared_ptr <Mesh> > _mesh;
 
         // cutting tool
-        int _bladeWaitIndex;
-        int _bladePostIndex;
-        ThreadControl *_bladeSyncControl;
+        SF::RM::Mesh *_blade;
+        StageControl *_bladeSyncControl;
 
         aabb _bladeBounds;
         vector <vec> *_bladeCurr;
@@ -94,9 +97,9 @@ namespace SF {
         Scene ();
         ~Scene ();
 
-        inline void resizePool (unsigned int n)
+        inline void setPool (WorkerPool *p)
         {
-          _pool.size_controller ().resize (n);
+          _pool = p;
         }
         inline void addMesh (Resource &r)
         {
@@ -115,6 +118,8 @@ namespace SF {
         void run ();
 
       private:
+        void updateBladeVertices (); // applies current blade pose to its model-space vertices
+
         // private method to update bounding box for blade
         inline void updateBladeBounds ()
         {
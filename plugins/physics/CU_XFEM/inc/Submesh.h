@@ -47,6 +47,9 @@ using namespace boost;
 
 namespace SF {
 
+  class BinaryCacheReader;
+  class BinaryCacheWriter;
+
 	namespace XFE {
 
 	  class Cell;
@@ -54,11 +57,38 @@ namespace SF {
 	  class Edge;
 	  class Partition;
 
+    /**
+     * Sections of the binary topology cache of a mesh. Mesh-wide arrays come
+     * first; the arrays of submesh i follow at cacheSection (i, XFE_CACHE_*).
+     */
+    enum {
+      XFE_CACHE_NODES = 0,
+      XFE_CACHE_BOUNDS,
+      XFE_CACHE_SURFACE,
+      XFE_CACHE_OWNER_COUNTS,
+      XFE_CACHE_OWNERS,
+      XFE_CACHE_SUBMESHES = 16
+    };
+    enum {
+      XFE_CACHE_FACE_INDICES = 0,
+      XFE_CACHE_CELLS,
+      XFE_CACHE_FACES,
+      XFE_CACHE_INSIDE_FACE_INDICES,
+      XFE_CACHE_INSIDE_FACES,
+      XFE_CACHE_EDGES,
+      XFE_CACHE_EDGE_OWNERS,
+      XFE_CACHE_PARTITIONS,
+      XFE_CACHE_SUBMESH_SECTIONS
+    };
+
+    inline unsigned int cacheSection (unsigned int submesh, unsigned int section) { return XFE_CACHE_SUBMESHES + submesh * XFE_CACHE_SUBMESH_SECTIONS + section; }
+
 		class Submesh {
 
 		public:
 			aabb _bbox;
 			unsigned int _myIndex;
+			int _node; // NUMA node whose workers process this submesh (-1 for any)
 			FaceChangeStruct *_changeBit;
 			vector <Partition> _partitions;
 
@@ -139,7 +169,8 @@ namespace SF {
 
 		public:
 			Submesh (const string &config, const string &prefix, unsigned int i, unsigned int maxSurfaceVertexIndex,
-            vector <Vertex> &vi, const FaceChangeStruct &fc, vector <vec> **verts, vector <vec3> *texCoords, vector <unsigned int> &indices);
+            vector <Vertex> &vi, const FaceChangeStruct &fc, vector <vec> **verts, vector <vec3> *texCoords, vector <unsigned int> &indices,
+            bool skipGL = false, const BinaryCacheReader *cache = NULL);
 			~Submesh ();
 
 			inline void plainDraw ()
@@ -175,14 +206,17 @@ namespace SF {
 			}
 
       void updateBounds ();
+      void initGLAttribs (const string &config); // sets up GL buffers (on the thread owning the context) if the constructor skipped them
+      void writeCache (BinaryCacheWriter &cache) const; // adds topology arrays (in partition order) to a mesh's cache
+      void relocate (); // re-allocates topology arrays from the calling thread (NUMA first touch)
 
       void resolveFaces ();
       void getAffectedCells (unsigned int pIndex, vector <vec> &bladeCurr, vector <vec> &bladePrev, vector <unsigned int> &bladeIndices, vector <vec> *bladeNormals [2]);
       void finalizeCollision (unsigned int pIndex, vector <vec> &bladeCurr, vector <vec> &bladePrev, vector <unsigned int> &bladeIndices, vector <vec> *bladeNormals [2]);
 
     private:
-      void reshuffleElements (unsigned int index);
-      void initGLAttribs (const string &config);
+      bool readCache (const BinaryCacheReader &cache);
+      void reshuffleElements (unsigned int index, const vector <unsigned int> &partitionSizes); // partitionSizes empty: split into slabs
 
 		private:
 			Submesh ();
@@ -66,9 +66,8 @@ namespace SF {
             result = string (fname);
             free (fname); fname = NULL;
 
-            // clean up and leave
+            // clean up and leave (the parser itself stays initialized, as submeshes read their settings concurrently)
             xmlFreeDoc (doc);
-            xmlCleanupParser ();
 
             return true;
 					}
@@ -80,7 +79,6 @@ namespace SF {
 
       // clean up and leave
       xmlFreeDoc (doc);
-      xmlCleanupParser ();
 
 			return false;
 		}
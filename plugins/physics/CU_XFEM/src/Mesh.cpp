@@ -20,11 +20,13 @@
  */
 
 #include <cmath>
+#include <cstring>
 
 #include <iostream>
 #include <fstream>
 
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <boost/shared_ptr.hpp>
 
@@ -53,12 +55,14 @@ extern "C" {
 #endif
 
 #include "aabb.h"
+#include "BinaryCache.h"
 #include "GL/common.h"
 #include "GL/texture.h"
+#include "IO/TextReader.h"
 
 #include "CUDA/common.h"
 
-#include "ThreadControl.h"
+#include "StageControl.h"
 #include "Driver.h"
 #include "Display.h"
 
@@ -79,6 +83,98 @@ namespace SF {
 
 	  static int GLX_ATTRIBUTE_LIST [] = {GLX_RGBA, None};
 
+    // binary topology cache: content version (section ids are in Submesh.h)
+    static const uint32_t XFE_CACHE_KIND = 0x58464501; // "XFE" version 1
+
+    // static method to read a file of triangles (run on the pool); maxIndex gets the largest vertex index
+    static void
+    readTriangleFile (const string &file, vector <unsigned int> *indices, unsigned int *maxIndex)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = -1;
+      if (!reader.read (tmpd) || tmpd < 0){
+        PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      indices->resize (3*static_cast <unsigned int> (tmpd));
+      *maxIndex = 0;
+      if (indices->empty ()){
+        return;
+      }
+      if (!reader.read (&((*indices) [0]), indices->size ())){
+        PRINT ("fatal error: %s is truncated or holds a negative vertex index\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      *maxIndex = *max_element (indices->begin (), indices->end ());
+    }
+
+    // static method to read the owner cells of every vertex (run on the pool)
+    static void
+    readOwnerFile (const string &file, unsigned int numSubmeshes, vector <Vertex> *vertexInfo)
+    {
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+
+      int tmpd = 0;
+      if (!reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      unsigned int nverts = static_cast <unsigned int> (tmpd);
+      vertexInfo->resize (nverts);
+
+      unsigned int nElems;
+      vector <unsigned int> elems;
+      vector <unsigned int> subNums (numSubmeshes);
+      for (unsigned int i = 0; i < nverts; ++i){
+
+        fill (subNums.begin (), subNums.end (), 0u);
+        if (!reader.read (nElems)){
+          PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+        nElems *= 2;
+        elems.resize (nElems);
+        if (nElems && !reader.read (&(elems [0]), nElems)){
+          PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+          exit (EXIT_FAILURE);
+        }
+        for (unsigned int j = 0; j < nElems; j += 2){
+          if (elems [j] >= numSubmeshes){
+            PRINT ("fatal error: invalid submesh %u in %s\n", elems [j], file.c_str ());
+            exit (EXIT_FAILURE);
+          }
+          ++subNums [elems [j]];
+        }
+        for (unsigned int j = 0; j < numSubmeshes; ++j){
+          if (subNums [j]){
+            (*vertexInfo) [i].allocateSubmeshSpace (j, subNums [j]);
+          }
+        }
+        for (unsigned int j = 0; j < nElems; j += 2){
+          (*vertexInfo) [i].addOwner (elems [j], elems [j + 1]);
+        }
+      }
+    }
+
+    // static method to get the outer face rings of submeshes [first, last) (run on the pool)
+    static void
+    getFaceRingRange (const vector <vector <unsigned int> > *faceIndices, vector <vector <unsigned int> > *rings, unsigned int first, unsigned int last)
+    {
+      for (unsigned int i = first; i < last; ++i){
+        getFaceRings (i, *faceIndices, (*rings) [i]);
+      }
+    }
+
 	  // static function to reload GPU programs
 	  static void reloadPrograms (Resource & r)
 	  {
@@ -190,7 +286,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 
 	    // reload program if needed
 	    if (mptr->_glReprogramFlag) {
@@ -359,7 +455,7 @@ namespace SF {
       }
       glUseProgram (0);
 
-      mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+      mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
     // drawing function textured datasets
@@ -367,7 +463,7 @@ namespace SF {
 	  {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 /******************************************************************************************************
 	    glXMakeCurrent (mptr->_glDisplay, mptr->_glDrawable, mptr->_glContext);
 /******************************************************************************************************/
@@ -583,7 +679,7 @@ namespace SF {
 
       glUseProgram (0);
 
-	    mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+	    mptr->_syncControl.post (GRAPHICS_STAGE);
 	  }
 
 		// protected constructor and assignment functions
@@ -593,10 +689,7 @@ namespace SF {
 
 		// only legitimate constructor
 		Mesh::Mesh (const string &config, Driver &driver)
-		: _semPhysicsWaitIndex (-1), _semPhysicsPostIndex (-1),
-		  _semIntersectionWaitIndex (-1), _semIntersectionPostIndex (-1),
-		  _semGraphicsWaitIndex (-1), _semGraphicsPostIndex (-1),
-		  _numSurfaceVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])), _numCells (0),
+		: _numSurfaceVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])), _numCells (0),
 		  _present (clock ()), _past (clock ()), _deltaT (0.), _deltaTminus1 (0.),
 		  _glBufferFlag (false), _glTextureFlag (false), _glReprogramFlag (false),
 		  _glNormalFramebufferId (0), _glNormalTexCoordBufferId (0), _glNormalTextureId (0), _glNumFaces (0), _glNormalIndexBufferId (0),
@@ -618,9 +711,33 @@ namespace SF {
 
 			_owner = boost::shared_ptr <string> (new string ("CudaXfem"));
 
-#ifndef SF_NO_PRINT
-			unsigned int numTotalFaces = 0;
-#endif
+			// the 3D texture (if any) is read on the pool while the mesh is loaded
+			Texture3D tex3d;
+			TaskGroup textureLoad;
+			string texStr;
+			getConfigParameter (config, "texture", texStr);
+			if (!texStr.empty ()){
+				string texInfoFile;
+				getConfigParameter (config, "textureinfo", texInfoFile);
+				assert (!texInfoFile.empty ());
+				// with texture_cache (megabytes of decoded bricks) the texture is read brick by brick as rays need it
+				size_t cacheBytes = 0;
+				string cacheStr;
+				if (getConfigParameter (config, "texture_cache", cacheStr)){
+				  for (unsigned int i = 0; i < cacheStr.length (); ++i){
+				    if (!isdigit (cacheStr [i])){
+				      PRINT ("fatal error: texture cache %s in %s not a number\n", cacheStr.c_str (), config.c_str ());
+				      exit (EXIT_FAILURE);
+				    }
+				  }
+				  cacheBytes = static_cast <size_t> (atoi (cacheStr.c_str ())) << 20;
+				}
+				driver._pool.submit (boost::bind (&readTexture3D, texInfoFile, texStr, boost::ref (tex3d), cacheBytes), &textureLoad);
+			}
+
+			// store of data derived from the mesh at startup (closed if mesh_cache is "off")
+			ArtifactCache artifacts;
+
 			{
 				string name;
 				if (!getConfigParameter (config, "name", name)){
@@ -666,269 +783,85 @@ namespace SF {
 				string prefix (folder);
 				prefix.append (name);
 
-				/*************************** READ NODE (VERTEX) AND OWNER INFO FILE ***************************/
-				int tmpd  [3]; // size 3 because this is used to read triangular elements later
-
-				string file (prefix);
-				file.append (".node");
-
-				FILE* fp = fopen (file.c_str (), "r");
-				assert (fp);
-
-				int status = fscanf (fp, "%d\n", &(tmpd [0]));
-				assert (status != 0);
-				if (tmpd [0] <= 0){
-          PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
-          exit (EXIT_FAILURE);
-				}
-
-				unsigned int nverts = static_cast <unsigned int> (tmpd [0]);
-
-				_vertices [0].reserve (nverts);
-				_vertices [1].reserve (nverts);
-				{
-					real tmpr  [SF_VECTOR_SIZE];
-#ifdef SF_VECTOR4_ENABLED
-					tmpr [3] = 1.;
-#endif
-#ifdef SF_DOUBLE_PRECISION
-					status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-					status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-					assert (status != 0);
-					_vertices [0].push_back (vec (tmpr));
-
-					vec3 min (vec3 (tmpr [0], tmpr [1], tmpr [2]));
-					vec3 max (min);
-
-					for (unsigned int i = 1; i < nverts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-						status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-						status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-						assert (status != 0);
-						_vertices [0].push_back (vec (tmpr));
-						for (int j = 0; j < 3; ++j){
-							if (min._v [j] > tmpr [j]){
-								min._v [j] = tmpr [j];
-							}
-							else if (max._v [j] < tmpr [j]){
-								max._v [j] = tmpr [j];
-							}
-						}
+				/*************************** READ MESH DATA ***************************/
+				// text sources, stamped in this order for the binary cache (the configuration fixes the partitioning)
+				vector <string> files;
+				files.push_back (config);
+				files.push_back (prefix + ".node");
+				files.push_back (prefix + ".node.own");
+				for (unsigned int i = 0; i < numSubmeshes; ++i){
+					char indexStr [16];
+					sprintf (indexStr, ".%u", i);
+					string subPrefix (prefix + indexStr);
+					files.push_back (subPrefix + ".trio.ele");
+					files.push_back (subPrefix + ".trio.own");
+					files.push_back (subPrefix + ".trii.ele");
+					if (!access ((subPrefix + ".trii.own").c_str (), F_OK)){
+						files.push_back (subPrefix + ".trii.own");
 					}
-					for (int j = 0; j < 3; ++j){
-            min._v [j] -= .05;
+					files.push_back (subPrefix + ".tet.ele");
+					files.push_back (subPrefix + ".tet.top");
+					if (!access ((subPrefix + ".tet.part").c_str (), F_OK)){
+						files.push_back (subPrefix + ".tet.part");
 					}
-					for (int j = 0; j < 3; ++j){
-            max._v [j] += .05;
-					}
-					_bbox = aabb (min, max);
+					files.push_back (subPrefix + ".edge.ele");
+					files.push_back (subPrefix + ".edge.top");
 				}
-				fclose (fp);
 
-				_vertices [1] = _vertices [0];
-
-				file.append (".own");
-				_vertexInfo.resize (_vertices [0].size ());
-
-				fp = fopen (file.c_str (), "r");
-				assert (fp);
-				{
-				  status = fscanf (fp, "%d\n", &(tmpd [0]));
-				  assert (status);
-          if (tmpd [0] <= 0){
-            PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd [0], file.c_str ());
-            exit (EXIT_FAILURE);
-          }
-          assert (nverts == static_cast <unsigned int> (tmpd [0]));
-
-          unsigned int nElems, *elems;
-          unsigned int *subNums = new unsigned int [numSubmeshes];
-          for (unsigned int i = 0; i < nverts; ++i){
-
-            for (unsigned int j = 0; j < numSubmeshes; ++j){
-              subNums [j] = 0;
-            }
-            status = fscanf (fp, "%u", &nElems);
-            assert (status);
-            nElems *= 2;
-            elems = new unsigned int [nElems];
-            for (unsigned int j = 0; j < nElems; j += 2){
-              status = fscanf (fp, "%u %u", &(elems [j]), &(elems [j + 1]));
-              assert (status);
-            }
-            for (unsigned int j = 0; j < nElems; j += 2){
-              ++subNums [elems [j]];
-            }
-            for (unsigned int j = 0; j < numSubmeshes; ++j){
-              if (subNums [j]){
-                _vertexInfo [i].allocateSubmeshSpace (j, subNums [j]);
-              }
-            }
-            for (unsigned int j = 0; j < nElems; j += 2){
-              _vertexInfo [i].addOwner (elems [j], elems [j + 1]);
-            }
-            delete [] elems;
-          }
-          delete [] subNums;
-          fclose (fp);
+				// binary cache is on unless mesh_cache is "off"
+				string cacheStr;
+				getConfigParameter (config, "mesh_cache", cacheStr);
+				uint32_t stamp = 0;
+				bool useCache = cacheStr.compare ("off") && sourceStamp (files, stamp);
+				if (cacheStr.compare ("off")){
+					artifacts.open (folder + "artifacts");
 				}
 
-				/*************************** READ TRIANGULAR ELEMENT FILES AND POPULATE SUBMESHES ***************************/
-				_numFaces.resize (numSubmeshes, 0);
-				_faceIndices.resize (numSubmeshes, vector <unsigned int> ());
-
-				for (unsigned int i = 0; i < numSubmeshes; ++i){
-
-					// generate file name
-					file = prefix;
-					file.append (".");
-
-					char indexStr [4];
-					sprintf (indexStr, "%u", i);
-					file.append (indexStr);
-					file.append (".trio.ele");
-
-					fp = fopen (file.c_str (), "r");
-					assert (fp);
-
-					status = fscanf (fp, "%d\n", &(tmpd [0]));
-					assert (status != 0);
-          if (tmpd [0] < 0){
-            PRINT ("fatal error: invalid number of elements \'%d\' in %s\n", tmpd [0], file.c_str ());
-            exit (EXIT_FAILURE);
-          }
-
-					_numFaces [i] = static_cast <unsigned int> (tmpd [0]);
+				string cacheFile (prefix);
+				cacheFile.append (".xfe.cache");
+				BinaryCacheReader cache;
+				bool cached = useCache && cache.open (cacheFile, XFE_CACHE_KIND, stamp) && readMeshCache (cache, numSubmeshes);
+				if (!cached){
+					readMeshFiles (prefix, numSubmeshes, driver._pool);
+				}
+				_vertices [1] = _vertices [0];
 
-					if (_numFaces [i]){
-						_faceIndices [i].reserve (3*_numFaces [i]);
-#ifndef NDEBUG
-            int vertSize = static_cast <int> (_vertices [0].size ());
-#endif
+				// initialize submeshes and needed substructures (each reads its own files, so they are built on the pool)
+				_faceChangeBits.resize (numSubmeshes, FaceChangeStruct ());
 
-						for (unsigned int j = 0; j < _numFaces [i]; ++j){
-							status = fscanf (fp, "%d %d %d\n", &(tmpd [0]), &(tmpd [1]), &(tmpd [2]));
-							assert (status != 0);
-							assert (tmpd [0] >= 0 && tmpd [0] < vertSize);
-							assert (tmpd [1] >= 0 && tmpd [1] < vertSize);
-							assert (tmpd [2] >= 0 && tmpd [2] < vertSize);
-							for (int k = 0; k < 3; ++k){
-								_faceIndices [i].push_back (static_cast <unsigned int> (tmpd [k]));
-								if (_numSurfaceVertices < static_cast <unsigned int> (tmpd [k])){
-									_numSurfaceVertices = static_cast <unsigned int> (tmpd [k]);
-								}
-							}
-						}
+				_submesh.resize (numSubmeshes);
+				driver._pool.parallelFor (0, numSubmeshes, boost::bind (&Mesh::buildSubmeshes, this, boost::cref (config), boost::cref (prefix),
+				                                                        cached ? &cache : NULL, _1, _2), 1);
 
-	#ifndef SF_NO_PRINT
-						numTotalFaces += _numFaces.at (i);
-	#endif
-						_numFaces [i] *= 3;
+				// GL buffers of the submeshes can only be created from this thread
+				if (!driver._display.get ()->_headless){
+					for (unsigned int i = 0; i < numSubmeshes; ++i){
+						_submesh [i]->initGLAttribs (config);
 					}
-					fclose (fp);
-				} // end - for (unsigned int i = 0; i < numSubmeshes; ++i)
-
-				++_numSurfaceVertices; // this is done because before this _numSurfaceVertices contains biggest index of triangles
-
-				// initialize submeshes and needed substructures
-				_faceChangeBits.resize (numSubmeshes, FaceChangeStruct ());
+				}
 
-				_submesh.reserve (numSubmeshes);
-				for (unsigned int i = 0; i < numSubmeshes; ++i){
-					_submesh.push_back (boost::shared_ptr <Submesh> (new Submesh (config, prefix, i, _numSurfaceVertices - 1, _vertexInfo,
-                                                                   _faceChangeBits [i], &_curr, &_texCoords3D, _faceIndices [i])));
+				// the cache holds the topology after submeshes reordered it, so later runs skip both parsing and reordering
+				if (useCache && !cached && writeMeshCache (cacheFile, stamp)){
+					PRINT ("wrote topology cache %s\n", cacheFile.c_str ());
 				}
-				assert (_submesh.size () == numSubmeshes);
 			}
 
       /*************************** INITIALIZE THREAD CONTROL PARAMETERS ***************************/
       {
-        string mStr;
-        getConfigParameter (config, "num_mutexes", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-
-        int numMutex = atoi (mStr.c_str ());
-        string msp ("mutex_startval"), msv;
-        for (int i = 0; i < numMutex; ++i){
-          mStr = msp;
-          char indexStr [4];
-          sprintf (indexStr, "%d", i + 1);
-          mStr.append (indexStr);
-
-          getConfigParameter (config, mStr.c_str (), msv);
-          assert (!msv.empty ());
-          for (unsigned int j = 0; j < msv.size (); ++j){
-            assert (isdigit (msv [j]));
-          }
-          _syncControl.push_back (static_cast <unsigned int> (atoi (msv.c_str ())));
-        }
-
-        getConfigParameter (config, "physics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "physics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsPostIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionPostIndex = atoi (mStr.c_str ());
+        unsigned int stages = (1u << PHYSICS_STAGE) | (1u << INTERSECTION_STAGE) | (1u << GRAPHICS_STAGE);
 
-        getConfigParameter (config, "intersection_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semIntersectionWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "intersection_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semIntersectionPostIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "graphics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semGraphicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "graphics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (unsigned int i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (!_syncControl.configure (config, &getConfigParameter, driver._stageGraph, stages)){
+          PRINT ("fatal error: could not set up stages for %s\n", config.c_str ());
+          exit (EXIT_FAILURE);
         }
-        _semGraphicsPostIndex = atoi (mStr.c_str ());
+        assert (_syncControl.has (PHYSICS_STAGE));
       }
 
       /*************************** INITIALIZE OPENGL PARAMETERS ***************************/
 
+      // without a GL context (headless run) only the physics state is set up
+      bool headless = driver._display.get ()->_headless;
+
       // initialize octant specific GL buffer ID's
       _glIndexBufferId.reserve (_submesh.size ());
       _glTexCoordBufferId.reserve (_submesh.size ());
@@ -955,53 +888,20 @@ namespace SF {
         _glProgram [i] = 0;
       }
 
-      string texStr;
-      getConfigParameter (config, "texture", texStr);
+      driver._pool.wait (textureLoad);
 
       if (!texStr.empty ()) {
 
         // initialize texture-related variables
         _glTextureFlag = true;
 
-        Texture3D tex3d;
-        int status = 0;
-
-        // load and read 3D texture file
-        {
-          string texInfoFile;
-          getConfigParameter (config, "textureinfo", texInfoFile);
-          assert (!texInfoFile.empty ());
-
-          FILE *txfp = fopen (texInfoFile.c_str (), "r");
-          assert (txfp);
-          status = fscanf (txfp, "%u %u %u", &(tex3d._dimension [0]), &(tex3d._dimension [1]), &(tex3d._dimension [2]));
-          assert (status != 0);
-          assert (tex3d._dimension [0] > 0 && tex3d._dimension [1] > 0 && tex3d._dimension [2] > 0);
-
-#ifdef SF_DOUBLE_PRECISION
-          status = fscanf (txfp, "%lf %lf %lf\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#else
-          status = fscanf (txfp, "%f %f %f\n", &(tex3d._aspectRatio [0]), &(tex3d._aspectRatio [1]), &(tex3d._aspectRatio [2]));
-#endif
-          assert (status != 0);
-          assert (tex3d._aspectRatio [0] > 0. && tex3d._aspectRatio [1] > 0. && tex3d._aspectRatio [2] > 0.);
-          fclose (txfp);
-
-          unsigned int size = 4*tex3d._dimension [0]*tex3d._dimension [1]*tex3d._dimension [2];
-          tex3d._rgba.resize (size);
-
-          txfp = fopen (texStr.c_str (), "rb");
-          assert (txfp);
-          status = fread (&(tex3d._rgba [0]), sizeof (unsigned char), size, txfp);
-          assert (status != 0);
-          texStr.clear ();
-        }
-
         // initialize 3D vertex texture coordinates (is properly populated in initTextureAtlas (..) function)
         _texCoords3D.resize (_vertices [0].size (), vec3 (2., 2., 2.));
 
         // initialize non-texture related buffers
-        initGLBufferObjects ();
+        if (!headless){
+          initGLBufferObjects ();
+        }
 
         // initialize texture-related objects
         string atlasShader;
@@ -1020,7 +920,9 @@ namespace SF {
           }
           scale = static_cast <unsigned int> (atoi (scaleStr.c_str ()));
         }
-        initGLTextureObjects (scale, atlasShader, tex3d);
+        if (!headless){
+          initGLTextureObjects (scale, atlasShader, artifacts, tex3d, driver._pool);
+        }
       }
       else {
         string cStr;
@@ -1057,11 +959,15 @@ namespace SF {
           }
         }
 
-        initGLBufferObjects ();
+        if (!headless){
+          initGLBufferObjects ();
+        }
       }
 
       // initialize GPU programs and update view volume
-      initGPUPrograms ();
+      if (!headless){
+        initGPUPrograms ();
+      }
 
       GL_Window *disp = driver._display.get ();
       if (_glNumLights){
@@ -1096,6 +1002,7 @@ namespace SF {
         draw = &plainDraw;
       }
       reprogram = &reloadPrograms;
+      _stages = &_syncControl;
 
       /*************************** INITIALIZE GLX RELATED PARAMETERS ***************************
       _glContext = glXGetCurrentContext ();
@@ -1112,6 +1019,198 @@ namespace SF {
 
 		} // end - Mesh::Mesh (const string &config, Driver &driver)
 
+		// private method to read vertices, vertex owners and outside faces from text files (face files are read on the pool)
+		void
+		Mesh::readMeshFiles (const string &prefix, unsigned int numSubmeshes, WorkerPool &pool)
+		{
+			/*************************** READ TRIANGULAR ELEMENT AND OWNER FILES (ON THE POOL) ***************************/
+			// these files are independent, so workers read them while this thread reads the vertices
+			_numFaces.resize (numSubmeshes, 0);
+			_faceIndices.resize (numSubmeshes, vector <unsigned int> ());
+			vector <unsigned int> maxIndices (numSubmeshes, 0);
+
+			TaskGroup faceLoad;
+			for (unsigned int i = 0; i < numSubmeshes; ++i){
+				char fileStr [32];
+				sprintf (fileStr, ".%u.trio.ele", i);
+				pool.submit (boost::bind (&readTriangleFile, prefix + fileStr, &(_faceIndices [i]), &(maxIndices [i])), &faceLoad);
+			}
+			pool.submit (boost::bind (&readOwnerFile, prefix + ".node.own", numSubmeshes, &_vertexInfo), &faceLoad);
+
+			/*************************** READ NODE (VERTEX) FILE ***************************/
+			string file (prefix);
+			file.append (".node");
+
+			TextReader reader;
+			if (!reader.open (file)){
+          PRINT ("fatal error: could not open %s\n", file.c_str ());
+          exit (EXIT_FAILURE);
+			}
+
+			int tmpd = 0;
+			if (!reader.read (tmpd) || tmpd <= 0){
+          PRINT ("fatal error: invalid number of vertices \'%d\' in %s\n", tmpd, file.c_str ());
+          exit (EXIT_FAILURE);
+			}
+
+			unsigned int nverts = static_cast <unsigned int> (tmpd);
+
+			_vertices [1].reserve (nverts);
+			{
+				real tmpr  [SF_VECTOR_SIZE] = {0.};
+#ifdef SF_VECTOR4_ENABLED
+				tmpr [3] = 1.;
+#endif
+				_vertices [0].resize (nverts, vec (tmpr));
+				for (unsigned int i = 0; i < nverts; ++i){
+					if (!reader.read (_vertices [0][i]._v, 3)){
+            PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+            exit (EXIT_FAILURE);
+					}
+				}
+
+				vec3 min (_vertices [0][0]._v [0], _vertices [0][0]._v [1], _vertices [0][0]._v [2]);
+				vec3 max (min);
+
+				for (unsigned int i = 1; i < nverts; ++i){
+					const real *v = _vertices [0][i]._v;
+					for (int j = 0; j < 3; ++j){
+						if (min._v [j] > v [j]){
+							min._v [j] = v [j];
+						}
+						else if (max._v [j] < v [j]){
+							max._v [j] = v [j];
+						}
+					}
+				}
+				for (int j = 0; j < 3; ++j){
+            min._v [j] -= .05;
+				}
+				for (int j = 0; j < 3; ++j){
+            max._v [j] += .05;
+				}
+				_bbox = aabb (min, max);
+			}
+
+			/*************************** COLLECT TRIANGULAR ELEMENT AND OWNER FILES ***************************/
+			pool.wait (faceLoad);
+
+			if (_vertexInfo.size () != nverts){
+        PRINT ("fatal error: owner file of %s lists %u vertices instead of %u\n", prefix.c_str (), static_cast <unsigned int> (_vertexInfo.size ()), nverts);
+        exit (EXIT_FAILURE);
+			}
+
+			for (unsigned int i = 0; i < numSubmeshes; ++i){
+				if (!_faceIndices [i].empty () && maxIndices [i] >= nverts){
+          PRINT ("fatal error: vertex index %u of submesh %u out of range\n", maxIndices [i], i);
+          exit (EXIT_FAILURE);
+				}
+				_numFaces [i] = static_cast <unsigned int> (_faceIndices [i].size ());
+				if (_numSurfaceVertices < maxIndices [i]){
+					_numSurfaceVertices = maxIndices [i];
+				}
+			}
+			++_numSurfaceVertices; // this is done because before this _numSurfaceVertices contains biggest index of triangles
+		}
+
+		// private method to construct submeshes [first, last) without GL buffers (run on the pool)
+		void
+		Mesh::buildSubmeshes (const string &config, const string &prefix, const BinaryCacheReader *cache, unsigned int first, unsigned int last)
+		{
+		  for (unsigned int i = first; i < last; ++i){
+		    _submesh [i] = boost::shared_ptr <Submesh> (new Submesh (config, prefix, i, _numSurfaceVertices - 1, _vertexInfo,
+		                                                             _faceChangeBits [i], &_curr, &_texCoords3D, _faceIndices [i], true, cache));
+		  }
+		}
+
+		/**
+		 * Private method to read vertices, vertex owners and outside faces from
+		 * the binary cache. Returns false (leaving the mesh untouched) if any
+		 * section is missing or inconsistent.
+		 */
+		bool
+		Mesh::readMeshCache (const BinaryCacheReader &cache, unsigned int numSubmeshes)
+		{
+		  vector <vec> vertices, bounds;
+		  vector <unsigned int> surface, ownerCounts;
+		  const unsigned int *owners = NULL;
+		  size_t numOwners = 0;
+		  if (!cache.get (XFE_CACHE_NODES, vertices) || !cache.get (XFE_CACHE_BOUNDS, bounds) || !cache.get (XFE_CACHE_SURFACE, surface)
+		      || !cache.get (XFE_CACHE_OWNER_COUNTS, ownerCounts) || !cache.get (XFE_CACHE_OWNERS, owners, numOwners)
+		      || bounds.size () != 2 || surface.size () != 1 || ownerCounts.size () != vertices.size ()){
+		    return false;
+		  }
+
+		  vector <vector <unsigned int> > faceIndices (numSubmeshes, vector <unsigned int> ());
+		  for (unsigned int i = 0; i < numSubmeshes; ++i){
+		    if (!cache.get (cacheSection (i, XFE_CACHE_FACE_INDICES), faceIndices [i])){
+		      return false;
+		    }
+		  }
+
+		  // owner lists are stored back to back as (submesh, length, cells...), ownerCounts [i] lists per vertex
+		  vector <Vertex> vertexInfo (vertices.size ());
+		  size_t o = 0;
+		  for (unsigned int i = 0; i < vertexInfo.size (); ++i){
+		    for (unsigned int j = 0; j < ownerCounts [i]; ++j){
+		      if (o + 2 > numOwners || owners [o] >= numSubmeshes || owners [o + 1] < 2 || o + owners [o + 1] > numOwners){
+		        return false;
+		      }
+		      vertexInfo [i].allocateSubmeshSpace (owners [o], owners [o + 1] - 2);
+		      memcpy (vertexInfo [i]._owners [j], owners + o, sizeof (unsigned int) * owners [o + 1]);
+		      o += owners [o + 1];
+		    }
+		  }
+		  if (o != numOwners){
+		    return false;
+		  }
+
+		  _vertices [0].swap (vertices);
+		  _bbox = aabb (bounds [0], bounds [1]);
+		  _numSurfaceVertices = surface [0];
+
+		  // Vertex owns raw arrays, so the list is moved element by element instead of copied
+		  _vertexInfo.resize (vertexInfo.size ());
+		  for (unsigned int i = 0; i < vertexInfo.size (); ++i){
+		    swap (_vertexInfo [i]._numSubmeshes, vertexInfo [i]._numSubmeshes);
+		    swap (_vertexInfo [i]._owners, vertexInfo [i]._owners);
+		  }
+
+		  _faceIndices.swap (faceIndices);
+		  _numFaces.resize (numSubmeshes, 0);
+		  for (unsigned int i = 0; i < numSubmeshes; ++i){
+		    _numFaces [i] = static_cast <unsigned int> (_faceIndices [i].size ());
+		  }
+		  return true;
+		}
+
+		// private method to write the topology just built from text (and reordered by the submeshes) to the binary cache
+		bool
+		Mesh::writeMeshCache (const string &file, uint32_t stamp) const
+		{
+		  BinaryCacheWriter cache;
+		  cache.add (XFE_CACHE_NODES, _vertices [0]);
+		  cache.add (XFE_CACHE_BOUNDS, _bbox._v, 2);
+		  cache.add (XFE_CACHE_SURFACE, &_numSurfaceVertices, 1);
+
+		  vector <unsigned int> ownerCounts, owners;
+		  ownerCounts.reserve (_vertexInfo.size ());
+		  for (unsigned int i = 0; i < _vertexInfo.size (); ++i){
+		    ownerCounts.push_back (_vertexInfo [i]._numSubmeshes);
+		    for (unsigned int j = 0; j < _vertexInfo [i]._numSubmeshes; ++j){
+		      owners.insert (owners.end (), _vertexInfo [i]._owners [j], _vertexInfo [i]._owners [j] + _vertexInfo [i]._owners [j][1]);
+		    }
+		  }
+		  cache.copy (XFE_CACHE_OWNER_COUNTS, ownerCounts);
+		  cache.copy (XFE_CACHE_OWNERS, owners);
+
+		  for (unsigned int i = 0; i < _submesh.size (); ++i){
+		    cache.add (cacheSection (i, XFE_CACHE_FACE_INDICES), _faceIndices [i]);
+		    _submesh [i]->writeCache (cache);
+		  }
+		  return cache.write (file, XFE_CACHE_KIND, stamp);
+		}
+
     // destructor method
     Mesh::~Mesh ()
     {
@@ -1189,7 +1288,7 @@ namespace SF {
       while (true) {
 
         // wait for physics end to get control
-        _syncControl [_semPhysicsWaitIndex].wait ();
+        _syncControl.wait (PHYSICS_STAGE);
 
         /*
       // push cuda context into stack
@@ -1236,7 +1335,7 @@ namespace SF {
         _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
 
         // release data
-        _syncControl [_semPhysicsPostIndex].post ();
+        _syncControl.post (PHYSICS_STAGE);
       }
     }
 
@@ -1805,7 +1904,7 @@ namespace SF {
 
     // private method to initialize texture-related objects
     bool
-    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const Texture3D &texture)
+    Mesh::initGLTextureObjects (unsigned int atlasScaleFactor, const string &atlasShader, const ArtifactCache &artifacts, const Texture3D &texture, WorkerPool &pool)
     {
       // store original number of faces and get three outer rings for each submesh triangles
       {
@@ -1813,9 +1912,7 @@ namespace SF {
         extraFaces.reserve (_faceIndices.size ());
         extraFaces.resize (_faceIndices.size ());
 
-        for (unsigned int i = 0; i < extraFaces.size (); ++i){
-          getFaceRings (i, _faceIndices, extraFaces [i]);
-        }
+        pool.parallelFor (0, extraFaces.size (), boost::bind (&getFaceRingRange, &_faceIndices, &extraFaces, _1, _2), 1);
         for (unsigned int i = 0; i < extraFaces.size (); ++i){
           for (unsigned int j = 0; j < extraFaces [i].size (); ++j){
             _faceIndices [i].push_back (extraFaces [i][j]);
@@ -1823,9 +1920,7 @@ namespace SF {
           extraFaces [i].clear ();
         }
 
-        for (unsigned int i = 0; i < extraFaces.size (); ++i){
-          getFaceRings (i, _faceIndices, extraFaces [i]);
-        }
+        pool.parallelFor (0, extraFaces.size (), boost::bind (&getFaceRingRange, &_faceIndices, &extraFaces, _1, _2), 1);
         for (unsigned int i = 0; i < extraFaces.size (); ++i){
           for (unsigned int j = 0; j < extraFaces [i].size (); ++j){
             _faceIndices [i].push_back (extraFaces [i][j]);
@@ -1834,40 +1929,23 @@ namespace SF {
         }
       }
 
-      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method
-      for (unsigned int i = 0; i < _faceIndices.size (); ++i){
-        calculateParametricCoordinates (_numSurfaceVertices, _vertices [0], _faceIndices [i], _submesh [i].get ()->_meshSurfaceVertexTexCoords);
+      // initialize 2D texture coordinates for each submesh using Tutte's parametric coordinates method (submeshes are independent)
+      uint32_t chartKey = 0;
+      {
+        vector <vector <vec2> > texCoords;
+        chartKey = calculateParametricCoordinates (artifacts, _numSurfaceVertices, _vertices [0], _faceIndices, texCoords, pool);
+        for (unsigned int i = 0; i < _submesh.size (); ++i){
+          vector <vec2> &dest = _submesh [i]->_meshSurfaceVertexTexCoords;
+          assert (texCoords [i].size () >= dest.size ());
+          copy (texCoords [i].begin (), texCoords [i].begin () + dest.size (), dest.begin ());
+        }
       }
 
       // determine scale factors to be used for rasterizing charts
       vector <real> area2d (_faceIndices.size ());
       {
         // calculate the resolution of surface pixels
-        int first, second;
-        unsigned int numPixels = 0;
-        unsigned int offset1 = 4*texture._dimension[0]*texture._dimension[1];
-        unsigned int offset2 = 4*texture._dimension[0];
-        for (unsigned int i = 0; i < texture._dimension [2]; ++i){
-          for (unsigned int j = 0; j < texture._dimension [1]; ++j){
-            first = -1;
-            second = -1;
-            for (unsigned int k = 0; k < texture._dimension [0]; ++k){
-              if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                first = static_cast <int> (k);
-                break;
-              }
-            }
-            if (first >= 0){
-              for (int k = static_cast <int> (texture._dimension [0]) - 1; k >=0; --k){
-                if (texture._rgba [offset1*i + offset2*j + 4*k + 3] > .5){
-                  second = k;
-                  break;
-                }
-              }
-              numPixels += first < second ? 2 : 1;
-            }
-          }
-        }
+        unsigned int numPixels = countSurfaceTexels (texture);
 
         // calculate scaling factors
         vec te, e1, e2;
@@ -1913,7 +1991,7 @@ namespace SF {
       }
 
       // rasterize each flattened 2D submesh and generate rectangular charts
-      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d);
+      rasterizeCharts (atlasScaleFactor, atlasShader, texture, area2d, artifacts, chartKey, pool);
 
       // update the 3D texture coordinates for internal vertices
       real min [3] = {2., 2., 2.};
@@ -1962,27 +2040,39 @@ namespace SF {
 
     // private method to rasterize flattened submeshes
     void
-    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales)
+    Mesh::rasterizeCharts (unsigned int atlasScale, const string &atlasShader, const Texture3D &texture, const vector <real> &scales,
+                           const ArtifactCache &artifacts, uint32_t chartKey, WorkerPool &pool)
     {
-      // scale vertices to account for aspect ratios of the texture dataset
-      vector <vec> normalizedVerts (_numSurfaceVertices, vec::ZERO);
-      scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
-
-      // locally calculate normals
-      vector <vec> normals(_numSurfaceVertices, vec::ZERO);
-      calculateVertexNormals (normalizedVerts, _faceIndices, normals);
+      // atlases rasterized before from the same charts, texture and settings are taken from the artifact cache
+      uint32_t atlasKey = artifacts.isOpen () ? textureAtlasKey (chartKey, texture, _bbox, scales, atlasScale, *_glslPrefixString, atlasShader) : 0;
+      vector <int> dims;
+      vector <vector <GLfloat> > atlases;
+      bool cached = artifacts.isOpen () && readTextureAtlases (artifacts, atlasKey, dims, atlases) && dims.size () == _faceIndices.size ();
+      dims.resize (_faceIndices.size ());
+      atlases.resize (_faceIndices.size ());
+
+      vector <vec> normalizedVerts, normals;
+      GLuint program = 0;
+      if (!cached){
+        // scale vertices to account for aspect ratios of the texture dataset
+        normalizedVerts.resize (_numSurfaceVertices, vec::ZERO);
+        scaleVertices (&(texture._aspectRatio [0]), _vertices [0], _bbox, normalizedVerts);
+
+        // locally calculate normals
+        normals.resize (_numSurfaceVertices, vec::ZERO);
+        calculateVertexNormals (normalizedVerts, _faceIndices, normals);
+
+        // scale normals so that they go from [-1:1] to [0, 1]
+        for (unsigned int i = 0; i < normals.size (); ++i){
+          normals [i] *= .5;
+          normals [i] += .5;
+        }
 
-      // scale normals so that they go from [-1:1] to [0, 1]
-      for (unsigned int i = 0; i < normals.size (); ++i){
-        normals [i] *= .5;
-        normals [i] += .5;
+        // load GL shader file
+        initGPUProgram (false, *_glslPrefixString, atlasShader, program);
+        assert (program);
       }
 
-      // load GL shader file
-      GLuint program = 0;
-      initGPUProgram (false, *_glslPrefixString, atlasShader, program);
-      assert (program);
-
       // initialize GL texture atlas and texture coordinate objects
       GLenum error;
 
@@ -2029,38 +2119,40 @@ namespace SF {
           }
         }
 
-        // generate texture atlases for coordinate and normal data
-        vector <GLfloat> rgbaData, coData, noData;
-        coData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normalizedVerts, sptr->_meshSurfaceVertexTexCoords, _faceIndices [i], coData);
-
-        noData.resize (4*dim*dim, 0.);
-        initTextureAtlas (program, dim, normals, sptr->_meshSurfaceVertexTexCoords, _faceIndices [i], noData);
-
-        // normalize incoming normals
-        for (int j = 0; j < 4*dim*dim; j += 4){
-          if (noData [j + 3] > .5) {
-            mag = 0.;
-            for (int k = 0; k < 3; ++k){
-              mag += noData [j + k] * noData [j + k];
-            }
-            mag = 1./ static_cast <real> (sqrt (mag));
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= mag;
-            }
-            // rescale normals from [0:1] range to [-1:1]
-            for (int k = 0; k < 3; ++k){
-              noData [j + k] *= 2.;
-              noData [j + k] -= 1.;
+        // generate texture atlases for coordinate and normal data, unless they were cached
+        vector <GLfloat> &rgbaData = atlases [i];
+        assert (!cached || dims [i] == dim);
+        if (!cached){
+          dims [i] = dim;
+          vector <GLfloat> coData, noData;
+          coData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normalizedVerts, sptr->_meshSurfaceVertexTexCoords, _faceIndices [i], coData);
+
+          noData.resize (4*dim*dim, 0.);
+          initTextureAtlas (program, dim, normals, sptr->_meshSurfaceVertexTexCoords, _faceIndices [i], noData);
+
+          // normalize incoming normals
+          for (int j = 0; j < 4*dim*dim; j += 4){
+            if (noData [j + 3] > .5) {
+              mag = 0.;
+              for (int k = 0; k < 3; ++k){
+                mag += noData [j + k] * noData [j + k];
+              }
+              mag = 1./ static_cast <real> (sqrt (mag));
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= mag;
+              }
+              // rescale normals from [0:1] range to [-1:1]
+              for (int k = 0; k < 3; ++k){
+                noData [j + k] *= 2.;
+                noData [j + k] -= 1.;
+              }
             }
           }
-        }
-
-        rgbaData.resize (4*dim*dim, 0.);
-        raytraceThroughVolumef (dim, coData, noData, texture, rgbaData);
 
-        coData.clear ();
-        noData.clear ();
+          rgbaData.resize (4*dim*dim, 0.);
+          raytraceThroughVolumef (dim, coData, noData, texture, rgbaData, &pool);
+        }
 
         // calculate 3D texture coordinates for every vertex from the data obtained above
         scale = 1./ scale;
@@ -2130,7 +2222,10 @@ namespace SF {
         glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, dim, dim, 0, GL_RGBA, GL_FLOAT, &(rgbaData [0]));
         checkGLError (error);
 
-        rgbaData.clear ();
+        // atlases are kept until they are written to the artifact cache
+        if (!artifacts.isOpen ()){
+          rgbaData.clear ();
+        }
 
         // generate 2D texture coordinate objects
         glBindBuffer (GL_ARRAY_BUFFER, _glTexCoordBufferId [i]);
@@ -2140,6 +2235,10 @@ namespace SF {
 
       } // end - for (unsigned int i = 0; i < _faceIndices.size (); ++i)
 
+      if (!cached && artifacts.isOpen ()){
+        writeTextureAtlases (artifacts, atlasKey, dims, atlases);
+      }
+
       // cleanup
       glBindTexture (GL_TEXTURE_2D, 0);
       glBindBuffer (GL_ARRAY_BUFFER, 0);
@@ -2154,8 +2253,40 @@ namespace SF {
       glTexParameteri (GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
       glTexParameteri (GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
       glTexParameteri (GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-      glTexImage3D (GL_TEXTURE_3D, 0, GL_RGBA, texture._dimension [0], texture._dimension [1], texture._dimension [2], 0, GL_RGBA, GL_UNSIGNED_BYTE, &(texture._rgba [0]));
-      checkGLError (error);
+      if (!texture._bricks){
+        glTexImage3D (GL_TEXTURE_3D, 0, GL_RGBA, texture._dimension [0], texture._dimension [1], texture._dimension [2], 0, GL_RGBA, GL_UNSIGNED_BYTE, &(texture._rgba [0]));
+        checkGLError (error);
+      } else {
+
+        // upload brick by brick, so the whole volume is never held in host memory (empty bricks decode to zeros)
+        glTexImage3D (GL_TEXTURE_3D, 0, GL_RGBA, texture._dimension [0], texture._dimension [1], texture._dimension [2], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        checkGLError (error);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, SF_BRICK_SIDE);
+        glPixelStorei (GL_UNPACK_IMAGE_HEIGHT, SF_BRICK_SIDE);
+
+        const BrickedVolume &bricks = *(texture._bricks);
+        const unsigned int *numBricks = bricks.numBricks ();
+        vector <unsigned char> texels;
+        for (unsigned int bz = 0; bz < numBricks [2]; ++bz){
+          for (unsigned int by = 0; by < numBricks [1]; ++by){
+            for (unsigned int bx = 0; bx < numBricks [0]; ++bx){
+              bricks.load (bricks.brickIndex (bx, by, bz), texels);
+              GLint origin [3] = {static_cast <GLint> (bx*SF_BRICK_SIZE), static_cast <GLint> (by*SF_BRICK_SIZE), static_cast <GLint> (bz*SF_BRICK_SIZE)};
+              GLsizei size [3];
+              for (int j = 0; j < 3; ++j){
+                size [j] = static_cast <GLsizei> (min (SF_BRICK_SIZE, texture._dimension [j] - origin [j]));
+              }
+              glTexSubImage3D (GL_TEXTURE_3D, 0, origin [0], origin [1], origin [2], size [0], size [1], size [2], GL_RGBA, GL_UNSIGNED_BYTE, &(texels [0]));
+            }
+          }
+        }
+        checkGLError (error);
+
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei (GL_UNPACK_IMAGE_HEIGHT, 0);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+      }
       glBindTexture (GL_TEXTURE_3D, 0);
     }
 
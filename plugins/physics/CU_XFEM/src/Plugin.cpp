@@ -40,7 +40,8 @@ extern "C" {
 
 #include "Preprocess.h"
 #include "aabb.h"
-#include "ThreadControl.h"
+#include "StageControl.h"
+#include "WorkerPool.h"
 #include "Plugin.h"
 #include "Driver.h"
 #include "Display.h"
@@ -57,7 +58,7 @@ namespace SF {
   XFE::Scene _scene;
 
 	// function to parse configuration file
-	static int
+	static bool
 	parse (const string &cfgFile, vector <string> &configs)
 	{
 		assert (!cfgFile.empty ());
@@ -67,7 +68,7 @@ namespace SF {
 		xmlDocPtr doc = xmlReadFile (cfgFile.c_str (), NULL, 0);
 		if (!doc){
 			PRINT ("error: could not read %s\n", cfgFile.c_str ());
-			return 0;
+			return false;
 		}
 
 		// get document root element
@@ -75,14 +76,13 @@ namespace SF {
 		if (strcmp (reinterpret_cast< const char* > (node->name), "SFXFEMConfig")){
 			PRINT ("error: root element in %s in not of SFXFEMConfig type", cfgFile.c_str ());
 			xmlFreeDoc (doc);
-			return 0;
+			return false;
 		}
 
 		// get children nodes
 		node = node->children;
 		node = node->next;
 
-		int result = 0;
 		while (node){
 
 			if (!strcmp (reinterpret_cast <const char *> (node->name), "configFile")){
@@ -90,19 +90,9 @@ namespace SF {
 				configs.push_back (string (fname));
 				free (fname); fname = NULL;
 			}
+			// threads now come from the Driver's worker pool (<workerpool> in the driver configuration)
 			else if (!strcmp (reinterpret_cast <const char *> (node->name), "threadpool")){
-				char *sname = reinterpret_cast <char *> (xmlGetProp (node, reinterpret_cast <const xmlChar *> ("size")));
-				for (unsigned int i = 0; i < strlen (sname); ++i){
-					if (!isdigit (sname[i])){
-						PRINT ("error: threadpool size \'%s\' is not a number", sname);
-						free (sname);
-						xmlFreeDoc (doc);
-						xmlCleanupParser ();
-						return 0;
-					}
-				}
-				result = atoi (sname);
-				free (sname); sname = NULL;
+				PRINT ("warning: threadpool in %s is ignored; size the Driver's workerpool instead\n", cfgFile.c_str ());
 			}
 
 			node = node->next;
@@ -114,23 +104,23 @@ namespace SF {
 		xmlFreeDoc (doc);
 		xmlCleanupParser ();
 
-		return result;
+		return true;
 	}
 
 	// plugin constructor
 	EXPORT
 	Plugin::Plugin (const string &config, Driver &driver)
+	: _pool (&(driver._pool))
 	{
 		// parse input configuration files
 		vector <string> configFiles;
 
-    unsigned int numThreads = static_cast <unsigned int> (parse (config, configFiles));
-		if (!numThreads){
+		if (!parse (config, configFiles)){
 			PRINT ("error parsing %s....aborting\n", config.c_str ());
 			exit (EXIT_FAILURE);
 		}
 		assert (!configFiles.empty ());
-		_scene.resizePool (numThreads);
+		_scene.setPool (_pool);
 
 		_resources.reserve (configFiles.size ());
 		for (unsigned int i = 0; i < configFiles.size (); ++i){
@@ -193,15 +183,11 @@ namespace SF {
 	void
 	Plugin::run ()
 	{
-    _threads = new boost::thread [_resources.size () + 1];
+    // start scene loop
+    _pool->spawn (boost::bind (&SF::XFE::Scene::run, dynamic_cast <SF::XFE::Scene *> (&_scene)), INTERSECTION_STAGE);
 
-    // start scene thread
-    boost::thread xs (&SF::XFE::Scene::run, dynamic_cast <SF::XFE::Scene *> (&_scene));
-    _threads [0] = boost::move (xs);
-
-    for (unsigned int i = 1; i <= _resources.size (); ++i){
-      boost::thread xm (&SF::XFE::Mesh::run, dynamic_cast <SF::XFE::Mesh *> (_resources.at (i - 1).get ()));
-      _threads [i] = boost::move (xm);
+    for (unsigned int i = 0; i < _resources.size (); ++i){
+      _pool->spawn (boost::bind (&SF::XFE::Mesh::run, dynamic_cast <SF::XFE::Mesh *> (_resources.at (i).get ())), PHYSICS_STAGE, _resources.at (i).get ());
     }
     PRINT ("libCudaXfem threads started\n");
 	}
@@ -210,10 +196,11 @@ namespace SF {
 	void
 	Plugin::cleanup ()
 	{
-	  for (unsigned int i = 1; i <= _resources.size (); ++i){
-      boost::thread xm (&SF::XFE::Mesh::cleanup, dynamic_cast <SF::XFE::Mesh *> (_resources.at (i - 1).get ()));
-      _threads [i] = boost::move (xm);
+	  TaskGroup group;
+	  for (unsigned int i = 0; i < _resources.size (); ++i){
+      _pool->submit (boost::bind (&SF::XFE::Mesh::cleanup, dynamic_cast <SF::XFE::Mesh *> (_resources.at (i).get ())), &group, HIGH_PRIORITY);
 	  }
+	  _pool->wait (group);
 	}
 
 }
@@ -23,8 +23,10 @@
 #include <forward_list>
 #include <boost/bind.hpp>
 
-#include "ThreadControl.h"
+#include "StageControl.h"
+#include "Placement.h"
 #include "aabb.h"
+#include "mat4x4.h"
 
 #include "Rigid/inc/Mesh.h"
 
@@ -33,7 +35,6 @@
 
 using namespace std;
 using namespace boost;
-using namespace boost::threadpool;
 
 /*********************** POOLJOB RELATED METHODS ***********************/
 namespace SF {
@@ -94,34 +95,29 @@ namespace SF {
 
     // default constructor
     Scene::Scene ()
-    :_bladeWaitIndex (-1), _bladePostIndex (-1), _bladeCurr (&( _bladeVerts [0])), _bladePrev (&(_bladeVerts [1]))
+    :_pool (NULL), _blade (NULL), _bladeSyncControl (NULL), _bladeCurr (&( _bladeVerts [0])), _bladePrev (&(_bladeVerts [1]))
     { }
 
     // destructor
-    Scene::~Scene ()
-    {
-      _pool.clear ();
-    }
+    Scene::~Scene () { }
 
     // method to add blade-related variables
     void
     Scene::addBlade (Resource *r)
     {
       SF::RM::Mesh *m = static_cast <SF::RM::Mesh *> (r);
+      assert (m->_bladeVertices);
 
+      _blade = m;
       _bladeSyncControl = &(m->_syncControl);
-      _bladeWaitIndex = m->_semIntersectionWaitIndex;
-      _bladePostIndex = m->_semIntersectionPostIndex;
+      assert (_bladeSyncControl->has (INTERSECTION_STAGE));
 
-      _bladeVerts [0] = *(m->_bladeCurr);
-      delete m->_bladeCurr;
-      m->_bladeCurr = &(_bladeVerts [0]);
+      // the blade only publishes a pose; world-space positions are kept here
       _bladeCurr = &(_bladeVerts [0]);
-
-      _bladeVerts [1] = *(m->_bladePrev);
-      delete m->_bladePrev;
-      m->_bladePrev = &(_bladeVerts [1]);
       _bladePrev = &(_bladeVerts [1]);
+      _bladeVerts [0].resize (m->_bladeVertices->size ());
+      updateBladeVertices ();
+      _bladeVerts [1] = _bladeVerts [0];
 
       updateBladeBounds ();
 
@@ -133,6 +129,17 @@ namespace SF {
       _bladeNormals [1].resize (_bladeIndices.size ()/ 2);
     }
 
+    // method to place the blade's model-space vertices with its current pose
+    void
+    Scene::updateBladeVertices ()
+    {
+      mat4x4 &pose = *(_blade->_currPose);
+      vector <vec> &verts = *(_blade->_bladeVertices);
+      for (unsigned int i = 0; i < verts.size (); ++i){
+        (*_bladeCurr) [i] = pose * verts [i];
+      }
+    }
+
     // intersection detection and resolution method
     void
     Scene::run ()
@@ -165,15 +172,33 @@ namespace SF {
         jobOffsets [i] += jobOffsets [i - 1];
       }
 
+      // hand out submeshes to the NUMA nodes of the workers round-robin; their jobs are queued there
+      Placement *placement = _pool->placement ();
+      {
+        vector <int> nodes;
+        if (placement){
+          nodes = placement->nodes (WORKER_ROLE);
+        }
+        unsigned int counter = 0;
+        for (unsigned int i = 0; i < _mesh.size (); ++i){
+          m = _mesh [i].get ();
+          for (unsigned int j = 0; j < m->_submesh.size (); ++j){
+            m->_submesh [j].get ()->_node = nodes.empty () ? -1 : nodes [counter++ % nodes.size ()];
+          }
+        }
+      }
+      vector <bool> relocated (_mesh.size (), !placement || !placement->firstTouch ());
+
       while (true){
 
         // lock blade
-        (*_bladeSyncControl) [_bladeWaitIndex].wait ();
+        _bladeSyncControl->wait (INTERSECTION_STAGE);
 
 				vector <vec> *tmpp = _bladeCurr;
 				_bladeCurr = _bladePrev;
 				_bladePrev = tmpp;
 
+        updateBladeVertices ();
         updateBladeBounds ();
 
         normalComputeFlag = true;
@@ -181,7 +206,16 @@ namespace SF {
         for (unsigned int i = 0; i < _mesh.size (); ++i){
           // lock mesh
           m = _mesh [i].get ();
-          m->_syncControl [m->_semIntersectionWaitIndex].wait ();
+          m->_syncControl.wait (INTERSECTION_STAGE);
+
+          // first time the mesh is held: move submesh data onto the nodes that will work on it
+          if (!relocated [i]){
+            for (unsigned int j = 0; j < m->_submesh.size (); ++j){
+              sm = m->_submesh [j].get ();
+              placement->onNode (sm->_node, boost::bind (&SF::XFE::Submesh::relocate, sm));
+            }
+            relocated [i] = true;
+          }
 
           if (_bladeBounds.collide (m->_bbox)){
 
@@ -196,7 +230,7 @@ if (cflag){
             for (unsigned int j = 0; j < m->_submesh.size (); ++j){
               sm = m->_submesh [j].get ();
 
-              // push affected cell gathering tasks to threadpool
+              // push affected cell gathering tasks to the worker pool
               if (_bladeBounds.collide (sm->_bbox)){
 
                 // process every partition for new cuts to cells
@@ -229,8 +263,8 @@ if (cflag){
                     if (!fCounter){
                       cflag = true;
                     }
-                    // push collision detection and resolution tasks to the threadpool
-                    schedule (_pool, bind (&SF::XFE::PoolJob::getAffectedCells, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]));
+                    // push collision detection and resolution tasks to the worker pool
+                    _pool->submit (bind (&SF::XFE::PoolJob::getAffectedCells, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]), &_jobs, HIGH_PRIORITY, sm->_node);
 
                   } // end - if (_bladeBounds.collide (sm->_partitions [k]._bbox))
                 } // end - for (unsigned int k = 0; k < sm->_partitions.size (); ++i)
@@ -238,7 +272,7 @@ if (cflag){
             } // end - for (unsigned int j = 0; j < m->_submesh.size (); ++j)
 
             // synchronize
-            _pool.wait ();
+            _pool->wait (_jobs);
 if (cflag){
   p2 += clock () - before;
   p2 -= tmpc;
@@ -363,12 +397,12 @@ if (cflag){
               sm = m->_submesh [j].get ();
               for (unsigned int k = 0; k < sm->_partitions.size (); ++k){
                 if (!sm->_partitions [k]._cutCells.empty () || !sm->_partitions [k]._reExaminedCells.empty ()){
-                  schedule (_pool, bind (&SF::XFE::PoolJob::resolveFaces, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]));
+                  _pool->submit (bind (&SF::XFE::PoolJob::resolveFaces, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]), &_jobs, HIGH_PRIORITY, sm->_node);
                   break;
                 }
               }
             }
-            _pool.wait ();
+            _pool->wait (_jobs);
 
             // rejiggle any vertex that is too near the blade indices
             m->adjustVertices (*_bladeCurr, *_bladePrev, _bladeIndices, _bladeNormals [0], _bladeNormals [1]);
@@ -384,15 +418,15 @@ if (cflag){
               for (unsigned int k = 0; k < sm->_partitions.size (); ++k){
                 if (!sm->_partitions [k]._cutCells.empty () || !sm->_partitions [k]._reExaminedCells.empty ()){
 
-                  // push collision detection and resolution tasks to the threadpool
-                  schedule (_pool, bind (&SF::XFE::PoolJob::finalizeCollision, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]));
+                  // push collision detection and resolution tasks to the worker pool
+                  _pool->submit (bind (&SF::XFE::PoolJob::finalizeCollision, collisionJobs [jobOffsets [i] + j*sm->_partitions.size () +k]), &_jobs, HIGH_PRIORITY, sm->_node);
 
                 } // end - (!sm->_partitions [k]._cutCells.empty () || !sm->_partitions [k]._reExaminedCells.empty ())
               } // end - for (unsigned int k = 0; k < sm->_partitions.size (); ++i)
             } // end - for (unsigned int j = 0; j < m->_submesh.size (); ++j)
 
             // synchronize
-            _pool.wait ();
+            _pool->wait (_jobs);
 if (cflag){
   p4 += clock () - before;
   if (fCounter >= TICKS){
@@ -419,12 +453,12 @@ if (cflag){
           } // end - if (_bladeBounds.collide (m->_bbox))
 
           // release mesh
-          m->_syncControl [m->_semIntersectionPostIndex].post ();
+          m->_syncControl.post (INTERSECTION_STAGE);
 
         } // end - for (unsigned int i = 0; i < _mesh.size (); ++i)
 
         // release blade
-        (*_bladeSyncControl) [_bladePostIndex].post ();
+        _bladeSyncControl->post (INTERSECTION_STAGE);
       } // end - while (true)
     }
 
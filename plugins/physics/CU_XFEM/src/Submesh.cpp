@@ -18,11 +18,18 @@
  * The submesh class for the CU_XFEM library.
  */
 
+extern "C" {
+#include <unistd.h>
+}
+
 #include "vec2.h"
 #include "vec3.h"
 #include "vec4.h"
 #include "GL/common.h"
+#include "BinaryCache.h"
+#include "IO/TextReader.h"
 #include "Collide/lineTriCollide.h"
+#include "Placement.h"
 
 #include "Common.h"
 #include "Vertex.h"
@@ -39,17 +46,17 @@ namespace SF {
 	  static bool
     readCellFiles (const string &prefix, unsigned int numVerts, vector <Cell> &cells)
     {
-      int tmpd [4];
+      int tmpd [4] = {0};
 
       string file (prefix);
       file.append (".tet.ele");
 
-      FILE* fp = fopen (file.c_str (), "r");
-      assert (fp);
+      TextReader reader;
+      bool status = reader.open (file);
+      assert (status);
 
-      int status = fscanf (fp, "%d\n", &(tmpd [0]));
-      assert (status != 0);
-      if (tmpd [0] <= 0){
+      status = reader.read (tmpd [0]);
+      if (!status || tmpd [0] <= 0){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd [0], file.c_str ());
         exit (EXIT_FAILURE);
       }
@@ -58,27 +65,25 @@ namespace SF {
 
       unsigned int tmpu [4];
       for (unsigned int i = 0; i < ncells; ++i){
-        status = fscanf (fp, "%d %d %d %d\n", &(tmpu [0]), &(tmpu [1]), &(tmpu [2]), &(tmpu [3]));
-        assert (status != 0);
-        assert (tmpu [0] >= 0 && tmpu [0] < numVerts);
-        assert (tmpu [1] >= 0 && tmpu [1] < numVerts);
-        assert (tmpu [2] >= 0 && tmpu [2] < numVerts);
-        assert (tmpu [3] >= 0 && tmpu [3] < numVerts);
+        status = reader.read (tmpu, 4);
+        assert (status);
+        assert (tmpu [0] < numVerts);
+        assert (tmpu [1] < numVerts);
+        assert (tmpu [2] < numVerts);
+        assert (tmpu [3] < numVerts);
         cells.push_back (Cell (tmpu));
       }
-      fclose (fp);
 
       assert (cells.size () == ncells);
 
       file = prefix;
       file.append (".tet.top");
 
-      fp = fopen (file.c_str (), "r");
-      assert (fp);
+      status = reader.open (file);
+      assert (status);
 
-      status = fscanf (fp, "%d\n", &(tmpd [0]));
-      assert (status != 0);
-      if (tmpd [0] <= 0){
+      status = reader.read (tmpd [0]);
+      if (!status || tmpd [0] <= 0){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd [0], file.c_str ());
         exit (EXIT_FAILURE);
       }
@@ -89,8 +94,8 @@ namespace SF {
       }
 
       for (unsigned int i = 0; i < ncells; ++i){
-        status = fscanf (fp, "%d %d %d %d\n", &(tmpd [0]), &(tmpd [1]), &(tmpd [2]), &(tmpd [3]));
-        assert (status != 0);
+        status = reader.read (tmpd, 4);
+        assert (status);
         assert (tmpd [0] < static_cast <int> (ncells) && tmpd [1] < static_cast <int> (ncells) &&
                 tmpd [2] < static_cast <int> (ncells) && tmpd [3] < static_cast <int> (ncells));
         cells [i].addNeighbors (tmpd);
@@ -99,24 +104,53 @@ namespace SF {
       return true;
     }
 
+    // static method to read the number of cells in every partition EditMesh balanced the submesh into (false if it wrote none)
+    static bool
+    readPartitionFile (const string &prefix, unsigned int numCells, vector <unsigned int> &sizes)
+    {
+      string file (prefix);
+      file.append (".tet.part");
+      if (access (file.c_str (), F_OK)){
+        return false;
+      }
+
+      TextReader reader;
+      int tmpd = 0;
+      if (!reader.open (file) || !reader.read (tmpd) || tmpd <= 0){
+        PRINT ("fatal error: invalid number of partitions %d in %s\n", tmpd, file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      sizes.resize (static_cast <unsigned int> (tmpd));
+      unsigned int total = 0;
+      bool status = reader.read (&(sizes [0]), sizes.size ());
+      for (unsigned int i = 0; status && i < sizes.size (); ++i){
+        total += sizes [i];
+      }
+      if (!status || total != numCells){
+        PRINT ("fatal error: partitions in %s don't add up to %u cells\n", file.c_str (), numCells);
+        exit (EXIT_FAILURE);
+      }
+      return true;
+    }
+
     // static method to read face related files
     static bool
     readFaceFiles (const string &prefix, unsigned int numCells, unsigned int numFaces, unsigned int numVertices,
                    vector <Face> &ofaces, vector <unsigned int> &iindices, vector <Face> &ifaces)
     {
-      int tmpd;
+      int tmpd = 0;
 
       string file (prefix);
 
       // read outside face related info file
       file.append (".trio.own");
 
-      FILE *fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      int status = fscanf (fp, "%d\n", &tmpd);
+      TextReader reader;
+      bool status = reader.open (file);
       assert (status);
-      if (tmpd <= 0 || 3*tmpd != static_cast <int> (numFaces)){
+
+      status = reader.read (tmpd);
+      if (!status || tmpd <= 0 || 3*tmpd != static_cast <int> (numFaces)){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd, file.c_str ());
         exit (EXIT_FAILURE);
       }
@@ -126,23 +160,22 @@ namespace SF {
 
       unsigned int tmpu [3];
       for (unsigned int i = 0; i < nelems; ++i){
-        status = fscanf (fp, "%u %u\n", &(tmpu[0]), &(tmpu[1]));
-        assert (status && tmpu [0] >= 0 && tmpu [0] < numCells && tmpu [1] < 4);
+        status = reader.read (tmpu, 2);
+        assert (status && tmpu [0] < numCells && tmpu [1] < 4);
         ofaces [i]._owner = tmpu [0];
         ofaces [i]._index = static_cast <unsigned char> (tmpu [1]);
       }
-      fclose (fp);
 
       // read inside faces
       file = prefix;
       file.append (".trii.ele");
 
-      fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      status = fscanf (fp, "%d\n", &tmpd);
+      status = reader.open (file);
       assert (status);
-      if (tmpd < 0){
+
+      tmpd = -1;
+      status = reader.read (tmpd);
+      if (!status || tmpd < 0){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd, file.c_str ());
         exit (EXIT_FAILURE);
       }
@@ -150,40 +183,32 @@ namespace SF {
       if (tmpd){
         nelems = static_cast <unsigned int> (tmpd);
         iindices.resize (3*nelems);
-
-        for (unsigned int i = 0; i < nelems; ++i){
-          status = fscanf (fp, "%u %u %u\n", &(tmpu[0]), &(tmpu[1]), &(tmpu[2]));
-          assert (status && tmpu [0] < numVertices && tmpu [1] < numVertices && tmpu [2] < numVertices);
-          for (unsigned int j = 0; j < 3; ++j){
-            iindices [3*i + j] = tmpu [j];
-          }
+        status = reader.read (&(iindices [0]), iindices.size ());
+        assert (status);
+        for (unsigned int i = 0; i < iindices.size (); ++i){
+          assert (iindices [i] < numVertices);
         }
-        fclose (fp);
 
         // read inside face related info file
         file = prefix;
         file.append (".trii.own");
 
-        fp = fopen (file.c_str (), "r");
-        assert (fp);
-
-        status = fscanf (fp, "%d\n", &tmpd);
+        status = reader.open (file);
         assert (status);
-        if (tmpd <= 0 || tmpd != static_cast <int> (nelems)){
+
+        status = reader.read (tmpd);
+        if (!status || tmpd <= 0 || tmpd != static_cast <int> (nelems)){
           PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd, file.c_str ());
           exit (EXIT_FAILURE);
         }
 
         ifaces.resize (nelems);
         for (unsigned int i = 0; i < nelems; ++i){
-          status = fscanf (fp, "%u %u\n", &(tmpu[0]), &(tmpu[1]));
-          assert (status && tmpu [0] >= 0 && tmpu [0] < numCells && tmpu [1] < 4);
+          status = reader.read (tmpu, 2);
+          assert (status && tmpu [0] < numCells && tmpu [1] < 4);
           ifaces [i]._owner = tmpu [0];
           ifaces [i]._index = static_cast <unsigned char> (tmpu [1]);
         }
-        fclose (fp);
-      } else {
-        fclose (fp);
       }
 
       return true;
@@ -193,62 +218,56 @@ namespace SF {
     static bool
     readEdgeFiles (const string &prefix, unsigned int numVerts, vector <unsigned int> &indices, vector <Edge> &edges)
     {
-      int tmpd;
+      int tmpd = 0;
 
       // read edge element files;
       string file (prefix);
       file.append (".edge.ele");
 
-      FILE *fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      int status = fscanf (fp, "%d\n", &tmpd);
+      TextReader reader;
+      bool status = reader.open (file);
       assert (status);
-      if (tmpd <= 0){
+
+      status = reader.read (tmpd);
+      if (!status || tmpd <= 0){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd, file.c_str ());
         exit (EXIT_FAILURE);
       }
 
-      unsigned int tmpu [2];
       unsigned int nedges = static_cast <unsigned int> (tmpd);
       indices.resize (2*nedges);
-      for (unsigned int i = 0; i < 2*nedges; i += 2){
-        status = fscanf (fp, "%u %u\n", &tmpu [0], &tmpu [1]);
-        assert (status && tmpu [0] < numVerts && tmpu [1] < numVerts);
-        indices [i] = tmpu [0];
-        indices [i + 1] = tmpu [1];
+      status = reader.read (&(indices [0]), indices.size ());
+      assert (status);
+      for (unsigned int i = 0; i < indices.size (); ++i){
+        assert (indices [i] < numVerts);
       }
-      fclose (fp);
 
       // read edge topology file
 
       file = prefix;
       file.append (".edge.top");
 
-      fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      status = fscanf (fp, "%d\n", &tmpd);
+      status = reader.open (file);
       assert (status);
-      if (tmpd <= 0 || tmpd != static_cast <int> (nedges)){
+
+      status = reader.read (tmpd);
+      if (!status || tmpd <= 0 || tmpd != static_cast <int> (nedges)){
         PRINT ("fatal error: invalid number of elements %d in %s\n", tmpd, file.c_str ());
         exit (EXIT_FAILURE);
       }
 
       edges.resize (nedges);
-      unsigned int *tmpo;
+      unsigned int numOwners;
+      vector <unsigned int> owners;
       for (unsigned int i = 0; i < nedges; ++i){
-        status = fscanf (fp, "%u", &tmpu [0]);
-        assert (status && tmpu [0]);
+        status = reader.read (numOwners);
+        assert (status && numOwners);
 
-        tmpo = new unsigned int [tmpu [0]];
-        for (unsigned int j = 0; j < tmpu [0]; ++j){
-          status = fscanf (fp, "%u", &tmpo [j]);
-        }
-        edges [i] = Edge (indices [2*i], tmpu [0], tmpo);
-        delete [] tmpo;
+        owners.resize (numOwners);
+        status = reader.read (&(owners [0]), numOwners);
+        assert (status);
+        edges [i] = Edge (indices [2*i], numOwners, &(owners [0]));
       }
-      fclose (fp);
 
       return true;
     }
@@ -379,57 +398,72 @@ namespace SF {
 
 		// proper constructor
 		Submesh::Submesh (const string &config, const string &prefix, unsigned int index, unsigned int maxSurfaceVertexIndex,
-                    vector <Vertex> &vi, const FaceChangeStruct &fc, vector <vec> **verts, vector <vec3> *texCoords, vector <unsigned int> &indices)
-		: _myIndex (index), _maxSurfaceVertexIndex (maxSurfaceVertexIndex), _vertexInfo (&vi), _meshVertices (verts), _meshVertexTexCoords (texCoords),
+                    vector <Vertex> &vi, const FaceChangeStruct &fc, vector <vec> **verts, vector <vec3> *texCoords, vector <unsigned int> &indices,
+                    bool skipGL, const BinaryCacheReader *cache)
+		: _myIndex (index), _node (-1), _maxSurfaceVertexIndex (maxSurfaceVertexIndex), _vertexInfo (&vi), _meshVertices (verts), _meshVertexTexCoords (texCoords),
 		_meshFaceIndices (&indices), _meshSurfaceVertexTexCoords (vector <vec2> (maxSurfaceVertexIndex + 1))
 		{
-      // initialize OpenGL related attributes
-		  initGLAttribs (config);
-
-      // formulate file prefix
-      string fpref (prefix);
-      {
-        char indexStr [4];
-        sprintf (indexStr,"%u", index);
-        fpref.append (".");
-        fpref.append (indexStr);
+      // initialize OpenGL related attributes (skipped when built off the GL thread or in a headless run)
+      if (skipGL){
+        _inUpdateFlag = false;
+      } else {
+		    initGLAttribs (config);
       }
 
-      // read cell indices and neighboring info
-      readCellFiles (fpref, (*_meshVertices)->size (), _cells);
+      vector <unsigned int> partitionSizes; // cells of every partition, when EditMesh balanced them
+      if (cache){
+        // the cache holds the topology already in partition order
+        if (!readCache (*cache)){
+          PRINT ("fatal error: topology cache of submesh %u is incomplete\n", index);
+          exit (EXIT_FAILURE);
+        }
+      } else {
+        // formulate file prefix
+        string fpref (prefix);
+        {
+          char indexStr [4];
+          sprintf (indexStr,"%u", index);
+          fpref.append (".");
+          fpref.append (indexStr);
+        }
 
-      // read face related info structures
-      readFaceFiles (fpref, _cells.size (), _meshFaceIndices->size (), (**_meshVertices).size (), _faces, _insideFaceIndices, _insideFaces);
+        // read cell indices and neighboring info
+        readCellFiles (fpref, (*_meshVertices)->size (), _cells);
+        readPartitionFile (fpref, _cells.size (), partitionSizes);
 
-      // read edge related structure
-      {
-        vector <unsigned int> eIndices;
-        readEdgeFiles (fpref, (**_meshVertices).size (), eIndices, _edges);
-        for (unsigned int i = 0; i < _edges.size (); ++i){
-          for (unsigned int j = 0; j < _edges [i]._numOwners; ++j){
-            updateCellEdgeInfo (i, eIndices [2*i], eIndices [2*i + 1], _cells [_edges [i]._owner [j]]);
-          }
-        }
-      }
+        // read face related info structures
+        readFaceFiles (fpref, _cells.size (), _meshFaceIndices->size (), (**_meshVertices).size (), _faces, _insideFaceIndices, _insideFaces);
 
-      // set surface vertex flags
-      for (unsigned int i = 0; i < _cells.size (); ++i){
-        for (unsigned int j = 0; j < 4; ++j){
-          if (_cells [i]._index [j] <= _maxSurfaceVertexIndex){
-            _cells [i].setExternalVertexFlag (j);
+        // read edge related structure
+        {
+          vector <unsigned int> eIndices;
+          readEdgeFiles (fpref, (**_meshVertices).size (), eIndices, _edges);
+          for (unsigned int i = 0; i < _edges.size (); ++i){
+            for (unsigned int j = 0; j < _edges [i]._numOwners; ++j){
+              updateCellEdgeInfo (i, eIndices [2*i], eIndices [2*i + 1], _cells [_edges [i]._owner [j]]);
+            }
           }
         }
-      }
-      {
-        vector <bool> surfaceFlags;
-        surfaceFlags.resize ((**_meshVertices).size (), false);
-        for (unsigned int i = 0; i < _insideFaceIndices.size (); ++i){
-          surfaceFlags [_insideFaceIndices [i]] = true;
-        }
+
+        // set surface vertex flags
         for (unsigned int i = 0; i < _cells.size (); ++i){
           for (unsigned int j = 0; j < 4; ++j){
-            if (surfaceFlags [_cells [i]._index [j]]){
-              _cells [i].setInternalVertexFlag (j);
+            if (_cells [i]._index [j] <= _maxSurfaceVertexIndex){
+              _cells [i].setExternalVertexFlag (j);
+            }
+          }
+        }
+        {
+          vector <bool> surfaceFlags;
+          surfaceFlags.resize ((**_meshVertices).size (), false);
+          for (unsigned int i = 0; i < _insideFaceIndices.size (); ++i){
+            surfaceFlags [_insideFaceIndices [i]] = true;
+          }
+          for (unsigned int i = 0; i < _cells.size (); ++i){
+            for (unsigned int j = 0; j < 4; ++j){
+              if (surfaceFlags [_cells [i]._index [j]]){
+                _cells [i].setInternalVertexFlag (j);
+              }
             }
           }
         }
@@ -450,6 +484,10 @@ namespace SF {
           }
         }
         unsigned int psize = static_cast <unsigned int> (atoi (pStr.c_str ()));
+        if (!partitionSizes.empty () && partitionSizes.size () != psize){
+          PRINT ("warning: submesh %u was balanced into %lu partitions, not %u: splitting it into slabs\n", index, partitionSizes.size (), psize);
+          partitionSizes.clear ();
+        }
         _partitions.reserve (psize);
         _partitions.resize (psize);
 
@@ -503,6 +541,16 @@ namespace SF {
           _partitions [i]._bbox._v [1]._v [minAxis1] = _bbox._v [1]._v [minAxis1];
           _partitions [i]._bbox._v [1]._v [minAxis2] = _bbox._v [1]._v [minAxis2];
 
+          // balanced partitions start from a vertex of their first cell, and updateBounds grows them around all of it
+          if (!partitionSizes.empty () && partitionSizes [i]){
+            unsigned int first = 0;
+            for (unsigned int j = 0; j < i; ++j){
+              first += partitionSizes [j];
+            }
+            const vec &v = vecs->at (_cells [first]._index [0]);
+            _partitions [i]._bbox._v [0] = _partitions [i]._bbox._v [1] = v;
+          }
+
           _partitions [i]._vertInfo = _vertexInfo;
           _partitions [i]._tex2D = &_meshSurfaceVertexTexCoords;
           _partitions [i]._tex3D = _meshVertexTexCoords;
@@ -525,8 +573,25 @@ namespace SF {
         }
       }
 
-      // reshuffle elements to align them with partitions
-      reshuffleElements (index);
+      // reshuffle elements to align them with partitions (cached elements are aligned already)
+      if (cache){
+        const unsigned int *ranges = NULL;
+        size_t numRanges = 0;
+        if (!cache->get (cacheSection (index, XFE_CACHE_PARTITIONS), ranges, numRanges) || numRanges != 6*_partitions.size ()){
+          PRINT ("fatal error: partitions of submesh %u do not match its topology cache\n", index);
+          exit (EXIT_FAILURE);
+        }
+        for (unsigned int i = 0; i < _partitions.size (); ++i, ranges += 6){
+          _partitions [i]._cellStartIndex = ranges [0];
+          _partitions [i]._cellEndIndex = ranges [1];
+          _partitions [i]._exFaceStartIndex = ranges [2];
+          _partitions [i]._exFaceEndIndex = ranges [3];
+          _partitions [i]._inFaceStartIndex = ranges [4];
+          _partitions [i]._inFaceEndIndex = ranges [5];
+        }
+      } else {
+        reshuffleElements (index, partitionSizes);
+      }
 
       // update bounds
       updateBounds ();
@@ -535,6 +600,77 @@ namespace SF {
 		// destructor
 		Submesh::~Submesh () { }
 
+		// private method to take the topology of this submesh from its mesh's binary cache
+		bool
+		Submesh::readCache (const BinaryCacheReader &cache)
+		{
+      const unsigned int *edges = NULL, *owners = NULL;
+      size_t numEdges = 0, numOwners = 0;
+      if (!cache.get (cacheSection (_myIndex, XFE_CACHE_CELLS), _cells) || !cache.get (cacheSection (_myIndex, XFE_CACHE_FACES), _faces)
+          || !cache.get (cacheSection (_myIndex, XFE_CACHE_INSIDE_FACE_INDICES), _insideFaceIndices)
+          || !cache.get (cacheSection (_myIndex, XFE_CACHE_INSIDE_FACES), _insideFaces)
+          || !cache.get (cacheSection (_myIndex, XFE_CACHE_EDGES), edges, numEdges)
+          || !cache.get (cacheSection (_myIndex, XFE_CACHE_EDGE_OWNERS), owners, numOwners) || numEdges % 2){
+        return false;
+      }
+
+      // edges are stored as (first vertex, number of owners) with the owners of all edges in one array
+      _edges.resize (numEdges/ 2);
+      size_t o = 0;
+      for (unsigned int i = 0; i < _edges.size (); ++i){
+        unsigned int n = edges [2*i + 1];
+        if (o + n > numOwners){
+          return false;
+        }
+        _edges [i] = Edge (edges [2*i], n, const_cast <unsigned int *> (owners + o));
+        o += n;
+      }
+      return o == numOwners;
+		}
+
+		// method to add the topology of this submesh to its mesh's binary cache (call right after construction)
+		void
+		Submesh::writeCache (BinaryCacheWriter &cache) const
+		{
+      cache.add (cacheSection (_myIndex, XFE_CACHE_CELLS), _cells);
+      cache.add (cacheSection (_myIndex, XFE_CACHE_FACES), _faces);
+      cache.add (cacheSection (_myIndex, XFE_CACHE_INSIDE_FACE_INDICES), _insideFaceIndices);
+      cache.add (cacheSection (_myIndex, XFE_CACHE_INSIDE_FACES), _insideFaces);
+
+      vector <unsigned int> edges, owners;
+      edges.reserve (2*_edges.size ());
+      for (unsigned int i = 0; i < _edges.size (); ++i){
+        edges.push_back (_edges [i]._firstVertex);
+        edges.push_back (_edges [i]._numOwners);
+        owners.insert (owners.end (), _edges [i]._owner, _edges [i]._owner + _edges [i]._numOwners);
+      }
+      cache.copy (cacheSection (_myIndex, XFE_CACHE_EDGES), edges);
+      cache.copy (cacheSection (_myIndex, XFE_CACHE_EDGE_OWNERS), owners);
+
+      vector <unsigned int> ranges;
+      ranges.reserve (6*_partitions.size ());
+      for (unsigned int i = 0; i < _partitions.size (); ++i){
+        ranges.push_back (_partitions [i]._cellStartIndex);
+        ranges.push_back (_partitions [i]._cellEndIndex);
+        ranges.push_back (_partitions [i]._exFaceStartIndex);
+        ranges.push_back (_partitions [i]._exFaceEndIndex);
+        ranges.push_back (_partitions [i]._inFaceStartIndex);
+        ranges.push_back (_partitions [i]._inFaceEndIndex);
+      }
+      cache.copy (cacheSection (_myIndex, XFE_CACHE_PARTITIONS), ranges);
+		}
+
+		// method to move the arrays used by cutting jobs to memory local to the calling thread
+		void
+		Submesh::relocate ()
+		{
+		  firstTouch (_faces);
+		  firstTouch (_insideFaceIndices);
+		  firstTouch (_insideFaces);
+		  firstTouch (_edges);
+		  firstTouch (_cells);
+		}
+
 		// method to update bounds
 		void
 		Submesh::updateBounds ()
@@ -605,7 +741,7 @@ namespace SF {
 
     // shuffle cells and other info-structures so that cells with bordering vertices get pushed to the front and compartmentalized into partitions
     void
-    Submesh::reshuffleElements (unsigned int myindex)
+    Submesh::reshuffleElements (unsigned int myindex, const vector <unsigned int> &partitionSizes)
     {
       // no reshuffling required for one partition in submesh
       if (_partitions.size () < 2){
@@ -623,8 +759,19 @@ namespace SF {
       // get partition index of cells
       vector <unsigned int> partitionIndex;
       partitionIndex.resize (_cells.size ());
-      for (unsigned int i = 0; i < partitionIndex.size (); ++i){
-        partitionIndex [i] = getCellPartitionIndex (_partitions, _cells [i], **_meshVertices);
+      if (partitionSizes.empty ()){
+        for (unsigned int i = 0; i < partitionIndex.size (); ++i){
+          partitionIndex [i] = getCellPartitionIndex (_partitions, _cells [i], **_meshVertices);
+        }
+      } else {
+        // balanced partitions come one after the other in the cell file
+        unsigned int p = 0, end = partitionSizes [0];
+        for (unsigned int i = 0; i < partitionIndex.size (); ++i){
+          while (i >= end){
+            end += partitionSizes [++p];
+          }
+          partitionIndex [i] = p;
+        }
       }
 
       /******************* RESHUFFLE CELLS RELATED DATA STRUCTURES AMONG SUBMESH PARTITIONS *******************/
@@ -947,7 +1094,7 @@ namespace SF {
       _partitions [_partitions.size () - 1]._inFaceEndIndex = _insideFaces.size () - 1;
     }
 
-		// private method to initialize OpenGL parameters
+		// method to initialize OpenGL parameters (needs the mesh's GL context current)
 		void
 		Submesh::initGLAttribs (const string &config)
 		{
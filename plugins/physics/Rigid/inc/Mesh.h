@@ -30,63 +30,74 @@
 namespace SF {
 
   class aabb;
+  class mat4x4;
   class Driver;
-  class ThreadControl;
+  class StageControl;
+  class TripleBuffer;
 
   namespace RM {
 
     class Mesh : public Resource {
 
     public:
-      aabb _bbox;
-      bool _transformFlag; // flag to switch between two vertex buffers
+      aabb _bbox; // world-space bounding box (follows the pose while the body moves)
+      aabb _modelBox; // bounding box of the model-space vertices
+      bool _transformFlag; // flag to denote motion of the body
 
       /************************ THREADCONTROL RELATED PARAMETERS *************************/
-      ThreadControl _syncControl;
-      int _semPhysicsWaitIndex;
-      int _semPhysicsPostIndex;
-      int _semCollisionWaitIndex;
-      int _semCollisionPostIndex;
-      int _semIntersectionWaitIndex;
-      int _semIntersectionPostIndex;
-      int _semGraphicsWaitIndex;
-      int _semGraphicsPostIndex;
+      StageControl _syncControl;
 
       /************************ DATA RELATED PARAMETERS *************************/
       size_t _numSurfaceVertices;
-      vector <vec> _vertices [2]; // on-host memory surface vertex buffers
-      vector <vec> *_curr;
-      vector <vec> *_prev;
+      vector <vec> _vertices; // on-host memory model-space surface vertices (never modified)
+
+      mat4x4 _pose [2]; // model-to-world transforms (double buffered)
+      mat4x4 *_currPose;
+      mat4x4 *_prevPose;
+      mat4x4 _poseSnapshot [3]; // poses handed to graphics when synchronizing lock-free (see _state)
+
+      /**
+       * Pose and box handed lock-free to the threads of other resources that
+       * follow the body (e.g. deformable meshes it touches). A TripleBuffer
+       * has one consumer, so every reader brings its own buffer and slots.
+       */
+      struct Watcher {
+        TripleBuffer *_state;
+        mat4x4 *_poses; // three slots indexed by _state
+        aabb *_boxes; // and the boxes of these poses
+      };
+      vector <Watcher> _watchers;
 
       vector <size_t> _numFaces;
       vector <vector <unsigned int> > _faceIndices;
 
-      // vertices and indices for blade edge
-      vector <vec> *_bladeCurr;
-      vector <vec> *_bladePrev;
+      // model-space vertices and indices for blade edge
+      vector <vec> *_bladeVertices;
       vector <unsigned int> *_bladeIndices;
 
       /************************ OPENGL RELATED PARAMETERS *************************/
-      bool _glBufferFlag; // flag to switch between two vertex buffers
+      bool _glBufferFlag; // flag to switch between two poses
       bool _glReprogramFlag; // flag to denote reloading of rendering programs
+      bool _glNormalFlag; // flag to denote (re)calculation of model-space normals
 
       GLuint _glNormalFramebufferDimensions [2]; // normal framebuffer dimensions
       GLuint _glNormalFramebufferId; // on-device framebuffer holding render texture
       GLuint _glNormalTexCoordBufferId; // on-device texture coordinate buffer
       GLuint _glNormalTextureId; // on-device 2D render texture for storing normals
-      GLuint _glNormalVertexArrayId [2]; // vertex array to hold the buffers
+      GLuint _glNormalVertexArrayId; // vertex array to hold the buffers
 
       GLuint _glEnvTextureId; // environment map ID (optional)
 
-      GLuint _glVertexBufferId [2]; // on-device memory vertex buffers
+      GLuint _glVertexBufferId; // on-device memory model-space vertex buffer
       GLuint _glIndexBufferId; // indexed triangles for each octant
-      GLuint _glRenderVertexArrayId [2]; // vertex buffer used by rendering programs (2*number-of-submeshes)
+      GLuint _glRenderVertexArrayId; // vertex array used by rendering program
 
       GLint _glEnvTextureLocation;
 
       // program variable locations (Rendering program 1)
       GLint _glModelviewMatrixLocation;
       GLint _glProjectionMatrixLocation;
+      GLint _glPoseMatrixLocation;
       GLint _glNormalTextureLocation;
       GLint _glColorLocation;
 
@@ -136,6 +147,15 @@ namespace SF {
 
       void run (); // run method
       void move (); // method to move
+      void updateBounds (); // method to place the bounding box with the current pose
+
+      // method to register a reader of the pose and box (before the threads start)
+      inline void
+      watch (TripleBuffer *state, mat4x4 *poses, aabb *boxes)
+      {
+        Watcher w = {state, poses, boxes};
+        _watchers.push_back (w);
+      }
       bool initGPUPrograms (); // initializes all GPU programs
 
     private:
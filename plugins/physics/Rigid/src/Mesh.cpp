@@ -42,8 +42,10 @@ extern "C" {
 #include "mat4x4.h"
 #include "aabb.h"
 #include "GL/common.h"
+#include "IO/TextReader.h"
 
-#include "ThreadControl.h"
+#include "StageControl.h"
+#include "TripleBuffer.h"
 #include "Driver.h"
 #include "Display.h"
 
@@ -73,17 +75,19 @@ namespace SF {
     {
       assert (!file.empty ());
 
-      FILE *fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      char header [32];
-      int status = fscanf (fp, "%s\n", header);
-      assert (status != 0);
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
 
+      string header;
       int nverts = 0, nfaces = 0, nedges = 0;
-      status = fscanf (fp, "%d %d %d\n", &nverts, &nfaces, &nedges);
-      assert (status != 0);
-      assert (nverts > 0 && (nfaces > 0 || nedges > 0));
+      if (!reader.read (header) || !reader.read (nverts) || !reader.read (nfaces) || !reader.read (nedges)
+          || nverts <= 0 || nfaces < 0 || nedges < 0 || (!nfaces && !nedges)){
+        PRINT ("fatal error: invalid header in %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
 
       // read vertex data
       real tmpr [SF_VECTOR_SIZE] = {0., 0., 0.
@@ -91,42 +95,25 @@ namespace SF {
         , 1.
 #endif
       };
-      verts.reserve (static_cast <size_t> (nverts));
+      bool status = true;
+      verts.resize (static_cast <size_t> (nverts), vec (tmpr));
       for (int i = 0; i < nverts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-        status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-        status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-        assert (status != 0);
-        verts.push_back (vec (tmpr));
+        status = status && reader.read (verts [i]._v, 3);
       }
 
-      int dummy;
-      int tmpd [3];
-      if (nfaces){
-        for (int i = 0; i < nfaces; ++i){
-          status = fscanf (fp, "%d %d %d %d\n", &dummy, &(tmpd [0]), &(tmpd [1]), &(tmpd [2]));
-          assert (status != 0);
-          assert (tmpd [0] >= 0 && tmpd [0] < nverts);
-          assert (tmpd [1] >= 0 && tmpd [1] < nverts);
-          assert (tmpd [2] >= 0 && tmpd [2] < nverts);
-          for (int j = 0; j < 3; ++j){
-            indices.push_back ( static_cast <unsigned int> (tmpd [j]));
-          }
-        }
-      } else if (nedges){
-        for (int i = 0; i < nedges; ++i){
-          status = fscanf (fp, "%d %d %d\n", &dummy, &(tmpd [0]), &(tmpd [1]));
-          assert (status != 0);
-          assert (tmpd [0] >= 0 && tmpd [0] < nverts);
-          assert (tmpd [1] >= 0 && tmpd [1] < nverts);
-          for (int j = 0; j < 2; ++j){
-            indices.push_back ( static_cast <unsigned int> (tmpd [j]));
-          }
-        }
+      // read faces (or edges if there are none), dropping the vertex count in front of each
+      unsigned int perElement = nfaces ? 3 : 2, numElements = static_cast <unsigned int> (nfaces ? nfaces : nedges), dummy;
+      indices.resize (perElement*numElements);
+      for (unsigned int i = 0; i < numElements; ++i){
+        status = status && reader.read (dummy) && reader.read (&(indices [perElement*i]), perElement);
+      }
+      if (!status){
+        PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      for (unsigned int i = 0; i < indices.size (); ++i){
+        assert (indices [i] < static_cast <unsigned int> (nverts));
       }
-      fclose (fp);
       return true;
     }
 
@@ -135,7 +122,7 @@ namespace SF {
     {
 	    Mesh* mptr = dynamic_cast <Mesh *> (&r);
 
-	    mptr->_syncControl [mptr->_semGraphicsWaitIndex].wait ();
+	    mptr->_syncControl.wait (GRAPHICS_STAGE);
 #ifndef NDEBUG
       GLenum error;
 #endif
@@ -151,95 +138,75 @@ namespace SF {
 
       /************************ RENDERING OF NORMALS HAPPENS HERE ************************/
 
-      // update data
-      if (!mptr->_glBufferFlag){
-        glBindBuffer (GL_ARRAY_BUFFER, mptr->_glVertexBufferId [0]);
-#ifndef NDEBUG
-        checkGLError (error);
-#endif
-        glBufferSubData (GL_ARRAY_BUFFER, 0, sizeof (real)*SF_VECTOR_SIZE*mptr->_numSurfaceVertices, &(mptr->_vertices [0] [0]));
-#ifndef NDEBUG
-        checkGLError (error);
-#endif
-      } else {
-        glBindBuffer (GL_ARRAY_BUFFER, mptr->_glVertexBufferId [1]);
-#ifndef NDEBUG
-        checkGLError (error);
-#endif
-        glBufferSubData (GL_ARRAY_BUFFER, 0, sizeof (real)*SF_VECTOR_SIZE*mptr->_numSurfaceVertices, &(mptr->_vertices [1] [0]));
-#ifndef NDEBUG
-        checkGLError (error);
-#endif
-      }
-      glBindBuffer (GL_ARRAY_BUFFER, 0);
+      // model-space vertices never change, so normals are only rendered when programs are (re)loaded
+      if (mptr->_glNormalFlag){
 
-      glUseProgram (mptr->_glProgram [0]);
+        glUseProgram (mptr->_glProgram [0]);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
 
-      glClampColor (GL_CLAMP_VERTEX_COLOR, GL_FALSE);
-      glClampColor (GL_CLAMP_READ_COLOR, GL_FALSE);
-      glClampColor (GL_CLAMP_FRAGMENT_COLOR, GL_FALSE);
+        glClampColor (GL_CLAMP_VERTEX_COLOR, GL_FALSE);
+        glClampColor (GL_CLAMP_READ_COLOR, GL_FALSE);
+        glClampColor (GL_CLAMP_FRAGMENT_COLOR, GL_FALSE);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
 
-      glEnable (GL_BLEND);
-      glBlendFunc (GL_ONE, GL_ONE);
+        glEnable (GL_BLEND);
+        glBlendFunc (GL_ONE, GL_ONE);
 
-      // bind normal frame buffer and render
-      glBindFramebuffer (GL_FRAMEBUFFER, mptr->_glNormalFramebufferId);
+        // bind normal frame buffer and render
+        glBindFramebuffer (GL_FRAMEBUFFER, mptr->_glNormalFramebufferId);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
 
-      glPushAttrib (GL_VIEWPORT_BIT);
-      glViewport (0, 0, mptr->_glNormalFramebufferDimensions [0], mptr->_glNormalFramebufferDimensions [1]);
+        glPushAttrib (GL_VIEWPORT_BIT);
+        glViewport (0, 0, mptr->_glNormalFramebufferDimensions [0], mptr->_glNormalFramebufferDimensions [1]);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
 
-      glDrawBuffer (GL_COLOR_ATTACHMENT0);
+        glDrawBuffer (GL_COLOR_ATTACHMENT0);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
 
-      glClearColor (0, 0, 0, 0);
-      glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearColor (0, 0, 0, 0);
+        glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-      if (!mptr->_glBufferFlag){
-        glBindVertexArray (mptr->_glNormalVertexArrayId [0]);
-      } else {
-        glBindVertexArray (mptr->_glNormalVertexArrayId [1]);
-      }
+        glBindVertexArray (mptr->_glNormalVertexArrayId);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
-      glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mptr->_glIndexBufferId);
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mptr->_glIndexBufferId);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
-      glDrawElements (GL_TRIANGLES, mptr->_numFaces [0], GL_UNSIGNED_INT, 0);
+        glDrawElements (GL_TRIANGLES, mptr->_numFaces [0], GL_UNSIGNED_INT, 0);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
-      glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
-      glFlush ();
+        glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+        glFlush ();
 
-      glBindVertexArray (0);
-      glDrawBuffer (0);
-      glBindFramebuffer (GL_FRAMEBUFFER, 0);
-      glPopAttrib ();
-      glDisable (GL_BLEND);
+        glBindVertexArray (0);
+        glDrawBuffer (0);
+        glBindFramebuffer (GL_FRAMEBUFFER, 0);
+        glPopAttrib ();
+        glDisable (GL_BLEND);
 
-      glClampColor (GL_CLAMP_VERTEX_COLOR, GL_TRUE);
-      glClampColor (GL_CLAMP_READ_COLOR, GL_TRUE);
-      glClampColor (GL_CLAMP_FRAGMENT_COLOR, GL_TRUE);
+        glClampColor (GL_CLAMP_VERTEX_COLOR, GL_TRUE);
+        glClampColor (GL_CLAMP_READ_COLOR, GL_TRUE);
+        glClampColor (GL_CLAMP_FRAGMENT_COLOR, GL_TRUE);
 #ifndef NDEBUG
-      checkGLError (error);
+        checkGLError (error);
 #endif
-      glUseProgram (0);
+        glUseProgram (0);
+
+        mptr->_glNormalFlag = false;
+      } // end - if (mptr->_glNormalFlag)
 
       /************************ RENDERING OF EXTERNAL SURFACE HAPPENS HERE ************************/
       glUseProgram (mptr->_glProgram [1]);
@@ -256,6 +223,19 @@ namespace SF {
       checkGLError (error);
 #endif
 
+      // poses are stored row-major, hence the transpose
+      if (mptr->_state){
+        mptr->_state->acquire ();
+        glUniformMatrix4fv (mptr->_glPoseMatrixLocation, 1, true, mptr->_poseSnapshot [mptr->_state->readIndex ()]._m);
+      } else if (mptr->_glBufferFlag){
+        glUniformMatrix4fv (mptr->_glPoseMatrixLocation, 1, true, mptr->_pose [1]._m);
+      } else {
+        glUniformMatrix4fv (mptr->_glPoseMatrixLocation, 1, true, mptr->_pose [0]._m);
+      }
+#ifndef NDEBUG
+      checkGLError (error);
+#endif
+
       glUniform3f (mptr->_glColorLocation, mptr->_glColor [0], mptr->_glColor [1], mptr->_glColor [2]);
 #ifndef NDEBUG
       checkGLError (error);
@@ -329,11 +309,7 @@ namespace SF {
 #endif
       }
 
-      if (mptr->_glBufferFlag){
-        glBindVertexArray (mptr->_glRenderVertexArrayId [1]);
-      } else {
-        glBindVertexArray (mptr->_glRenderVertexArrayId [0]);
-      }
+      glBindVertexArray (mptr->_glRenderVertexArrayId);
 #ifndef NDEBUG
       checkGLError (error);
 #endif
@@ -353,7 +329,7 @@ namespace SF {
       glBindTexture (GL_TEXTURE_CUBE_MAP, 0);
       glUseProgram (0);
 
-	    mptr->_syncControl [mptr->_semGraphicsPostIndex].post ();
+	    mptr->_syncControl.post (GRAPHICS_STAGE);
     }
 
 		// protected constructor and assignment functions
@@ -364,16 +340,13 @@ namespace SF {
 		// only legitimate constructor
 		Mesh::Mesh (const string &config, Driver &driver)
 		: _transformFlag (false),
-		_semPhysicsWaitIndex (-1), _semPhysicsPostIndex (-1),
-		_semCollisionWaitIndex (-1), _semCollisionPostIndex (-1),
-    _semIntersectionWaitIndex (-1), _semIntersectionPostIndex (-1),
-    _semGraphicsWaitIndex (-1), _semGraphicsPostIndex (-1),
-    _numSurfaceVertices (0), _curr (&(_vertices [0])), _prev (&(_vertices [1])),
-    _bladeCurr (NULL), _bladePrev (NULL), _bladeIndices (NULL),
-    _glBufferFlag (false), _glReprogramFlag (false),
-    _glNormalFramebufferId (0), _glNormalTexCoordBufferId (0), _glNormalTextureId (0),
-    _glEnvTextureId (driver._display.get ()->_glEnvTextureId), _glIndexBufferId (0), _glEnvTextureLocation (-1),
-    _glModelviewMatrixLocation (-1), _glProjectionMatrixLocation (-1), _glNormalTextureLocation (-1), _glColorLocation (-1),
+		_numSurfaceVertices (0), _currPose (&(_pose [0])), _prevPose (&(_pose [1])),
+    _bladeVertices (NULL), _bladeIndices (NULL),
+    _glBufferFlag (false), _glReprogramFlag (false), _glNormalFlag (true),
+    _glNormalFramebufferId (0), _glNormalTexCoordBufferId (0), _glNormalTextureId (0), _glNormalVertexArrayId (0),
+    _glEnvTextureId (driver._display.get ()->_glEnvTextureId), _glVertexBufferId (0), _glIndexBufferId (0), _glRenderVertexArrayId (0),
+    _glEnvTextureLocation (-1),
+    _glModelviewMatrixLocation (-1), _glProjectionMatrixLocation (-1), _glPoseMatrixLocation (-1), _glNormalTextureLocation (-1), _glColorLocation (-1),
     _glLightDirLocation1 (-1), _glLightAmbLocation1 (-1), _glLightDiffLocation1 (-1), _glLightSpecLocation1 (-1), _glLightExpLocation1 (-1),
     _glLightDirLocation2 (-1), _glLightAmbLocation2 (-1), _glLightDiffLocation2 (-1), _glLightSpecLocation2 (-1), _glLightExpLocation2 (-1),
     _glNumLights (driver._display.get ()->_numLights),
@@ -399,28 +372,23 @@ namespace SF {
 				// initialize faceIndices structure
 				_faceIndices.reserve (1);
 				_faceIndices.push_back (vector <unsigned int> ());
-				readOFFMeshFile (file, _vertices [0], _faceIndices [0]);
+				readOFFMeshFile (file, _vertices, _faceIndices [0]);
 
-				_numSurfaceVertices = _vertices [0].size ();
+				_numSurfaceVertices = _vertices.size ();
 
-				_numFaces.reserve (1);
-				_numFaces.push_back (_faceIndices [0].size ());
-
-				vec3 min (_vertices [0][0]._v [0], _vertices [0][0]._v [1], _vertices [0][0]._v [2]);
+				vec3 min (_vertices [0]._v [0], _vertices [0]._v [1], _vertices [0]._v [2]);
 				vec3 max (min);
-
-				for (size_t i = 1; i < _vertices [0].size (); ++i){
-          for (int j = 0; j < 3; ++j){
-            if (min._v [j] > _vertices [0][i]._v [j]){
-              min._v [j] = _vertices [0][i]._v [j];
-            } else if (max._v [j] < _vertices [0][i]._v [j]){
-              max._v [j] = _vertices [0][i]._v [j];
-            }
-          }
+				for (size_t i = 1; i < _numSurfaceVertices; ++i){
+				  for (int j = 0; j < 3; ++j){
+				    min._v [j] = min._v [j] > _vertices [i]._v [j] ? _vertices [i]._v [j] : min._v [j];
+				    max._v [j] = max._v [j] < _vertices [i]._v [j] ? _vertices [i]._v [j] : max._v [j];
+				  }
 				}
-				_bbox = aabb (min, max);
+				_modelBox = aabb (min, max);
+
+				_numFaces.reserve (1);
+				_numFaces.push_back (_faceIndices [0].size ());
       }
-      _vertices [1] = _vertices [0];
 
       // add blade-related parameters if body is of
       {
@@ -432,33 +400,20 @@ namespace SF {
           getConfigParameter (config, "cut_data", bladeFile);
           assert (!bladeFile.empty ());
 
-          _bladeCurr = new vector <vec> ();
+          _bladeVertices = new vector <vec> ();
           _bladeIndices = new vector <unsigned int> ();
 
-          readOFFMeshFile (bladeFile, *_bladeCurr, *_bladeIndices);
-
-          _bladePrev = new vector <vec> (*_bladeCurr);
+          readOFFMeshFile (bladeFile, *_bladeVertices, *_bladeIndices);
         }
       }
 
-      // add any additional displacement vector to node
+      // initialize pose (vertices stay in model space; orientation and any displacement vector go into the pose)
       {
         mat4x4 m (1., 0., 0., 0.,
                   0., 0., 1., 0.,
                   0., -1., 0., 0.,
                   0., 0., 0., 1.);
-        for (unsigned int i = 0; i < _numSurfaceVertices; ++i){
-          _vertices [0] [i] = m * _vertices [0] [i];
-        }
-        for (unsigned int i = 0; i < _numSurfaceVertices; ++i){
-          _vertices [1] [i] = m * _vertices [1] [i];
-        }
-        for (unsigned int i = 0; i < _bladeCurr->size (); ++i){
-          _bladeCurr->at (i) = m * _bladeCurr->at (i);
-        }
-        for (unsigned int i = 0; i < _bladePrev->size (); ++i){
-          _bladePrev->at (i) = m * _bladePrev->at (i);
-        }
+
         string dispStr;
         getConfigParameter (config, "displacement_vector", dispStr);
         if (!dispStr.empty ()){
@@ -481,119 +436,63 @@ namespace SF {
             assert (isdigit (z [i]) || z [i] == '.' || z [i] == '-');
           }
 
-          real disp [3] = {static_cast <real> (atof (x.c_str ())), static_cast <real> (atof (y.c_str ())), static_cast <real> (atof (z.c_str ()))};
-
-          for (size_t i = 0; i < _numSurfaceVertices; ++i){
-            for (int j = 0; j < 3; ++j){
-              _vertices [0][i]._v [j] += disp [j];
-            }
-          }
-
-          for (size_t i = 0; i < _numSurfaceVertices; ++i){
-            for (int j = 0; j < 3; ++j){
-              _vertices [1][i]._v [j] += disp [j];
-            }
-          }
+          m._m [3] = static_cast <real> (atof (x.c_str ()));
+          m._m [7] = static_cast <real> (atof (y.c_str ()));
+          m._m [11] = static_cast <real> (atof (z.c_str ()));
+        }
+        _pose [0] = m;
+        _pose [1] = m;
 
-          for (size_t i = 0; i < _bladeCurr->size (); ++i){
-            for (int j = 0; j < 3; ++j){
-              _bladeCurr->at (i)._v [j] += disp [j];
-            }
-          }
+        // bounding box of the posed body
+        vec tmpv = m * _vertices [0];
+        vec3 min (tmpv._v [0], tmpv._v [1], tmpv._v [2]);
+        vec3 max (min);
 
-          for (size_t i = 0; i < _bladePrev->size (); ++i){
-            for (int j = 0; j < 3; ++j){
-              _bladePrev->at (i)._v [j] += disp [j];
+        for (size_t i = 1; i < _numSurfaceVertices; ++i){
+          tmpv = m * _vertices [i];
+          for (int j = 0; j < 3; ++j){
+            if (min._v [j] > tmpv._v [j]){
+              min._v [j] = tmpv._v [j];
+            } else if (max._v [j] < tmpv._v [j]){
+              max._v [j] = tmpv._v [j];
             }
           }
         }
+        _bbox = aabb (min, max);
       }
 
       /*************************** INITIALIZE THREAD CONTROL PARAMETERS ***************************/
       {
-        string mStr;
-        getConfigParameter (config, "num_mutexes", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        unsigned int stages = 1u << PHYSICS_STAGE;
+        if (_bladeVertices){
+          stages |= 1u << INTERSECTION_STAGE;
         }
 
-        int numMutex = atoi (mStr.c_str ());
-        string msp ("mutex_startval"), msv;
-        for (int i = 0; i < numMutex; ++i){
-          mStr = msp;
-          stringstream ss;
-          ss << i + 1;
-          mStr.append (ss.str ());
-
-          getConfigParameter (config, mStr.c_str (), msv);
-          assert (!msv.empty ());
-          for (size_t j = 0; j < msv.size (); ++j){
-            assert (isdigit (msv [j]));
+        // with graphics_sync="lockfree" the renderer reads the latest published pose and never blocks
+        string syncStr;
+        getConfigParameter (config, "graphics_sync", syncStr);
+        if (!syncStr.compare ("lockfree")){
+          _state = boost::shared_ptr <TripleBuffer> (new TripleBuffer ());
+          for (int i = 0; i < 3; ++i){
+            _poseSnapshot [i] = _pose [0];
           }
-          _syncControl.push_back (static_cast <unsigned int> (atoi (msv.c_str ())));
-        }
-
-        getConfigParameter (config, "physics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "physics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semPhysicsPostIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionWaitIndex = atoi (mStr.c_str ());
-
-        getConfigParameter (config, "collision_post_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
-        }
-        _semCollisionPostIndex = atoi (mStr.c_str ());
-
-        if (_bladeCurr){
-          getConfigParameter (config, "intersection_wait_index", mStr);
-          assert (!mStr.empty ());
-          for (size_t i = 0; i < mStr.size (); ++i){
-            assert (isdigit (mStr [i]));
-          }
-          _semIntersectionWaitIndex = atoi (mStr.c_str ());
-
-          getConfigParameter (config, "intersection_post_index", mStr);
-          assert (!mStr.empty ());
-          for (size_t i = 0; i < mStr.size (); ++i){
-            assert (isdigit (mStr [i]));
-          }
-          _semIntersectionPostIndex = atoi (mStr.c_str ());
-        }
-
-        getConfigParameter (config, "graphics_wait_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+          _state->publish ();
+        } else {
+          stages |= 1u << GRAPHICS_STAGE;
         }
-        _semGraphicsWaitIndex = atoi (mStr.c_str ());
 
-        getConfigParameter (config, "graphics_post_index", mStr);
-        assert (!mStr.empty ());
-        for (size_t i = 0; i < mStr.size (); ++i){
-          assert (isdigit (mStr [i]));
+        if (!_syncControl.configure (config, &getConfigParameter, driver._stageGraph, stages)){
+          PRINT ("fatal error: could not set up stages for %s\n", config.c_str ());
+          exit (EXIT_FAILURE);
         }
-        _semGraphicsPostIndex = atoi (mStr.c_str ());
+        assert (_syncControl.has (PHYSICS_STAGE));
       }
 
       /*************************** INITIALIZE OPENGL PARAMETERS ***************************/
+
+      // without a GL context (headless run) only the physics state is set up
+      bool headless = driver._display.get ()->_headless;
+
       string colorStr;
       getConfigParameter (config, "color", colorStr);
       if (!colorStr.empty ()){
@@ -628,12 +527,11 @@ namespace SF {
 
       for (int i = 0; i < 2; ++i){
         _glNormalFramebufferDimensions [i] = 0;
-        _glNormalVertexArrayId [i] = 0;
-        _glVertexBufferId [i] = 0;
-        _glRenderVertexArrayId [i] = 0;
       }
 
-      initGLBufferObjects ();
+      if (!headless){
+        initGLBufferObjects ();
+      }
 
       // get names of the shading programs
       getConfigParameter (config, "normal_shader", _glProgramName [0]);
@@ -647,7 +545,9 @@ namespace SF {
       }
 
       // initialize GPU programs and update view volume
-      initGPUPrograms ();
+      if (!headless){
+        initGPUPrograms ();
+      }
 
       GL_Window *disp = driver._display.get ();
       if (_glNumLights){
@@ -679,54 +579,83 @@ namespace SF {
       draw = &plainDraw;
       reprogram = &reloadPrograms;
       transform = &toggleTransformFlag;
+      _stages = &_syncControl;
 		}
 
     // mesh's run method
     void
     Mesh::run ()
     {
-      vector <vec> *tmp;
+      mat4x4 *tmp;
 
       while (true) {
 
         // wait for physics end to get control
-        _syncControl [_semPhysicsWaitIndex].wait ();
-
-        // swap vertex buffers
-        tmp = _curr;
-        _curr = _prev;
-        _prev = tmp;
+        _syncControl.wait (PHYSICS_STAGE);
 
-        if (_bladeCurr){
-          tmp = _bladeCurr;
-          _bladeCurr = _bladePrev;
-          _bladePrev = tmp;
-        }
+        // swap poses
+        tmp = _currPose;
+        _currPose = _prevPose;
+        _prevPose = tmp;
 
         // do useful stuff
         if (_transformFlag){
           move ();
+          updateBounds ();
+        } else {
+          *_currPose = *_prevPose;
         }
 
-        _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
+        if (_state){
+          _poseSnapshot [_state->writeIndex ()] = *_currPose;
+          _state->publish ();
+        } else {
+          _glBufferFlag = !_glBufferFlag; // should be the last line in this segment
+        }
+        for (unsigned int i = 0; i < _watchers.size (); ++i){
+          unsigned int slot = _watchers [i]._state->writeIndex ();
+          _watchers [i]._poses [slot] = *_currPose;
+          _watchers [i]._boxes [slot] = _bbox;
+          _watchers [i]._state->publish ();
+        }
 
         // release data
-        _syncControl [_semPhysicsPostIndex].post ();
+        _syncControl.post (PHYSICS_STAGE);
       }
     }
 
     void
     Mesh::move ()
     {
-      vec moveVec (-.02, 0., 0.);
-      for (unsigned int i = 0; i < _curr->size (); ++i){
-        _curr->at (i) = _prev->at (i) + moveVec;
-      }
-      if (_bladeCurr){
-        for (unsigned int i = 0; i < _bladeCurr->size (); ++i){
-          _bladeCurr->at (i) = _bladePrev->at (i) + moveVec;
+      mat4x4 moveMat (1., 0., 0., -.02,
+                      0., 1., 0., 0.,
+                      0., 0., 1., 0.,
+                      0., 0., 0., 1.);
+      *_currPose = moveMat * (*_prevPose);
+    }
+
+    /**
+     * Method to place the bounding box with the current pose: the box of the
+     * posed corners of the model-space box (looser than the posed vertices
+     * under rotation, but eight transforms a step). Other plugins get it
+     * from their watcher slots (see run), never from here.
+     */
+    void
+    Mesh::updateBounds ()
+    {
+      vec corner = _modelBox [0];
+      vec tmpv = (*_currPose) * corner;
+      vec3 min (tmpv._v [0], tmpv._v [1], tmpv._v [2]);
+      vec3 max (min);
+      for (int i = 1; i < 8; ++i){
+        corner = _modelBox [i];
+        tmpv = (*_currPose) * corner;
+        for (int j = 0; j < 3; ++j){
+          min._v [j] = min._v [j] > tmpv._v [j] ? tmpv._v [j] : min._v [j];
+          max._v [j] = max._v [j] < tmpv._v [j] ? tmpv._v [j] : max._v [j];
         }
       }
+      _bbox = aabb (min, max);
     }
 
     // method to initialize all GPU programs
@@ -753,38 +682,51 @@ namespace SF {
       glBindFragDataLocation (_glProgram [0], 0, "fragColor");
       checkGLError (error);
 
-      glGenVertexArrays (2, _glNormalVertexArrayId);
+      glGenVertexArrays (1, &_glNormalVertexArrayId);
       checkGLError (error);
 
-      for (int i = 0; i < 2; ++i){
-
-        glBindVertexArray (_glNormalVertexArrayId [i]);
-        checkGLError (error);
-        glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId [i]);
-        checkGLError (error);
-        glVertexAttribPointer (vertLocation, SF_VECTOR_SIZE, GL_FLOAT, GL_FALSE, 0, 0);
-        checkGLError (error);
-        glEnableVertexAttribArray (vertLocation);
-        checkGLError (error);
+      glBindVertexArray (_glNormalVertexArrayId);
+      checkGLError (error);
+      glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId);
+      checkGLError (error);
+      glVertexAttribPointer (vertLocation, SF_VECTOR_SIZE, GL_FLOAT, GL_FALSE, 0, 0);
+      checkGLError (error);
+      glEnableVertexAttribArray (vertLocation);
+      checkGLError (error);
 
-        glBindBuffer (GL_ARRAY_BUFFER, _glNormalTexCoordBufferId);
-        checkGLError (error);
-        glVertexAttribPointer (texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
-        checkGLError (error);
-        glEnableVertexAttribArray (texCoordLocation);
-        checkGLError (error);
+      glBindBuffer (GL_ARRAY_BUFFER, _glNormalTexCoordBufferId);
+      checkGLError (error);
+      glVertexAttribPointer (texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+      checkGLError (error);
+      glEnableVertexAttribArray (texCoordLocation);
+      checkGLError (error);
 
-        glBindBuffer (GL_ARRAY_BUFFER, 0);
-        glBindVertexArray (0);
-      }
+      glBindBuffer (GL_ARRAY_BUFFER, 0);
+      glBindVertexArray (0);
       glUseProgram (0);
 
+      // normals have to be re-rendered with the new program
+      _glNormalFlag = true;
+
       /*************************** INITIALIZE SURFACE RENDERING PROGRAM ***************************/
       if (!initGPUProgram (false, *_glslPrefixString, _glProgramName [1], _glProgram [1])){
         PRINT ("error: could not initialize %s\n", _glProgramName [1].c_str ());
         return false;
       }
 
+      // vertices stay in model space, so a color_shader without a pose uniform (older configs) is replaced by the rigid program next to it
+      if (glGetUniformLocation (_glProgram [1], "pose") < 0){
+        size_t slash = _glProgramName [1].find_last_of ('/');
+        string rigidName (slash == string::npos ? string () : _glProgramName [1].substr (0, slash + 1));
+        rigidName.append ("rigid");
+        PRINT ("warning: color_shader %s has no pose uniform, using %s instead\n", _glProgramName [1].c_str (), rigidName.c_str ());
+        _glProgramName [1] = rigidName;
+        if (!initGPUProgram (false, *_glslPrefixString, _glProgramName [1], _glProgram [1])){
+          PRINT ("error: could not initialize %s\n", _glProgramName [1].c_str ());
+          return false;
+        }
+      }
+
       glUseProgram (_glProgram [1]);
       checkGLError (error);
 
@@ -797,6 +739,8 @@ namespace SF {
       assert (_glModelviewMatrixLocation > -1);
       _glProjectionMatrixLocation = glGetUniformLocation (_glProgram [1], "projection");
       assert (_glProjectionMatrixLocation > -1);
+      _glPoseMatrixLocation = glGetUniformLocation (_glProgram [1], "pose");
+      assert (_glPoseMatrixLocation > -1);
       _glNormalTextureLocation = glGetUniformLocation (_glProgram [1], "normalTexture");
       assert (_glNormalTextureLocation > -1);
       _glColorLocation = glGetUniformLocation (_glProgram [1], "color");
@@ -835,31 +779,28 @@ namespace SF {
       glBindFragDataLocation (_glProgram [1], 0, "fragColor");
       checkGLError (error);
 
-      glGenVertexArrays (2, _glRenderVertexArrayId);
+      glGenVertexArrays (1, &_glRenderVertexArrayId);
       checkGLError (error);
 
-      for (size_t i = 0; i < 2; ++i){
-
-        glBindVertexArray (_glRenderVertexArrayId [i]);
-        checkGLError (error);
+      glBindVertexArray (_glRenderVertexArrayId);
+      checkGLError (error);
 
-        glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId [i]);
-        checkGLError (error);
-        glVertexAttribPointer (vertLocation, SF_VECTOR_SIZE, GL_FLOAT, GL_FALSE, 0, 0);
-        checkGLError (error);
-        glEnableVertexAttribArray (vertLocation);
-        checkGLError (error);
+      glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId);
+      checkGLError (error);
+      glVertexAttribPointer (vertLocation, SF_VECTOR_SIZE, GL_FLOAT, GL_FALSE, 0, 0);
+      checkGLError (error);
+      glEnableVertexAttribArray (vertLocation);
+      checkGLError (error);
 
-        glBindBuffer (GL_ARRAY_BUFFER, _glNormalTexCoordBufferId);
-        checkGLError (error);
-        glVertexAttribPointer (texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
-        checkGLError (error);
-        glEnableVertexAttribArray (texCoordLocation);
-        checkGLError (error);
+      glBindBuffer (GL_ARRAY_BUFFER, _glNormalTexCoordBufferId);
+      checkGLError (error);
+      glVertexAttribPointer (texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+      checkGLError (error);
+      glEnableVertexAttribArray (texCoordLocation);
+      checkGLError (error);
 
-        glBindBuffer (GL_ARRAY_BUFFER, 0);
-        glBindVertexArray (0);
-      }
+      glBindBuffer (GL_ARRAY_BUFFER, 0);
+      glBindVertexArray (0);
       glUseProgram (0);
 
       return true;
@@ -871,17 +812,13 @@ namespace SF {
     {
       GLenum error;
 
-      glGenBuffers (2, _glVertexBufferId);
-      checkGLError (error);
-
-      glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId [0]);
-      checkGLError (error);
-      glBufferData (GL_ARRAY_BUFFER, SF_VECTOR_SIZE*sizeof (real)*_numSurfaceVertices, &(_vertices [0][0]), GL_DYNAMIC_DRAW);
+      // model-space vertices are uploaded once; motion is applied through the pose uniform
+      glGenBuffers (1, &_glVertexBufferId);
       checkGLError (error);
 
-		  glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId [1]);
+      glBindBuffer (GL_ARRAY_BUFFER, _glVertexBufferId);
       checkGLError (error);
-		  glBufferData (GL_ARRAY_BUFFER, SF_VECTOR_SIZE*sizeof (real)*_vertices [1].size (), &(_vertices [1][0]), GL_DYNAMIC_DRAW);
+      glBufferData (GL_ARRAY_BUFFER, SF_VECTOR_SIZE*sizeof (real)*_numSurfaceVertices, &(_vertices [0]), GL_STATIC_DRAW);
       checkGLError (error);
       glBindBuffer (GL_ARRAY_BUFFER, 0);
 
@@ -40,7 +40,9 @@ extern "C" {
 
 #include "Preprocess.h"
 #include "aabb.h"
-#include "ThreadControl.h"
+#include "mat4x4.h"
+#include "StageControl.h"
+#include "WorkerPool.h"
 #include "Plugin.h"
 #include "Driver.h"
 #include "Display.h"
@@ -99,6 +101,7 @@ namespace SF {
   // plugin constructor
   EXPORT
   Plugin::Plugin (const string &config, Driver &driver)
+  : _pool (&(driver._pool))
   {
 		// parse input configuration files
 		vector <string> configFiles;
@@ -146,11 +149,8 @@ namespace SF {
 	void
 	Plugin::run ()
 	{
-    _threads = new boost::thread [_resources.size ()];
-
     for (size_t i = 0; i < _resources.size (); ++i){
-      boost::thread xm (&SF::RM::Mesh::run, dynamic_cast <SF::RM::Mesh *> (_resources.at (i).get ()));
-      _threads [i] = boost::move (xm);
+      _pool->spawn (boost::bind (&SF::RM::Mesh::run, dynamic_cast <SF::RM::Mesh *> (_resources.at (i).get ())), PHYSICS_STAGE, _resources.at (i).get ());
     }
     PRINT ("libRigid threads started\n");
 	}
@@ -24,6 +24,7 @@
 
 #include "Collide/triTriCollide.h"
 #include "Collide/lineTriCollide.h"
+#include "IO/TextReader.h"
 
 #ifdef SF_VECTOR3_ENABLED
 #include "vec3.h"
@@ -38,17 +39,19 @@ using namespace SF;
     {
       assert (!file.empty ());
 
-      FILE *fp = fopen (file.c_str (), "r");
-      assert (fp);
-
-      char header [32];
-      int status = fscanf (fp, "%s\n", header);
-      assert (status != 0);
+      TextReader reader;
+      if (!reader.open (file)){
+        PRINT ("fatal error: could not open %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
 
+      string header;
       int nverts = 0, nfaces = 0, nedges = 0;
-      status = fscanf (fp, "%d %d %d\n", &nverts, &nfaces, &nedges);
-      assert (status != 0);
-      assert (nverts > 0 && (nfaces > 0 || nedges > 0));
+      if (!reader.read (header) || !reader.read (nverts) || !reader.read (nfaces) || !reader.read (nedges)
+          || nverts <= 0 || nfaces < 0 || nedges < 0 || (!nfaces && !nedges)){
+        PRINT ("fatal error: invalid header in %s\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
 
       // read vertex data
       real tmpr [SF_VECTOR_SIZE] = {0., 0., 0.
@@ -56,42 +59,25 @@ using namespace SF;
         , 1.
 #endif
       };
-      verts.reserve (static_cast <size_t> (nverts));
+      bool status = true;
+      verts.resize (static_cast <size_t> (nverts), vec (tmpr));
       for (int i = 0; i < nverts; ++i){
-#ifdef SF_DOUBLE_PRECISION
-        status = fscanf (fp, "%lf %lf %lf\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#else
-        status = fscanf (fp, "%f %f %f\n", &(tmpr [0]), &(tmpr [1]), &(tmpr [2]));
-#endif
-        assert (status != 0);
-        verts.push_back (vec (tmpr));
+        status = status && reader.read (verts [i]._v, 3);
       }
 
-      int dummy;
-      int tmpd [3];
-      if (nfaces){
-        for (int i = 0; i < nfaces; ++i){
-          status = fscanf (fp, "%d %d %d %d\n", &dummy, &(tmpd [0]), &(tmpd [1]), &(tmpd [2]));
-          assert (status != 0);
-          assert (tmpd [0] >= 0 && tmpd [0] < nverts);
-          assert (tmpd [1] >= 0 && tmpd [1] < nverts);
-          assert (tmpd [2] >= 0 && tmpd [2] < nverts);
-          for (int j = 0; j < 3; ++j){
-            indices.push_back ( static_cast <unsigned int> (tmpd [j]));
-          }
-        }
-      } else if (nedges){
-        for (int i = 0; i < nedges; ++i){
-          status = fscanf (fp, "%d %d %d\n", &dummy, &(tmpd [0]), &(tmpd [1]));
-          assert (status != 0);
-          assert (tmpd [0] >= 0 && tmpd [0] < nverts);
-          assert (tmpd [1] >= 0 && tmpd [1] < nverts);
-          for (int j = 0; j < 2; ++j){
-            indices.push_back ( static_cast <unsigned int> (tmpd [j]));
-          }
-        }
+      // read faces (or edges if there are none), dropping the vertex count in front of each
+      unsigned int perElement = nfaces ? 3 : 2, numElements = static_cast <unsigned int> (nfaces ? nfaces : nedges), dummy;
+      indices.resize (perElement*numElements);
+      for (unsigned int i = 0; i < numElements; ++i){
+        status = status && reader.read (dummy) && reader.read (&(indices [perElement*i]), perElement);
+      }
+      if (!status){
+        PRINT ("fatal error: %s is truncated or malformed\n", file.c_str ());
+        exit (EXIT_FAILURE);
+      }
+      for (unsigned int i = 0; i < indices.size (); ++i){
+        assert (indices [i] < static_cast <unsigned int> (nverts));
       }
-      fclose (fp);
       return true;
     }
 
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <cstdlib>
+#include "Topology.h"
 #include "EM_Mesh.h"
 
 namespace SF {
@@ -69,10 +70,11 @@ namespace SF {
 		FEMMesh ();
 		~FEMMesh ();
 
-		void process (const int);
+		void process (const int depth, const unsigned int numPartitions);
 
 	protected:
-		void shuffleVertices ();
+		void shuffleVertices (const vector <unsigned int> &vertSubmesh);
+		void generateTopology (const vector <FaceKey> &surface, size_t begin, size_t end);
 		void writeElementsToFiles (const string &folder, const string &prefix) const;
 	};
 }
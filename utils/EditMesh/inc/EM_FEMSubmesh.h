@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "Preprocess.h"
+#include "Topology.h"
 #include "vec4.h"
 #include "EM_common.h"
 
@@ -69,6 +70,12 @@ namespace SF {
 
 		inline edge_t& operator = (const edge_t &e)
 		{
+		  if (this == &e){
+		    return *this;
+		  }
+		  if (_nOwners){
+		    free (_owners);
+		  }
 		  _nOwners = e._nOwners;
 			_owners = (int *) malloc (_nOwners*sizeof (int));
 			memcpy (_indices, e._indices, 2*sizeof (int));
@@ -106,12 +113,11 @@ namespace SF {
     unsigned int _index;
   } CellOwner;
 
-	class aabb;
-
 	class FEMSubmesh {
 
 	public:
-		aabb _bbox;
+		// number of cells in every partition (cells are stored partition by partition)
+		vector <unsigned int> _partitionSizes;
 
 		// edges
 		vector <Edge> _edges;
@@ -134,14 +140,10 @@ namespace SF {
 		FEMSubmesh ();
 		~FEMSubmesh ();
 
-		// overloaded constructor
-		FEMSubmesh (const vec &min, const vec &max);
-
-		// method to generate topological info
-		void generateTopology (const vector <int> &faces);
+		// method to generate topological info (surface: sorted keys of the surface triangles of the whole mesh)
+		void generateTopology (const vector <FaceKey> &surface);
 
 	protected:
-    void generateFaceOwnerInfo ();
 		void generateEdgeTopology ();
 		void generateCellTopology ();
 	};
@@ -28,29 +28,43 @@ using namespace std;
 
 namespace SF {
 
-	class aabb;
+	static const unsigned int SF_MSD_LOD_LEVELS = 3; // default number of coarser surfaces per submesh
 
 	class MSDMesh : public Mesh {
 
 	private:
-		vector <aabb> _bbox;
-
 		vector <vector <int> > _trigs;
 		vector <vector <Face> > _ftop;
 
+		// coarser surfaces of every submesh, each about a quarter of the triangles of the one before
+		unsigned int _numLevels;
+		vector <vector <vector <int> > > _levels;
+
 		vector <int> _edges;
-		vector <float> _mass;
+
+		// coarse lattice of a two-level mesh (empty without one) and the embedding of every vertex in it
+		float _latticeScale; // lattice spacing in mean spring lengths (0: no lattice)
+		vector <vec3> _latticeNodes;
+		vector <float> _latticeMass; // reciprocal mass of every lattice node
+		vector <int> _latticeEdges;
+		vector <int> _embedRegions; // lattice cell of every vertex
+		vector <int> _embedNodes; // four lattice nodes per vertex (corners of the tetrahedron of the cell holding it)
+		vector <float> _embedWeights; // barycentric weights of those nodes
 
 	public:
-		MSDMesh ();
+		MSDMesh (unsigned int numLevels = SF_MSD_LOD_LEVELS, float latticeScale = 0.);
 		~MSDMesh ();
 
-		void process (const int);
+		void process (const int depth, const unsigned int numPartitions);
+		bool writeBundle (const string &folder, const string &prefix) const;
 
 	protected:
-		void shuffleVertices (const vector <aabb> &bvs);
+		void shuffleVertices (const vector <unsigned int> &vertSubmesh);
 		void generateEdgeList ();
-		void calcMassReciprocal ();
+		void generateFaceTopology (size_t begin, size_t end);
+		void generateLevels (size_t begin, size_t end);
+		void generateLattice ();
+		void getLevelData (size_t submesh, vector <int> &data) const;
 		void writeElementsToFiles (const string &folder, const string &prefix) const;
 	};
 }
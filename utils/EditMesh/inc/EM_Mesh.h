@@ -35,13 +35,14 @@ namespace SF {
 		vector< vec3 > _vertices;
 		vector< int > _cells;
 		vector <int> _faces;
+		vector <float> _mass; // reciprocal mass of every vertex
 
 	public:
 		Mesh () { }
 		virtual ~Mesh () { }
 
-		// method to process
-		virtual void process (const int) = 0;
+		// method to process into 8^depth submeshes (of numPartitions partitions each, where the format has them)
+		virtual void process (const int depth, const unsigned int numPartitions) = 0;
 
 		// method to output to files (to be customized by derived classes)
 		void writeToFiles (const string &folder, const string &prefix) const
@@ -50,6 +51,9 @@ namespace SF {
 			writeElementsToFiles (folder, prefix);
 		}
 
+		// method to output one binary bundle in the layout of the runtime (false if the format has none, or on failure)
+		virtual bool writeBundle (const string &, const string &) const { return false; }
+
 	protected:
 		// method to write geometric elements to files
 		virtual void writeElementsToFiles (const string &folder, const string &prefix) const = 0;
@@ -22,74 +22,16 @@
 
 #include <vector>
 #include <string>
+extern "C"{
+#include <stdint.h>
+}
 
 using namespace std;
 
 namespace SF {
 
 	class vec3;
-
-	typedef struct line_t {
-		int _owner;
-		int _face;
-		int _indices[2];
-
-		inline line_t ()
-		: _owner (-1), _face (-1)
-		{
-			for (int i = 0; i < 2; ++i){
-				_indices[i] = -1;
-			}
-		}
-
-		inline line_t (const int o, const int f, const int *i)
-		: _owner (o), _face (f)
-		{
-			memcpy (_indices, i, 2*sizeof (int));
-		}
-
-		inline bool operator == (const int *f) const
-		{
-			bool flags[2] = {false, false};
-			for(int i = 0; i < 2; ++i){
-				for (int j = 0; j < 2; ++j){
-					flags[i] |= (_indices[i] == f[j]);
-				}
-			}
-			return flags[0] & flags[1];
-		}
-	} Line;
-
-	typedef struct trig_t {
-		int _owner;
-		int _face;
-		int _indices[3];
-
-		inline trig_t ()
-		: _owner (-1), _face (-1)
-		{
-			for (int i = 0; i < 3; ++i){
-				_indices[i] = -1;
-			}
-		}
-
-		inline trig_t (const int o, const int f, const int *i)
-		: _owner (o), _face (f)
-		{
-			memcpy (_indices, i, 3*sizeof (int));
-		}
-
-		inline bool operator == (const int *f) const
-		{
-			bool flags[3] = {false, false, false};
-			for(int i = 0; i < 3; ++i){
-				for (int j = 0; j < 3; ++j){
-					flags[i] |= (_indices[i] == f[j]);
-				}
-			}
-			return flags[0] & flags[1] & flags[2];
-		}
-	} Trig;
+	class ArtifactCache;
 
 	typedef struct face_t {
 		int _neighbors[3];
@@ -163,4 +105,30 @@ namespace SF {
 
 	// function to examine ordering consistency in cells
 	void orderCells (bool rflag, int start, vector < int > &indices, vector <int> &faces);
+
+	// function to get the reciprocal of the mass of every vertex (a quarter of the volume of each of its cells, at unit density)
+	void calcMassReciprocal (const vector <vec3> &verts, const vector <int> &cells, vector <float> &mass);
+
+	// functions to read and write the oriented mesh (vertices, oriented cells, surface triangles and mass reciprocals),
+	// so that it is not rebuilt from the .tet file when only the depth, format or number of partitions changes
+	bool readOrientedMesh (const ArtifactCache &artifacts, const string &prefix, uint32_t key, vector <vec3> &verts, vector <int> &cells,
+	                       vector <int> &faces, vector <float> &mass);
+	bool writeOrientedMesh (const ArtifactCache &artifacts, const string &prefix, uint32_t key, const vector <vec3> &verts,
+	                        const vector <int> &cells, const vector <int> &faces, const vector <float> &mass);
+
+	// function to renumber vertices by bucket (in increasing order), and along a Morton curve within each bucket
+	// (values, if given, holds one value per vertex and is permuted along with the vertices)
+	void reorderVertices (const vector <unsigned int> &bucket, vector <vec3> &verts, vector <int> &cells, vector <int> &faces,
+	                      vector <float> *values = NULL);
+
+	// function to sort tetrahedra by bucket, and along a Morton curve through their centroids within each bucket
+	// (bucket is permuted along with the cells)
+	void sortCells (const vector <vec3> &verts, vector <unsigned int> &bucket, vector <int> &cells);
+
+	// function to split every part of the cells into numParts balanced parts by recursive coordinate bisection
+	// (part p becomes parts p*numParts to p*numParts + numParts - 1)
+	void partitionCells (const vector <vec3> &verts, const vector <int> &cells, unsigned int numParts, vector <unsigned int> &part);
+
+	// function to assign every vertex to the lowest part among its cells
+	void getVertexParts (size_t numVerts, const vector <int> &cells, const vector <unsigned int> &cellPart, vector <unsigned int> &vertPart);
 }
@@ -0,0 +1,144 @@
+/**
+ * @file EM_parallel.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ * Parallel loops and sorting for the Edit Mesh application. Every call
+ * starts its own threads and joins them before returning, so stages stay
+ * strictly ordered and nothing outlives the call.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+namespace SF {
+
+	// number of threads used by parallel stages (defaults to the number of cores)
+	inline unsigned int & numThreads ()
+	{
+		static unsigned int threads = boost::thread::hardware_concurrency () ? boost::thread::hardware_concurrency () : 1;
+		return threads;
+	}
+
+	// function run by every thread of parallelFor: takes chunks off a shared counter until none are left
+	inline void runChunks (const boost::function <void (size_t, size_t)> *f, size_t *next, size_t end, size_t grain, boost::mutex *mutex)
+	{
+		for (;;){
+			size_t lo;
+			{
+				boost::mutex::scoped_lock lock (*mutex);
+				lo = *next;
+				*next = end - lo > grain ? lo + grain : end;
+			}
+			if (lo >= end){
+				return;
+			}
+			(*f) (lo, end - lo > grain ? lo + grain : end);
+		}
+	}
+
+	/**
+	 * Function to run f (lo, hi) over [begin, end) split into chunks of at
+	 * most grain indices, and wait for all of them. A grain of 0 gives every
+	 * thread a few chunks. Chunks are handed out as threads get free, so
+	 * chunks of uneven cost (e.g. one submesh each) still balance.
+	 */
+	inline void parallelFor (size_t begin, size_t end, const boost::function <void (size_t, size_t)> &f, size_t grain = 0)
+	{
+		if (begin >= end){
+			return;
+		}
+		size_t threads = numThreads ();
+		if (!grain){
+			grain = (end - begin + 4*threads - 1)/ (4*threads);
+		}
+		threads = min (threads, (end - begin + grain - 1)/ grain);
+		if (threads < 2){
+			f (begin, end);
+			return;
+		}
+
+		boost::mutex mutex;
+		size_t next = begin;
+		boost::thread_group group;
+		for (size_t i = 0; i < threads; ++i){
+			group.create_thread (boost::bind (&runChunks, &f, &next, end, grain, &mutex));
+		}
+		group.join_all ();
+	}
+
+	template <class T, class Compare>
+	inline void sortRuns (vector <T> *v, const vector <size_t> *bounds, Compare compare, size_t lo, size_t hi)
+	{
+		for (size_t i = lo; i < hi; ++i){
+			sort (v->begin () + (*bounds) [i], v->begin () + (*bounds) [i + 1], compare);
+		}
+	}
+
+	template <class T, class Compare>
+	inline void mergeRuns (vector <T> *v, const vector <size_t> *bounds, Compare compare, size_t lo, size_t hi)
+	{
+		for (size_t i = lo; i < hi; ++i){
+			inplace_merge (v->begin () + (*bounds) [2*i], v->begin () + (*bounds) [2*i + 1], v->begin () + (*bounds) [2*i + 2], compare);
+		}
+	}
+
+	// function to sort v: one run per thread is sorted, then neighboring runs are merged pairwise, a round at a time
+	template <class T, class Compare>
+	inline void parallelSort (vector <T> &v, Compare compare)
+	{
+		size_t threads = numThreads ();
+		if (threads < 2 || v.size () < 65536){
+			sort (v.begin (), v.end (), compare);
+			return;
+		}
+
+		vector <size_t> bounds;
+		for (size_t i = 0; i <= threads; ++i){
+			bounds.push_back (v.size ()*i/ threads);
+		}
+		parallelFor (0, threads, boost::bind (&sortRuns <T, Compare>, &v, &bounds, compare, _1, _2), 1);
+
+		while (bounds.size () > 2){
+			parallelFor (0, (bounds.size () - 1)/ 2, boost::bind (&mergeRuns <T, Compare>, &v, &bounds, compare, _1, _2), 1);
+
+			vector <size_t> merged;
+			for (size_t i = 0; i < bounds.size (); i += 2){
+				merged.push_back (bounds [i]);
+			}
+			if (merged.back () != bounds.back ()){
+				merged.push_back (bounds.back ());
+			}
+			bounds.swap (merged);
+		}
+	}
+
+	template <class T>
+	inline void parallelSort (vector <T> &v) { parallelSort (v, less <T> ()); }
+
+	// parallelSort as a sorter for the topology functions (e.g. matchTetrahedronFaces)
+	struct ParallelSort {
+		template <class T>
+		inline void operator () (vector <T> &v) const { parallelSort (v); }
+	};
+}
@@ -24,54 +24,12 @@
 #include "Preprocess.h"
 #include "vec3.h"
 #include "vec4.h"
-#include "aabb.h"
+#include "EM_parallel.h"
 #include "EM_FEMSubmesh.h"
 #include "EM_FEMMesh.h"
 
 namespace SF {
 
-	// function to decide which submesh a cell belongs to
-	// race to 2. (default: submesh the 1st vertex belongs to)
-	static inline size_t getCellSubmeshIndex (const vector <FEMSubmesh> &submesh, const vec3 &v1, const vec3 &v2, const vec3 &v3, const vec3 &v4)
-	{
-		size_t result = submesh.size ();
-		for (size_t i = 0; i < submesh.size (); ++i){
-			if (submesh.at (i)._bbox.collide (v1)){
-				result = i;
-				break;
-			}
-		}
-		assert (result < submesh.size ());
-
-		unsigned int counter = 0;
-		for (size_t i = 0; i < submesh.size (); ++i){
-
-			counter = 0;
-
-			if (submesh.at (i)._bbox.collide (v1)){
-				++counter;
-			}
-			if (submesh.at (i)._bbox.collide (v2)){
-				if (counter){
-					return i;
-				}
-				++counter;
-			}
-			if (submesh.at (i)._bbox.collide (v3)){
-				if (counter){
-					return i;
-				}
-				++counter;
-			}
-			if (submesh.at (i)._bbox.collide (v4)){
-				if (counter){
-					return i;
-				}
-			}
-		}
-		return result;
-	}
-
 	// default constructor
 	FEMMesh::FEMMesh () { }
 
@@ -80,96 +38,68 @@ namespace SF {
 
 	// method to process data to break them to a FEM format
 	void
-	FEMMesh::process (const int depth)
+	FEMMesh::process (const int depth, const unsigned int numPartitions)
 	{
 		{
-			// calculate bounding box
-			vec min (_vertices.at (0));
-			vec max (min);
-
-			for (size_t i = 1; i < _vertices.size (); ++i){
-				for (int j = 0; j < 3; ++j){
-					min._v[j] = min._v[j] > _vertices.at (i)._v[j] ? _vertices.at (i)._v[j] : min._v[j];
-				}
-				for (int j = 0; j < 3; ++j){
-					max._v[j] = max._v[j] < _vertices.at (i)._v[j] ? _vertices.at (i)._v[j] : max._v[j];
-				}
-			}
-
-			// expand the bounding box
-			for (int j = 0; j < 3; ++j){
-        min._v [j] -= 1.0;
-			}
-			for (int j = 0; j < 3; ++j){
-        max._v [j] += 1.0;
-			}
-			aabb bv (min, max);
-
 			// calculate number of submeshes
 			size_t numSubmeshes = 1;
 			for (int i = 1; i <= depth; ++i){
 				numSubmeshes *= 8;
 			}
-			_submesh.reserve (numSubmeshes);
+			_submesh.resize (numSubmeshes);
+
+			// balance cells among submeshes, then among the partitions of every submesh
+			vector <unsigned int> part (_cells.size ()/ 4, 0);
+			partitionCells (_vertices, _cells, static_cast <unsigned int> (numSubmeshes), part);
+			{
+				vector <unsigned int> vertSubmesh;
+				getVertexParts (_vertices.size (), _cells, part, vertSubmesh);
+				shuffleVertices (vertSubmesh);
+			}
+			partitionCells (_vertices, _cells, numPartitions, part);
 
-			// initialize submeshes
-			vec step (max - min);
-			size_t factor = 1;
-			for (int i = 1; i <= depth; ++i){
-				factor *= 2;
+			// cells go to their submeshes in this order, so every partition gets them along the curve too
+			sortCells (_vertices, part, _cells);
+
+			for (size_t i = 0; i < numSubmeshes; ++i){
+				_submesh [i]._partitionSizes.resize (numPartitions, 0);
 			}
-			step *= 1./ static_cast <real> (factor);
-
-			vec bmin, bmax;
-			for (int i = 0; i <= depth; ++i){
-				for (int j = 0; j <= depth; ++j){
-					for (int k = 0; k <= depth; ++k){
-						bmin = min;
-						bmin._v[2] += i * step._v[2];
-						bmin._v[1] += j * step._v[1];
-						bmin._v[0] += k * step._v[0];
-						bmax = bmin + step;
-						_submesh.push_back (FEMSubmesh (bmin, bmax));
-					}
+			_vertInfo.resize (_vertices.size ());
+			for (size_t i = 0; i < _cells.size (); i += 4){
+				unsigned int submeshIndex = part [i/ 4]/ numPartitions;
+				unsigned int cellIndex = _submesh [submeshIndex]._cells.size ()/ 4;
+				for (int j = 0; j < 4; ++j){
+					_vertInfo [_cells [i + j]].addOwner (submeshIndex, cellIndex);
+					_submesh [submeshIndex]._cells.push_back (_cells [i + j]);
 				}
+				++_submesh [submeshIndex]._partitionSizes [part [i/ 4] % numPartitions];
 			}
-
-			shuffleVertices ();
-
-      _vertInfo.resize (_vertices.size ());
-      if (depth){
-        size_t submeshIndex, cellIndex;
-        for (size_t i = 0; i < _cells.size (); i += 4){
-          submeshIndex = getCellSubmeshIndex (_submesh,
-              _vertices.at (_cells.at (i)), _vertices.at (_cells.at (i+1)), _vertices.at (_cells.at (i+2)), _vertices.at (_cells.at (i+3)));
-          assert (submeshIndex < numSubmeshes);
-          cellIndex = _submesh [submeshIndex]._cells.size ()/ 4;
-          for (int j = 0; j < 4; ++j){
-            _vertInfo [_cells [i + j]].addOwner (submeshIndex, cellIndex);
-          }
-          for (int j = 0; j < 4; ++j){
-            _submesh.at (submeshIndex)._cells.push_back (_cells.at (i+j));
-          }
-        }
-      } else {
-        for (unsigned int i = 0; i < _cells.size (); i+= 4){
-          for (unsigned int j = 0; j < 4; ++j){
-            _vertInfo [_cells[i + j]].addOwner (0, i/ 4);
-            _submesh [0]._cells.push_back (_cells [i + j]);
-          }
-        }
-      }
 			_cells.clear ();
 		}
 
-		for (size_t i = 0; i < _submesh.size (); ++i){
-			_submesh.at (i).generateTopology (_faces);
+		// surface triangles of the whole mesh, for submeshes to tell their own surface from the cuts between them
+		vector <FaceKey> surface (_faces.size ()/ 3);
+		for (size_t i = 0; i < surface.size (); ++i){
+			surface [i] = faceKey (_faces [3*i], _faces [3*i + 1], _faces [3*i + 2]);
 		}
+		parallelSort (surface);
+
+		// submeshes are independent of each other
+		parallelFor (0, _submesh.size (), boost::bind (&FEMMesh::generateTopology, this, boost::cref (surface), _1, _2), 1);
 	}
 
-	// protected method to shuffle cell vertices
+	// protected method to generate the topology of submeshes [begin, end)
 	void
-	FEMMesh::shuffleVertices ()
+	FEMMesh::generateTopology (const vector <FaceKey> &surface, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i){
+			_submesh [i].generateTopology (surface);
+		}
+	}
+
+	// protected method to shuffle cell vertices (by submesh, then along a Morton curve)
+	void
+	FEMMesh::shuffleVertices (const vector <unsigned int> &vertSubmesh)
 	{
 		vector <bool> sflag;
 		sflag.resize (_vertices.size (), false);
@@ -178,103 +108,13 @@ namespace SF {
 			sflag.at (_faces.at (i)) = true;
 		}
 
-		// contains  and current counters offsets for each bv
-		vector <int> sOffset;
-		sOffset.resize (_submesh.size (), 0);
-
-		vector <int> iOffset;
-		iOffset.resize (_submesh.size (), 0);
-
+		// surface vertices of every submesh first, then interior vertices of every submesh
+		vector <unsigned int> bucket (_vertices.size ());
 		for (size_t i = 0; i < _vertices.size (); ++i){
-			for (size_t j = 0; j < _submesh.size (); ++j){
-
-				if (_submesh.at (j)._bbox.collide (_vertices.at (i))){
-					if (sflag.at (i)){
-						++ (sOffset.at (j));
-					} else {
-						++ (iOffset.at (j));
-					}
-					break;
-				}
-			}
+			bucket [i] = sflag [i] ? vertSubmesh [i] : _submesh.size () + vertSubmesh [i];
 		}
 
-		// do cumulative indices
-		if (_submesh.size () > 1){
-			int final = sOffset.at (sOffset.size () - 1);
-
-			for (int i = sOffset.size () - 1; i > 0; --i){
-				sOffset.at (i) = sOffset.at (i - 1);
-			}
-			sOffset.at (0) = 0;
-			for (size_t i = 1; i < sOffset.size (); ++i){
-				sOffset.at (i) += sOffset.at (i - 1);
-			}
-
-			for (int i = iOffset.size () - 1; i > 0; --i){
-				iOffset.at (i) = iOffset.at (i - 1);
-			}
-			iOffset.at (0) = 0;
-			for (size_t i = 1; i < iOffset.size (); ++i){
-				iOffset.at (i) += iOffset.at (i - 1);
-			}
-
-			for (size_t i = 0; i < iOffset.size (); ++i){
-				iOffset.at (i) += final;
-			}
-		}
-
-		int addendum = sOffset.at (sOffset.size () - 1);
-		for (size_t i = 0; i < iOffset.size (); ++i){
-			iOffset.at (i) += addendum;
-		}
-		sOffset [0] = 0;
-
-		vector <int> sCounter;
-		sCounter.resize (_submesh.size (), 0);
-
-		vector <int> iCounter;
-		iCounter.resize (_submesh.size (), 0);
-
-		vector <size_t> newIndices;
-		newIndices.resize (_vertices.size (), UINT_MAX);
-
-		for (size_t i = 0; i < _vertices.size (); ++i){
-			for (size_t j = 0; j < _submesh.size (); ++j){
-
-				if (_submesh.at (j)._bbox.collide (_vertices.at (i))){
-					if (sflag.at (i)){
-						newIndices.at (i) = sOffset.at (j) + sCounter.at (j);
-						++ (sCounter.at (j));
-					} else {
-						newIndices.at (i) = iOffset.at (j) + iCounter.at (j);
-						++ (iCounter.at (j));
-					}
-					break;
-				}
-			}
-		}
-
-		// shuffle actual vertices
-		{
-			vector <vec3> verts;
-			verts.reserve (_vertices.size ());
-			verts.push_back (vec3::ZERO);
-			verts.resize (_vertices.size(), vec3::ZERO);
-
-			for (size_t i = 0; i < newIndices.size (); ++i){
-				verts.at (newIndices.at (i)) = _vertices.at (i);
-			}
-			_vertices.swap (verts);
-		}
-
-		for (size_t i = 0; i < _cells.size (); ++i){
-			_cells.at (i) = newIndices.at (_cells.at (i));
-		}
-
-		for (size_t i = 0; i < _faces.size (); ++i){
-			_faces.at (i) = newIndices.at (_faces.at (i));
-		}
+		reorderVertices (bucket, _vertices, _cells, _faces, &_mass);
 	}
 
 	// method to write elements to files
@@ -331,6 +171,32 @@ namespace SF {
 			}
 		}
 
+		// write partition sizes to files
+		{
+			for (size_t i = 0; i < _submesh.size (); ++i){
+
+				fname = folder + prefix;
+				fname.append (".");
+
+				stringstream ss;
+				ss << i;
+				fname.append (ss.str ());
+				fname.append (".tet.part");
+
+				fp = fopen (fname.c_str (), "w");
+				assert (fp);
+
+				const vector <unsigned int> &sizes = _submesh [i]._partitionSizes;
+				fprintf (fp, "%lu\n", sizes.size ());
+
+				for (size_t j = 0; j < sizes.size (); ++j){
+					fprintf (fp, "%u\n", sizes [j]);
+				}
+
+				fclose (fp);
+			}
+		}
+
 		// write cell topology to files
 		{
 			vector <Cell> *cptr;
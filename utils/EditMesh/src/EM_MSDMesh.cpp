@@ -18,156 +18,71 @@
  * Mass spring mesh for Edit Mesh application. Derived from Mesh
  */
 
+#include <cstdio>
 #include <cstring>
 #include <climits>
 
+#include <algorithm>
+#include <list>
 #include <sstream>
 #include <vector>
-#include <list>
 
-#include "crc32.h"
-#include "aabb.h"
+#include "Preprocess.h"
+#include "BinaryCache.h"
+#include "MSDBundle.h"
+#include "Topology.h"
+#include "vec3.h"
+#include "vec4.h"
 #include "EM_common.h"
+#include "EM_parallel.h"
 #include "EM_MSDMesh.h"
 
 using namespace std;
 
 namespace SF {
 
-	typedef struct edge_t {
-		int _indices[2];
-
-		inline edge_t ()
-		{
-			for (int i = 0; i < 2; ++i){
-				_indices[i] = -1;
-			}
-		}
-
-		inline edge_t (const int *i)
-		{
-			memcpy (_indices, i, 2*sizeof (int));
-		}
-
-		inline bool operator == (const int *f) const
-		{
-			bool flags[2] = {false, false};
-			for(int i = 0; i < 2; ++i){
-				for (int j = 0; j < 2; ++j){
-					flags[i] |= (_indices[i] == f[j]);
-				}
-			}
-			return flags[0] & flags[1];
-		}
-	} Edge;
-
 	// static function to detect which submesh a triangle belongs to
-	static size_t getFaceSubmeshIndex (const vector <aabb> &bvs, const vec3 &v1, const vec3 &v2, const vec3 &v3)
+	// race to 2. (default: submesh the 1st vertex belongs to)
+	static inline unsigned int getFaceSubmeshIndex (const vector <unsigned int> &vertSubmesh, const int *face)
 	{
-		size_t result = bvs.size ();
-		for (size_t i = 0; i < bvs.size (); ++i){
-			if (bvs.at (i).collide (v1)){
-				result = i;
-				break;
-			}
-		}
-		int counter = 0;
-		for (size_t i = 0; i < bvs.size (); ++i){
-
-			counter = 0;
-			if (bvs. at(i).collide (v1)){
-				++counter;
-			}
-
-			if (bvs. at(i).collide (v2)){
-				++counter;
-				if (counter > 1){
-					result = i;
-					break;
-				}
-			}
-
-			if (bvs. at(i).collide (v3)){
-				++counter;
-				if (counter > 1){
-					result = i;
-					break;
-				}
-			}
-		}
-		return result;
+		unsigned int s0 = vertSubmesh.at (face[0]), s1 = vertSubmesh.at (face[1]), s2 = vertSubmesh.at (face[2]);
+		return (s1 == s2 && s0 != s1) ? s1 : s0;
 	}
 
-	// default constructor
-	MSDMesh::MSDMesh () { }
+	// constructor (numLevels: number of coarser surfaces to generate for every submesh,
+	// latticeScale: spacing of the coarse lattice in mean spring lengths, 0 for none)
+	MSDMesh::MSDMesh (unsigned int numLevels, float latticeScale)
+	: _numLevels (numLevels), _latticeScale (latticeScale)
+	{ }
 
 	// destructor
 	MSDMesh::~MSDMesh () { }
 
-	// method to process data to break them to an MSD format
+	// method to process data to break them to an MSD format (the runtime has no partitions below submeshes)
 	void
-	MSDMesh::process (const int depth)
+	MSDMesh::process (const int depth, const unsigned int)
 	{
-		// calculate bounding box
-		vec min (_vertices.at (0));
-		vec max (min);
-
-		for (size_t i = 1; i < _vertices.size (); ++i){
-			for (int j = 0; j < 3; ++j){
-				min._v[j] = min._v[j] > _vertices.at (i)._v[j] ? _vertices.at (i)._v[j] : min._v[j];
-			}
-			for (int j = 0; j < 3; ++j){
-				max._v[j] = max._v[j] < _vertices.at (i)._v[j] ? _vertices.at (i)._v[j] : max._v[j];
-			}
-		}
-
-    // expand the bounding box
-    for (int j = 0; j < 3; ++j){
-      min._v [j] -= 1.0;
-    }
-    for (int j = 0; j < 3; ++j){
-      max._v [j] += 1.0;
-    }
-		aabb bv (min, max);
-
 		// calculate number of submeshes
 		size_t numSubmeshes = 1;
 		for (int i = 1; i <= depth; ++i){
 			numSubmeshes *= 8;
 		}
 
-		vector <aabb> bboxes;
-		bboxes.reserve (numSubmeshes);
-
-		// initialize submeshes
-		vec step (max - min);
-		size_t factor = 1;
-		for (int i = 1; i <= depth; ++i){
-			factor *= 2;
-		}
-		step *= 1./ static_cast <real> (factor);
-
-		vec bmin, bmax;
-		for (int i = 0; i <= depth; ++i){
-			for (int j = 0; j <= depth; ++j){
-				for (int k = 0; k <= depth; ++k){
-					bmin = min;
-					bmin._v[2] += i * step._v[2];
-					bmin._v[1] += j * step._v[1];
-					bmin._v[0] += k * step._v[0];
-					bmax = bmin + step;
-					bboxes.push_back (aabb (bmin, bmax));
-				}
+		// balance cells among submeshes; vertices and triangles follow the cells they belong to
+		vector <unsigned int> faceSubmesh (_faces.size ()/ 3);
+		{
+			vector <unsigned int> part (_cells.size ()/ 4, 0), vertSubmesh;
+			partitionCells (_vertices, _cells, static_cast <unsigned int> (numSubmeshes), part);
+			getVertexParts (_vertices.size (), _cells, part, vertSubmesh);
+			for (size_t i = 0; i < faceSubmesh.size (); ++i){
+				faceSubmesh [i] = getFaceSubmeshIndex (vertSubmesh, &(_faces.at (3*i)));
 			}
+			shuffleVertices (vertSubmesh);
 		}
 
-		shuffleVertices (bboxes);
-
 		generateEdgeList ();
 		fprintf (stdout, "%lu edges\n", _edges.size ()/ 2);
 
-		calcMassReciprocal ();
-
 		// generate topology information
 		_trigs.reserve (numSubmeshes);
 		_trigs.push_back (vector <int> ());
@@ -177,265 +92,450 @@ namespace SF {
 		_ftop.push_back (vector <Face> ());
 		_ftop.resize (numSubmeshes, vector <Face> ());
 
-		size_t index;
 		for (size_t i = 0; i < _faces.size (); i += 3){
-			index = getFaceSubmeshIndex (bboxes, _vertices.at (_faces.at (i)), _vertices.at (_faces.at (i+1)), _vertices.at (_faces.at (i+2)));
 			for (int j = 0; j < 3; ++j){
-				_trigs. at(index).push_back (_faces.at (i + j));
+				_trigs. at(faceSubmesh [i/ 3]).push_back (_faces.at (i + j));
 			}
 		}
 		_faces.clear ();
 
-		for (size_t i = 0; i < numSubmeshes; ++i){
-			generateFaceTopology (_ftop.at (i), _trigs.at (i));
+		parallelFor (0, numSubmeshes, boost::bind (&MSDMesh::generateFaceTopology, this, _1, _2), 1);
+
+		_levels.assign (numSubmeshes, vector <vector <int> > ());
+		parallelFor (0, numSubmeshes, boost::bind (&MSDMesh::generateLevels, this, _1, _2), 1);
+
+		if (_latticeScale > 0.){
+			generateLattice ();
+			fprintf (stdout, "%lu lattice nodes, %lu lattice springs, %lu regions\n", _latticeNodes.size (), _latticeEdges.size ()/ 2,
+			         static_cast <size_t> (*max_element (_embedRegions.begin (), _embedRegions.end ()) + 1));
 		}
 	}
 
-	// protected method to shuffle vertices such that surface vertices are in front and
-	// vertices in a submesh are congruent
+	// protected method to generate the face topology of submeshes [begin, end)
 	void
-	MSDMesh::shuffleVertices (const vector <aabb> &bvs)
+	MSDMesh::generateFaceTopology (size_t begin, size_t end)
 	{
-		vector <bool> sflag;
-		sflag.reserve (_vertices.size ());
-		sflag.push_back (false);
-		sflag.resize (_vertices.size (), false);
-
-		for (size_t i = 0; i < _faces.size (); ++i){
-			sflag.at (_faces.at (i)) = true;
+		for (size_t i = begin; i < end; ++i){
+			SF::generateFaceTopology (_ftop.at (i), _trigs.at (i));
 		}
+	}
 
-		// contains  and current counters offsets for each bv
-		vector <int> sOffset;
-		sOffset.reserve (bvs.size ());
-		sOffset.push_back (0);
-		sOffset.resize (bvs.size (), 0);
-
-		vector <int> iOffset;
-		iOffset.reserve (bvs.size ());
-		iOffset.push_back (0);
-		iOffset.resize (bvs.size (), 0);
+	// static function to get the cell of a grid of spacing h (with a corner at min) that p falls in
+	static inline uint64_t getClusterKey (const vec3 &p, const vec3 &min, real h)
+	{
+		uint64_t key = 0;
+		for (int i = 0; i < 3; ++i){
+			key = (key << 21) | (static_cast <uint64_t> ((p._v[i] - min._v[i])/ h) & 0x1fffffull);
+		}
+		return key;
+	}
 
-		for (size_t i = 0; i < _vertices.size (); ++i){
-			for (size_t j = 0; j < bvs.size (); ++j){
+	/**
+	 * Static function to get a coarser version of a surface by vertex
+	 * clustering: vertices are grouped by the cells of a grid of spacing h,
+	 * every group is replaced by its vertex closest to the mean of the group,
+	 * and triangles that collapse or repeat are dropped. Only existing vertices
+	 * are kept, so the coarse surface follows the simulated positions (and
+	 * texture coordinates) of the fine one.
+	 */
+	static void clusterSurface (const vector <vec3> &verts, const vector <int> &trigs, real h, vector <int> &coarse)
+	{
+		vector <int> used (trigs);
+		sort (used.begin (), used.end ());
+		used.erase (unique (used.begin (), used.end ()), used.end ());
 
-				if (bvs.at (j).collide (_vertices.at (i))){
-					if (sflag.at (i)){
-						++ (sOffset.at (j));
-					} else {
-						++ (iOffset.at (j));
-					}
-					break;
-				}
+		vec3 min (verts.at (used.at (0)));
+		for (size_t i = 1; i < used.size (); ++i){
+			for (int j = 0; j < 3; ++j){
+				min._v[j] = min._v[j] > verts [used [i]]._v[j] ? verts [used [i]]._v[j] : min._v[j];
 			}
 		}
 
-		// do cumulative indices
-		if (bvs.size () > 1){
-			int final = sOffset.at (sOffset.size () - 1);
+		vector <pair <uint64_t, int> > clusters (used.size ());
+		for (size_t i = 0; i < used.size (); ++i){
+			clusters [i] = make_pair (getClusterKey (verts [used [i]], min, h), used [i]);
+		}
+		sort (clusters.begin (), clusters.end ());
+
+		// representative of every vertex (in the order of used)
+		vector <int> rep (used.size ());
+		for (size_t i = 0; i < clusters.size ();){
+			size_t end = i;
+			vec3 mean (0., 0., 0.);
+			while (end < clusters.size () && clusters [end].first == clusters [i].first){
+				mean += verts [clusters [end].second];
+				++end;
+			}
+			mean /= static_cast <real> (end - i);
 
-			for (size_t i = sOffset.size () - 1; i > 0; --i){
-				sOffset.at (i) = sOffset.at (i - 1);
+			int best = clusters [i].second;
+			for (size_t j = i + 1; j < end; ++j){
+				if ((verts [clusters [j].second] - mean).square_length () < (verts [best] - mean).square_length ()){
+					best = clusters [j].second;
+				}
 			}
-			sOffset.at (0) = 0;
-			for (size_t i = 1; i < sOffset.size (); ++i){
-				sOffset.at (i) += sOffset.at (i - 1);
+			for (size_t j = i; j < end; ++j){
+				rep [lower_bound (used.begin (), used.end (), clusters [j].second) - used.begin ()] = best;
 			}
+			i = end;
+		}
 
-			for (size_t i = iOffset.size () - 1; i > 0; --i){
-				iOffset.at (i) = iOffset.at (i - 1);
+		// remap triangles; of triangles on the same vertices only the first is kept
+		vector <pair <FaceKey, size_t> > keys;
+		vector <int> mapped (trigs.size ());
+		for (size_t i = 0; i < trigs.size (); i += 3){
+			for (int j = 0; j < 3; ++j){
+				mapped [i + j] = rep [lower_bound (used.begin (), used.end (), trigs [i + j]) - used.begin ()];
 			}
-			iOffset.at (0) = 0;
-			for (size_t i = 1; i < iOffset.size (); ++i){
-				iOffset.at (i) += iOffset.at (i - 1);
+			if (mapped [i] != mapped [i + 1] && mapped [i] != mapped [i + 2] && mapped [i + 1] != mapped [i + 2]){
+				keys.push_back (make_pair (faceKey (mapped [i], mapped [i + 1], mapped [i + 2]), i));
 			}
+		}
+		sort (keys.begin (), keys.end ());
 
-			for (size_t i = 0; i < iOffset.size (); ++i){
-				iOffset.at (i) += final;
+		vector <size_t> kept;
+		for (size_t i = 0; i < keys.size (); ++i){
+			if (!i || keys [i].first != keys [i - 1].first){
+				kept.push_back (keys [i].second);
 			}
 		}
-		int addendum = sOffset.at (sOffset.size () - 1);
-		for (size_t i = 0; i < iOffset.size (); ++i){
-			iOffset.at (i) += addendum;
-		}
-
-		vector <int> sCounter;
-		sCounter.reserve (bvs.size ());
-		sCounter.push_back (0);
-		sCounter.resize (bvs.size (), 0);
+		sort (kept.begin (), kept.end ());
 
-		vector <int> iCounter;
-		iCounter.reserve (bvs.size ());
-		iCounter.push_back (0);
-		iCounter.resize (bvs.size (), 0);
+		coarse.clear ();
+		coarse.reserve (3*kept.size ());
+		for (size_t i = 0; i < kept.size (); ++i){
+			coarse.insert (coarse.end (), mapped.begin () + kept [i], mapped.begin () + kept [i] + 3);
+		}
+	}
 
-		vector <size_t> newIndices;
-		newIndices.reserve (_vertices.size ());
-		newIndices.push_back (UINT_MAX);
-		newIndices.resize (_vertices.size (), UINT_MAX);
+	// protected method to generate the coarser surfaces of submeshes [begin, end): the grid spacing of level l
+	// is 2^(l - 1/2) times the mean edge length of the submesh's surface, and levels stop once they stop shrinking
+	void
+	MSDMesh::generateLevels (size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i){
+			const vector <int> &trigs = _trigs.at (i);
+			if (trigs.empty ()){
+				continue;
+			}
 
-		for (size_t i = 0; i < _vertices.size (); ++i){
-			for (size_t j = 0; j < bvs.size (); ++j){
-
-				if (bvs.at (j).collide (_vertices.at (i))){
-					if (sflag.at (i)){
-						newIndices.at (i) = sOffset.at (j) + sCounter.at (j);
-						++ (sCounter.at (j));
-					} else {
-						newIndices.at (i) = iOffset.at (j) + iCounter.at (j);
-						++ (iCounter.at (j));
-					}
+			real h = 0.;
+			for (size_t j = 0; j < trigs.size (); j += 3){
+				for (int k = 0; k < 3; ++k){
+					h += (_vertices [trigs [j + k]] - _vertices [trigs [j + (k + 1) % 3]]).length ();
+				}
+			}
+			h /= static_cast <real> (trigs.size ());
+			h *= 0.70710678;
+
+			size_t finer = trigs.size ();
+			for (unsigned int l = 0; l < _numLevels; ++l){
+				h *= 2.;
+				vector <int> coarse;
+				clusterSurface (_vertices, trigs, h, coarse);
+				if (coarse.empty () || 10*coarse.size () > 9*finer){
 					break;
 				}
+				finer = coarse.size ();
+				_levels [i].push_back (vector <int> ());
+				_levels [i].back ().swap (coarse);
 			}
 		}
+	}
 
-		// shuffle actual vertices
-		{
-			vector <vec3> verts;
-			verts.reserve (_vertices.size ());
-			verts.push_back (vec3::ZERO);
-			verts.resize (_vertices.size(), vec3::ZERO);
+	// static function to pack the integer coordinates of a lattice node or cell (21 bits each) into a key
+	static inline uint64_t getLatticeKey (const unsigned int *c)
+	{
+		return (static_cast <uint64_t> (c[0]) << 42) | (static_cast <uint64_t> (c[1]) << 21) | static_cast <uint64_t> (c[2]);
+	}
 
-			for (size_t i = 0; i < newIndices.size (); ++i){
-				verts.at (newIndices.at (i)) = _vertices.at (i);
-			}
-			_vertices.swap (verts);
+	/**
+	 * Protected method to embed the mesh in a coarse lattice for two-level
+	 * simulation. The lattice is a grid of spacing _latticeScale times the mean
+	 * spring length over the cells that hold vertices, every cell split into
+	 * the six tetrahedra around its main diagonal (Kuhn). A vertex with cell
+	 * fractions t sorted as t_a >= t_b >= t_c lies in the tetrahedron through
+	 * corners c, c + e_a, c + e_a + e_b and c + 1, with barycentric weights
+	 * 1 - t_a, t_a - t_b, t_b - t_c and t_c. Springs run along the edges of
+	 * these tetrahedra (corner pairs whose offsets contain one another), so
+	 * neighboring cells share them. Node masses are the vertex masses spread
+	 * by the weights, with a floor for corners that hardly carry any. The
+	 * cells are the regions the runtime switches between fine and coarse.
+	 */
+	void
+	MSDMesh::generateLattice ()
+	{
+		real h = 0.;
+		for (size_t i = 0; i < _edges.size (); i += 2){
+			h += (_vertices [_edges [i + 1]] - _vertices [_edges [i]]).length ();
 		}
+		h *= _latticeScale/ static_cast <real> (_edges.size ()/ 2);
 
-		for (size_t i = 0; i < _cells.size (); ++i){
-			_cells.at (i) = newIndices.at (_cells.at (i));
+		vec3 min (_vertices.at (0));
+		for (size_t i = 1; i < _vertices.size (); ++i){
+			for (int j = 0; j < 3; ++j){
+				min._v[j] = min._v[j] > _vertices [i]._v[j] ? _vertices [i]._v[j] : min._v[j];
+			}
 		}
 
-		for (size_t i = 0; i < _faces.size (); ++i){
-			_faces.at (i) = newIndices.at (_faces.at (i));
+		// cell and tetrahedron of every vertex
+		size_t numVerts = _vertices.size ();
+		vector <uint64_t> cellKeys (numVerts), cornerKeys (4*numVerts);
+		_embedWeights.resize (4*numVerts);
+		for (size_t i = 0; i < numVerts; ++i){
+			unsigned int c [3];
+			real t [3];
+			for (int j = 0; j < 3; ++j){
+				real f = (_vertices [i]._v[j] - min._v[j])/ h;
+				c [j] = f < 0x1fffff ? static_cast <unsigned int> (f) : 0x1ffffeu;
+				t [j] = f - static_cast <real> (c [j]);
+				t [j] = t [j] < 0. ? 0. : (t [j] > 1. ? 1. : t [j]);
+			}
+			cellKeys [i] = getLatticeKey (c);
+
+			int a [3] = {0, 1, 2};
+			for (int j = 1; j < 3; ++j){
+				for (int k = j; k > 0 && t [a [k]] > t [a [k - 1]]; --k){
+					swap (a [k], a [k - 1]);
+				}
+			}
+			cornerKeys [4*i] = getLatticeKey (c);
+			for (int j = 0; j < 3; ++j){
+				++c [a [j]];
+				cornerKeys [4*i + j + 1] = getLatticeKey (c);
+			}
+			_embedWeights [4*i] = 1. - t [a [0]];
+			_embedWeights [4*i + 1] = t [a [0]] - t [a [1]];
+			_embedWeights [4*i + 2] = t [a [1]] - t [a [2]];
+			_embedWeights [4*i + 3] = t [a [2]];
 		}
-	}
 
-	// protected method to generate list of unique edges
-	void
-	MSDMesh::generateEdgeList ()
-	{
-		vector <list <Edge> > edges;
-		list <Edge> *eptr;
-		list <Edge>::iterator iter;
+		// every corner of an occupied cell is a node, so each cell is a whole cube of six tetrahedra
+		vector <uint64_t> cells (cellKeys);
+		sort (cells.begin (), cells.end ());
+		cells.erase (unique (cells.begin (), cells.end ()), cells.end ());
 
-		edges.reserve (USHRT_MAX + 1);
-		edges.push_back (list <Edge> ());
-		edges.resize (USHRT_MAX + 1, list <Edge> ());
+		vector <uint64_t> nodeKeys;
+		nodeKeys.reserve (8*cells.size ());
+		for (size_t i = 0; i < cells.size (); ++i){
+			for (unsigned int k = 0; k < 8; ++k){
+				nodeKeys.push_back (cells [i] + ((k & 1) ? 1ull << 42 : 0) + ((k & 2) ? 1ull << 21 : 0) + ((k & 4) ? 1ull : 0));
+			}
+		}
+		sort (nodeKeys.begin (), nodeKeys.end ());
+		nodeKeys.erase (unique (nodeKeys.begin (), nodeKeys.end ()), nodeKeys.end ());
 
-		bool inflag = true;
-		uint32_t index;
-		int tmpi, inds[2];
-		char tmpstr[16], finalstr[32];
+		_latticeNodes.resize (nodeKeys.size ());
+		for (size_t i = 0; i < nodeKeys.size (); ++i){
+			for (int j = 0; j < 3; ++j){
+				_latticeNodes [i]._v[j] = min._v[j] + h*static_cast <real> ((nodeKeys [i] >> (42 - 21*j)) & 0x1fffffull);
+			}
+		}
 
-		for (size_t i = 0; i < _cells.size (); i += 4){
-			for (int j = 0; j < 6; ++j){
+		_embedRegions.resize (numVerts);
+		_embedNodes.resize (4*numVerts);
+		for (size_t i = 0; i < numVerts; ++i){
+			_embedRegions [i] = static_cast <int> (lower_bound (cells.begin (), cells.end (), cellKeys [i]) - cells.begin ());
+			for (int j = 0; j < 4; ++j){
+				_embedNodes [4*i + j] = static_cast <int> (lower_bound (nodeKeys.begin (), nodeKeys.end (), cornerKeys [4*i + j]) - nodeKeys.begin ());
+			}
+		}
 
-				switch (j){
-					case 0:
-						inds[0] = _cells.at (i);
-						inds[1] = _cells.at (i + 1);
-						break;
-					case 1:
-						inds[0] = _cells.at (i);
-						inds[1] = _cells.at (i + 2);
-						break;
-					case 2:
-						inds[0] = _cells.at (i);
-						inds[1] = _cells.at (i + 3);
-						break;
-					case 3:
-						inds[0] = _cells.at (i + 1);
-						inds[1] = _cells.at (i + 2);
-						break;
-					case 4:
-						inds[0] = _cells.at (i + 1);
-						inds[1] = _cells.at (i + 3);
-						break;
-					case 5:
-						inds[0] = _cells.at (i + 2);
-						inds[1] = _cells.at (i + 3);
-						break;
+		// springs: the 19 edges of the Kuhn tetrahedra of every cell
+		vector <uint64_t> keys;
+		keys.reserve (19*cells.size ());
+		for (size_t i = 0; i < cells.size (); ++i){
+			int corner [8];
+			for (unsigned int k = 0; k < 8; ++k){
+				uint64_t key = cells [i] + ((k & 1) ? 1ull << 42 : 0) + ((k & 2) ? 1ull << 21 : 0) + ((k & 4) ? 1ull : 0);
+				corner [k] = static_cast <int> (lower_bound (nodeKeys.begin (), nodeKeys.end (), key) - nodeKeys.begin ());
+			}
+			for (unsigned int p = 0; p < 8; ++p){
+				for (unsigned int q = p + 1; q < 8; ++q){
+					if ((p & q) == p){
+						keys.push_back (edgeKey (corner [p], corner [q]));
+					}
 				}
+			}
+		}
+		sort (keys.begin (), keys.end ());
+		keys.erase (unique (keys.begin (), keys.end ()), keys.end ());
 
-				// sort the indices
-				if (inds[0] > inds[1]){
-					tmpi = inds[0];
-					inds[0] = inds[1];
-					inds[1] = tmpi;
-				}
+		_latticeEdges.resize (2*keys.size ());
+		for (size_t i = 0; i < keys.size (); ++i){
+			_latticeEdges [2*i] = static_cast <int> (keys [i] >> 32);
+			_latticeEdges [2*i + 1] = static_cast <int> (keys [i] & 0xffffffffull);
+		}
 
-				// form string by concatenating three indices
-				sprintf (finalstr, "%x", inds[0]);
-				sprintf (tmpstr, "%x", inds[1]);
-				assert (strlen (finalstr) + strlen (tmpstr) < 32);
-				strcat (finalstr, tmpstr);
+		// node masses (the lattice carries the whole mass; no node is lighter than a tenth of the mean)
+		vector <double> mass (_latticeNodes.size (), 0.);
+		double total = 0.;
+		for (size_t i = 0; i < numVerts; ++i){
+			double m = 1./ _mass [i];
+			total += m;
+			for (int j = 0; j < 4; ++j){
+				mass [_embedNodes [4*i + j]] += _embedWeights [4*i + j]*m;
+			}
+		}
+		double lightest = .1*total/ static_cast <double> (mass.size ());
+		_latticeMass.resize (mass.size ());
+		for (size_t i = 0; i < mass.size (); ++i){
+			_latticeMass [i] = static_cast <float> (1./ (mass [i] > lightest ? mass [i] : lightest));
+		}
+	}
 
-				// get crc32 hash-code and mask it to below 65536
-				index = crc32 (finalstr, strlen (finalstr));
-				index &= 0x0000ffff;
+	// protected method to shuffle vertices such that surface vertices are in front, vertices
+	// in a submesh are congruent and follow a Morton curve (for locality in the spring loop)
+	void
+	MSDMesh::shuffleVertices (const vector <unsigned int> &vertSubmesh)
+	{
+		vector <bool> sflag;
+		sflag.reserve (_vertices.size ());
+		sflag.push_back (false);
+		sflag.resize (_vertices.size (), false);
 
-				inflag = false;
-				eptr = &(edges.at (index));
-				iter = eptr->begin ();
+		for (size_t i = 0; i < _faces.size (); ++i){
+			sflag.at (_faces.at (i)) = true;
+		}
 
-				while (iter != eptr->end ()){
-					if (*iter == &(inds[0])){
-						inflag = true;
-						break;
-					}
-					++iter;
-				}
-				if (!inflag){
-					eptr->push_back( Edge (&(inds[0])));
-				}
-			}
+		// surface vertices of every submesh first, then interior vertices of every submesh
+		size_t numSubmeshes = *max_element (vertSubmesh.begin (), vertSubmesh.end ()) + 1;
+		vector <unsigned int> bucket (_vertices.size ());
+		for (size_t i = 0; i < _vertices.size (); ++i){
+			bucket [i] = sflag [i] ? vertSubmesh [i] : numSubmeshes + vertSubmesh [i];
 		}
-		// copy edges to edge-vector
-		for (int i = 0; i <= USHRT_MAX; ++i){
 
-			eptr = &(edges.at (i));
+		reorderVertices (bucket, _vertices, _cells, _faces, &_mass);
+	}
 
-			while (!eptr->empty ()){
-				for (int k = 0; k < 2; ++k){
-					_edges.push_back (eptr->front ()._indices[k]);
-				}
-				eptr->pop_front ();
+	// static function to get the keys of the edges of cells [begin, end) (six per cell, duplicates included)
+	static void getEdgeKeys (const vector <int> *cells, vector <uint64_t> *keys, size_t begin, size_t end)
+	{
+		static const int corners[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+		for (size_t i = begin; i < end; ++i){
+			for (int j = 0; j < 6; ++j){
+				(*keys)[6*i + j] = edgeKey ((*cells)[4*i + corners[j][0]], (*cells)[4*i + corners[j][1]]);
 			}
 		}
 	}
 
-  // protected method to calculate the reciprocal mass for every vertex
-  void
-  MSDMesh::calcMassReciprocal ()
-  {
-    _mass.resize (_vertices.size (), 0.);
+	// protected method to generate list of unique edges, sorted by their vertices
+	// (so the runtime walks the springs in the order of the vertices they pull on)
+	void
+	MSDMesh::generateEdgeList ()
+	{
+		// keys hold the lower vertex in the upper half, so sorting them sorts by lower, then upper vertex
+		vector <uint64_t> keys (6*(_cells.size ()/ 4));
+		parallelFor (0, _cells.size ()/ 4, boost::bind (&getEdgeKeys, &_cells, &keys, _1, _2));
+		parallelSort (keys);
+		keys.erase (unique (keys.begin (), keys.end ()), keys.end ());
+
+		_edges.resize (2*keys.size ());
+		for (size_t i = 0; i < keys.size (); ++i){
+			_edges[2*i] = static_cast <int> (keys[i] >> 32);
+			_edges[2*i + 1] = static_cast <int> (keys[i] & 0xffffffffull);
+		}
+	}
 
-    real volume;
-    vec3 a, b, c;
-    for (size_t i = 0; i < _cells.size (); i += 4){
-      a = _vertices [_cells [i + 1]] - _vertices [_cells [i]];
-      b = _vertices [_cells [i + 2]] - _vertices [_cells [i]];
-      c = _vertices [_cells [i + 3]] - _vertices [_cells [i]];
+	// method to get the coarser surfaces of a submesh as they are stored (number of levels, then
+	// the number of triangles and the triangles of every level)
+	void
+	MSDMesh::getLevelData (size_t submesh, vector <int> &data) const
+	{
+		const vector <vector <int> > &levels = _levels.at (submesh);
+		data.assign (1, static_cast <int> (levels.size ()));
+		for (size_t l = 0; l < levels.size (); ++l){
+			data.push_back (static_cast <int> (levels [l].size ()/ 3));
+			data.insert (data.end (), levels [l].begin (), levels [l].end ());
+		}
+	}
 
-      volume = a.dot (b.cross (c))/ 24.;
-      volume = volume < 0. ? -volume: volume;
+	/**
+	 * Method to write the mesh as one bundle (prefix.msd.bin) in the layout the
+	 * mass-spring plugin maps at startup: vertices and bounds as vec of the
+	 * build, reciprocal masses as real, and the triangles of every submesh as
+	 * a section of their own. Everything the plugin derives from the text
+	 * files is derived here the same way, so the two load the same mesh.
+	 */
+	bool
+	MSDMesh::writeBundle (const string &folder, const string &prefix) const
+	{
+		vector <vec> nodes (_vertices.size ()), latticeNodes (_latticeNodes.size ());
+		vector <vec> bounds (2);
+		{
+			real tmpr [SF_VECTOR_SIZE] = {0.};
+#ifdef SF_VECTOR4_ENABLED
+			tmpr [3] = 1.;
+#endif
+			for (size_t i = 0; i < _vertices.size (); ++i){
+				memcpy (tmpr, _vertices [i]._v, 3*sizeof (real));
+				nodes [i] = vec (tmpr);
+			}
+			for (size_t i = 0; i < _latticeNodes.size (); ++i){
+				memcpy (tmpr, _latticeNodes [i]._v, 3*sizeof (real));
+				latticeNodes [i] = vec (tmpr);
+			}
 
-      for (unsigned int j = 0; j < 4; ++j){
-        _mass [_cells [i + j]] += volume;
-      }
-    }
+			// bounds padded as the plugin pads them
+			bounds [0] = bounds [1] = nodes.at (0);
+			for (size_t i = 1; i < nodes.size (); ++i){
+				for (int j = 0; j < 3; ++j){
+					bounds [0]._v[j] = bounds [0]._v[j] > nodes [i]._v[j] ? nodes [i]._v[j] : bounds [0]._v[j];
+					bounds [1]._v[j] = bounds [1]._v[j] < nodes [i]._v[j] ? nodes [i]._v[j] : bounds [1]._v[j];
+				}
+			}
+			for (int j = 0; j < 3; ++j){
+				bounds [0]._v[j] -= .05;
+				bounds [1]._v[j] += .05;
+			}
+		}
+		vector <real> mass (_mass.begin (), _mass.end ());
+		vector <real> latticeMass (_latticeMass.begin (), _latticeMass.end ());
+		vector <real> embedWeights (_embedWeights.begin (), _embedWeights.end ());
 
-    for (size_t i = 0; i < _mass.size (); ++i){
-      _mass [i] = 1./ _mass [i];
-    }
-  }
+		// surface vertices come first, so their number is one past the largest index of a triangle
+		unsigned int numSurfaceVertices = 0;
+		for (size_t i = 0; i < _trigs.size (); ++i){
+			for (size_t j = 0; j < _trigs [i].size (); ++j){
+				numSurfaceVertices = max (numSurfaceVertices, static_cast <unsigned int> (_trigs [i][j]));
+			}
+		}
+		++numSurfaceVertices;
+
+		// indices are never negative, so the int arrays are stored as they are and read as unsigned int
+		BinaryCacheWriter writer;
+		writer.add (SF_MSD_NODES, nodes);
+		writer.add (SF_MSD_MASSES, mass);
+		writer.add (SF_MSD_SPRINGS, _edges);
+		writer.add (SF_MSD_BOUNDS, bounds);
+		writer.add (SF_MSD_SURFACE, &numSurfaceVertices, 1);
+		for (size_t i = 0; i < _trigs.size (); ++i){
+			writer.add (SF_MSD_FACES + static_cast <uint32_t> (i), _trigs [i]);
+		}
+		list <vector <int> > levels;
+		for (size_t i = 0; i < _levels.size (); ++i){
+			levels.push_back (vector <int> ());
+			getLevelData (i, levels.back ());
+			writer.add (SF_MSD_LEVELS + static_cast <uint32_t> (i), levels.back ());
+		}
+		if (!_latticeNodes.empty ()){
+			writer.add (SF_MSD_LATTICE_NODES, latticeNodes);
+			writer.add (SF_MSD_LATTICE_MASSES, latticeMass);
+			writer.add (SF_MSD_LATTICE_SPRINGS, _latticeEdges);
+			writer.add (SF_MSD_EMBED_REGIONS, _embedRegions);
+			writer.add (SF_MSD_EMBED_NODES, _embedNodes);
+			writer.add (SF_MSD_EMBED_WEIGHTS, embedWeights);
+		}
+		return writer.write (folder + prefix + ".msd.bin", SF_MSD_MESH_KIND, SF_MSD_BUNDLE_STAMP);
+	}
 
 	// method to write elements to files
 	void
 	MSDMesh::writeElementsToFiles (const string &folder, const string &prefix) const
 	{
+		// a bundle left from an earlier export would be loaded instead of these files
+		remove ((folder + prefix + ".msd.bin").c_str ());
+
 		// write out edge file
 		string fname (folder + prefix);
 		fname.append (".edge");
@@ -486,5 +586,70 @@ namespace SF {
 
 			fclose (fp);
 		}
+
+		// write out the coarser surfaces of every submesh (number of levels, then every level as a triangle file)
+		for (size_t i = 0; i < _levels.size (); ++i){
+			stringstream ss;
+			ss << folder << prefix << "." << i << ".lod";
+
+			fp = fopen (ss.str ().c_str (), "w");
+			assert (fp);
+
+			fprintf (fp, "%lu\n", _levels [i].size ());
+			for (size_t l = 0; l < _levels [i].size (); ++l){
+				tptr = const_cast <vector <int>* > (&(_levels [i][l]));
+				fprintf (fp, "%lu\n", tptr->size ()/ 3);
+				for (size_t j = 0; j < tptr->size (); j += 3){
+					fprintf (fp, "%d %d %d\n", tptr->at (j), tptr->at (j + 1), tptr->at (j + 2));
+				}
+			}
+
+			fclose (fp);
+		}
+
+		// write out the coarse lattice (nodes, reciprocal masses and springs as the files above) and the
+		// embedding (per vertex: its region, four lattice nodes and their weights) of a two-level mesh
+		if (!_latticeNodes.empty ()){
+			fname = folder + prefix + ".lattice.node";
+			fp = fopen (fname.c_str (), "w");
+			assert (fp);
+			fprintf (fp, "%lu\n", _latticeNodes.size ());
+			for (size_t i = 0; i < _latticeNodes.size (); ++i){
+				fprintf (fp, "%g %g %g\n", _latticeNodes [i]._v[0], _latticeNodes [i]._v[1], _latticeNodes [i]._v[2]);
+			}
+			fclose (fp);
+
+			fname = folder + prefix + ".lattice.lm";
+			fp = fopen (fname.c_str (), "w");
+			assert (fp);
+			fprintf (fp, "%lu\n", _latticeMass.size ());
+			for (size_t i = 0; i < _latticeMass.size (); ++i){
+				fprintf (fp, "%f\n", _latticeMass [i]);
+			}
+			fclose (fp);
+
+			fname = folder + prefix + ".lattice.edge";
+			fp = fopen (fname.c_str (), "w");
+			assert (fp);
+			fprintf (fp, "%lu\n", _latticeEdges.size ()/ 2);
+			for (size_t i = 0; i < _latticeEdges.size (); i += 2){
+				fprintf (fp, "%d %d\n", _latticeEdges [i], _latticeEdges [i + 1]);
+			}
+			fclose (fp);
+
+			fname = folder + prefix + ".embed";
+			fp = fopen (fname.c_str (), "w");
+			assert (fp);
+			fprintf (fp, "%lu\n", _embedRegions.size ());
+			for (size_t i = 0; i < _embedRegions.size (); ++i){
+				const int *n = &(_embedNodes [4*i]);
+				const float *w = &(_embedWeights [4*i]);
+				fprintf (fp, "%d %d %d %d %d %g %g %g %g\n", _embedRegions [i], n[0], n[1], n[2], n[3], w[0], w[1], w[2], w[3]);
+			}
+			fclose (fp);
+		} else {
+			// files of an earlier two-level export would make the plugin load a lattice this mesh does not match
+			remove ((folder + prefix + ".embed").c_str ());
+		}
 	}
 }
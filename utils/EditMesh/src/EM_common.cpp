@@ -21,8 +21,10 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstddef>
 #include <cstring>
 #include <climits>
+#include <algorithm>
 extern "C"{
 #include <stdint.h>
 }
@@ -31,25 +33,17 @@ extern "C"{
 #include <list>
 #include <string>
 
-#include "crc32.h"
+#include "ArtifactCache.h"
+#include "Topology.h"
 #include "vec3.h"
+#include "IO/TextReader.h"
 #include "EM_common.h"
+#include "EM_parallel.h"
 
 using namespace std;
 
 namespace SF {
 
- 	static inline bool sameCell(int *t1, int *t2)
- 	{
- 		bool flags[4] = {false, false, false, false};
- 		for(int i = 0; i < 4; ++i){
- 			for (int j = 0; j < 4; ++j){
- 				flags[i] |= (t1[i] == t2[j]);
- 			}
- 		}
- 		return flags[0] & flags[1] & flags[2] & flags[3];
- 	}
-
  	static inline bool sameOrder (const int *t1, const int *t2)
  	{
  		int index = -1;
@@ -78,42 +72,14 @@ namespace SF {
  			assert (indices.at (i + 2) != indices.at (i + 3));
  			i >>= 2;
  		}
- 		// detect duplicate cells
- 		vector < vector < Cell > > chash;
- 		vector <Cell>* hptr;
-
- 		chash.reserve( USHRT_MAX + 1);
- 		chash.push_back (vector <Cell> ());
- 		chash.resize (USHRT_MAX + 1, vector <Cell> ());
-
- 		int tmpi[4];
- 		size_t index;
-		char fstr[64], tstr1[16], tstr2[16], tstr3[16];
-
+ 		// detect duplicate cells (equal keys end up next to each other)
+ 		vector <CellKey> keys (size);
  		for (size_t i = 0; i < size; ++i){
- 			i <<= 2;
- 			for (int j = 0; j < 4; ++j){
- 				tmpi[j] = indices.at (i + j);
- 			}
- 			i >>= 2;
- 			qsort (&( tmpi[0]), 4, sizeof (int), compare);
-
-			sprintf (fstr, "%d", tmpi[0]);
-			sprintf (tstr1, "%d", tmpi[1]);
-			strcat (fstr, tstr1);
-			sprintf (tstr2, "%d", tmpi[2]);
-			strcat (fstr, tstr2);
-			sprintf (tstr3, "%d", tmpi[3]);
-			strcat (fstr, tstr3);
-
- 			index = crc32 (fstr, strlen (fstr));
- 			index &= 0x0000ffff;
-
- 			hptr = &( chash.at (index));
- 			for (size_t j = 0; j < hptr->size (); ++j){
- 				assert (!sameCell (tmpi, hptr->at (j)._neighbors));
- 			}
- 			hptr->push_back( Cell (tmpi));
+ 			keys [i] = cellKey (indices.at (4*i), indices.at (4*i + 1), indices.at (4*i + 2), indices.at (4*i + 3));
+ 		}
+ 		parallelSort (keys);
+ 		for (size_t i = 1; i < size; ++i){
+ 			assert (keys [i - 1] != keys [i]);
  		}
  	}
 	void readMesh (const string &folder, const string &prefix, vector < vec3 > &verts, vector < int > &indices)
@@ -124,38 +90,35 @@ namespace SF {
 		string filename (folder + prefix);
 		filename.append (".tet");
 
-		FILE* fp = fopen (filename.c_str (), "r");
-		if (!fp){
+		TextReader reader;
+		if (!reader.open (filename)){
       fprintf (stderr, "error: could not open %s\n", filename.c_str ());
       exit (EXIT_FAILURE);
 		}
 
 		int numVerts = 0, numIndices = 0;
-		int status = fscanf (fp, "%d %d\n", &numVerts, &numIndices);
-		assert (status);
-		assert (numVerts);
-		assert (numIndices);
+		if (!reader.read (numVerts) || !reader.read (numIndices) || numVerts <= 0 || numIndices <= 0){
+      fprintf (stderr, "error: invalid header in %s\n", filename.c_str ());
+      exit (EXIT_FAILURE);
+		}
 
-		verts.reserve (numVerts);
-		indices.reserve (4*numIndices);
+		verts.resize (numVerts);
+		indices.resize (4*numIndices);
 
-		float tmpf[3];
+		bool status = true;
 		for (int i = 0; i < numVerts; ++i){
-			status = fscanf (fp, "%f %f %f\n", &(tmpf[0]), &(tmpf[1]), &(tmpf[2]));
-			assert (status);
-			verts.push_back (vec3 (tmpf));
-		}
-
-		int tmpi[4], mini = numVerts;
-		for (int i = 0; i < numIndices; ++i){
-			status = fscanf (fp, "%d %d %d %d\n", &(tmpi[0]), &(tmpi[1]), &(tmpi[2]), &(tmpi[3]));
-			assert (status);
-			for (int j = 0; j < 4; ++j){
-				mini = mini < tmpi[j] ? mini: tmpi[j];
-				indices.push_back (tmpi[j]);
-			}
+			status = status && reader.read (verts [i]._v, 3);
+		}
+		status = status && reader.read (&(indices [0]), indices.size ());
+		if (!status){
+      fprintf (stderr, "error: %s is truncated or malformed\n", filename.c_str ());
+      exit (EXIT_FAILURE);
+		}
+
+		int mini = numVerts;
+		for (size_t i = 0; i < indices.size (); ++i){
+			mini = mini < indices [i] ? mini : indices [i];
 		}
-		fclose (fp);
 		assert (mini >= 0);
 
 		if (mini){
@@ -199,16 +162,12 @@ namespace SF {
 		}
 
 		// get the extents of the file
-		FILE* fp = fopen (extentfile.c_str (), "r");
-		assert(fp);
-
+		TextReader reader;
 		vec3 from, to;
-		int status = fscanf (fp, "%f %f %f\n", &(from._v[0]), &(from._v[1]), &(from._v[2]));
-		assert (status);
-		status = fscanf (fp, "%f %f %f\n", &(to._v[0]), &(to._v[1]), &(to._v[2]));
-		assert (status);
-
-		fclose (fp);
+		if (!reader.open (extentfile) || !reader.read (from._v, 3) || !reader.read (to._v, 3)){
+      fprintf (stderr, "error: could not read extents from %s\n", extentfile.c_str ());
+      exit (EXIT_FAILURE);
+		}
 
 		// change the extent properties to account for aspect ratio
 		to -= from;
@@ -254,75 +213,13 @@ namespace SF {
 	// function to generate face-topological info for triangular mesh
 	void generateFaceTopology(vector <Face> &top, const vector <int> &faces)
 	{
-		top.reserve (faces.size ()/ 3);
-		top.push_back (Face ());
-		top.resize (faces.size ()/ 3, Face ());
-
-		vector <list <Line> > edges;
-		list <Line> *eptr;
-		list <Line>::iterator iter;
-
-		edges.reserve (USHRT_MAX + 1);
-		edges.push_back (list <Line> ());
-		edges.resize (USHRT_MAX + 1, list <Line> ());
-
-		bool inflag = true;
-		uint32_t index;
-		int tmpi, inds[2];
-		char tmpstr[16], finalstr[32];
+		vector <int> neighbors;
+		matchTriangleEdges (faces.empty () ? static_cast <const int *> (NULL) : &(faces[0]), faces.size ()/ 3, neighbors);
 
+		top.assign (faces.size ()/ 3, Face ());
 		for (size_t i = 0; i < top.size (); ++i){
-			for (int j = 0; j < 3; ++j){
-
-				if (j > 1){
-					inds[0] = faces.at (3*i + 2);
-					inds[1] = faces.at (3*i);
-				} else {
-					inds[0] = faces.at (3*i + j);
-					inds[1] = faces.at (3*i + j + 1);
-				}
-
-				// sort the indices
-				if (inds[0] > inds[1]){
-					tmpi = inds[0];
-					inds[0] = inds[1];
-					inds[1] = tmpi;
-				}
-
-				// form string by concatenating three indices
-				sprintf (finalstr, "%d", inds[0]);
-				sprintf (tmpstr, "%d", inds[1]);
-				assert (strlen (finalstr) + strlen (tmpstr) < 32);
-				strcat (finalstr, tmpstr);
-
-				// get crc32 hash-code and mask it to below 65536
-				index = crc32 (finalstr, strlen (finalstr));
-				index &= 0x0000ffff;
-
-				inflag = false;
-				eptr = &(edges.at (index));
-				iter = eptr->begin ();
-
-				// check for existing entry
-				while (iter != eptr->end ()){
-					if (*iter == &(inds[0])){
-						inflag = true;
-						top.at (i)._neighbors[j] = iter->_owner;
-						top.at (iter->_owner)._neighbors[iter->_face] = i;
-
-						eptr->erase (iter);
-						break;
-					}
-					++iter;
-				}
-
-				// new entry
-				if (!inflag){
-					eptr->push_back (Line (i, j, &(inds[0])));
-				}
-
-			} // end - for (int j = 0; j < 3; ++j)
-		} // end - for (size_t i = 0; i < top.size (); ++i)
+			memcpy (top.at (i)._neighbors, &(neighbors[3*i]), 3*sizeof (int));
+		}
 	}
 
 	// function to check ordering consistency for mesh cells
@@ -436,96 +333,23 @@ namespace SF {
 
 		// generate neighborhood information for cells
 		{
-			vector < list < Trig > > faces;
-			list < Trig >* fptr;
-			list < Trig >::iterator iter;
-			faces.reserve (USHRT_MAX + 1);
-			faces.push_back (list < Trig > ());
-			faces.resize (USHRT_MAX + 1, list < Trig > ());
-
-			bool inflag = false;
-			uint32_t index;
-			int sorted_inds[3];
-			char tmpstr1[16], tmpstr2[16], finalstr[48];
-
+			vector <int> neighbors;
+			vector <unsigned int> boundary;
+			matchTetrahedronFaces (indices.empty () ? static_cast <const int *> (NULL) : &(indices[0]), cells.size (), neighbors, boundary, ParallelSort ());
 			for (size_t i = 0; i < cells.size (); ++i){
-				for (int j = 0; j < 4; ++j){
-
-					// make copy of 3 face indices for each cell
-					switch (j){
-						case 0: // 0-1-2
-							sorted_inds[0] = indices.at (4*i);
-							sorted_inds[1] = indices.at (4*i + 1);
-							sorted_inds[2] = indices.at (4*i + 2);
-							break;
-						case 1: // 0-2-3
-							sorted_inds[0] = indices.at (4*i);
-							sorted_inds[1] = indices.at (4*i + 2);
-							sorted_inds[2] = indices.at (4*i + 3);
-							break;
-						case 2: // 0-3-1
-							sorted_inds[0] = indices.at (4*i);
-							sorted_inds[1] = indices.at (4*i + 3);
-							sorted_inds[2] = indices.at (4*i + 1);
-							break;
-						case 3: // 1-3-2
-							sorted_inds[0] = indices.at (4*i + 1);
-							sorted_inds[1] = indices.at (4*i + 3);
-							sorted_inds[2] = indices.at (4*i + 2);
-					}
-
-					qsort (&(sorted_inds[0]), 3, sizeof (int), compare);
-
-					// form string by concatenating three indices
-					sprintf (finalstr, "%d", sorted_inds[0]);
-					sprintf (tmpstr1, "%d", sorted_inds[1]);
-					sprintf (tmpstr2, "%d", sorted_inds[2]);
-					assert (strlen (finalstr) + strlen (tmpstr1) + strlen (tmpstr2) < 48);
-					strcat (finalstr, tmpstr1);
-					strcat (finalstr, tmpstr2);
-
-					// get crc32 hash-code and mask it to below 65536
-					index = crc32 (finalstr, strlen (finalstr));
-					index &= 0x0000ffff;
-
-					inflag = false;
-					fptr = &(faces.at (index));
-					iter = fptr->begin ();
-
-					// check for existing entry
-					while (iter != fptr->end ()){
-						if (*iter == &(sorted_inds[0])){
-							inflag = true;
-							cells.at (i)._neighbors[j] = iter->_owner;
-							cells.at (iter->_owner)._neighbors[iter->_face] = i;
-
-							fptr->erase (iter);
-							break;
-						}
-						++iter;
-					}
-
-					// new entry
-					if (!inflag){
-						fptr->push_back (Trig (i, j, &(sorted_inds[0])));
-					}
-				} // end - for (int j = 0; j < 4; ++j)
-			} // end - for (size_t i = 0; i < cells.size (); ++i)
-
-
-			// faces now contains list of surface triangles
-			for (size_t i = 0; i < faces.size (); ++i){
-
-				fptr = &(faces.at (i));
+				memcpy (cells.at (i)._neighbors, &(neighbors[4*i]), 4*sizeof (int));
+			}
 
-				while (!fptr->empty ()){
-					for (int j = 0; j < 3; ++j){
-						trigs.push_back (fptr->front ()._indices[j]);
-					}
-					fptr->pop_front ();
+			// unmatched faces are the surface triangles
+			trigs.reserve (trigs.size () + 3*boundary.size ());
+			for (size_t i = 0; i < boundary.size (); ++i){
+				int sorted_inds[3];
+				for (int j = 0; j < 3; ++j){
+					sorted_inds[j] = indices.at (4*(boundary[i]/ 4) + SF_TET_FACE_CORNERS[boundary[i] % 4][j]);
 				}
+				sort (sorted_inds, sorted_inds + 3);
+				trigs.insert (trigs.end (), sorted_inds, sorted_inds + 3);
 			}
-
 		} // end - generate neighborhood information for cells
 
 		// initialize vector flags
@@ -561,4 +385,311 @@ namespace SF {
 
 		fprintf (stdout, "%lu cells (%d flipped)\n%lu surface triangles\n", indices.size ()/ 4, counter, trigs.size ()/ 3);
 	}
+
+	// function to get the reciprocal mass of every vertex
+	void calcMassReciprocal (const vector <vec3> &verts, const vector <int> &cells, vector <float> &mass)
+	{
+		mass.assign (verts.size (), 0.);
+
+		real volume;
+		vec3 a, b, c;
+		for (size_t i = 0; i < cells.size (); i += 4){
+			a = verts [cells [i + 1]] - verts [cells [i]];
+			b = verts [cells [i + 2]] - verts [cells [i]];
+			c = verts [cells [i + 3]] - verts [cells [i]];
+
+			volume = a.dot (b.cross (c))/ 24.;
+			volume = volume < 0. ? -volume: volume;
+
+			for (unsigned int j = 0; j < 4; ++j){
+				mass [cells [i + j]] += volume;
+			}
+		}
+
+		for (size_t i = 0; i < mass.size (); ++i){
+			mass [i] = 1./ mass [i];
+		}
+	}
+
+	// oriented mesh artifact: content version and section ids
+	static const uint32_t SF_ORIENTED_MESH_KIND = 0x454d4f01; // "EMO" version 1
+	enum {
+		SF_ORIENTED_VERTICES = 0, // 3 coordinates per vertex
+		SF_ORIENTED_CELLS,
+		SF_ORIENTED_FACES,
+		SF_ORIENTED_MASS
+	};
+
+	// function to read the oriented mesh stored for key (false if there is none)
+	bool readOrientedMesh (const ArtifactCache &artifacts, const string &prefix, uint32_t key, vector <vec3> &verts, vector <int> &cells,
+	                       vector <int> &faces, vector <float> &mass)
+	{
+		BinaryCacheReader reader;
+		if (!artifacts.read (prefix + ".oriented", SF_ORIENTED_MESH_KIND, key, reader)){
+			return false;
+		}
+
+		const real *coords = NULL;
+		size_t count = 0;
+		if (!reader.get (SF_ORIENTED_VERTICES, coords, count) || !count || count % 3 || !reader.get (SF_ORIENTED_CELLS, cells)
+		    || cells.empty () || cells.size () % 4 || !reader.get (SF_ORIENTED_FACES, faces) || faces.size () % 3
+		    || !reader.get (SF_ORIENTED_MASS, mass) || mass.size () != count/ 3){
+			fprintf (stderr, "warning: %s is not an oriented mesh\n", artifacts.file (prefix + ".oriented", key).c_str ());
+			cells.clear ();
+			faces.clear ();
+			mass.clear ();
+			return false;
+		}
+
+		verts.resize (count/ 3);
+		for (size_t i = 0; i < verts.size (); ++i){
+			verts [i] = vec3 (coords [3*i], coords [3*i + 1], coords [3*i + 2]);
+		}
+		return true;
+	}
+
+	// function to store the oriented mesh for key (false if the artifact store is closed or not writable)
+	bool writeOrientedMesh (const ArtifactCache &artifacts, const string &prefix, uint32_t key, const vector <vec3> &verts,
+	                        const vector <int> &cells, const vector <int> &faces, const vector <float> &mass)
+	{
+		vector <real> coords (3*verts.size ());
+		for (size_t i = 0; i < verts.size (); ++i){
+			for (int j = 0; j < 3; ++j){
+				coords [3*i + j] = verts [i]._v[j];
+			}
+		}
+
+		BinaryCacheWriter writer;
+		writer.add (SF_ORIENTED_VERTICES, coords);
+		writer.add (SF_ORIENTED_CELLS, cells);
+		writer.add (SF_ORIENTED_FACES, faces);
+		writer.add (SF_ORIENTED_MASS, mass);
+		return artifacts.write (prefix + ".oriented", SF_ORIENTED_MESH_KIND, key, writer);
+	}
+
+	// function to interleave the lower 21 bits of x with two zero bits each
+	static inline uint64_t spreadBits (uint64_t x)
+	{
+		x &= 0x1fffffull;
+		x = (x | x << 32) & 0x1f00000000ffffull;
+		x = (x | x << 16) & 0x1f0000ff0000ffull;
+		x = (x | x << 8) & 0x100f00f00f00f00full;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+		x = (x | x << 2) & 0x1249249249249249ull;
+		return x;
+	}
+
+	// function to get the Morton code of p on a 2^21 grid over the box [min, max]
+	static inline uint64_t mortonCode (const vec3 &p, const vec3 &min, const vec3 &max)
+	{
+		uint64_t code = 0;
+		for (int i = 0; i < 3; ++i){
+			real extent = max._v[i] - min._v[i];
+			real t = extent > 0. ? (p._v[i] - min._v[i])/ extent : 0.;
+			t = t < 0. ? 0. : (t > 1. ? 1. : t);
+			code |= spreadBits (static_cast <uint64_t> (t * 0x1fffff)) << i;
+		}
+		return code;
+	}
+
+	// function to get the bounding box of a set of vertices
+	static void getBounds (const vector <vec3> &verts, vec3 &min, vec3 &max)
+	{
+		min = max = verts.at (0);
+		for (size_t i = 1; i < verts.size (); ++i){
+			for (int j = 0; j < 3; ++j){
+				min._v[j] = min._v[j] > verts[i]._v[j] ? verts[i]._v[j] : min._v[j];
+				max._v[j] = max._v[j] < verts[i]._v[j] ? verts[i]._v[j] : max._v[j];
+			}
+		}
+	}
+
+	typedef pair <pair <unsigned int, uint64_t>, unsigned int> CurveKey; // bucket, Morton code, index
+
+	// function to get the curve keys of points [begin, end)
+	static void getCurveKeys (const vector <vec3> *points, const vector <unsigned int> *bucket, vec3 min, vec3 max, vector <CurveKey> *keys,
+	                          size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i){
+			(*keys)[i] = make_pair (make_pair ((*bucket)[i], mortonCode ((*points)[i], min, max)), static_cast <unsigned int> (i));
+		}
+	}
+
+	// function to renumber vertices by bucket, and along a Morton curve within each bucket
+	void reorderVertices (const vector <unsigned int> &bucket, vector <vec3> &verts, vector <int> &cells, vector <int> &faces,
+	                      vector <float> *values)
+	{
+		assert (bucket.size () == verts.size ());
+		vec3 min, max;
+		getBounds (verts, min, max);
+
+		// sort key: bucket, then Morton code, then old index (keeps the order deterministic)
+		vector <CurveKey> order (verts.size ());
+		parallelFor (0, verts.size (), boost::bind (&getCurveKeys, &verts, &bucket, min, max, &order, _1, _2));
+		parallelSort (order);
+
+		vector <int> newIndices (verts.size ());
+		vector <vec3> sorted (verts.size ());
+		for (size_t i = 0; i < order.size (); ++i){
+			newIndices [order [i].second] = static_cast <int> (i);
+			sorted [i] = verts [order [i].second];
+		}
+		verts.swap (sorted);
+
+		if (values){
+			assert (values->size () == verts.size ());
+			vector <float> permuted (values->size ());
+			for (size_t i = 0; i < order.size (); ++i){
+				permuted [i] = (*values) [order [i].second];
+			}
+			values->swap (permuted);
+		}
+
+		for (size_t i = 0; i < cells.size (); ++i){
+			cells [i] = newIndices [cells [i]];
+		}
+		for (size_t i = 0; i < faces.size (); ++i){
+			faces [i] = newIndices [faces [i]];
+		}
+	}
+
+	// function to get the centroids of tetrahedra [begin, end)
+	static void getCentroidRange (const vector <vec3> *verts, const vector <int> *cells, vector <vec3> *centroids, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i){
+			(*centroids)[i] = (*verts)[(*cells)[4*i]] + (*verts)[(*cells)[4*i + 1]] + (*verts)[(*cells)[4*i + 2]] + (*verts)[(*cells)[4*i + 3]];
+			(*centroids)[i] *= 0.25;
+		}
+	}
+
+	// function to get the centroid of every tetrahedron
+	static void getCentroids (const vector <vec3> &verts, const vector <int> &cells, vector <vec3> &centroids)
+	{
+		centroids.resize (cells.size ()/ 4);
+		parallelFor (0, centroids.size (), boost::bind (&getCentroidRange, &verts, &cells, &centroids, _1, _2));
+	}
+
+	// function to sort tetrahedra by bucket, and along a Morton curve through their centroids within each bucket
+	void sortCells (const vector <vec3> &verts, vector <unsigned int> &bucket, vector <int> &cells)
+	{
+		assert (bucket.size () == cells.size ()/ 4);
+		vec3 min, max;
+		getBounds (verts, min, max);
+		vector <vec3> centroids;
+		getCentroids (verts, cells, centroids);
+
+		vector <CurveKey> order (centroids.size ());
+		parallelFor (0, centroids.size (), boost::bind (&getCurveKeys, &centroids, &bucket, min, max, &order, _1, _2));
+		parallelSort (order);
+
+		vector <int> sorted (cells.size ());
+		for (size_t i = 0; i < order.size (); ++i){
+			memcpy (&(sorted [4*i]), &(cells [4*order [i].second]), 4*sizeof (int));
+			bucket [i] = order [i].first.first;
+		}
+		cells.swap (sorted);
+	}
+
+	// functor to order cells along one axis by their centroids (ties broken by index)
+	class CentroidOrder {
+		const vector <vec3> &_centroids;
+		int _axis;
+
+	public:
+		CentroidOrder (const vector <vec3> &centroids, int axis)
+		: _centroids (centroids), _axis (axis)
+		{ }
+
+		inline bool operator () (unsigned int a, unsigned int b) const
+		{
+			return _centroids [a]._v[_axis] < _centroids [b]._v[_axis] || (_centroids [a]._v[_axis] == _centroids [b]._v[_axis] && a < b);
+		}
+	};
+
+	// function to split the cells in [begin, end) into numParts parts, cutting the longest side of their centroids' box at
+	// the cell that divides their count in proportion to the parts on each side
+	static void bisect (const vector <vec3> &centroids, vector <unsigned int>::iterator begin, vector <unsigned int>::iterator end,
+	                    unsigned int numParts, unsigned int firstPart, vector <unsigned int> &part)
+	{
+		if (numParts < 2 || end - begin < 2){
+			for (vector <unsigned int>::iterator i = begin; i != end; ++i){
+				part [*i] = firstPart;
+			}
+			return;
+		}
+
+		vec3 min (centroids [*begin]), max (min);
+		for (vector <unsigned int>::iterator i = begin + 1; i != end; ++i){
+			for (int j = 0; j < 3; ++j){
+				min._v[j] = min._v[j] > centroids [*i]._v[j] ? centroids [*i]._v[j] : min._v[j];
+				max._v[j] = max._v[j] < centroids [*i]._v[j] ? centroids [*i]._v[j] : max._v[j];
+			}
+		}
+		int axis = 0;
+		for (int j = 1; j < 3; ++j){
+			if (max._v[j] - min._v[j] > max._v[axis] - min._v[axis]){
+				axis = j;
+			}
+		}
+
+		unsigned int lower = numParts/ 2;
+		vector <unsigned int>::iterator middle = begin + static_cast <ptrdiff_t> ((end - begin)*static_cast <uint64_t> (lower)/ numParts);
+		nth_element (begin, middle, end, CentroidOrder (centroids, axis));
+
+		bisect (centroids, begin, middle, lower, firstPart, part);
+		bisect (centroids, middle, end, numParts - lower, firstPart + lower, part);
+	}
+
+	// function to bisect groups [begin, end) of cells (groups: where every group starts in order, and where the last ends)
+	static void bisectGroups (const vector <vec3> *centroids, vector <unsigned int> *order, const vector <size_t> *groups, unsigned int numParts,
+	                          vector <unsigned int> *part, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i){
+			unsigned int first = (*part)[(*order)[(*groups)[i]]]*numParts;
+			bisect (*centroids, order->begin () + (*groups)[i], order->begin () + (*groups)[i + 1], numParts, first, *part);
+		}
+	}
+
+	// function to split every part of the cells into numParts balanced parts by recursive coordinate bisection
+	void partitionCells (const vector <vec3> &verts, const vector <int> &cells, unsigned int numParts, vector <unsigned int> &part)
+	{
+		assert (part.size () == cells.size ()/ 4);
+		assert (numParts > 0);
+		vector <vec3> centroids;
+		getCentroids (verts, cells, centroids);
+
+		// cells grouped by the part they are in so far
+		vector <pair <unsigned int, unsigned int> > groups (part.size ());
+		for (size_t i = 0; i < part.size (); ++i){
+			groups [i] = make_pair (part [i], static_cast <unsigned int> (i));
+		}
+		parallelSort (groups);
+		vector <unsigned int> order (groups.size ());
+		for (size_t i = 0; i < groups.size (); ++i){
+			order [i] = groups [i].second;
+		}
+
+		// groups are independent of each other
+		vector <size_t> starts;
+		for (size_t i = 0; i < groups.size (); ++i){
+			if (!i || groups [i].first != groups [i - 1].first){
+				starts.push_back (i);
+			}
+		}
+		starts.push_back (groups.size ());
+		parallelFor (0, starts.size () - 1, boost::bind (&bisectGroups, &centroids, &order, &starts, numParts, &part, _1, _2), 1);
+	}
+
+	// function to assign every vertex to the lowest part among its cells (0 for vertices in no cell)
+	void getVertexParts (size_t numVerts, const vector <int> &cells, const vector <unsigned int> &cellPart, vector <unsigned int> &vertPart)
+	{
+		vertPart.assign (numVerts, UINT_MAX);
+		for (size_t i = 0; i < cells.size (); ++i){
+			unsigned int &p = vertPart [cells [i]];
+			p = p < cellPart [i/ 4] ? p : cellPart [i/ 4];
+		}
+		for (size_t i = 0; i < numVerts; ++i){
+			vertPart [i] = vertPart [i] == UINT_MAX ? 0 : vertPart [i];
+		}
+	}
 }
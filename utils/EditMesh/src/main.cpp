@@ -30,8 +30,10 @@ extern "C" {
 #include <boost/shared_ptr.hpp>
 
 #include "Preprocess.h"
+#include "ArtifactCache.h"
 #include "vec3.h"
 #include "EM_common.h"
+#include "EM_parallel.h"
 #include "EM_Mesh.h"
 #include "EM_FEMMesh.h"
 #include "EM_MSDMesh.h"
@@ -47,6 +49,7 @@ static inline void makeOutputFolder (const int formatcode, const int max_depth,
 			folder.append ("fem/");
 			break;
 		case 1:
+		case 2:
 			folder.append ("msd/");
 			break;
 	}
@@ -74,12 +77,20 @@ static void display_usage ()
 	cerr << "Mandatory argument:" << endl;
 	cerr << "\t-i [--input-dir] <folder_name>\tfolder name" << endl;
 	cerr << "\t-p [--file-prefix] <prefix>\tfile prefix of tetrahedron mesh file" << endl;
-	cerr << "\t-f [--format] <format>\t\toutput format (\"fem\" or \"msd\")" << endl;
+	cerr << "\t-f [--format] <format>\t\toutput format (\"fem\", \"msd\" or \"bin\")" << endl;
+	cerr << "\t\t\t\t\t\"bin\" writes the msd mesh as one binary bundle (prefix.msd.bin)" << endl;
+	cerr << "\t\t\t\t\tthat the mass-spring plugin maps instead of reading text files" << endl;
 	cerr << "\t-d [--depth] <depth>\t\tdepth of recursion for mesh sub-division" << endl;
 	cerr << "\t\t\t\t\tThe total number of sub-divisions is 8^depth" << endl;
+	cerr << "\t\t\t\t\tSub-divisions are balanced by their number of cells" << endl;
 
 	cerr << "Optional arguments:" << endl;
 	cerr << "\t-e [--ext-file] <f> <x> <y> <z>\t<f>: file with mesh extents, <x> <y> <z>: aspect ratio (Default: none)" << endl;
+	cerr << "\t-n [--partitions] <n>\t\tnumber of partitions in every FEM sub-division (Default: 1)" << endl;
+	cerr << "\t-l [--levels] <n>\t\tnumber of coarser surfaces per msd sub-division, for rendering (Default: 3)" << endl;
+	cerr << "\t-c [--coarse] <s>\t\tmsd only: also embed the mesh in a coarse lattice of spacing <s> mean" << endl;
+	cerr << "\t\t\t\t\tspring lengths, for two-level simulation (Default: none)" << endl;
+	cerr << "\t-j [--threads] <n>\t\tnumber of threads (Default: number of cores)" << endl;
 	cerr << "\t-r [--reverse]\t\t\treverse flag: reverses orientation of starting tetrahedron" << endl;
 	cerr << "\t-xyz [--start-axis] <opt>\t<opt> valid inputs - \"x\", \"y\", \"z\", \"X\", \"Y\" or \"Z\" (Default: x)" << endl;
 	cerr << "\t\t\t\t\tStart axis signifies tetrahedron with min/max vertex in specified" << endl;
@@ -97,6 +108,8 @@ main (int argc, char* argv  [])
 
 	// input variables
 	int max_depth = -1;
+	unsigned int num_partitions = 1;
+	bool bundle = false;
 	string folder, prefix;
 
 	shared_ptr< Mesh > mesh;
@@ -107,6 +120,8 @@ main (int argc, char* argv  [])
 		bool reverseflag = false;
 		int formatcode = -1;
 		int startcode = 0;
+		unsigned int num_levels = SF_MSD_LOD_LEVELS;
+		float lattice_scale = 0.;
 		string extentfile;
 		float aspect_ratio [3] = {1., 1., 1.};
 
@@ -128,11 +143,13 @@ main (int argc, char* argv  [])
 				++index;
 				if ( !strcmp (argv [index], "fem")){
 					formatcode = 0;
-					mesh = shared_ptr< Mesh > (new FEMMesh ());
 				}
 				else if (!strcmp (argv [index], "msd")){
 					formatcode = 1;
-					mesh = shared_ptr< Mesh > (new MSDMesh ());
+				}
+				else if (!strcmp (argv [index], "bin")){
+					formatcode = 2;
+					bundle = true;
 				}
 				else {
 					cerr << "error: could not recognize format: " << argv [index] << "...aborting" << endl << endl;
@@ -151,6 +168,55 @@ main (int argc, char* argv  [])
 				}
 				max_depth = atoi (argv [index]);
 			}
+			else if (!strcmp (argv [index], "-n") || !strcmp (argv [index], "--partitions")){
+				++index;
+				for (unsigned int i = 0; i < strlen (argv [index]); ++i){
+					if (!isdigit (argv [index] [i])){
+					  cerr << "error: invalid -n option: " << argv [index] << endl;
+					  display_usage ();
+					  exit (EXIT_FAILURE);
+					}
+				}
+				num_partitions = static_cast <unsigned int> (atoi (argv [index]));
+				if (!num_partitions){
+				  cerr << "error: invalid -n option: " << argv [index] << endl;
+				  display_usage ();
+				  exit (EXIT_FAILURE);
+				}
+			}
+			else if (!strcmp (argv [index], "-l") || !strcmp (argv [index], "--levels")){
+				++index;
+				for (unsigned int i = 0; i < strlen (argv [index]); ++i){
+					if (!isdigit (argv [index] [i])){
+					  cerr << "error: invalid -l option: " << argv [index] << endl;
+					  display_usage ();
+					  exit (EXIT_FAILURE);
+					}
+				}
+				num_levels = static_cast <unsigned int> (atoi (argv [index]));
+			}
+			else if (!strcmp (argv [index], "-c") || !strcmp (argv [index], "--coarse")){
+				++index;
+				for (unsigned int i = 0; i < strlen (argv [index]); ++i){
+					if (!isdigit (argv [index] [i]) && argv [index] [i] != '.'){
+					  cerr << "error: invalid -c option: " << argv [index] << endl;
+					  display_usage ();
+					  exit (EXIT_FAILURE);
+					}
+				}
+				lattice_scale = static_cast <float> (atof (argv [index]));
+			}
+			else if (!strcmp (argv [index], "-j") || !strcmp (argv [index], "--threads")){
+				++index;
+				for (unsigned int i = 0; i < strlen (argv [index]); ++i){
+					if (!isdigit (argv [index] [i])){
+					  cerr << "error: invalid -j option: " << argv [index] << endl;
+					  display_usage ();
+					  exit (EXIT_FAILURE);
+					}
+				}
+				numThreads () = max (atoi (argv [index]), 1);
+			}
 			else if (!strcmp (argv [index], "-e") || !strcmp (argv [index], "--ext-file")){
 				extentfile = string (argv [++index]);
 
@@ -202,33 +268,66 @@ main (int argc, char* argv  [])
 		assert (!folder.empty ());
 		assert (!prefix.empty ());
 		assert (max_depth >= 0);
+		if (formatcode < 0){
+			cerr << "error: no output format given...aborting" << endl << endl;
+			display_usage ();
+			exit (EXIT_FAILURE);
+		}
+		if (!formatcode){
+			mesh = shared_ptr< Mesh > (new FEMMesh ());
+		} else {
+			mesh = shared_ptr< Mesh > (new MSDMesh (num_levels, lattice_scale));
+		}
+
+		// the oriented mesh depends on the input files and the options above only, so it is
+		// reused from the artifact store when just the depth, format or partitions change
+		ArtifactCache artifacts;
+		artifacts.open (folder + "artifacts");
+		ArtifactKey key;
+		key.add (prefix).add (extentfile).add (aspect_ratio, sizeof (aspect_ratio)).add (startcode).add (reverseflag);
+		bool sources = key.addFile (folder + prefix + ".tet") && (extentfile.empty () || key.addFile (extentfile));
 
-		// read in file
 		Mesh* mptr = mesh.get ();
-		readMesh (folder, prefix, mptr->_vertices, mptr->_cells);
-
-		// get index of starting vertex and optionally scale vertices to the extents given by the extent file
-		int startvertex = -1;
-		processVertices (extentfile, aspect_ratio, mptr->_vertices, startcode, startvertex);
-		assert (startvertex >= 0);
-
-		// get index of the starting cell
-		startcell = getStartingCell (startvertex, mptr->_cells);
-
-		// if reverseflag is ON, change orientation of starting cell
-		if (reverseflag){
-			int ind = 4*startcell;
-			int tmp = mptr->_cells.at (ind);
-			mptr->_cells.at (ind) = mptr->_cells.at (ind + 1);
-			mptr->_cells.at(ind + 1) = tmp;
+		if (sources && readOrientedMesh (artifacts, prefix, key.value (), mptr->_vertices, mptr->_cells, mptr->_faces, mptr->_mass)){
+			fprintf (stdout, "%lu cells\n%lu surface triangles (oriented mesh reused from %s)\n", mptr->_cells.size ()/ 4,
+			         mptr->_faces.size ()/ 3, artifacts.file (prefix + ".oriented", key.value ()).c_str ());
+		} else {
+			// read in file
+			readMesh (folder, prefix, mptr->_vertices, mptr->_cells);
+
+			// get index of starting vertex and optionally scale vertices to the extents given by the extent file
+			int startvertex = -1;
+			processVertices (extentfile, aspect_ratio, mptr->_vertices, startcode, startvertex);
+			assert (startvertex >= 0);
+
+			// get index of the starting cell
+			startcell = getStartingCell (startvertex, mptr->_cells);
+
+			// if reverseflag is ON, change orientation of starting cell
+			if (reverseflag){
+				int ind = 4*startcell;
+				int tmp = mptr->_cells.at (ind);
+				mptr->_cells.at (ind) = mptr->_cells.at (ind + 1);
+				mptr->_cells.at(ind + 1) = tmp;
+			}
+
+			orderCells (reverseflag, startcell, mptr->_cells, mptr->_faces);
+			calcMassReciprocal (mptr->_vertices, mptr->_cells, mptr->_mass);
+
+			if (sources){
+				writeOrientedMesh (artifacts, prefix, key.value (), mptr->_vertices, mptr->_cells, mptr->_faces, mptr->_mass);
+			}
 		}
 
 		// formulate the output folder-name
 		makeOutputFolder (formatcode, max_depth, folder);
-
-		orderCells (reverseflag, startcell, mptr->_cells, mptr->_faces);
 	}
 
-	mesh.get ()->process (max_depth);
-	mesh.get ()->writeToFiles (folder, prefix);
+	mesh.get ()->process (max_depth, num_partitions);
+	if (!bundle){
+		mesh.get ()->writeToFiles (folder, prefix);
+	} else if (!mesh.get ()->writeBundle (folder, prefix)){
+		cerr << "error: could not write bundle " << folder << prefix << ".msd.bin" << endl;
+		exit (EXIT_FAILURE);
+	}
 }